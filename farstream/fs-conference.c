@@ -24,6 +24,10 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
  */
 
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
@@ -32,6 +36,22 @@
 #include "fs-session.h"
 #include "fs-private.h"
 
+#include <errno.h>
+#include <string.h>
+
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+
+#ifdef HAVE_SYS_RESOURCE_H
+#include <sys/resource.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 /**
  * SECTION:fs-conference
  * @short_description: Interface for farstream conference elements
@@ -55,6 +75,10 @@
  * </para>
  * </refsect2>
  *
+ * The streaming threads started inside the conference are sorted in
+ * #FsThreadClass classes when they start, and the scheduling settings of
+ * the #FsConference:thread-policy for their class are applied to them.
+ *
  */
 
 
@@ -62,8 +86,61 @@ GST_DEBUG_CATEGORY (_fs_conference_debug);
 #define GST_CAT_DEFAULT _fs_conference_debug
 
 
+/* Properties */
+enum
+{
+  PROP_0,
+  PROP_THREAD_POLICY
+};
+
+struct _FsConferencePrivate
+{
+  /* Protected by GST_OBJECT_LOCK */
+  GstStructure *thread_policy;
+};
+
 G_DEFINE_ABSTRACT_TYPE (FsConference, fs_conference, GST_TYPE_BIN)
 
+#define FS_CONFERENCE_GET_PRIVATE(o)                                    \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), FS_TYPE_CONFERENCE, FsConferencePrivate))
+
+/* List of the conferences the current thread is a streaming thread of */
+static GPrivate internal_thread_conferences =
+  G_PRIVATE_INIT ((GDestroyNotify) g_slist_free);
+
+/* The scheduling settings the current thread had before a conference
+ * applied its thread policy, restored when the thread leaves it */
+struct SavedThreadPolicy {
+  FsConference *conference;
+
+  gboolean has_scheduler;
+  gint scheduler;
+#ifdef HAVE_SCHED_SETSCHEDULER
+  struct sched_param param;
+#endif
+
+  gboolean has_priority;
+  gint priority;
+
+  gboolean has_cpus;
+#ifdef HAVE_SCHED_SETAFFINITY
+  cpu_set_t cpus;
+#endif
+};
+
+static GPrivate saved_thread_policy = G_PRIVATE_INIT (g_free);
+
+static void fs_conference_finalize (GObject *object);
+static void fs_conference_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec);
+static void fs_conference_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec);
+static void fs_conference_handle_message (GstBin *bin, GstMessage *message);
+
 
 GQuark
 fs_error_quark (void)
@@ -81,13 +158,572 @@ _fs_conference_init_debug (void)
 static void
 fs_conference_class_init (FsConferenceClass * klass)
 {
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBinClass *gstbin_class = GST_BIN_CLASS (klass);
+
   _fs_conference_init_debug ();
+
+  g_type_class_add_private (klass, sizeof (FsConferencePrivate));
+
+  gobject_class->finalize = fs_conference_finalize;
+  gobject_class->get_property = fs_conference_get_property;
+  gobject_class->set_property = fs_conference_set_property;
+
+  gstbin_class->handle_message =
+    GST_DEBUG_FUNCPTR (fs_conference_handle_message);
+
+  /**
+   * FsConference:thread-policy:
+   *
+   * The scheduling settings applied to the streaming threads of the
+   * conference, according to their #FsThreadClass. It is a #GstStructure
+   * that can contain, for each class, the following fields, where
+   * <literal>class</literal> is the nick of the #FsThreadClass
+   * (ie "audio-send", "video-encode", "network-receive", "jitterbuffer"
+   * or "other"):
+   *
+   * <refsect2>
+   * |[
+   * "class-scheduler"   gchar*  One of "other", "batch", "idle", "fifo" or "rr"
+   * "class-priority"    gint    The nice level, or the realtime priority for
+   *                             the "fifo" and "rr" schedulers
+   * "class-cpus"        gchar*  The CPUs the thread can run on, ie "0,2-3"
+   * ]|
+   * </refsect2>
+   *
+   * The settings are applied when a thread enters the conference and the
+   * previous settings of the thread are restored when it leaves it, so that
+   * a pooled thread does not keep them when it is reused for another task.
+   * Settings that are not supported by the platform or that the process is
+   * not allowed to apply are ignored with a warning.
+   *
+   * Since: UNRELEASED
+   */
+  g_object_class_install_property (gobject_class, PROP_THREAD_POLICY,
+      g_param_spec_boxed ("thread-policy",
+          "Scheduling settings of the streaming threads",
+          "Scheduling class, priority and CPU affinity to apply to each class"
+          " of streaming threads",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
 fs_conference_init (FsConference *conf)
 {
   GST_DEBUG_OBJECT (conf, "fs_conference_init");
+
+  conf->priv = FS_CONFERENCE_GET_PRIVATE (conf);
+}
+
+static void
+fs_conference_finalize (GObject *object)
+{
+  FsConference *self = FS_CONFERENCE (object);
+
+  if (self->priv->thread_policy)
+    gst_structure_free (self->priv->thread_policy);
+
+  G_OBJECT_CLASS (fs_conference_parent_class)->finalize (object);
+}
+
+static void
+fs_conference_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsConference *self = FS_CONFERENCE (object);
+
+  switch (prop_id)
+  {
+    case PROP_THREAD_POLICY:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boxed (value, self->priv->thread_policy);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+fs_conference_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsConference *self = FS_CONFERENCE (object);
+
+  switch (prop_id)
+  {
+    case PROP_THREAD_POLICY:
+      GST_OBJECT_LOCK (self);
+      if (self->priv->thread_policy)
+        gst_structure_free (self->priv->thread_policy);
+      self->priv->thread_policy = g_value_dup_boxed (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static gboolean
+klass_has (const gchar *klass, const gchar *word)
+{
+  return klass && strstr (klass, word) != NULL;
+}
+
+static GstPad *
+get_first_src_pad (GstElement *element)
+{
+  GstPad *pad = NULL;
+
+  GST_OBJECT_LOCK (element);
+  if (element->srcpads)
+    pad = gst_object_ref (element->srcpads->data);
+  GST_OBJECT_UNLOCK (element);
+
+  return pad;
+}
+
+/* Bounds the walk in case the pipeline has a loop */
+#define MAX_POSITION_HOPS 64
+
+/*
+ * Follows the data downstream of @element, through the bins, and returns
+ * %TRUE if it leaves the conference through one of its source pads. That
+ * is where the receive side ends, the send side ends in the sinks of the
+ * transmitters.
+ */
+
+static gboolean
+is_on_receive_side (FsConference *self, GstElement *element)
+{
+  GstPad *pad = get_first_src_pad (element);
+  gboolean ret = FALSE;
+  guint hops;
+
+  for (hops = 0; pad && !ret && hops < MAX_POSITION_HOPS; hops++)
+  {
+    GstPad *peer = gst_pad_get_peer (pad);
+    GstObject *parent;
+
+    gst_object_unref (pad);
+    pad = NULL;
+
+    if (!peer)
+      break;
+
+    parent = gst_object_get_parent (GST_OBJECT (peer));
+    if (parent && GST_IS_PAD (parent))
+    {
+      /* The internal pad of a source ghost pad, the data leaves a bin */
+      GstObject *bin = gst_object_get_parent (parent);
+
+      if (bin == GST_OBJECT (self))
+        ret = TRUE;
+      else
+        pad = GST_PAD (gst_object_ref (parent));
+
+      if (bin)
+        gst_object_unref (bin);
+    }
+    else if (GST_IS_GHOST_PAD (peer))
+    {
+      /* A sink ghost pad, the data enters a bin */
+      pad = GST_PAD (gst_proxy_pad_get_internal (GST_PROXY_PAD (peer)));
+    }
+    else if (parent && GST_IS_ELEMENT (parent))
+    {
+      pad = get_first_src_pad (GST_ELEMENT (parent));
+    }
+
+    if (parent)
+      gst_object_unref (parent);
+    gst_object_unref (peer);
+  }
+
+  if (pad)
+    gst_object_unref (pad);
+
+  return ret;
+}
+
+static FsThreadClass
+classify_element (FsConference *self, GstElement *element,
+    gboolean look_downstream)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *name;
+  const gchar *klass;
+
+  if (!factory)
+    return FS_THREAD_CLASS_OTHER;
+
+  name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+  klass = gst_element_factory_get_metadata (factory,
+      GST_ELEMENT_METADATA_KLASS);
+
+  if (!strcmp (name, "rtpjitterbuffer"))
+    return FS_THREAD_CLASS_JITTERBUFFER;
+
+  if (GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SOURCE) &&
+      ((klass_has (klass, "Network") && !klass_has (klass, "RTP")) ||
+          !strcmp (name, "shmsrc")))
+    return FS_THREAD_CLASS_NETWORK_RECEIVE;
+
+  if (klass_has (klass, "Video") && klass_has (klass, "Encoder"))
+    return FS_THREAD_CLASS_VIDEO_ENCODE;
+
+  /* Decoders and the other audio elements of the receive side are audio
+   * too, so the position of the element decides */
+  if ((klass_has (klass, "Audio") ||
+          (GST_OBJECT_FLAG_IS_SET (element, GST_ELEMENT_FLAG_SOURCE) &&
+              klass_has (klass, "RTP"))) &&
+      !is_on_receive_side (self, element))
+    return FS_THREAD_CLASS_AUDIO_SEND;
+
+  /* Queues and other generic elements take the class of the element they
+   * push into */
+  if (look_downstream)
+  {
+    GstPad *pad = get_first_src_pad (element);
+    GstPad *peer = pad ? gst_pad_get_peer (pad) : NULL;
+    FsThreadClass thread_class = FS_THREAD_CLASS_OTHER;
+
+    if (peer)
+    {
+      GstElement *peer_element = gst_pad_get_parent_element (peer);
+
+      if (peer_element)
+      {
+        thread_class = classify_element (self, peer_element, FALSE);
+        gst_object_unref (peer_element);
+      }
+      gst_object_unref (peer);
+    }
+    if (pad)
+      gst_object_unref (pad);
+
+    return thread_class;
+  }
+
+  return FS_THREAD_CLASS_OTHER;
+}
+
+static FsThreadClass
+fs_conference_classify_thread (FsConference *self, GstElement *owner)
+{
+  if (!owner)
+    return FS_THREAD_CLASS_OTHER;
+
+  return classify_element (self, owner, TRUE);
+}
+
+#ifdef HAVE_SCHED_SETAFFINITY
+static gboolean
+parse_cpu_list (const gchar *cpus, cpu_set_t *set)
+{
+  gchar **ranges = g_strsplit (cpus, ",", 0);
+  gboolean ret = TRUE;
+  guint i;
+
+  CPU_ZERO (set);
+
+  for (i = 0; ranges[i]; i++)
+  {
+    gchar *end = NULL;
+    guint64 first, last;
+
+    first = g_ascii_strtoull (ranges[i], &end, 10);
+    if (end == ranges[i])
+    {
+      ret = FALSE;
+      break;
+    }
+    last = first;
+    if (*end == '-')
+    {
+      const gchar *start = end + 1;
+
+      last = g_ascii_strtoull (start, &end, 10);
+      if (end == start)
+      {
+        ret = FALSE;
+        break;
+      }
+    }
+    if (*end != '\0' || last < first || last >= CPU_SETSIZE)
+    {
+      ret = FALSE;
+      break;
+    }
+
+    for (; first <= last; first++)
+      CPU_SET (first, set);
+  }
+
+  g_strfreev (ranges);
+
+  return ret;
+}
+#endif
+
+static void
+fs_conference_apply_thread_policy (FsConference *self,
+    FsThreadClass thread_class, struct SavedThreadPolicy *saved)
+{
+  GstStructure *policy = NULL;
+  GEnumClass *enum_class;
+  const gchar *nick;
+  gchar *field;
+  const gchar *scheduler;
+  const gchar *cpus;
+  gint priority = 0;
+  gboolean has_priority;
+  gboolean realtime = FALSE;
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->thread_policy)
+    policy = gst_structure_copy (self->priv->thread_policy);
+  GST_OBJECT_UNLOCK (self);
+
+  if (!policy)
+    return;
+
+  enum_class = g_type_class_ref (FS_TYPE_THREAD_CLASS);
+  nick = g_enum_get_value (enum_class, thread_class)->value_nick;
+
+  field = g_strdup_printf ("%s-priority", nick);
+  has_priority = gst_structure_get_int (policy, field, &priority);
+  g_free (field);
+
+  field = g_strdup_printf ("%s-scheduler", nick);
+  scheduler = gst_structure_get_string (policy, field);
+  g_free (field);
+
+  field = g_strdup_printf ("%s-cpus", nick);
+  cpus = gst_structure_get_string (policy, field);
+  g_free (field);
+
+  if (scheduler)
+  {
+#ifdef HAVE_SCHED_SETSCHEDULER
+    struct sched_param param = {0};
+    gint sched_policy = -1;
+
+    if (!strcmp (scheduler, "other"))
+      sched_policy = SCHED_OTHER;
+#ifdef SCHED_BATCH
+    else if (!strcmp (scheduler, "batch"))
+      sched_policy = SCHED_BATCH;
+#endif
+#ifdef SCHED_IDLE
+    else if (!strcmp (scheduler, "idle"))
+      sched_policy = SCHED_IDLE;
+#endif
+    else if (!strcmp (scheduler, "fifo"))
+      sched_policy = SCHED_FIFO;
+    else if (!strcmp (scheduler, "rr"))
+      sched_policy = SCHED_RR;
+
+    if (sched_policy == SCHED_FIFO || sched_policy == SCHED_RR)
+    {
+      realtime = TRUE;
+      param.sched_priority = CLAMP (priority,
+          sched_get_priority_min (sched_policy),
+          sched_get_priority_max (sched_policy));
+    }
+
+    if (sched_policy < 0)
+    {
+      GST_WARNING_OBJECT (self, "Unknown scheduler \"%s\" for %s threads",
+          scheduler, nick);
+    }
+    else
+    {
+      if (!saved->has_scheduler)
+      {
+        saved->scheduler = sched_getscheduler (0);
+        saved->has_scheduler = saved->scheduler >= 0 &&
+            sched_getparam (0, &saved->param) == 0;
+      }
+
+      if (sched_setscheduler (0, sched_policy, &param) < 0)
+        GST_WARNING_OBJECT (self, "Could not set the %s scheduler on a %s"
+            " thread: %s", scheduler, nick, g_strerror (errno));
+    }
+#else
+    GST_WARNING_OBJECT (self, "Setting the scheduler of a thread is not"
+        " supported on this platform");
+#endif
+  }
+
+  if (has_priority && !realtime)
+  {
+#if defined (HAVE_SETPRIORITY) && defined (__linux__)
+    /* On Linux, the nice level is per thread */
+    if (!saved->has_priority)
+    {
+      /* getpriority() can legitimately return -1 */
+      errno = 0;
+      saved->priority = getpriority (PRIO_PROCESS, syscall (SYS_gettid));
+      saved->has_priority = (errno == 0);
+    }
+
+    if (setpriority (PRIO_PROCESS, syscall (SYS_gettid), priority) < 0)
+      GST_WARNING_OBJECT (self, "Could not set the nice level of a %s thread"
+          " to %d: %s", nick, priority, g_strerror (errno));
+#else
+    GST_WARNING_OBJECT (self, "Setting the nice level of a thread is not"
+        " supported on this platform");
+#endif
+  }
+
+  if (cpus)
+  {
+#ifdef HAVE_SCHED_SETAFFINITY
+    cpu_set_t set;
+
+    if (!parse_cpu_list (cpus, &set))
+    {
+      GST_WARNING_OBJECT (self, "Invalid CPU list \"%s\" for %s threads",
+          cpus, nick);
+    }
+    else
+    {
+      if (!saved->has_cpus)
+        saved->has_cpus = sched_getaffinity (0, sizeof (saved->cpus),
+            &saved->cpus) == 0;
+
+      if (sched_setaffinity (0, sizeof (set), &set) < 0)
+        GST_WARNING_OBJECT (self, "Could not set the CPU affinity of a %s"
+            " thread to %s: %s", nick, cpus, g_strerror (errno));
+    }
+#else
+    GST_WARNING_OBJECT (self, "Setting the CPU affinity of a thread is not"
+        " supported on this platform");
+#endif
+  }
+
+  g_type_class_unref (enum_class);
+  gst_structure_free (policy);
+}
+
+static void
+fs_conference_restore_thread_policy (FsConference *self,
+    struct SavedThreadPolicy *saved)
+{
+#ifdef HAVE_SCHED_SETSCHEDULER
+  if (saved->has_scheduler &&
+      sched_setscheduler (0, saved->scheduler, &saved->param) < 0)
+    GST_WARNING_OBJECT (self, "Could not restore the scheduler of a thread:"
+        " %s", g_strerror (errno));
+#endif
+
+#if defined (HAVE_SETPRIORITY) && defined (__linux__)
+  if (saved->has_priority &&
+      setpriority (PRIO_PROCESS, syscall (SYS_gettid), saved->priority) < 0)
+    GST_WARNING_OBJECT (self, "Could not restore the nice level of a thread"
+        " to %d: %s", saved->priority, g_strerror (errno));
+#endif
+
+#ifdef HAVE_SCHED_SETAFFINITY
+  if (saved->has_cpus &&
+      sched_setaffinity (0, sizeof (saved->cpus), &saved->cpus) < 0)
+    GST_WARNING_OBJECT (self, "Could not restore the CPU affinity of a"
+        " thread: %s", g_strerror (errno));
+#endif
+}
+
+static void
+fs_conference_handle_message (GstBin *bin, GstMessage *message)
+{
+  FsConference *self = FS_CONFERENCE (bin);
+
+  if (GST_MESSAGE_TYPE (message) == GST_MESSAGE_STREAM_STATUS)
+  {
+    GstStreamStatusType type;
+    GstElement *owner = NULL;
+    GSList *conferences;
+    struct SavedThreadPolicy *saved;
+
+    gst_message_parse_stream_status (message, &type, &owner);
+
+    /* The ENTER and LEAVE messages are posted from the streaming thread
+     * itself, so the membership can live in thread-local storage */
+    switch (type)
+    {
+      case GST_STREAM_STATUS_TYPE_ENTER:
+      {
+        FsThreadClass thread_class;
+
+        conferences = g_private_get (&internal_thread_conferences);
+        if (!g_slist_find (conferences, self))
+          g_private_set (&internal_thread_conferences,
+              g_slist_prepend (conferences, self));
+
+        thread_class = fs_conference_classify_thread (self, owner);
+        GST_DEBUG_OBJECT (self, "Thread of %s entered, class %d",
+            owner ? GST_ELEMENT_NAME (owner) : "(unknown)", thread_class);
+
+        /* If the thread is already inside another conference, the settings
+         * it had before that one are the ones to restore */
+        saved = g_private_get (&saved_thread_policy);
+        if (!saved)
+        {
+          saved = g_new0 (struct SavedThreadPolicy, 1);
+          saved->conference = self;
+          g_private_set (&saved_thread_policy, saved);
+        }
+        fs_conference_apply_thread_policy (self, thread_class, saved);
+        break;
+      }
+      case GST_STREAM_STATUS_TYPE_LEAVE:
+        conferences = g_private_get (&internal_thread_conferences);
+        if (g_slist_find (conferences, self))
+          g_private_set (&internal_thread_conferences,
+              g_slist_remove (conferences, self));
+
+        saved = g_private_get (&saved_thread_policy);
+        if (saved && saved->conference == self)
+        {
+          fs_conference_restore_thread_policy (self, saved);
+          g_private_replace (&saved_thread_policy, NULL);
+        }
+        break;
+      default:
+        /* Do nothing */
+        break;
+    }
+  }
+
+  GST_BIN_CLASS (fs_conference_parent_class)->handle_message (bin, message);
+}
+
+/**
+ * fs_conference_is_internal_thread:
+ * @conference: a #FsConference
+ *
+ * Checks if the calling thread is a streaming thread started by an element
+ * inside @conference.
+ *
+ * Returns: %TRUE if the current thread is a streaming thread of @conference
+ *
+ * Since: UNRELEASED
+ */
+
+gboolean
+fs_conference_is_internal_thread (FsConference *conference)
+{
+  g_return_val_if_fail (FS_IS_CONFERENCE (conference), FALSE);
+
+  return g_slist_find (g_private_get (&internal_thread_conferences),
+      conference) != NULL;
 }
 
 
@@ -51,6 +51,7 @@ G_BEGIN_DECLS
 
 typedef struct _FsConference FsConference;
 typedef struct _FsConferenceClass FsConferenceClass;
+typedef struct _FsConferencePrivate FsConferencePrivate;
 
 /**
  * FsConference:
@@ -64,7 +65,9 @@ struct _FsConference
 
   /*< private >*/
 
-  gpointer _padding[8];
+  FsConferencePrivate *priv;
+
+  gpointer _padding[7];
 };
 
 
@@ -141,6 +144,32 @@ typedef enum
   FS_ERROR_ALREADY_EXISTS
 } FsError;
 
+/**
+ * FsThreadClass:
+ * @FS_THREAD_CLASS_OTHER: Any other streaming thread of the conference
+ * @FS_THREAD_CLASS_AUDIO_SEND: A thread that produces or encodes audio to be
+ *  sent
+ * @FS_THREAD_CLASS_VIDEO_ENCODE: A thread that encodes video to be sent
+ * @FS_THREAD_CLASS_NETWORK_RECEIVE: A thread that receives packets from the
+ *  network
+ * @FS_THREAD_CLASS_JITTERBUFFER: A thread that pushes the received packets
+ *  out of a jitterbuffer
+ *
+ * The classes in which the streaming threads of a #FsConference are sorted
+ * to apply the #FsConference:thread-policy.
+ *
+ * Since: UNRELEASED
+ */
+
+typedef enum
+{
+  FS_THREAD_CLASS_OTHER,
+  FS_THREAD_CLASS_AUDIO_SEND,
+  FS_THREAD_CLASS_VIDEO_ENCODE,
+  FS_THREAD_CLASS_NETWORK_RECEIVE,
+  FS_THREAD_CLASS_JITTERBUFFER
+} FsThreadClass;
+
 /**
  * FS_ERROR:
  *
@@ -176,6 +205,8 @@ gboolean fs_parse_error (GObject *object,
     FsError *error,
     const gchar **error_msg);
 
+gboolean fs_conference_is_internal_thread (FsConference *conference);
+
 
 
 G_END_DECLS
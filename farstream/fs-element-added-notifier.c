@@ -55,6 +55,13 @@ enum
 
 struct _FsElementAddedNotifierPrivate {
   GPtrArray *bins;
+
+  /* Set of every bin (top-level or nested) we have connected our handlers to,
+   * the bins are not reffed, a weak ref removes them when they die.
+   * Protected by the mutex
+   */
+  GHashTable *watched_bins;
+  GMutex mutex;
 };
 
 static void _element_added_callback (GstBin *parent, GstElement *element,
@@ -62,6 +69,8 @@ static void _element_added_callback (GstBin *parent, GstElement *element,
 
 static void fs_element_added_notifier_finalize (GObject *object);
 
+static void _watched_bin_finalized (gpointer data, GObject *where_the_object_was);
+
 
 G_DEFINE_TYPE(FsElementAddedNotifier, fs_element_added_notifier, G_TYPE_OBJECT);
 
@@ -104,6 +113,9 @@ fs_element_added_notifier_init (FsElementAddedNotifier *notifier)
   notifier->priv = FS_ELEMENT_ADDED_NOTIFIER_GET_PRIVATE(notifier);
 
   notifier->priv->bins = g_ptr_array_new_with_free_func (gst_object_unref);
+  notifier->priv->watched_bins = g_hash_table_new (g_direct_hash,
+      g_direct_equal);
+  g_mutex_init (&notifier->priv->mutex);
 }
 
 
@@ -112,12 +124,83 @@ static void
 fs_element_added_notifier_finalize (GObject *object)
 {
   FsElementAddedNotifier *self = FS_ELEMENT_ADDED_NOTIFIER (object);
+  GHashTableIter iter;
+  gpointer key;
+
+  g_hash_table_iter_init (&iter, self->priv->watched_bins);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    g_object_weak_unref (key, _watched_bin_finalized, self);
+  g_hash_table_unref (self->priv->watched_bins);
+  g_mutex_clear (&self->priv->mutex);
 
   g_ptr_array_unref (self->priv->bins);
 
   G_OBJECT_CLASS (fs_element_added_notifier_parent_class)->finalize (object);
 }
 
+static void
+_watched_bin_finalized (gpointer data, GObject *where_the_object_was)
+{
+  FsElementAddedNotifier *self = FS_ELEMENT_ADDED_NOTIFIER (data);
+
+  g_mutex_lock (&self->priv->mutex);
+  g_hash_table_remove (self->priv->watched_bins, where_the_object_was);
+  g_mutex_unlock (&self->priv->mutex);
+}
+
+/*
+ * Marks the bin as watched by this notifier
+ *
+ * Returns: %TRUE if the bin was not already being watched
+ */
+static gboolean
+_watch_bin (FsElementAddedNotifier *self, GstElement *bin)
+{
+  gboolean added = FALSE;
+
+  g_mutex_lock (&self->priv->mutex);
+  if (!g_hash_table_contains (self->priv->watched_bins, bin))
+  {
+    g_hash_table_add (self->priv->watched_bins, bin);
+    g_object_weak_ref (G_OBJECT (bin), _watched_bin_finalized, self);
+    added = TRUE;
+  }
+  g_mutex_unlock (&self->priv->mutex);
+
+  return added;
+}
+
+/*
+ * Stops watching the bin
+ *
+ * Returns: %TRUE if the bin was being watched
+ */
+static gboolean
+_unwatch_bin (FsElementAddedNotifier *self, GstElement *bin)
+{
+  gboolean removed;
+
+  g_mutex_lock (&self->priv->mutex);
+  removed = g_hash_table_remove (self->priv->watched_bins, bin);
+  if (removed)
+    g_object_weak_unref (G_OBJECT (bin), _watched_bin_finalized, self);
+  g_mutex_unlock (&self->priv->mutex);
+
+  return removed;
+}
+
+static gboolean
+_is_watching_bin (FsElementAddedNotifier *self, gpointer bin)
+{
+  gboolean watched;
+
+  g_mutex_lock (&self->priv->mutex);
+  watched = g_hash_table_contains (self->priv->watched_bins, bin);
+  g_mutex_unlock (&self->priv->mutex);
+
+  return watched;
+}
+
 /**
  * fs_element_added_notifier_new:
  *
@@ -162,12 +245,14 @@ _element_removed_callback (GstBin *bin, GstElement *element,
 {
 
   /* Return if there was no handler connected */
-  if (g_signal_handlers_disconnect_by_func (element, _element_added_callback,
-          notifier) == 0 ||
-      g_signal_handlers_disconnect_by_func (element, _element_removed_callback,
-          notifier) == 0)
+  if (!_unwatch_bin (notifier, element))
     return;
 
+  g_signal_handlers_disconnect_by_func (element, _element_added_callback,
+      notifier);
+  g_signal_handlers_disconnect_by_func (element, _element_removed_callback,
+      notifier);
+
   if (GST_IS_BIN (element))
   {
     GstIterator *iter = NULL;
@@ -224,10 +309,7 @@ fs_element_added_notifier_remove (FsElementAddedNotifier *notifier,
 
   g_ptr_array_remove (notifier->priv->bins, bin);
 
-  if (g_signal_handler_find (bin,
-          G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA,
-          0, 0, NULL, /* id, detail, closure */
-          _element_added_callback, notifier) != 0)
+  if (_is_watching_bin (notifier, bin))
   {
     _element_removed_callback (NULL, GST_ELEMENT (bin), notifier);
     return TRUE;
@@ -411,7 +493,9 @@ _element_added_callback (GstBin *parent, GstElement *element,
 {
   FsElementAddedNotifier *notifier = FS_ELEMENT_ADDED_NOTIFIER (user_data);
 
-  if (GST_IS_BIN (element)) {
+  /* A bin is only instrumented once, even if it is reached through
+   * more than one path */
+  if (GST_IS_BIN (element) && _watch_bin (notifier, element)) {
     GstIterator *iter = NULL;
     gboolean done;
 
@@ -432,10 +516,7 @@ _element_added_callback (GstBin *parent, GstElement *element,
       switch (gst_iterator_next (iter, &item)) {
        case GST_ITERATOR_OK:
          /* We make sure the callback has not already been added */
-         if (g_signal_handler_find (g_value_get_object (&item),
-                 G_SIGNAL_MATCH_FUNC | G_SIGNAL_MATCH_DATA,
-                 0, 0, NULL, /* id, detail, closure */
-                 _element_added_callback, notifier) == 0)
+         if (!_is_watching_bin (notifier, g_value_get_object (&item)))
            _element_added_callback (GST_BIN_CAST (element),
                g_value_get_object (&item), notifier);
          g_value_reset (&item);
@@ -141,6 +141,8 @@
 
 #include "fs-session.h"
 
+#include <string.h>
+
 #include <gst/gst.h>
 
 #include "fs-conference.h"
@@ -175,17 +177,25 @@ enum
   PROP_ENCRYPTION_PARAMETERS
 };
 
-/*
 struct _FsSessionPrivate
 {
+  /* Protects the snapshot and its generation */
+  GMutex mutex;
+  FsSessionSnapshot *snapshot;
+  guint snapshot_generation;
 };
 
 #define FS_SESSION_GET_PRIVATE(o)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((o), FS_TYPE_SESSION, FsSessionPrivate))
-*/
 
 G_DEFINE_ABSTRACT_TYPE(FsSession, fs_session, G_TYPE_OBJECT)
 
+G_DEFINE_BOXED_TYPE (FsSessionSnapshot, fs_session_snapshot,
+    fs_session_snapshot_ref, fs_session_snapshot_unref)
+
+static void fs_session_finalize (GObject *object);
+static void fs_session_notify (GObject *object, GParamSpec *pspec);
+
 static void fs_session_get_property (GObject *object,
                                      guint prop_id,
                                      GValue *value,
@@ -206,6 +216,8 @@ fs_session_class_init (FsSessionClass *klass)
 
   gobject_class->set_property = fs_session_set_property;
   gobject_class->get_property = fs_session_get_property;
+  gobject_class->finalize = fs_session_finalize;
+  gobject_class->notify = fs_session_notify;
 
 
   /**
@@ -441,13 +453,51 @@ fs_session_class_init (FsSessionClass *klass)
       G_SIGNAL_RUN_LAST,
       0, NULL, NULL, NULL,
       G_TYPE_NONE, 3, G_TYPE_OBJECT, FS_TYPE_ERROR, G_TYPE_STRING);
+
+  g_type_class_add_private (klass, sizeof (FsSessionPrivate));
 }
 
 static void
 fs_session_init (FsSession *self)
 {
   /* member init */
-  // self->priv = FS_SESSION_GET_PRIVATE (self);
+  self->priv = FS_SESSION_GET_PRIVATE (self);
+  g_mutex_init (&self->priv->mutex);
+  self->priv->snapshot_generation = 1;
+}
+
+static void
+fs_session_finalize (GObject *object)
+{
+  FsSession *self = FS_SESSION (object);
+
+  if (self->priv->snapshot)
+    fs_session_snapshot_unref (self->priv->snapshot);
+  g_mutex_clear (&self->priv->mutex);
+
+  G_OBJECT_CLASS (fs_session_parent_class)->finalize (object);
+}
+
+static void
+fs_session_notify (GObject *object, GParamSpec *pspec)
+{
+  FsSession *self = FS_SESSION (object);
+  const gchar *name = g_param_spec_get_name (pspec);
+  FsSessionSnapshot *old = NULL;
+
+  if (strcmp (name, "codecs") && strcmp (name, "codecs-without-config") &&
+      strcmp (name, "current-send-codec") &&
+      strcmp (name, "allowed-sink-caps") && strcmp (name, "allowed-src-caps"))
+    return;
+
+  g_mutex_lock (&self->priv->mutex);
+  self->priv->snapshot_generation++;
+  old = self->priv->snapshot;
+  self->priv->snapshot = NULL;
+  g_mutex_unlock (&self->priv->mutex);
+
+  if (old)
+    fs_session_snapshot_unref (old);
 }
 
 static void
@@ -1014,6 +1064,135 @@ fs_session_parse_telephony_event_stopped (FsSession *session,
   return TRUE;
 }
 
+/**
+ * fs_session_snapshot_ref:
+ * @snapshot: a #FsSessionSnapshot
+ *
+ * Increases the reference count of @snapshot
+ *
+ * Returns: (transfer full): @snapshot
+ *
+ * Since: UNRELEASED
+ */
+FsSessionSnapshot *
+fs_session_snapshot_ref (FsSessionSnapshot *snapshot)
+{
+  g_return_val_if_fail (snapshot != NULL, NULL);
+
+  g_atomic_int_inc (&snapshot->refcount);
+
+  return snapshot;
+}
+
+/**
+ * fs_session_snapshot_unref:
+ * @snapshot: a #FsSessionSnapshot
+ *
+ * Decreases the reference count of @snapshot and frees it when it reaches 0
+ *
+ * Since: UNRELEASED
+ */
+void
+fs_session_snapshot_unref (FsSessionSnapshot *snapshot)
+{
+  g_return_if_fail (snapshot != NULL);
+
+  if (!g_atomic_int_dec_and_test (&snapshot->refcount))
+    return;
+
+  fs_codec_list_destroy (snapshot->codecs);
+  fs_codec_list_destroy (snapshot->codecs_without_config);
+  fs_codec_destroy (snapshot->current_send_codec);
+  if (snapshot->allowed_sink_caps)
+    gst_caps_unref (snapshot->allowed_sink_caps);
+  if (snapshot->allowed_src_caps)
+    gst_caps_unref (snapshot->allowed_src_caps);
+  g_slice_free (FsSessionSnapshot, snapshot);
+}
+
+/**
+ * fs_session_get_snapshot:
+ * @session: a #FsSession
+ *
+ * Gets an immutable copy of the #FsSession:codecs,
+ * #FsSession:codecs-without-config, #FsSession:current-send-codec,
+ * #FsSession:allowed-sink-caps and #FsSession:allowed-src-caps properties.
+ *
+ * The copy is only made once after one of them changes, so calling this
+ * function repeatedly is much cheaper than reading the properties, which
+ * copy the lists every time.
+ *
+ * Returns: (transfer full): a #FsSessionSnapshot, unref it with
+ * fs_session_snapshot_unref()
+ *
+ * Since: UNRELEASED
+ */
+FsSessionSnapshot *
+fs_session_get_snapshot (FsSession *session)
+{
+  FsSessionSnapshot *snapshot;
+  guint generation;
+
+  g_return_val_if_fail (FS_IS_SESSION (session), NULL);
+
+  g_mutex_lock (&session->priv->mutex);
+  if (session->priv->snapshot)
+  {
+    snapshot = fs_session_snapshot_ref (session->priv->snapshot);
+    g_mutex_unlock (&session->priv->mutex);
+    return snapshot;
+  }
+  generation = session->priv->snapshot_generation;
+  g_mutex_unlock (&session->priv->mutex);
+
+  snapshot = g_slice_new0 (FsSessionSnapshot);
+  snapshot->refcount = 1;
+  snapshot->generation = generation;
+  g_object_get (session,
+      "codecs", &snapshot->codecs,
+      "codecs-without-config", &snapshot->codecs_without_config,
+      "current-send-codec", &snapshot->current_send_codec,
+      "allowed-sink-caps", &snapshot->allowed_sink_caps,
+      "allowed-src-caps", &snapshot->allowed_src_caps,
+      NULL);
+
+  /* Only keep it if nothing changed while the properties were read */
+  g_mutex_lock (&session->priv->mutex);
+  if (!session->priv->snapshot &&
+      session->priv->snapshot_generation == generation)
+    session->priv->snapshot = fs_session_snapshot_ref (snapshot);
+  g_mutex_unlock (&session->priv->mutex);
+
+  return snapshot;
+}
+
+/**
+ * fs_session_get_snapshot_generation:
+ * @session: a #FsSession
+ *
+ * Gets the current generation of the properties returned by
+ * fs_session_get_snapshot(). It changes every time one of them changes, so
+ * if it is the same as the #FsSessionSnapshot.generation of a previous
+ * snapshot, that snapshot is still current.
+ *
+ * Returns: the current generation
+ *
+ * Since: UNRELEASED
+ */
+guint
+fs_session_get_snapshot_generation (FsSession *session)
+{
+  guint generation;
+
+  g_return_val_if_fail (FS_IS_SESSION (session), 0);
+
+  g_mutex_lock (&session->priv->mutex);
+  generation = session->priv->snapshot_generation;
+  g_mutex_unlock (&session->priv->mutex);
+
+  return generation;
+}
+
 /**
  * fs_session_set_allowed_caps:
  * @session: a #FsSession
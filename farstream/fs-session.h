@@ -52,6 +52,7 @@ G_BEGIN_DECLS
 typedef struct _FsSession FsSession;
 typedef struct _FsSessionClass FsSessionClass;
 typedef struct _FsSessionPrivate FsSessionPrivate;
+typedef struct _FsSessionSnapshot FsSessionSnapshot;
 
 /**
  * FsDTMFEvent:
@@ -172,6 +173,46 @@ struct _FsSession
 
 GType fs_session_get_type (void);
 
+/**
+ * FsSessionSnapshot:
+ * @generation: The generation of the #FsSession this snapshot was taken in
+ * @codecs: (element-type FsCodec): The value of the #FsSession:codecs
+ *  property
+ * @codecs_without_config: (element-type FsCodec): The value of the
+ *  #FsSession:codecs-without-config property
+ * @current_send_codec: The value of the #FsSession:current-send-codec property
+ * @allowed_sink_caps: The value of the #FsSession:allowed-sink-caps property
+ * @allowed_src_caps: The value of the #FsSession:allowed-src-caps property
+ *
+ * An immutable copy of the codec related properties of a #FsSession,
+ * returned by fs_session_get_snapshot(). None of its members may be modified.
+ *
+ * Since: UNRELEASED
+ */
+struct _FsSessionSnapshot
+{
+  guint generation;
+
+  GList *codecs;
+  GList *codecs_without_config;
+  FsCodec *current_send_codec;
+  GstCaps *allowed_sink_caps;
+  GstCaps *allowed_src_caps;
+
+  /*< private >*/
+  gint refcount;
+  gpointer _padding[4];
+};
+
+#define FS_TYPE_SESSION_SNAPSHOT (fs_session_snapshot_get_type ())
+GType fs_session_snapshot_get_type (void);
+
+FsSessionSnapshot *fs_session_snapshot_ref (FsSessionSnapshot *snapshot);
+void fs_session_snapshot_unref (FsSessionSnapshot *snapshot);
+
+FsSessionSnapshot *fs_session_get_snapshot (FsSession *session);
+guint fs_session_get_snapshot_generation (FsSession *session);
+
 FsStream *fs_session_new_stream (FsSession *session,
                                  FsParticipant *participant,
                                  FsStreamDirection direction,
@@ -102,6 +102,8 @@
 
 #include "fs-stream.h"
 
+#include <string.h>
+
 #include <gst/gst.h>
 
 #include "fs-session.h"
@@ -140,6 +142,10 @@ struct _FsStreamPrivate
   GMutex mutex;
   GList *src_pads;
   guint32 src_pads_cookie;
+
+  /* Protected by the mutex */
+  FsStreamSnapshot *snapshot;
+  guint snapshot_generation;
 };
 
 #define FS_STREAM_GET_PRIVATE(o)  \
@@ -148,6 +154,9 @@ struct _FsStreamPrivate
 
 G_DEFINE_ABSTRACT_TYPE(FsStream, fs_stream, G_TYPE_OBJECT)
 
+G_DEFINE_BOXED_TYPE (FsStreamSnapshot, fs_stream_snapshot,
+    fs_stream_snapshot_ref, fs_stream_snapshot_unref)
+
 static void fs_stream_constructed (GObject *obj);
 static void fs_stream_get_property (GObject *object,
                                     guint prop_id,
@@ -158,6 +167,7 @@ static void fs_stream_set_property (GObject *object,
                                     const GValue *value,
                                     GParamSpec *pspec);
 static void fs_stream_finalize (GObject *obj);
+static void fs_stream_notify (GObject *object, GParamSpec *pspec);
 
 static void fs_stream_pad_removed (FsStream *stream, GstPad *pad);
 
@@ -177,6 +187,7 @@ fs_stream_class_init (FsStreamClass *klass)
   gobject_class->get_property = fs_stream_get_property;
   gobject_class->finalize = fs_stream_finalize;
   gobject_class->constructed = fs_stream_constructed;
+  gobject_class->notify = fs_stream_notify;
 
 
   /**
@@ -351,6 +362,7 @@ fs_stream_init (FsStream *self)
   /* member init */
   self->priv = FS_STREAM_GET_PRIVATE (self);
   g_mutex_init (&self->priv->mutex);
+  self->priv->snapshot_generation = 1;
 }
 
 static void
@@ -375,11 +387,34 @@ fs_stream_finalize (GObject *obj)
   FsStream *stream = FS_STREAM (obj);
 
   g_list_free_full (stream->priv->src_pads, gst_object_unref);
+  if (stream->priv->snapshot)
+    fs_stream_snapshot_unref (stream->priv->snapshot);
   g_mutex_clear (&stream->priv->mutex);
 
   G_OBJECT_CLASS (fs_stream_parent_class)->finalize (obj);
 }
 
+static void
+fs_stream_notify (GObject *object, GParamSpec *pspec)
+{
+  FsStream *self = FS_STREAM (object);
+  const gchar *name = g_param_spec_get_name (pspec);
+  FsStreamSnapshot *old = NULL;
+
+  if (strcmp (name, "remote-codecs") && strcmp (name, "negotiated-codecs") &&
+      strcmp (name, "current-recv-codecs"))
+    return;
+
+  FS_STREAM_LOCK (self);
+  self->priv->snapshot_generation++;
+  old = self->priv->snapshot;
+  self->priv->snapshot = NULL;
+  FS_STREAM_UNLOCK (self);
+
+  if (old)
+    fs_stream_snapshot_unref (old);
+}
+
 static void
 fs_stream_get_property (GObject *object,
                         guint prop_id,
@@ -415,6 +450,125 @@ fs_stream_set_property (GObject *object,
       g_param_spec_get_name (pspec));
 }
 
+/**
+ * fs_stream_snapshot_ref:
+ * @snapshot: a #FsStreamSnapshot
+ *
+ * Increases the reference count of @snapshot
+ *
+ * Returns: (transfer full): @snapshot
+ *
+ * Since: UNRELEASED
+ */
+FsStreamSnapshot *
+fs_stream_snapshot_ref (FsStreamSnapshot *snapshot)
+{
+  g_return_val_if_fail (snapshot != NULL, NULL);
+
+  g_atomic_int_inc (&snapshot->refcount);
+
+  return snapshot;
+}
+
+/**
+ * fs_stream_snapshot_unref:
+ * @snapshot: a #FsStreamSnapshot
+ *
+ * Decreases the reference count of @snapshot and frees it when it reaches 0
+ *
+ * Since: UNRELEASED
+ */
+void
+fs_stream_snapshot_unref (FsStreamSnapshot *snapshot)
+{
+  g_return_if_fail (snapshot != NULL);
+
+  if (!g_atomic_int_dec_and_test (&snapshot->refcount))
+    return;
+
+  fs_codec_list_destroy (snapshot->remote_codecs);
+  fs_codec_list_destroy (snapshot->negotiated_codecs);
+  fs_codec_list_destroy (snapshot->current_recv_codecs);
+  g_slice_free (FsStreamSnapshot, snapshot);
+}
+
+/**
+ * fs_stream_get_snapshot:
+ * @stream: a #FsStream
+ *
+ * Gets an immutable copy of the #FsStream:remote-codecs,
+ * #FsStream:negotiated-codecs and #FsStream:current-recv-codecs properties.
+ *
+ * The copy is only made once after one of them changes, so calling this
+ * function repeatedly is much cheaper than reading the properties.
+ *
+ * Returns: (transfer full): a #FsStreamSnapshot, unref it with
+ * fs_stream_snapshot_unref()
+ *
+ * Since: UNRELEASED
+ */
+FsStreamSnapshot *
+fs_stream_get_snapshot (FsStream *stream)
+{
+  FsStreamSnapshot *snapshot;
+  guint generation;
+
+  g_return_val_if_fail (FS_IS_STREAM (stream), NULL);
+
+  FS_STREAM_LOCK (stream);
+  if (stream->priv->snapshot)
+  {
+    snapshot = fs_stream_snapshot_ref (stream->priv->snapshot);
+    FS_STREAM_UNLOCK (stream);
+    return snapshot;
+  }
+  generation = stream->priv->snapshot_generation;
+  FS_STREAM_UNLOCK (stream);
+
+  snapshot = g_slice_new0 (FsStreamSnapshot);
+  snapshot->refcount = 1;
+  snapshot->generation = generation;
+  g_object_get (stream,
+      "remote-codecs", &snapshot->remote_codecs,
+      "negotiated-codecs", &snapshot->negotiated_codecs,
+      "current-recv-codecs", &snapshot->current_recv_codecs,
+      NULL);
+
+  /* Only keep it if nothing changed while the properties were read */
+  FS_STREAM_LOCK (stream);
+  if (!stream->priv->snapshot &&
+      stream->priv->snapshot_generation == generation)
+    stream->priv->snapshot = fs_stream_snapshot_ref (snapshot);
+  FS_STREAM_UNLOCK (stream);
+
+  return snapshot;
+}
+
+/**
+ * fs_stream_get_snapshot_generation:
+ * @stream: a #FsStream
+ *
+ * Gets the current generation of the properties returned by
+ * fs_stream_get_snapshot(). It changes every time one of them changes.
+ *
+ * Returns: the current generation
+ *
+ * Since: UNRELEASED
+ */
+guint
+fs_stream_get_snapshot_generation (FsStream *stream)
+{
+  guint generation;
+
+  g_return_val_if_fail (FS_IS_STREAM (stream), 0);
+
+  FS_STREAM_LOCK (stream);
+  generation = stream->priv->snapshot_generation;
+  FS_STREAM_UNLOCK (stream);
+
+  return generation;
+}
+
 /**
  * fs_stream_add_remote_candidates:
  * @stream: an #FsStream
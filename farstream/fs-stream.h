@@ -94,6 +94,7 @@ typedef enum
 typedef struct _FsStream FsStream;
 typedef struct _FsStreamClass FsStreamClass;
 typedef struct _FsStreamPrivate FsStreamPrivate;
+typedef struct _FsStreamSnapshot FsStreamSnapshot;
 
 
 /**
@@ -160,6 +161,43 @@ struct _FsStream
 
 GType fs_stream_get_type (void);
 
+/**
+ * FsStreamSnapshot:
+ * @generation: The generation of the #FsStream this snapshot was taken in
+ * @remote_codecs: (element-type FsCodec): The value of the
+ *  #FsStream:remote-codecs property
+ * @negotiated_codecs: (element-type FsCodec): The value of the
+ *  #FsStream:negotiated-codecs property
+ * @current_recv_codecs: (element-type FsCodec): The value of the
+ *  #FsStream:current-recv-codecs property
+ *
+ * An immutable copy of the codec related properties of a #FsStream,
+ * returned by fs_stream_get_snapshot(). None of its members may be modified.
+ *
+ * Since: UNRELEASED
+ */
+struct _FsStreamSnapshot
+{
+  guint generation;
+
+  GList *remote_codecs;
+  GList *negotiated_codecs;
+  GList *current_recv_codecs;
+
+  /*< private >*/
+  gint refcount;
+  gpointer _padding[4];
+};
+
+#define FS_TYPE_STREAM_SNAPSHOT (fs_stream_snapshot_get_type ())
+GType fs_stream_snapshot_get_type (void);
+
+FsStreamSnapshot *fs_stream_snapshot_ref (FsStreamSnapshot *snapshot);
+void fs_stream_snapshot_unref (FsStreamSnapshot *snapshot);
+
+FsStreamSnapshot *fs_stream_get_snapshot (FsStream *stream);
+guint fs_stream_get_snapshot_generation (FsStream *stream);
+
 gboolean fs_stream_add_remote_candidates (FsStream *stream,
                                           GList *candidates,
                                           GError **error);
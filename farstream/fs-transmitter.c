@@ -366,3 +366,171 @@ fs_transmitter_list_available (void)
 {
   return fs_plugin_list_available ("transmitter");
 }
+
+static gboolean
+fs_send_time_meta_init (GstMeta *meta, gpointer params, GstBuffer *buffer)
+{
+  FsSendTimeMeta *stmeta = (FsSendTimeMeta *) meta;
+
+  stmeta->send_time = GST_CLOCK_TIME_NONE;
+
+  return TRUE;
+}
+
+static gboolean
+fs_send_time_meta_transform (GstBuffer *transbuf, GstMeta *meta,
+    GstBuffer *buffer, GQuark type, gpointer data)
+{
+  FsSendTimeMeta *stmeta = (FsSendTimeMeta *) meta;
+
+  /* The time only makes sense for the whole packet */
+  if (GST_META_TRANSFORM_IS_COPY (type))
+  {
+    GstMetaTransformCopy *copy = data;
+
+    if (!copy->region)
+      fs_buffer_add_send_time_meta (transbuf, stmeta->send_time);
+  }
+
+  return TRUE;
+}
+
+GType
+fs_send_time_meta_api_get_type (void)
+{
+  static volatile GType type;
+  static const gchar *tags[] = { NULL };
+
+  if (g_once_init_enter (&type))
+  {
+    GType _type = gst_meta_api_type_register ("FsSendTimeMetaAPI", tags);
+    g_once_init_leave (&type, _type);
+  }
+
+  return type;
+}
+
+const GstMetaInfo *
+fs_send_time_meta_get_info (void)
+{
+  static const GstMetaInfo *meta_info = NULL;
+
+  if (g_once_init_enter (&meta_info))
+  {
+    const GstMetaInfo *mi = gst_meta_register (FS_SEND_TIME_META_API_TYPE,
+        "FsSendTimeMeta",
+        sizeof (FsSendTimeMeta),
+        fs_send_time_meta_init,
+        NULL,
+        fs_send_time_meta_transform);
+    g_once_init_leave (&meta_info, mi);
+  }
+
+  return meta_info;
+}
+
+/**
+ * fs_buffer_add_send_time_meta:
+ * @buffer: a #GstBuffer
+ * @send_time: The running time at which @buffer should be sent
+ *
+ * Attaches a #FsSendTimeMeta to an outgoing packet. Only do this if a
+ * query created with fs_send_time_query_new() said that the transmitters
+ * downstream pace the sending, others send the packet right away.
+ *
+ * Returns: (transfer none): the #FsSendTimeMeta added to @buffer
+ *
+ * Since: UNRELEASED
+ */
+
+FsSendTimeMeta *
+fs_buffer_add_send_time_meta (GstBuffer *buffer, GstClockTime send_time)
+{
+  FsSendTimeMeta *meta;
+
+  g_return_val_if_fail (GST_IS_BUFFER (buffer), NULL);
+
+  meta = (FsSendTimeMeta *) gst_buffer_add_meta (buffer,
+      FS_SEND_TIME_META_INFO, NULL);
+  meta->send_time = send_time;
+
+  return meta;
+}
+
+#define SEND_TIME_QUERY_NAME "FsSendTimeQuery"
+
+/**
+ * fs_send_time_query_new:
+ *
+ * Creates a query that asks whether the transmitters downstream send the
+ * packets at the time of their #FsSendTimeMeta. A transmitter that does
+ * answers it with fs_send_time_query_set_paced().
+ *
+ * Returns: (transfer full): a new custom #GstQuery
+ *
+ * Since: UNRELEASED
+ */
+
+GstQuery *
+fs_send_time_query_new (void)
+{
+  return gst_query_new_custom (GST_QUERY_CUSTOM,
+      gst_structure_new (SEND_TIME_QUERY_NAME,
+          "paced", G_TYPE_BOOLEAN, FALSE,
+          NULL));
+}
+
+/**
+ * fs_send_time_query_parse:
+ * @query: a #GstQuery
+ * @paced: (out) (allow-none): Where to store whether the packets are paced
+ *
+ * Checks if @query was created by fs_send_time_query_new() and gets its
+ * answer.
+ *
+ * Returns: %TRUE if @query is a send time query
+ *
+ * Since: UNRELEASED
+ */
+
+gboolean
+fs_send_time_query_parse (GstQuery *query, gboolean *paced)
+{
+  const GstStructure *s;
+
+  g_return_val_if_fail (GST_IS_QUERY (query), FALSE);
+
+  if (GST_QUERY_TYPE (query) != GST_QUERY_CUSTOM)
+    return FALSE;
+
+  s = gst_query_get_structure (query);
+  if (!s || !gst_structure_has_name (s, SEND_TIME_QUERY_NAME))
+    return FALSE;
+
+  if (paced && !gst_structure_get_boolean (s, "paced", paced))
+    *paced = FALSE;
+
+  return TRUE;
+}
+
+/**
+ * fs_send_time_query_set_paced:
+ * @query: a query created by fs_send_time_query_new()
+ * @paced: Whether the packets will be sent at the time of their
+ *  #FsSendTimeMeta
+ *
+ * Answers a send time query
+ *
+ * Since: UNRELEASED
+ */
+
+void
+fs_send_time_query_set_paced (GstQuery *query, gboolean paced)
+{
+  GstStructure *s;
+
+  g_return_if_fail (fs_send_time_query_parse (query, NULL));
+
+  s = gst_query_writable_structure (query);
+  gst_structure_set (s, "paced", G_TYPE_BOOLEAN, paced, NULL);
+}
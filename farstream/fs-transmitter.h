@@ -117,6 +117,51 @@ void fs_transmitter_emit_error (FsTransmitter *transmitter,
 
 char **fs_transmitter_list_available (void);
 
+/**
+ * FsSendTimeMeta:
+ * @meta: the parent #GstMeta
+ * @send_time: The running time at which the packet should leave
+ *
+ * Attached to an outgoing packet by whatever paces the sending, like a rate
+ * controller, when the transmitter is expected to send it at the given
+ * time instead of as soon as it arrives.
+ *
+ * Since: UNRELEASED
+ */
+typedef struct {
+  GstMeta meta;
+
+  GstClockTime send_time;
+} FsSendTimeMeta;
+
+GType fs_send_time_meta_api_get_type (void);
+#define FS_SEND_TIME_META_API_TYPE (fs_send_time_meta_api_get_type ())
+
+const GstMetaInfo *fs_send_time_meta_get_info (void);
+#define FS_SEND_TIME_META_INFO (fs_send_time_meta_get_info ())
+
+/**
+ * fs_buffer_get_send_time_meta:
+ * @b: a #GstBuffer
+ *
+ * Gets the #FsSendTimeMeta of a buffer
+ *
+ * Returns: the #FsSendTimeMeta of @b or %NULL if it has none
+ *
+ * Since: UNRELEASED
+ */
+#define fs_buffer_get_send_time_meta(b) \
+  ((FsSendTimeMeta *) gst_buffer_get_meta ((b), FS_SEND_TIME_META_API_TYPE))
+
+FsSendTimeMeta *fs_buffer_add_send_time_meta (GstBuffer *buffer,
+    GstClockTime send_time);
+
+GstQuery *fs_send_time_query_new (void);
+
+gboolean fs_send_time_query_parse (GstQuery *query, gboolean *paced);
+
+void fs_send_time_query_set_paced (GstQuery *query, gboolean paced);
+
 G_END_DECLS
 
 #endif /* __FS_TRANSMITTER_H__ */
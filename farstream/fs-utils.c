@@ -142,54 +142,73 @@ fs_utils_get_default_element_properties (GstElement *element)
 }
 
 /**
- * fs_utils_set_bitrate:
+ * fs_utils_get_bitrate_unit:
  * @element: The #GstElement
- * @bitrate: The bitrate in bits/sec
  *
- * This allows setting the bitrate on all elements that have a "bitrate"
- * property without having to know the type or of the unit used by that element.
+ * Finds the unit used by the "bitrate" property of this element. Most
+ * elements use bits/sec, but some older ones use kbits/sec.
  *
- * This will be obsolete in 0.11 (when all elements use bit/sec for the
- * "bitrate" property.
+ * Returns: the number of bits/sec represented by one unit of the
+ * "bitrate" property of @element (1 or 1000)
+ *
+ * Since: UNRELEASED
  */
 
-void
-fs_utils_set_bitrate (GstElement *element, glong bitrate)
+guint
+fs_utils_get_bitrate_unit (GstElement *element)
 {
-  GParamSpec *spec;
   const char *elements_in_kbps[] = { "lamemp3enc", "lame", "x264enc", "twolame",
     "mpeg2enc", NULL
   };
   int i;
-  GstElementFactory *factory;
-  const gchar *factory_name = NULL;
+  const gchar *factory_name;
 
-  g_return_if_fail (GST_IS_ELEMENT (element));
-
-  spec = g_object_class_find_property (G_OBJECT_GET_CLASS (element), "bitrate");
-  g_return_if_fail (spec != NULL);
+  g_return_val_if_fail (GST_IS_ELEMENT (element), 1);
 
-  factory = gst_element_get_factory (element);
-  if (factory)
-    factory_name = gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory));
+  factory_name = factory_name_from_element (element);
+  if (!factory_name)
+    return 1;
 
-  /* divide by 1000 for elements that are known to use kbs */
   for (i = 0; elements_in_kbps[i]; i++)
-    if (factory_name && !strcmp (factory_name, elements_in_kbps[i]))
-    {
-      bitrate /= 1000;
-      break;
-    }
+    if (!strcmp (factory_name, elements_in_kbps[i]))
+      return 1000;
+
+  return 1;
+}
+
+/**
+ * fs_utils_set_bitrate_full:
+ * @element: The #GstElement
+ * @spec: The #GParamSpec of the "bitrate" property of @element
+ * @unit: The unit of the property as returned by fs_utils_get_bitrate_unit()
+ * @bitrate: The bitrate in bits/sec
+ *
+ * Same as fs_utils_set_bitrate(), but without looking up the property
+ * and its unit. This is useful for callers that set the bitrate often on the
+ * same element and can look these up once.
+ *
+ * Since: UNRELEASED
+ */
 
-  if (G_PARAM_SPEC_TYPE (spec) == G_TYPE_LONG)
+void
+fs_utils_set_bitrate_full (GstElement *element, GParamSpec *spec, guint unit,
+    glong bitrate)
+{
+  g_return_if_fail (GST_IS_ELEMENT (element));
+  g_return_if_fail (spec != NULL);
+  g_return_if_fail (unit > 0);
+
+  bitrate /= unit;
+
+  if (G_PARAM_SPEC_VALUE_TYPE (spec) == G_TYPE_LONG)
   {
-    g_object_set (element, "bitrate", (glong) CLAMP (bitrate,
+    g_object_set (element, spec->name, (glong) CLAMP (bitrate,
             G_PARAM_SPEC_LONG (spec)->minimum,
             G_PARAM_SPEC_LONG (spec)->maximum), NULL);
   }
   else if (G_PARAM_SPEC_VALUE_TYPE (spec) == G_TYPE_ULONG)
   {
-    g_object_set (element, "bitrate", (gulong) CLAMP (bitrate,
+    g_object_set (element, spec->name, (gulong) CLAMP (bitrate,
             G_PARAM_SPEC_ULONG (spec)->minimum,
             G_PARAM_SPEC_ULONG (spec)->maximum), NULL);
   }
@@ -197,7 +216,7 @@ fs_utils_set_bitrate (GstElement *element, glong bitrate)
   {
     gint tmp = MIN (bitrate, G_MAXINT);
 
-    g_object_set (element, "bitrate", (gint)  CLAMP (tmp,
+    g_object_set (element, spec->name, (gint)  CLAMP (tmp,
             G_PARAM_SPEC_INT (spec)->minimum,
             G_PARAM_SPEC_INT (spec)->maximum), NULL);
   }
@@ -205,7 +224,7 @@ fs_utils_set_bitrate (GstElement *element, glong bitrate)
   {
     guint tmp = MIN (bitrate, G_MAXUINT);
 
-    g_object_set (element, "bitrate", (guint) CLAMP (tmp,
+    g_object_set (element, spec->name, (guint) CLAMP (tmp,
             G_PARAM_SPEC_UINT (spec)->minimum,
             G_PARAM_SPEC_UINT (spec)->maximum), NULL);
   }
@@ -215,6 +234,32 @@ fs_utils_set_bitrate (GstElement *element, glong bitrate)
   }
 }
 
+/**
+ * fs_utils_set_bitrate:
+ * @element: The #GstElement
+ * @bitrate: The bitrate in bits/sec
+ *
+ * This allows setting the bitrate on all elements that have a "bitrate"
+ * property without having to know the type or of the unit used by that element.
+ *
+ * This will be obsolete in 0.11 (when all elements use bit/sec for the
+ * "bitrate" property.
+ */
+
+void
+fs_utils_set_bitrate (GstElement *element, glong bitrate)
+{
+  GParamSpec *spec;
+
+  g_return_if_fail (GST_IS_ELEMENT (element));
+
+  spec = g_object_class_find_property (G_OBJECT_GET_CLASS (element), "bitrate");
+  g_return_if_fail (spec != NULL);
+
+  fs_utils_set_bitrate_full (element, spec, fs_utils_get_bitrate_unit (element),
+      bitrate);
+}
+
 static GList *
 load_default_rtp_hdrext_preferences_from_path (const gchar *element_name,
     const gchar *path, FsMediaType media_type)
@@ -37,6 +37,11 @@ GKeyFile *fs_utils_get_default_element_properties (GstElement *element);
 
 void fs_utils_set_bitrate (GstElement *element, glong bitrate);
 
+guint fs_utils_get_bitrate_unit (GstElement *element);
+
+void fs_utils_set_bitrate_full (GstElement *element, GParamSpec *spec,
+    guint unit, glong bitrate);
+
 GList *fs_utils_get_default_rtp_header_extension_preferences (
   GstElement *element, FsMediaType media_type);
 
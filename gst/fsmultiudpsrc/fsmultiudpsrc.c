@@ -0,0 +1,1495 @@
+/*
+ * Farstream - Multi-socket UDP source
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:element-fsmultiudpsrc
+ * @short_description: Receives from many UDP sockets on a few threads
+ *
+ * This element reads datagrams from any number of already bound UDP sockets.
+ * Each socket is given to a request pad through the pad's "socket"
+ * property and the packets received on it are pushed out of that pad, with a
+ * #GstNetAddressMeta holding the sender's address like udpsrc does.
+ *
+ * Instead of having one streaming thread per socket, the sockets are
+ * spread over #FsMultiUdpSrc:n-threads threads that each wait on their own
+ * epoll set. A socket is always read by the same thread, so its packets stay
+ * in order, and idle sockets cost nothing but a file descriptor.
+ *
+ * When built with liburing, the #FsMultiUdpSrc:io-uring property makes each
+ * thread use an io_uring instead of an epoll set. Every socket then has one
+ * multishot receive request that fills the buffers of a ring registered with
+ * the kernel, so a thread gets all the ready packets of all its sockets from
+ * a single wait, without any system call per packet.
+ *
+ * A #GstBufferPool can be given to a pad through its "buffer-pool" property.
+ * The packets of that socket are then received straight into the buffers of
+ * the pool, which come back to it once downstream is done with them, instead
+ * of into a new allocation each. The element activates the pool. A datagram
+ * that does not fit in its buffers is dropped.
+ *
+ * The element never closes the sockets. A socket must stay open until its
+ * pad has been released.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fsmultiudpsrc.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include <gst/net/gstnetaddressmeta.h>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#endif
+
+GST_DEBUG_CATEGORY_STATIC (fs_multi_udp_src_debug);
+#define GST_CAT_DEFAULT (fs_multi_udp_src_debug)
+
+#define DEFAULT_N_THREADS 1
+#define MAX_N_THREADS 64
+#define DEFAULT_DO_TIMESTAMP FALSE
+#define DEFAULT_IO_URING FALSE
+
+/* The biggest datagram that UDP can carry */
+#define MAX_PACKET_SIZE 65536
+/* Packets read from one socket before giving the others a turn */
+#define MAX_PACKETS_PER_WAKEUP 32
+#define MAX_EVENTS 64
+
+/* The pad ids start at 1, so this key is free for the wakeup fd */
+#define WAKEUP_ID 0
+
+/* The keys that identify a pad in the epoll sets and the rings also carry
+ * the serial of the socket, so events for a socket the pad no longer has
+ * are dropped */
+#define PAD_KEY(pad) (((guint64) (pad)->serial << 32) | (pad)->id)
+#define KEY_ID(key) ((guint) ((key) & G_MAXUINT32))
+
+#ifdef HAVE_LIBURING
+#define RING_ENTRIES 256
+/* Must be a power of 2 */
+#define RING_BUFFERS 32
+/* Room for the header, the address and the largest datagram */
+#define RING_BUFFER_SIZE (sizeof (struct io_uring_recvmsg_out) + \
+    sizeof (struct sockaddr_storage) + MAX_PACKET_SIZE)
+#define RING_BUFFER_GROUP 0
+/* The completions of the cancel requests */
+#define RING_IGNORE_KEY G_MAXUINT64
+#endif
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS_ANY);
+
+enum
+{
+  PROP_0,
+  PROP_N_THREADS,
+  PROP_DO_TIMESTAMP,
+  PROP_IO_URING
+};
+
+struct _FsMultiUdpSrcWorker
+{
+  FsMultiUdpSrc *self;
+
+  GstTask *task;
+  GRecMutex task_lock;
+  gint epfd;
+
+#ifdef HAVE_LIBURING
+  /* In io-uring mode, the submission side of the ring is protected by the
+   * object lock, the completions and the buffers are only touched by the
+   * thread of the task */
+  struct io_uring ring;
+  gboolean ring_ready;
+  struct io_uring_buf_ring *buf_ring;
+  guint8 *buffers;
+  struct msghdr msg;
+#endif
+
+  /* Only touched by the thread of the task, in epoll mode */
+  guint8 *data;
+};
+
+
+/*
+ * The request pads, each one carries one socket
+ */
+
+#define FS_TYPE_MULTI_UDP_SRC_PAD \
+  (fs_multi_udp_src_pad_get_type())
+#define FS_MULTI_UDP_SRC_PAD(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+  FS_TYPE_MULTI_UDP_SRC_PAD,FsMultiUdpSrcPad))
+
+typedef struct _FsMultiUdpSrcPad FsMultiUdpSrcPad;
+typedef struct _FsMultiUdpSrcPadClass FsMultiUdpSrcPadClass;
+
+struct _FsMultiUdpSrcPad
+{
+  GstPad parent;
+
+  /* Set once when the pad is requested */
+  guint id;
+
+  /* Protected by the object lock of the element */
+  GSocket *socket;
+  gint fd;
+  gboolean watched;
+  guint serial;
+  GstBufferPool *pool;
+};
+
+struct _FsMultiUdpSrcPadClass
+{
+  GstPadClass parent_class;
+};
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_SOCKET,
+  PROP_PAD_BUFFER_POOL
+};
+
+static GType fs_multi_udp_src_pad_get_type (void);
+
+G_DEFINE_TYPE (FsMultiUdpSrcPad, fs_multi_udp_src_pad, GST_TYPE_PAD);
+
+G_DEFINE_TYPE (FsMultiUdpSrc, fs_multi_udp_src, GST_TYPE_ELEMENT);
+
+static void fs_multi_udp_src_finalize (GObject *object);
+static void fs_multi_udp_src_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec);
+static void fs_multi_udp_src_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec);
+
+static GstPad *fs_multi_udp_src_request_new_pad (GstElement *element,
+    GstPadTemplate *templ,
+    const gchar *name,
+    const GstCaps *caps);
+static void fs_multi_udp_src_release_pad (GstElement *element,
+    GstPad *pad);
+static GstStateChangeReturn fs_multi_udp_src_change_state (
+    GstElement *element,
+    GstStateChange transition);
+
+static void fs_multi_udp_src_watch_locked (FsMultiUdpSrc *self,
+    FsMultiUdpSrcPad *pad);
+static void fs_multi_udp_src_unwatch_locked (FsMultiUdpSrc *self,
+    FsMultiUdpSrcPad *pad);
+
+
+static void
+fs_multi_udp_src_pad_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsMultiUdpSrcPad *pad = FS_MULTI_UDP_SRC_PAD (object);
+  GstElement *parent = gst_pad_get_parent_element (GST_PAD (pad));
+
+  if (parent)
+    GST_OBJECT_LOCK (parent);
+
+  switch (prop_id)
+  {
+    case PROP_PAD_SOCKET:
+      g_value_set_object (value, pad->socket);
+      break;
+    case PROP_PAD_BUFFER_POOL:
+      g_value_set_object (value, pad->pool);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  if (parent)
+  {
+    GST_OBJECT_UNLOCK (parent);
+    gst_object_unref (parent);
+  }
+}
+
+static void
+fs_multi_udp_src_pad_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsMultiUdpSrcPad *pad = FS_MULTI_UDP_SRC_PAD (object);
+  GstElement *parent = gst_pad_get_parent_element (GST_PAD (pad));
+  GSocket *old_socket = NULL;
+  GstBufferPool *old_pool = NULL;
+
+  if (parent)
+    GST_OBJECT_LOCK (parent);
+
+  switch (prop_id)
+  {
+    case PROP_PAD_SOCKET:
+      if (parent)
+        fs_multi_udp_src_unwatch_locked (FS_MULTI_UDP_SRC (parent), pad);
+      old_socket = pad->socket;
+      pad->socket = g_value_dup_object (value);
+      pad->fd = pad->socket ? g_socket_get_fd (pad->socket) : -1;
+      if (parent)
+        fs_multi_udp_src_watch_locked (FS_MULTI_UDP_SRC (parent), pad);
+      break;
+    case PROP_PAD_BUFFER_POOL:
+      old_pool = pad->pool;
+      pad->pool = g_value_dup_object (value);
+      if (pad->pool && !gst_buffer_pool_set_active (pad->pool, TRUE))
+        GST_WARNING_OBJECT (pad, "Could not activate the buffer pool");
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+
+  if (parent)
+  {
+    GST_OBJECT_UNLOCK (parent);
+    gst_object_unref (parent);
+  }
+
+  if (old_socket)
+    g_object_unref (old_socket);
+
+  if (old_pool)
+  {
+    gst_buffer_pool_set_active (old_pool, FALSE);
+    gst_object_unref (old_pool);
+  }
+}
+
+static void
+fs_multi_udp_src_pad_finalize (GObject *object)
+{
+  FsMultiUdpSrcPad *pad = FS_MULTI_UDP_SRC_PAD (object);
+
+  if (pad->socket)
+    g_object_unref (pad->socket);
+
+  if (pad->pool)
+  {
+    gst_buffer_pool_set_active (pad->pool, FALSE);
+    gst_object_unref (pad->pool);
+  }
+
+  G_OBJECT_CLASS (fs_multi_udp_src_pad_parent_class)->finalize (object);
+}
+
+static void
+fs_multi_udp_src_pad_class_init (FsMultiUdpSrcPadClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->get_property = fs_multi_udp_src_pad_get_property;
+  gobject_class->set_property = fs_multi_udp_src_pad_set_property;
+  gobject_class->finalize = fs_multi_udp_src_pad_finalize;
+
+  g_object_class_install_property (gobject_class,
+      PROP_PAD_SOCKET,
+      g_param_spec_object ("socket",
+          "Socket",
+          "The bound UDP socket to receive from",
+          G_TYPE_SOCKET,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_PAD_BUFFER_POOL,
+      g_param_spec_object ("buffer-pool",
+          "Buffer pool",
+          "A configured pool to receive the packets into, or NULL to"
+          " allocate a buffer per packet",
+          GST_TYPE_BUFFER_POOL,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+fs_multi_udp_src_pad_init (FsMultiUdpSrcPad *pad)
+{
+  pad->fd = -1;
+}
+
+
+/*
+ * The element
+ */
+
+static void
+fs_multi_udp_src_class_init (FsMultiUdpSrcClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (fs_multi_udp_src_debug, "fsmultiudpsrc", 0,
+      "fsmultiudpsrc");
+
+  gobject_class->finalize = fs_multi_udp_src_finalize;
+  gobject_class->get_property = fs_multi_udp_src_get_property;
+  gobject_class->set_property = fs_multi_udp_src_set_property;
+
+  element_class->request_new_pad =
+    GST_DEBUG_FUNCPTR (fs_multi_udp_src_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR (fs_multi_udp_src_release_pad);
+  element_class->change_state =
+    GST_DEBUG_FUNCPTR (fs_multi_udp_src_change_state);
+
+  /**
+   * FsMultiUdpSrc:n-threads:
+   *
+   * The number of threads that wait on the sockets. Changes only take effect
+   * the next time the element goes from NULL to READY.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_N_THREADS,
+      g_param_spec_uint ("n-threads",
+          "Number of threads",
+          "The number of threads that receive from the sockets",
+          1, MAX_N_THREADS, DEFAULT_N_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsMultiUdpSrc:do-timestamp:
+   *
+   * Timestamp the packets with the running time at which they were read,
+   * like the property of the same name on #GstBaseSrc.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_DO_TIMESTAMP,
+      g_param_spec_boolean ("do-timestamp",
+          "Do timestamp",
+          "Apply the current running time to the buffers",
+          DEFAULT_DO_TIMESTAMP,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+#ifdef HAVE_LIBURING
+  /**
+   * FsMultiUdpSrc:io-uring:
+   *
+   * Receive through one io_uring per thread instead of an epoll set. Changes
+   * only take effect the next time the element goes from NULL to READY.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_IO_URING,
+      g_param_spec_boolean ("io-uring",
+          "Use io_uring",
+          "Receive with multishot io_uring requests instead of epoll",
+          DEFAULT_IO_URING,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+#endif
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&src_template));
+
+  gst_element_class_set_metadata (element_class,
+      "Multi-socket UDP source",
+      "Source/Network",
+      "Receives packets from many UDP sockets on a few threads",
+      "Farstream developers <farstream@lists.freedesktop.org>");
+}
+
+static void
+fs_multi_udp_src_init (FsMultiUdpSrc *self)
+{
+  self->n_threads = DEFAULT_N_THREADS;
+  self->do_timestamp = DEFAULT_DO_TIMESTAMP;
+  self->io_uring = DEFAULT_IO_URING;
+  self->pads = g_hash_table_new (NULL, NULL);
+  self->wakeup_fd = -1;
+
+  GST_OBJECT_FLAG_SET (self, GST_ELEMENT_FLAG_SOURCE);
+}
+
+static void
+fs_multi_udp_src_finalize (GObject *object)
+{
+  FsMultiUdpSrc *self = FS_MULTI_UDP_SRC (object);
+
+  g_hash_table_unref (self->pads);
+
+  G_OBJECT_CLASS (fs_multi_udp_src_parent_class)->finalize (object);
+}
+
+static void
+fs_multi_udp_src_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsMultiUdpSrc *self = FS_MULTI_UDP_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_N_THREADS:
+      g_value_set_uint (value, self->n_threads);
+      break;
+    case PROP_DO_TIMESTAMP:
+      g_value_set_boolean (value, self->do_timestamp);
+      break;
+    case PROP_IO_URING:
+      g_value_set_boolean (value, self->io_uring);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_multi_udp_src_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsMultiUdpSrc *self = FS_MULTI_UDP_SRC (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_N_THREADS:
+      self->n_threads = g_value_get_uint (value);
+      break;
+    case PROP_DO_TIMESTAMP:
+      self->do_timestamp = g_value_get_boolean (value);
+      break;
+    case PROP_IO_URING:
+      self->io_uring = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+#ifdef HAVE_LIBURING
+
+static struct io_uring_sqe *
+fs_multi_udp_src_ring_get_sqe_locked (FsMultiUdpSrcWorker *worker)
+{
+  struct io_uring_sqe *sqe = io_uring_get_sqe (&worker->ring);
+
+  /* The queue is full, make room by submitting what is in it */
+  if (!sqe && io_uring_submit (&worker->ring) >= 0)
+    sqe = io_uring_get_sqe (&worker->ring);
+
+  return sqe;
+}
+
+static gboolean
+fs_multi_udp_src_ring_recv_locked (FsMultiUdpSrcWorker *worker,
+    FsMultiUdpSrcPad *pad)
+{
+  struct io_uring_sqe *sqe;
+  gint ret;
+
+  sqe = fs_multi_udp_src_ring_get_sqe_locked (worker);
+  if (!sqe)
+  {
+    GST_WARNING_OBJECT (pad, "The submission queue is full");
+    return FALSE;
+  }
+
+  /* A single request keeps receiving until the buffer ring is empty */
+  io_uring_prep_recvmsg_multishot (sqe, pad->fd, &worker->msg, 0);
+  sqe->flags |= IOSQE_BUFFER_SELECT;
+  sqe->buf_group = RING_BUFFER_GROUP;
+  io_uring_sqe_set_data64 (sqe, PAD_KEY (pad));
+
+  ret = io_uring_submit (&worker->ring);
+  if (ret < 0)
+  {
+    GST_WARNING_OBJECT (pad, "Could not submit the receive request: %s",
+        g_strerror (-ret));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static void
+fs_multi_udp_src_ring_cancel_locked (FsMultiUdpSrcWorker *worker,
+    FsMultiUdpSrcPad *pad)
+{
+  struct io_uring_sqe *sqe;
+
+  sqe = fs_multi_udp_src_ring_get_sqe_locked (worker);
+  if (!sqe)
+  {
+    GST_WARNING_OBJECT (pad, "Could not cancel the receive request,"
+        " the submission queue is full");
+    return;
+  }
+
+  io_uring_prep_cancel64 (sqe, PAD_KEY (pad), 0);
+  io_uring_sqe_set_data64 (sqe, RING_IGNORE_KEY);
+  io_uring_submit (&worker->ring);
+}
+
+static void
+fs_multi_udp_src_ring_wakeup_locked (FsMultiUdpSrcWorker *worker)
+{
+  struct io_uring_sqe *sqe;
+
+  sqe = fs_multi_udp_src_ring_get_sqe_locked (worker);
+  if (!sqe)
+  {
+    GST_WARNING_OBJECT (worker->self, "Could not wake up a thread,"
+        " the submission queue is full");
+    return;
+  }
+
+  io_uring_prep_nop (sqe);
+  io_uring_sqe_set_data64 (sqe, WAKEUP_ID);
+  io_uring_submit (&worker->ring);
+}
+
+#endif /* HAVE_LIBURING */
+
+static void
+fs_multi_udp_src_watch_locked (FsMultiUdpSrc *self, FsMultiUdpSrcPad *pad)
+{
+  FsMultiUdpSrcWorker *worker;
+  struct epoll_event event;
+
+  if (!self->workers || pad->fd < 0 || pad->watched)
+    return;
+
+  worker = &self->workers[pad->id % self->n_workers];
+  pad->serial++;
+
+#ifdef HAVE_LIBURING
+  if (self->workers_use_io_uring)
+  {
+    pad->watched = fs_multi_udp_src_ring_recv_locked (worker, pad);
+    return;
+  }
+#endif
+
+  memset (&event, 0, sizeof (event));
+  event.events = EPOLLIN;
+  event.data.u64 = PAD_KEY (pad);
+
+  if (epoll_ctl (worker->epfd, EPOLL_CTL_ADD, pad->fd, &event) < 0)
+  {
+    GST_WARNING_OBJECT (pad, "Could not watch the socket: %s",
+        g_strerror (errno));
+    return;
+  }
+
+  pad->watched = TRUE;
+}
+
+static void
+fs_multi_udp_src_unwatch_locked (FsMultiUdpSrc *self, FsMultiUdpSrcPad *pad)
+{
+  FsMultiUdpSrcWorker *worker;
+  struct epoll_event event;
+
+  if (!pad->watched)
+    return;
+
+  worker = &self->workers[pad->id % self->n_workers];
+
+#ifdef HAVE_LIBURING
+  if (self->workers_use_io_uring)
+  {
+    /* Completions that are already queued are dropped, as the pad is no
+     * longer watched */
+    fs_multi_udp_src_ring_cancel_locked (worker, pad);
+    pad->watched = FALSE;
+    return;
+  }
+#endif
+
+  /* Kernels before 2.6.9 want a non-NULL event even for a delete */
+  memset (&event, 0, sizeof (event));
+  if (epoll_ctl (worker->epfd, EPOLL_CTL_DEL, pad->fd, &event) < 0)
+    GST_WARNING_OBJECT (pad, "Could not stop watching the socket: %s",
+        g_strerror (errno));
+
+  pad->watched = FALSE;
+}
+
+static GstPad *
+fs_multi_udp_src_request_new_pad (GstElement *element,
+    GstPadTemplate *templ,
+    const gchar *name,
+    const GstCaps *caps)
+{
+  FsMultiUdpSrc *self = FS_MULTI_UDP_SRC (element);
+  FsMultiUdpSrcPad *pad;
+  gchar *padname;
+  guint id;
+
+  GST_OBJECT_LOCK (self);
+  id = ++self->last_pad_id;
+  GST_OBJECT_UNLOCK (self);
+
+  padname = g_strdup_printf ("src_%u", id);
+  pad = g_object_new (FS_TYPE_MULTI_UDP_SRC_PAD,
+      "name", padname,
+      "direction", GST_PAD_SRC,
+      "template", templ,
+      NULL);
+  g_free (padname);
+  pad->id = id;
+
+  GST_OBJECT_LOCK (self);
+  g_hash_table_insert (self->pads, GUINT_TO_POINTER (id), pad);
+  GST_OBJECT_UNLOCK (self);
+
+  /* This also activates the pad if we are running */
+  if (!gst_element_add_pad (element, GST_PAD (pad)))
+  {
+    GST_OBJECT_LOCK (self);
+    g_hash_table_remove (self->pads, GUINT_TO_POINTER (id));
+    GST_OBJECT_UNLOCK (self);
+    return NULL;
+  }
+
+  return GST_PAD (pad);
+}
+
+static void
+fs_multi_udp_src_release_pad (GstElement *element, GstPad *pad)
+{
+  FsMultiUdpSrc *self = FS_MULTI_UDP_SRC (element);
+  FsMultiUdpSrcPad *mpad = FS_MULTI_UDP_SRC_PAD (pad);
+
+  GST_OBJECT_LOCK (self);
+  fs_multi_udp_src_unwatch_locked (self, mpad);
+  g_hash_table_remove (self->pads, GUINT_TO_POINTER (mpad->id));
+  GST_OBJECT_UNLOCK (self);
+
+  /* Takes the stream lock, so it waits for a worker that is still reading
+   * from this socket */
+  gst_pad_set_active (pad, FALSE);
+  gst_element_remove_pad (element, pad);
+}
+
+static void
+fs_multi_udp_src_start_stream (FsMultiUdpSrc *self, GstPad *pad)
+{
+  GstEvent *event;
+  GstSegment segment;
+  gchar *stream_id;
+
+  event = gst_pad_get_sticky_event (pad, GST_EVENT_STREAM_START, 0);
+  if (event)
+  {
+    gst_event_unref (event);
+    return;
+  }
+
+  stream_id = gst_pad_create_stream_id (pad, GST_ELEMENT (self), NULL);
+  gst_pad_push_event (pad, gst_event_new_stream_start (stream_id));
+  g_free (stream_id);
+
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  gst_pad_push_event (pad, gst_event_new_segment (&segment));
+}
+
+/* Returns a reference to the pad with its stream lock held, or NULL if it
+ * is gone, flushing or no longer has the socket the key was for */
+static FsMultiUdpSrcPad *
+fs_multi_udp_src_lock_pad (FsMultiUdpSrc *self,
+    guint64 key,
+    gint *fd,
+    GstBufferPool **pool,
+    GstClock **clock,
+    GstClockTime *base_time)
+{
+  FsMultiUdpSrcPad *pad;
+
+  *pool = NULL;
+  *clock = NULL;
+  *base_time = 0;
+
+  GST_OBJECT_LOCK (self);
+  pad = g_hash_table_lookup (self->pads, GUINT_TO_POINTER (KEY_ID (key)));
+  if (pad && pad->watched && PAD_KEY (pad) == key)
+  {
+    gst_object_ref (pad);
+    if (fd)
+      *fd = pad->fd;
+    if (pad->pool)
+      *pool = gst_object_ref (pad->pool);
+    if (self->do_timestamp && GST_ELEMENT_CLOCK (self))
+    {
+      *clock = gst_object_ref (GST_ELEMENT_CLOCK (self));
+      *base_time = GST_ELEMENT_CAST (self)->base_time;
+    }
+  }
+  else
+  {
+    pad = NULL;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (!pad)
+    return NULL;
+
+  /* Like a source task, hold the stream lock while pushing. Releasing the
+   * pad deactivates it first, so if it is not flushing, the socket is still
+   * open. */
+  GST_PAD_STREAM_LOCK (pad);
+
+  if (GST_PAD_IS_FLUSHING (pad))
+  {
+    GST_PAD_STREAM_UNLOCK (pad);
+    gst_object_unref (pad);
+    if (*pool)
+      gst_object_unref (*pool);
+    *pool = NULL;
+    if (*clock)
+      gst_object_unref (*clock);
+    *clock = NULL;
+    return NULL;
+  }
+
+  fs_multi_udp_src_start_stream (self, GST_PAD (pad));
+
+  return pad;
+}
+
+static void
+fs_multi_udp_src_unlock_pad (FsMultiUdpSrcPad *pad,
+    GstBufferPool *pool,
+    GstClock *clock)
+{
+  GST_PAD_STREAM_UNLOCK (pad);
+  gst_object_unref (pad);
+
+  if (pool)
+    gst_object_unref (pool);
+
+  if (clock)
+    gst_object_unref (clock);
+}
+
+/* Copies a packet into a buffer of the pool if it fits, or into a new
+ * buffer otherwise */
+static GstBuffer *
+fs_multi_udp_src_copy (GstBufferPool *pool,
+    const guint8 *data,
+    gsize len)
+{
+  GstBuffer *buffer = NULL;
+
+  if (pool &&
+      gst_buffer_pool_acquire_buffer (pool, &buffer, NULL) == GST_FLOW_OK)
+  {
+    if (gst_buffer_get_size (buffer) >= len)
+    {
+      gst_buffer_fill (buffer, 0, data, len);
+      gst_buffer_set_size (buffer, len);
+      return buffer;
+    }
+    gst_buffer_unref (buffer);
+  }
+
+  buffer = gst_buffer_new_allocate (NULL, len, NULL);
+  gst_buffer_fill (buffer, 0, data, len);
+
+  return buffer;
+}
+
+/* Takes ownership of the buffer */
+static GstFlowReturn
+fs_multi_udp_src_push (FsMultiUdpSrcPad *pad,
+    GstBuffer *buffer,
+    gpointer addr,
+    gsize addrlen,
+    GstClock *clock,
+    GstClockTime base_time)
+{
+  GSocketAddress *saddr;
+  GstFlowReturn ret;
+
+  saddr = g_socket_address_new_from_native (addr, addrlen);
+  if (saddr)
+  {
+    gst_buffer_add_net_address_meta (buffer, saddr);
+    g_object_unref (saddr);
+  }
+
+  if (clock)
+  {
+    GstClockTime now = gst_clock_get_time (clock);
+
+    if (now > base_time)
+      GST_BUFFER_DTS (buffer) = now - base_time;
+    else
+      GST_BUFFER_DTS (buffer) = 0;
+  }
+
+  ret = gst_pad_push (GST_PAD (pad), buffer);
+
+  /* One pad not being linked or downstream refusing the data must not
+   * stop the other sockets from being read */
+  if (ret != GST_FLOW_OK && ret != GST_FLOW_FLUSHING)
+    GST_LOG_OBJECT (pad, "Pushing returned %s", gst_flow_get_name (ret));
+
+  return ret;
+}
+
+static void
+fs_multi_udp_src_read (FsMultiUdpSrc *self,
+    FsMultiUdpSrcWorker *worker,
+    guint64 key)
+{
+  FsMultiUdpSrcPad *pad;
+  GstBufferPool *pool;
+  GstClock *clock;
+  GstClockTime base_time;
+  gint fd = -1;
+  guint i;
+
+  pad = fs_multi_udp_src_lock_pad (self, key, &fd, &pool, &clock,
+      &base_time);
+  if (!pad)
+    return;
+
+  for (i = 0; i < MAX_PACKETS_PER_WAKEUP; i++)
+  {
+    struct sockaddr_storage addr;
+    struct iovec iov[2];
+    struct msghdr msg;
+    GstBuffer *buffer = NULL;
+    GstMapInfo map;
+    gsize size = MAX_PACKET_SIZE;
+    gssize len;
+    gint err;
+
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_name = &addr;
+    msg.msg_namelen = sizeof (addr);
+    msg.msg_iov = iov;
+    msg.msg_iovlen = 1;
+    iov[0].iov_base = worker->data;
+    iov[0].iov_len = MAX_PACKET_SIZE;
+
+    /* Receive straight into a buffer of the pool when there is one, it is
+     * only inactive while the pad is being reconfigured. What does not fit
+     * in it, if the packet is bigger than the receive-mtu, goes on into the
+     * scratch buffer of the thread, so it does not get lost. */
+    if (pool &&
+        gst_buffer_pool_acquire_buffer (pool, &buffer, NULL) == GST_FLOW_OK)
+    {
+      gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+      size = map.size;
+      iov[1] = iov[0];
+      iov[0].iov_base = map.data;
+      iov[0].iov_len = map.size;
+      msg.msg_iovlen = 2;
+    }
+
+    len = recvmsg (fd, &msg, MSG_DONTWAIT);
+    err = errno;
+
+    if (buffer && len > (gssize) size)
+    {
+      GstBuffer *big = gst_buffer_new_allocate (NULL, len, NULL);
+
+      /* This one packet is too big for the pool, so it gets a buffer of
+       * its own */
+      GST_LOG_OBJECT (pad, "Got a packet of %" G_GSSIZE_FORMAT " bytes, the"
+          " buffers of the pool only have %" G_GSIZE_FORMAT, len, size);
+      gst_buffer_fill (big, 0, map.data, size);
+      gst_buffer_fill (big, size, worker->data, len - size);
+      gst_buffer_unmap (buffer, &map);
+      gst_buffer_unref (buffer);
+      buffer = big;
+    }
+    else if (buffer)
+    {
+      gst_buffer_unmap (buffer, &map);
+    }
+
+    if (len < 0)
+    {
+      if (buffer)
+        gst_buffer_unref (buffer);
+      /* ICMP errors from earlier sends are reported here, they do not
+       * mean there is nothing more to read */
+      if (err == EINTR || err == ECONNREFUSED)
+        continue;
+      if (err != EAGAIN && err != EWOULDBLOCK)
+        GST_DEBUG_OBJECT (pad, "Error receiving: %s", g_strerror (err));
+      break;
+    }
+
+    /* Only possible for a packet bigger than any UDP packet could be */
+    if (msg.msg_flags & MSG_TRUNC)
+    {
+      GST_DEBUG_OBJECT (pad, "Dropping a truncated packet");
+      if (buffer)
+        gst_buffer_unref (buffer);
+      continue;
+    }
+
+    if (!buffer)
+      buffer = fs_multi_udp_src_copy (NULL, worker->data, len);
+    else if (gst_buffer_get_size (buffer) > (gsize) len)
+      gst_buffer_set_size (buffer, len);
+
+    if (fs_multi_udp_src_push (pad, buffer, &addr, msg.msg_namelen, clock,
+            base_time) == GST_FLOW_FLUSHING)
+      break;
+  }
+
+  fs_multi_udp_src_unlock_pad (pad, pool, clock);
+}
+
+static void
+fs_multi_udp_src_loop (gpointer user_data)
+{
+  FsMultiUdpSrcWorker *worker = user_data;
+  FsMultiUdpSrc *self = worker->self;
+  struct epoll_event events[MAX_EVENTS];
+  gint n, i;
+
+  n = epoll_wait (worker->epfd, events, MAX_EVENTS, -1);
+
+  if (n < 0)
+  {
+    if (errno != EINTR)
+    {
+      GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+          ("Could not wait on the sockets: %s", g_strerror (errno)));
+      gst_task_pause (worker->task);
+    }
+    return;
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    /* When woken up, return so that the task can see it was stopped */
+    if (events[i].data.u64 == WAKEUP_ID)
+      return;
+
+    fs_multi_udp_src_read (self, worker, events[i].data.u64);
+  }
+}
+
+#ifdef HAVE_LIBURING
+
+static void
+fs_multi_udp_src_ring_complete (FsMultiUdpSrc *self,
+    FsMultiUdpSrcWorker *worker,
+    struct io_uring_cqe *cqe)
+{
+  guint64 key = io_uring_cqe_get_data64 (cqe);
+  guint8 *buf = NULL;
+  guint bid = 0;
+
+  if (cqe->flags & IORING_CQE_F_BUFFER)
+  {
+    bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+    buf = worker->buffers + (gsize) bid * RING_BUFFER_SIZE;
+  }
+
+  if (buf && cqe->res >= 0)
+  {
+    struct io_uring_recvmsg_out *out;
+    FsMultiUdpSrcPad *pad;
+    GstBufferPool *pool;
+    GstClock *clock;
+    GstClockTime base_time;
+
+    out = io_uring_recvmsg_validate (buf, cqe->res, &worker->msg);
+
+    if (!out)
+      GST_DEBUG_OBJECT (self, "Got an invalid receive completion");
+    else if (out->flags & MSG_TRUNC)
+      GST_DEBUG_OBJECT (self, "Dropping a truncated packet");
+    else if ((pad = fs_multi_udp_src_lock_pad (self, key, NULL, &pool,
+                &clock, &base_time)))
+    {
+      /* The ring buffers are shared by all the sockets of the thread, so
+       * the packet is copied out into the pool of its pad */
+      fs_multi_udp_src_push (pad,
+          fs_multi_udp_src_copy (pool,
+              io_uring_recvmsg_payload (out, &worker->msg),
+              io_uring_recvmsg_payload_length (out, cqe->res, &worker->msg)),
+          io_uring_recvmsg_name (out),
+          MIN (out->namelen, worker->msg.msg_namelen),
+          clock, base_time);
+      fs_multi_udp_src_unlock_pad (pad, pool, clock);
+    }
+  }
+
+  /* The data has been copied out, give the buffer back to the kernel */
+  if (buf)
+  {
+    io_uring_buf_ring_add (worker->buf_ring, buf, RING_BUFFER_SIZE, bid,
+        io_uring_buf_ring_mask (RING_BUFFERS), 0);
+    io_uring_buf_ring_advance (worker->buf_ring, 1);
+  }
+
+  if (!(cqe->flags & IORING_CQE_F_MORE))
+  {
+    FsMultiUdpSrcPad *pad;
+
+    /* The multishot request has ended. Unless it was cancelled, it is
+     * usually because the buffer ring ran empty, so restart it. The packets
+     * that arrived meanwhile are still in the socket. */
+    GST_OBJECT_LOCK (self);
+    pad = g_hash_table_lookup (self->pads, GUINT_TO_POINTER (KEY_ID (key)));
+    if (pad && pad->watched && PAD_KEY (pad) == key)
+    {
+      if (cqe->res >= 0 || cqe->res == -ENOBUFS ||
+          cqe->res == -ECONNREFUSED || cqe->res == -EINTR)
+      {
+        pad->watched = fs_multi_udp_src_ring_recv_locked (worker, pad);
+      }
+      else
+      {
+        GST_WARNING_OBJECT (pad, "Stopped receiving: %s",
+            g_strerror (-cqe->res));
+        pad->watched = FALSE;
+      }
+    }
+    GST_OBJECT_UNLOCK (self);
+  }
+}
+
+static void
+fs_multi_udp_src_ring_loop (gpointer user_data)
+{
+  FsMultiUdpSrcWorker *worker = user_data;
+  FsMultiUdpSrc *self = worker->self;
+  struct io_uring_cqe *cqe;
+  guint head, count = 0;
+  gint ret;
+
+  ret = io_uring_wait_cqe (&worker->ring, &cqe);
+
+  if (ret < 0)
+  {
+    if (ret != -EINTR)
+    {
+      GST_ELEMENT_ERROR (self, RESOURCE, READ, (NULL),
+          ("Could not wait for the io_uring completions: %s",
+              g_strerror (-ret)));
+      gst_task_pause (worker->task);
+    }
+    return;
+  }
+
+  /* Returning after a wakeup lets the task see it was stopped */
+  io_uring_for_each_cqe (&worker->ring, head, cqe)
+  {
+    guint64 key = io_uring_cqe_get_data64 (cqe);
+
+    if (key != WAKEUP_ID && key != RING_IGNORE_KEY)
+      fs_multi_udp_src_ring_complete (self, worker, cqe);
+    count++;
+  }
+
+  io_uring_cq_advance (&worker->ring, count);
+}
+
+#endif /* HAVE_LIBURING */
+
+static void
+fs_multi_udp_src_post_stream_status (FsMultiUdpSrc *self,
+    GstStreamStatusType type,
+    GstTask *task)
+{
+  GstMessage *message;
+  GValue value = G_VALUE_INIT;
+
+  message = gst_message_new_stream_status (GST_OBJECT (self), type,
+      GST_ELEMENT (self));
+  g_value_init (&value, GST_TYPE_TASK);
+  g_value_set_object (&value, task);
+  gst_message_set_stream_status_object (message, &value);
+  g_value_unset (&value);
+
+  gst_element_post_message (GST_ELEMENT (self), message);
+}
+
+static void
+fs_multi_udp_src_enter_thread (GstTask *task, GThread *thread,
+    gpointer user_data)
+{
+  FsMultiUdpSrcWorker *worker = user_data;
+
+  fs_multi_udp_src_post_stream_status (worker->self,
+      GST_STREAM_STATUS_TYPE_ENTER, task);
+}
+
+static void
+fs_multi_udp_src_leave_thread (GstTask *task, GThread *thread,
+    gpointer user_data)
+{
+  FsMultiUdpSrcWorker *worker = user_data;
+
+  fs_multi_udp_src_post_stream_status (worker->self,
+      GST_STREAM_STATUS_TYPE_LEAVE, task);
+}
+
+static void
+fs_multi_udp_src_free_workers (FsMultiUdpSrcWorker *workers, guint n_workers)
+{
+  guint i;
+
+  for (i = 0; i < n_workers; i++)
+  {
+    if (workers[i].task)
+    {
+      gst_task_join (workers[i].task);
+      gst_object_unref (workers[i].task);
+    }
+    g_rec_mutex_clear (&workers[i].task_lock);
+    if (workers[i].epfd >= 0)
+      close (workers[i].epfd);
+#ifdef HAVE_LIBURING
+    if (workers[i].buf_ring)
+      io_uring_free_buf_ring (&workers[i].ring, workers[i].buf_ring,
+          RING_BUFFERS, RING_BUFFER_GROUP);
+    /* Also cancels the receive requests that are still pending */
+    if (workers[i].ring_ready)
+      io_uring_queue_exit (&workers[i].ring);
+    g_free (workers[i].buffers);
+#endif
+    g_free (workers[i].data);
+  }
+
+  g_free (workers);
+}
+
+static gboolean
+fs_multi_udp_src_open_epoll (FsMultiUdpSrc *self,
+    FsMultiUdpSrcWorker *worker,
+    gint wakeup_fd)
+{
+  struct epoll_event event;
+
+  worker->data = g_malloc (MAX_PACKET_SIZE);
+
+  worker->epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (worker->epfd < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Could not create the epoll set: %s", g_strerror (errno)));
+    return FALSE;
+  }
+
+  memset (&event, 0, sizeof (event));
+  event.events = EPOLLIN;
+  event.data.u64 = WAKEUP_ID;
+  if (epoll_ctl (worker->epfd, EPOLL_CTL_ADD, wakeup_fd, &event) < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Could not watch the wakeup fd: %s", g_strerror (errno)));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+#ifdef HAVE_LIBURING
+static gboolean
+fs_multi_udp_src_open_ring (FsMultiUdpSrc *self,
+    FsMultiUdpSrcWorker *worker)
+{
+  guint i;
+  gint ret;
+
+  ret = io_uring_queue_init (RING_ENTRIES, &worker->ring, 0);
+  if (ret < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Could not create the io_uring: %s", g_strerror (-ret)));
+    return FALSE;
+  }
+  worker->ring_ready = TRUE;
+
+  worker->buf_ring = io_uring_setup_buf_ring (&worker->ring, RING_BUFFERS,
+      RING_BUFFER_GROUP, 0, &ret);
+  if (!worker->buf_ring)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+        ("Could not register the buffer ring: %s", g_strerror (-ret)));
+    return FALSE;
+  }
+
+  worker->buffers = g_malloc ((gsize) RING_BUFFERS * RING_BUFFER_SIZE);
+  for (i = 0; i < RING_BUFFERS; i++)
+    io_uring_buf_ring_add (worker->buf_ring,
+        worker->buffers + (gsize) i * RING_BUFFER_SIZE, RING_BUFFER_SIZE, i,
+        io_uring_buf_ring_mask (RING_BUFFERS), i);
+  io_uring_buf_ring_advance (worker->buf_ring, RING_BUFFERS);
+
+  /* The kernel reads the sizes of the address and of the control data from
+   * it for every packet, so it must outlive the requests */
+  memset (&worker->msg, 0, sizeof (worker->msg));
+  worker->msg.msg_namelen = sizeof (struct sockaddr_storage);
+
+  return TRUE;
+}
+#endif
+
+static gboolean
+fs_multi_udp_src_open (FsMultiUdpSrc *self)
+{
+  FsMultiUdpSrcWorker *workers;
+  GHashTableIter iter;
+  gpointer pad;
+  guint n_workers;
+  gboolean use_io_uring;
+  gint wakeup_fd = -1;
+  guint i;
+
+  GST_OBJECT_LOCK (self);
+  n_workers = self->n_threads;
+  use_io_uring = self->io_uring;
+  GST_OBJECT_UNLOCK (self);
+
+  /* The rings are woken up with a no-op request instead */
+  if (!use_io_uring)
+  {
+    wakeup_fd = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd < 0)
+    {
+      GST_ELEMENT_ERROR (self, RESOURCE, OPEN_READ, (NULL),
+          ("Could not create the wakeup fd: %s", g_strerror (errno)));
+      return FALSE;
+    }
+  }
+
+  workers = g_new0 (FsMultiUdpSrcWorker, n_workers);
+
+  for (i = 0; i < n_workers; i++)
+  {
+    workers[i].self = self;
+    g_rec_mutex_init (&workers[i].task_lock);
+    workers[i].epfd = -1;
+  }
+
+  for (i = 0; i < n_workers; i++)
+  {
+    FsMultiUdpSrcWorker *worker = &workers[i];
+    GstTaskFunction func = fs_multi_udp_src_loop;
+
+#ifdef HAVE_LIBURING
+    if (use_io_uring)
+    {
+      if (!fs_multi_udp_src_open_ring (self, worker))
+        goto error;
+      func = fs_multi_udp_src_ring_loop;
+    }
+    else
+#endif
+    if (!fs_multi_udp_src_open_epoll (self, worker, wakeup_fd))
+    {
+      goto error;
+    }
+
+    worker->task = gst_task_new (func, worker, NULL);
+    gst_task_set_lock (worker->task, &worker->task_lock);
+    gst_task_set_enter_callback (worker->task, fs_multi_udp_src_enter_thread,
+        worker, NULL);
+    gst_task_set_leave_callback (worker->task, fs_multi_udp_src_leave_thread,
+        worker, NULL);
+
+    /* Lets the application, or the conference, pick the task pool */
+    fs_multi_udp_src_post_stream_status (self, GST_STREAM_STATUS_TYPE_CREATE,
+        worker->task);
+  }
+
+  GST_OBJECT_LOCK (self);
+  self->workers = workers;
+  self->n_workers = n_workers;
+  self->workers_use_io_uring = use_io_uring;
+  self->wakeup_fd = wakeup_fd;
+
+  g_hash_table_iter_init (&iter, self->pads);
+  while (g_hash_table_iter_next (&iter, NULL, &pad))
+    fs_multi_udp_src_watch_locked (self, pad);
+  GST_OBJECT_UNLOCK (self);
+
+  GST_DEBUG_OBJECT (self, "Receiving on %u threads with %s", n_workers,
+      use_io_uring ? "io_uring" : "epoll");
+
+  return TRUE;
+
+ error:
+  fs_multi_udp_src_free_workers (workers, n_workers);
+  if (wakeup_fd >= 0)
+    close (wakeup_fd);
+  return FALSE;
+}
+
+static void
+fs_multi_udp_src_close (FsMultiUdpSrc *self)
+{
+  FsMultiUdpSrcWorker *workers;
+  GHashTableIter iter;
+  gpointer pad;
+  guint n_workers;
+  gint wakeup_fd;
+
+  GST_OBJECT_LOCK (self);
+  /* Closing the epoll sets or the rings removes the sockets from them */
+  g_hash_table_iter_init (&iter, self->pads);
+  while (g_hash_table_iter_next (&iter, NULL, &pad))
+    ((FsMultiUdpSrcPad *) pad)->watched = FALSE;
+
+  workers = self->workers;
+  n_workers = self->n_workers;
+  wakeup_fd = self->wakeup_fd;
+  self->workers = NULL;
+  self->n_workers = 0;
+  self->workers_use_io_uring = FALSE;
+  self->wakeup_fd = -1;
+  GST_OBJECT_UNLOCK (self);
+
+  if (workers)
+    fs_multi_udp_src_free_workers (workers, n_workers);
+  if (wakeup_fd >= 0)
+    close (wakeup_fd);
+}
+
+static void
+fs_multi_udp_src_start (FsMultiUdpSrc *self)
+{
+  guint64 value;
+  guint i;
+
+  /* Drain the wakeup from the last time the tasks were stopped */
+  if (self->wakeup_fd >= 0)
+    while (read (self->wakeup_fd, &value, sizeof (value)) > 0);
+
+  for (i = 0; i < self->n_workers; i++)
+    gst_task_start (self->workers[i].task);
+}
+
+static void
+fs_multi_udp_src_stop (FsMultiUdpSrc *self)
+{
+  guint64 value = 1;
+  guint i;
+
+  for (i = 0; i < self->n_workers; i++)
+    gst_task_stop (self->workers[i].task);
+
+#ifdef HAVE_LIBURING
+  if (self->workers_use_io_uring)
+  {
+    GST_OBJECT_LOCK (self);
+    for (i = 0; i < self->n_workers; i++)
+      fs_multi_udp_src_ring_wakeup_locked (&self->workers[i]);
+    GST_OBJECT_UNLOCK (self);
+  }
+  else
+#endif
+  /* The wakeup fd is in every epoll set and stays readable, so this wakes
+   * up all the threads */
+  if (write (self->wakeup_fd, &value, sizeof (value)) < 0)
+  {
+    GST_WARNING_OBJECT (self, "Could not wake up the threads: %s",
+        g_strerror (errno));
+  }
+
+  for (i = 0; i < self->n_workers; i++)
+    gst_task_join (self->workers[i].task);
+}
+
+static GstStateChangeReturn
+fs_multi_udp_src_change_state (GstElement *element, GstStateChange transition)
+{
+  FsMultiUdpSrc *self = FS_MULTI_UDP_SRC (element);
+  GstStateChangeReturn ret;
+
+  switch (transition)
+  {
+    case GST_STATE_CHANGE_NULL_TO_READY:
+      if (!fs_multi_udp_src_open (self))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_PLAYING:
+      fs_multi_udp_src_start (self);
+      break;
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      fs_multi_udp_src_stop (self);
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (fs_multi_udp_src_parent_class)->change_state (
+      element, transition);
+  if (ret == GST_STATE_CHANGE_FAILURE)
+    return ret;
+
+  switch (transition)
+  {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+    case GST_STATE_CHANGE_PLAYING_TO_PAUSED:
+      /* We are a live source */
+      ret = GST_STATE_CHANGE_NO_PREROLL;
+      break;
+    case GST_STATE_CHANGE_READY_TO_NULL:
+      fs_multi_udp_src_close (self);
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
+
+static gboolean
+fs_multi_udp_src_plugin_init (GstPlugin *plugin)
+{
+  return gst_element_register (plugin, "fsmultiudpsrc",
+      GST_RANK_NONE, FS_TYPE_MULTI_UDP_SRC);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    fsmultiudpsrc,
+    "Multi-socket UDP source",
+    fs_multi_udp_src_plugin_init, VERSION, "LGPL", "Farstream",
+    "http://www.freedesktop.org/wiki/Software/Farstream")
@@ -0,0 +1,77 @@
+/*
+ * Farstream - Multi-socket UDP source
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __FS_MULTI_UDP_SRC_H__
+#define __FS_MULTI_UDP_SRC_H__
+
+#include <gst/gst.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* #define's don't like whitespacey bits */
+#define FS_TYPE_MULTI_UDP_SRC \
+  (fs_multi_udp_src_get_type())
+#define FS_MULTI_UDP_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+  FS_TYPE_MULTI_UDP_SRC,FsMultiUdpSrc))
+#define FS_MULTI_UDP_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+  FS_TYPE_MULTI_UDP_SRC,FsMultiUdpSrcClass))
+#define FS_IS_MULTI_UDP_SRC(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),FS_TYPE_MULTI_UDP_SRC))
+#define FS_IS_MULTI_UDP_SRC_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),FS_TYPE_MULTI_UDP_SRC))
+
+typedef struct _FsMultiUdpSrc FsMultiUdpSrc;
+typedef struct _FsMultiUdpSrcClass FsMultiUdpSrcClass;
+typedef struct _FsMultiUdpSrcWorker FsMultiUdpSrcWorker;
+
+struct _FsMultiUdpSrc
+{
+  GstElement parent;
+
+  /* Everything below is protected by the object lock */
+
+  guint n_threads;
+  gboolean do_timestamp;
+  gboolean io_uring;
+
+  /* Indexed by the id of the pad, which is also its epoll key */
+  GHashTable *pads;
+  guint last_pad_id;
+
+  /* Only exist between READY and NULL */
+  FsMultiUdpSrcWorker *workers;
+  guint n_workers;
+  gboolean workers_use_io_uring;
+  gint wakeup_fd;
+};
+
+struct _FsMultiUdpSrcClass
+{
+  GstElementClass parent_class;
+};
+
+GType fs_multi_udp_src_get_type (void);
+
+G_END_DECLS
+
+#endif /* __FS_MULTI_UDP_SRC_H__ */
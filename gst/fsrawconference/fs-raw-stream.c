@@ -289,7 +289,7 @@ fs_raw_stream_dispose (GObject *obj)
     return;
 
 
-  if (fs_raw_conference_is_internal_thread (conference))
+  if (fs_conference_is_internal_thread (FS_CONFERENCE (conference)))
   {
     g_critical ("You MUST call fs_stream_destroy() from your main thread, "
         "this FsStream may now be leaked");
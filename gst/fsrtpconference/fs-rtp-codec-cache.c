@@ -40,6 +40,7 @@
 #include <farstream/fs-conference.h>
 
 #include "fs-rtp-conference.h"
+#include "fs-rtp-codec-specific.h"
 
 
 /* Because of annoying CRTs */
@@ -601,3 +602,311 @@ save_codecs_cache (FsMediaType media_type, GList *blueprints)
   GST_DEBUG ("Wrote binary codecs cache");
   return TRUE;
 }
+
+
+/*
+ * Cache of the configuration discovered from the encoders
+ *
+ * It is a GKeyFile with one group per cached codec, named after a checksum
+ * of the key, the group contains the key itself and one entry per config
+ * parameter prefixed with "param.".
+ * It is shared by all sessions of the process and written next to the
+ * blueprint caches.
+ */
+
+#define CONFIG_CACHE_KEY "key"
+#define CONFIG_CACHE_PARAM_PREFIX "param."
+
+G_LOCK_DEFINE_STATIC (config_cache);
+static GKeyFile *config_cache = NULL;
+/* TRUE while a write is queued on the writer, protected by config_cache */
+static gboolean config_cache_write_queued = FALSE;
+/* Created on the first write and drained when the last session is gone,
+ * protected by config_cache */
+static GThreadPool *config_cache_writer = NULL;
+static guint config_cache_users = 0;
+
+static gchar *
+get_codec_config_cache_path (void)
+{
+  gchar *cache_path;
+
+  cache_path = g_strdup (g_getenv ("FS_CODECS_CONFIG_CACHE"));
+  if (cache_path == NULL)
+    cache_path = g_build_filename (g_get_user_cache_dir (), "farstream",
+        "codecs-config." HOST_CPU ".cache", NULL);
+
+  return cache_path;
+}
+
+static GKeyFile *
+get_codec_config_cache_locked (void)
+{
+  gchar *cache_path;
+  GError *error = NULL;
+
+  if (config_cache)
+    return config_cache;
+
+  config_cache = g_key_file_new ();
+
+  cache_path = get_codec_config_cache_path ();
+
+  if (!codecs_cache_valid (cache_path))
+  {
+    GST_DEBUG ("Codec config cache %s is outdated or does not exist",
+        cache_path);
+  }
+  else if (!g_key_file_load_from_file (config_cache, cache_path,
+          G_KEY_FILE_NONE, &error))
+  {
+    GST_WARNING ("Could not load the codec config cache %s: %s", cache_path,
+        error->message);
+    g_clear_error (&error);
+  }
+  else
+  {
+    GST_DEBUG ("Loaded codec config cache %s", cache_path);
+  }
+
+  g_free (cache_path);
+
+  return config_cache;
+}
+
+/*
+ * Writes the cache to disk from the writer thread. The changes queued while
+ * a write is waiting are all saved by that write, the contents are only
+ * copied under the lock.
+ */
+
+static void
+write_codec_config_cache (gpointer data, gpointer user_data)
+{
+  gchar *cache_path;
+  gchar *dir;
+  gchar *contents;
+  gsize length;
+  GError *error = NULL;
+
+  G_LOCK (config_cache);
+  config_cache_write_queued = FALSE;
+  contents = g_key_file_to_data (config_cache, &length, NULL);
+  G_UNLOCK (config_cache);
+
+  cache_path = get_codec_config_cache_path ();
+
+  dir = g_path_get_dirname (cache_path);
+  g_mkdir_with_parents (dir, 0777);
+  g_free (dir);
+
+  if (!g_file_set_contents (cache_path, contents, length, &error))
+  {
+    GST_DEBUG ("Unable to save the codec config cache %s: %s", cache_path,
+        error->message);
+    g_clear_error (&error);
+  }
+
+  g_free (contents);
+  g_free (cache_path);
+}
+
+/*
+ * Queues a write of the cache, the callers are usually streaming threads
+ * that hold the session lock, so they must not wait for the disk.
+ */
+
+static void
+save_codec_config_cache_locked (void)
+{
+  GError *error = NULL;
+
+  if (config_cache_write_queued)
+    return;
+
+  if (!config_cache_writer)
+  {
+    config_cache_writer = g_thread_pool_new (write_codec_config_cache, NULL, 1,
+        FALSE, &error);
+    if (!config_cache_writer)
+    {
+      GST_ERROR ("Could not create the codec config cache writer: %s",
+          error ? error->message : "unknown error");
+      g_clear_error (&error);
+      return;
+    }
+  }
+
+  config_cache_write_queued = TRUE;
+  g_thread_pool_push (config_cache_writer, GINT_TO_POINTER (1), NULL);
+}
+
+/**
+ * codec_config_cache_ref:
+ *
+ * Registers a user of the codec config cache, each session is one.
+ */
+
+void
+codec_config_cache_ref (void)
+{
+  G_LOCK (config_cache);
+  config_cache_users++;
+  G_UNLOCK (config_cache);
+}
+
+/**
+ * codec_config_cache_unref:
+ *
+ * Unregisters a user of the codec config cache. When the last one is gone,
+ * waits for the queued write to be done, stops the writer thread and frees
+ * the in-memory cache.
+ */
+
+void
+codec_config_cache_unref (void)
+{
+  GThreadPool *writer = NULL;
+
+  G_LOCK (config_cache);
+  if (config_cache_users == 0)
+  {
+    G_UNLOCK (config_cache);
+    g_return_if_reached ();
+  }
+  config_cache_users--;
+  if (config_cache_users == 0)
+  {
+    writer = config_cache_writer;
+    config_cache_writer = NULL;
+  }
+  G_UNLOCK (config_cache);
+
+  /* The writer takes the lock, so it must not be held here */
+  if (writer)
+    g_thread_pool_free (writer, FALSE, TRUE);
+
+  G_LOCK (config_cache);
+  if (config_cache_users == 0 && !config_cache_writer && config_cache)
+  {
+    g_key_file_free (config_cache);
+    config_cache = NULL;
+  }
+  G_UNLOCK (config_cache);
+}
+
+/**
+ * lookup_codec_config_cache:
+ * @key: the key describing the encoder and the send codec
+ * @codec: the #FsCodec to add the configuration to
+ *
+ * Adds the cached configuration parameters for @key to @codec
+ *
+ * Returns: %TRUE if there was a cached configuration
+ */
+
+gboolean
+lookup_codec_config_cache (const gchar *key, FsCodec *codec)
+{
+  GKeyFile *cache;
+  gchar *group;
+  gchar **params;
+  gboolean found = FALSE;
+  gint i;
+
+  group = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+
+  G_LOCK (config_cache);
+  cache = get_codec_config_cache_locked ();
+
+  if (g_key_file_has_group (cache, group))
+  {
+    gchar *cached_key = g_key_file_get_string (cache, group,
+        CONFIG_CACHE_KEY, NULL);
+
+    found = !g_strcmp0 (cached_key, key);
+    g_free (cached_key);
+  }
+
+  if (found)
+  {
+    params = g_key_file_get_keys (cache, group, NULL, NULL);
+
+    for (i = 0; params && params[i]; i++)
+    {
+      gchar *value;
+
+      if (!g_str_has_prefix (params[i], CONFIG_CACHE_PARAM_PREFIX))
+        continue;
+
+      value = g_key_file_get_string (cache, group, params[i], NULL);
+      if (value &&
+          !fs_codec_get_optional_parameter (codec,
+              params[i] + strlen (CONFIG_CACHE_PARAM_PREFIX), NULL))
+        fs_codec_add_optional_parameter (codec,
+            params[i] + strlen (CONFIG_CACHE_PARAM_PREFIX), value);
+      g_free (value);
+    }
+
+    g_strfreev (params);
+  }
+
+  G_UNLOCK (config_cache);
+
+  g_free (group);
+
+  return found;
+}
+
+/**
+ * save_codec_config_cache:
+ * @key: the key describing the encoder and the send codec
+ * @codec: the #FsCodec with the discovered configuration
+ *
+ * Stores the configuration parameters of @codec in the cache and queues a
+ * write of the cache to disk if they changed.
+ */
+
+void
+save_codec_config_cache (const gchar *key, FsCodec *codec)
+{
+  GKeyFile *cache;
+  gchar *group;
+  GList *item;
+  gboolean changed = FALSE;
+
+  group = g_compute_checksum_for_string (G_CHECKSUM_SHA1, key, -1);
+
+  G_LOCK (config_cache);
+  cache = get_codec_config_cache_locked ();
+
+  for (item = codec->optional_params; item; item = item->next)
+  {
+    FsCodecParameter *param = item->data;
+    gchar *name;
+    gchar *old_value;
+
+    if (!codec_has_config_data_named (codec, param->name))
+      continue;
+
+    name = g_strconcat (CONFIG_CACHE_PARAM_PREFIX, param->name, NULL);
+    old_value = g_key_file_get_string (cache, group, name, NULL);
+    if (g_strcmp0 (old_value, param->value))
+    {
+      g_key_file_set_string (cache, group, name, param->value);
+      changed = TRUE;
+    }
+    g_free (old_value);
+    g_free (name);
+  }
+
+  if (changed)
+  {
+    g_key_file_set_string (cache, group, CONFIG_CACHE_KEY, key);
+    save_codec_config_cache_locked ();
+  }
+
+  G_UNLOCK (config_cache);
+
+  g_free (group);
+}
@@ -34,6 +34,11 @@ G_BEGIN_DECLS
 GList *load_codecs_cache (FsMediaType media_type);
 gboolean save_codecs_cache (FsMediaType media_type, GList *codec_blueprints);
 
+gboolean lookup_codec_config_cache (const gchar *key, FsCodec *codec);
+void save_codec_config_cache (const gchar *key, FsCodec *codec);
+void codec_config_cache_ref (void);
+void codec_config_cache_unref (void);
+
 
 G_END_DECLS
 
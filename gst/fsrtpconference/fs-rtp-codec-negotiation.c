@@ -47,9 +47,6 @@ static CodecAssociation *
 lookup_codec_association_by_pt_list (GList *codec_associations, gint pt,
     gboolean want_empty);
 
-static CodecAssociation *
-codec_association_copy (CodecAssociation *ca);
-
 static CodecAssociation *
 lookup_codec_association_custom_internal (GList *codec_associations,
     gboolean want_disabled, CAFindFunc func, gpointer user_data);
@@ -162,18 +159,25 @@ find_matching_pad (gconstpointer a, gconstpointer b)
   return ret;
 }
 
-static gboolean
-validate_codec_profile (CodecPreference *cp, const gchar *bin_description,
-    FsStreamDirection direction)
+/*
+ * Builds the bin described by the profile to verify that it has the right
+ * shape for the codec.
+ *
+ * Returns: the input caps for a send profile, the output caps for a recv
+ * profile or %NULL if the profile is invalid
+ */
+
+static GstCaps *
+validate_codec_profile_uncached (FsCodec *codec, GstCaps *caps,
+    const gchar *bin_description, FsStreamDirection direction)
 {
   GError *error = NULL;
   GstElement *codecbin = NULL;
   guint src_pad_count = 0, sink_pad_count = 0;
-  GstCaps *caps;
   GstIterator *iter;
   gboolean has_matching_pad = FALSE;
   GValue val = {0,};
-  gboolean ret = FALSE;
+  GstCaps *ret = NULL;
 
   codecbin = parse_bin_from_description_all_linked (bin_description, direction,
       &src_pad_count, &sink_pad_count, &error);
@@ -184,12 +188,10 @@ validate_codec_profile (CodecPreference *cp, const gchar *bin_description,
     GST_WARNING ("Could not build profile (%s): %s", bin_description,
         error->message);
     g_clear_error (&error);
-    return FALSE;
+    return NULL;
   }
   g_clear_error (&error);
 
-  caps = fs_codec_to_gst_caps (cp->codec);
-
   if (direction == FS_DIRECTION_SEND)
     iter = gst_element_iterate_src_pads (codecbin);
   else if (direction == FS_DIRECTION_RECV)
@@ -234,28 +236,107 @@ validate_codec_profile (CodecPreference *cp, const gchar *bin_description,
     goto done;
   }
 
-  if (direction == FS_DIRECTION_SEND)
+  ret = codec_get_in_out_caps (codec, caps, direction, codecbin);
+
+done:
+
+  gst_object_unref (codecbin);
+
+  return ret;
+}
+
+/*
+ * Building the bin of a profile is expensive, so the results of the
+ * validation are cached for the whole process. The cache is flushed if the
+ * list of features in the registry changes.
+ * The values are the caps returned by validate_codec_profile_uncached(),
+ * %NULL for invalid profiles.
+ */
+
+G_LOCK_DEFINE_STATIC (profile_validations);
+static GHashTable *profile_validations = NULL;
+static guint32 profile_validations_cookie = 0;
+
+static void
+_profile_validation_free (gpointer data)
+{
+  if (data)
+    gst_caps_unref (data);
+}
+
+static gboolean
+validate_codec_profile (CodecPreference *cp, const gchar *bin_description,
+    FsStreamDirection direction)
+{
+  GstCaps *caps;
+  GstCaps *result = NULL;
+  gchar *caps_str;
+  gchar *key;
+  gpointer value;
+  guint32 cookie;
+  gboolean cached;
+
+  caps = fs_codec_to_gst_caps (cp->codec);
+
+  caps_str = gst_caps_to_string (caps);
+  key = g_strdup_printf ("%s\n%s\n%s",
+      direction == FS_DIRECTION_SEND ? "send" : "recv", caps_str,
+      bin_description);
+  g_free (caps_str);
+
+  cookie = gst_registry_get_feature_list_cookie (gst_registry_get ());
+
+  G_LOCK (profile_validations);
+  if (!profile_validations || profile_validations_cookie != cookie)
   {
-    cp->input_caps = codec_get_in_out_caps (cp->codec, caps, FS_DIRECTION_SEND,
-        codecbin);
-    if (!cp->input_caps)
-      goto done;
+    if (profile_validations)
+      g_hash_table_unref (profile_validations);
+    profile_validations = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, _profile_validation_free);
+    profile_validations_cookie = cookie;
   }
-  else if (direction == FS_DIRECTION_RECV)
+  cached = g_hash_table_lookup_extended (profile_validations, key, NULL,
+      &value);
+  if (cached && value)
+    result = gst_caps_ref (value);
+  G_UNLOCK (profile_validations);
+
+  if (cached)
   {
-    cp->output_caps = codec_get_in_out_caps (cp->codec, caps, FS_DIRECTION_RECV,
-        codecbin);
-    if (!cp->output_caps)
-      goto done;
+    GST_LOG ("Using cached validation of profile (%s)", bin_description);
+    g_free (key);
   }
+  else
+  {
+    result = validate_codec_profile_uncached (cp->codec, caps,
+        bin_description, direction);
 
-  ret = TRUE;
-done:
+    G_LOCK (profile_validations);
+    if (profile_validations_cookie == cookie)
+      g_hash_table_replace (profile_validations, key,
+          result ? gst_caps_ref (result) : NULL);
+    else
+      g_free (key);
+    G_UNLOCK (profile_validations);
+  }
 
   gst_caps_unref (caps);
-  gst_object_unref (codecbin);
 
-  return ret;
+  if (!result)
+    return FALSE;
+
+  if (direction == FS_DIRECTION_SEND)
+  {
+    gst_caps_replace (&cp->input_caps, NULL);
+    cp->input_caps = result;
+  }
+  else
+  {
+    gst_caps_replace (&cp->output_caps, NULL);
+    cp->output_caps = result;
+  }
+
+  return TRUE;
 }
 
 static gboolean
@@ -986,20 +1067,8 @@ negotiate_stream_codec (CodecAssociation *old_ca, FsCodec *remote_codec,
   }
 }
 
-/**
- * negotiate_stream_codecs:
- * @remote_codecs: Remote codecs for the stream
- * @current_codec_assocations: The current list of #CodecAssociation
- * @multi_stream: %TRUE if there is more than one stream.
- *
- * This function performs codec negotiation for a single stream. It does an
- * intersection of the current codecs and the remote codecs.
- *
- * Returns: a #GList of #CodecAssociation
- */
-
-GList *
-negotiate_stream_codecs (
+static GList *
+negotiate_stream_codecs_uncached (
     const GList *remote_codecs,
     GList *current_codec_associations,
     gboolean multi_stream)
@@ -1111,6 +1180,286 @@ negotiate_stream_codecs (
   return NULL;
 }
 
+/*
+ * The result of negotiate_stream_codecs_uncached() only depends on its
+ * arguments, and many sessions negotiate the same local codecs against the
+ * same handful of remote codec lists. So the results are kept in a small
+ * process-wide LRU cache. The key is a serialization of every field that
+ * the negotiation looks at, and the generation of the blueprints, since the
+ * #CodecAssociation keep pointers to them.
+ *
+ * Setting the FS_RTP_NEGOTIATION_CACHE environment variable to "0"
+ * disables the cache, setting it to "verify" makes every hit be compared with
+ * a fresh negotiation. It is read on every negotiation, which is cheap next
+ * to building the key, so the tests can change it.
+ */
+
+#define NEGOTIATION_CACHE_SIZE 64
+
+enum {
+  NEGOTIATION_CACHE_DISABLED = 1,
+  NEGOTIATION_CACHE_ENABLED,
+  NEGOTIATION_CACHE_VERIFY
+};
+
+struct NegotiationCacheEntry {
+  gchar *key;
+  GList *codec_associations;
+};
+
+G_LOCK_DEFINE_STATIC (negotiation_cache);
+static GHashTable *negotiation_cache = NULL;
+/* Of struct NegotiationCacheEntry, most recently used first */
+static GQueue negotiation_cache_lru = G_QUEUE_INIT;
+
+static guint
+get_negotiation_cache_mode (void)
+{
+  const gchar *env = g_getenv ("FS_RTP_NEGOTIATION_CACHE");
+
+  if (env && !strcmp (env, "0"))
+    return NEGOTIATION_CACHE_DISABLED;
+  else if (env && !strcmp (env, "verify"))
+    return NEGOTIATION_CACHE_VERIFY;
+  else
+    return NEGOTIATION_CACHE_ENABLED;
+}
+
+static void
+append_string_to_key (GString *key, const gchar *str)
+{
+  if (str)
+    g_string_append_printf (key, "%" G_GSIZE_FORMAT ":%s", strlen (str), str);
+  else
+    g_string_append_c (key, '-');
+}
+
+static void
+append_codec_to_key (GString *key, const FsCodec *codec)
+{
+  GList *item;
+
+  if (!codec)
+  {
+    g_string_append_c (key, '-');
+    return;
+  }
+
+  g_string_append_printf (key, "(%d %d %u %u %u ", codec->id,
+      codec->media_type, codec->clock_rate, codec->channels,
+      codec->minimum_reporting_interval);
+  append_string_to_key (key, codec->encoding_name);
+
+  for (item = codec->optional_params; item; item = item->next)
+  {
+    FsCodecParameter *param = item->data;
+
+    g_string_append_c (key, 'o');
+    append_string_to_key (key, param->name);
+    append_string_to_key (key, param->value);
+  }
+
+  for (item = codec->feedback_params; item; item = item->next)
+  {
+    FsFeedbackParameter *param = item->data;
+
+    g_string_append_c (key, 'f');
+    append_string_to_key (key, param->type);
+    append_string_to_key (key, param->subtype);
+    append_string_to_key (key, param->extra_params);
+  }
+
+  g_string_append_c (key, ')');
+}
+
+static void
+append_codec_associations_to_key (GString *key, GList *codec_associations)
+{
+  GList *item;
+
+  for (item = codec_associations; item; item = item->next)
+  {
+    CodecAssociation *ca = item->data;
+
+    g_string_append_printf (key, "[%p %d%d%d%d ", ca->blueprint,
+        ca->reserved, ca->disable, ca->need_config, ca->recv_only);
+    append_codec_to_key (key, ca->codec);
+    append_codec_to_key (key, ca->send_codec);
+    append_string_to_key (key, ca->send_profile);
+    append_string_to_key (key, ca->recv_profile);
+    g_string_append_c (key, ']');
+  }
+}
+
+static gchar *
+negotiation_cache_key (const GList *remote_codecs,
+    GList *current_codec_associations, gboolean multi_stream)
+{
+  GString *key = g_string_new (NULL);
+  const GList *item;
+
+  g_string_append_printf (key, "%u %d\n", fs_rtp_blueprints_get_generation (),
+      multi_stream);
+  for (item = remote_codecs; item; item = item->next)
+    append_codec_to_key (key, item->data);
+  g_string_append_c (key, '\n');
+  append_codec_associations_to_key (key, current_codec_associations);
+
+  return g_string_free (key, FALSE);
+}
+
+static GList *
+codec_association_list_copy (GList *codec_associations)
+{
+  GList *copy = NULL;
+  GList *item;
+
+  for (item = codec_associations; item; item = item->next)
+    copy = g_list_prepend (copy, codec_association_copy (item->data));
+
+  return g_list_reverse (copy);
+}
+
+static gboolean
+codec_association_lists_are_identical (GList *list1, GList *list2)
+{
+  GString *key1 = g_string_new (NULL);
+  GString *key2 = g_string_new (NULL);
+  gboolean ret;
+
+  append_codec_associations_to_key (key1, list1);
+  append_codec_associations_to_key (key2, list2);
+  ret = g_string_equal (key1, key2);
+  g_string_free (key1, TRUE);
+  g_string_free (key2, TRUE);
+
+  return ret;
+}
+
+static void
+negotiation_cache_entry_free (struct NegotiationCacheEntry *entry)
+{
+  codec_association_list_destroy (entry->codec_associations);
+  g_slice_free (struct NegotiationCacheEntry, entry);
+}
+
+/* Returns %TRUE on a hit and sets @result to a copy of the cached list */
+
+static gboolean
+negotiation_cache_lookup (const gchar *key, GList **result)
+{
+  GList *link;
+
+  G_LOCK (negotiation_cache);
+  link = negotiation_cache ? g_hash_table_lookup (negotiation_cache, key) :
+      NULL;
+  if (link)
+  {
+    struct NegotiationCacheEntry *entry = link->data;
+
+    g_queue_unlink (&negotiation_cache_lru, link);
+    g_queue_push_head_link (&negotiation_cache_lru, link);
+    *result = codec_association_list_copy (entry->codec_associations);
+  }
+  G_UNLOCK (negotiation_cache);
+
+  return link != NULL;
+}
+
+/* Takes ownership of @key */
+
+static void
+negotiation_cache_insert (gchar *key, GList *codec_associations)
+{
+  struct NegotiationCacheEntry *entry;
+
+  G_LOCK (negotiation_cache);
+  if (!negotiation_cache)
+    negotiation_cache = g_hash_table_new_full (g_str_hash, g_str_equal,
+        g_free, NULL);
+
+  if (g_hash_table_lookup (negotiation_cache, key))
+  {
+    /* Another thread negotiated the same thing in the meantime */
+    G_UNLOCK (negotiation_cache);
+    g_free (key);
+    return;
+  }
+
+  while (g_queue_get_length (&negotiation_cache_lru) >=
+      NEGOTIATION_CACHE_SIZE)
+  {
+    entry = g_queue_pop_tail (&negotiation_cache_lru);
+    g_hash_table_remove (negotiation_cache, entry->key);
+    negotiation_cache_entry_free (entry);
+  }
+
+  entry = g_slice_new (struct NegotiationCacheEntry);
+  entry->key = key;
+  entry->codec_associations = codec_association_list_copy (codec_associations);
+  g_queue_push_head (&negotiation_cache_lru, entry);
+  g_hash_table_insert (negotiation_cache, key, negotiation_cache_lru.head);
+  G_UNLOCK (negotiation_cache);
+}
+
+/**
+ * negotiate_stream_codecs:
+ * @remote_codecs: Remote codecs for the stream
+ * @current_codec_assocations: The current list of #CodecAssociation
+ * @multi_stream: %TRUE if there is more than one stream.
+ *
+ * This function performs codec negotiation for a single stream. It does an
+ * intersection of the current codecs and the remote codecs.
+ *
+ * Returns: a #GList of #CodecAssociation
+ */
+
+GList *
+negotiate_stream_codecs (
+    const GList *remote_codecs,
+    GList *current_codec_associations,
+    gboolean multi_stream)
+{
+  guint mode = get_negotiation_cache_mode ();
+  GList *new_codec_associations = NULL;
+  gchar *key;
+
+  if (mode == NEGOTIATION_CACHE_DISABLED)
+    return negotiate_stream_codecs_uncached (remote_codecs,
+        current_codec_associations, multi_stream);
+
+  key = negotiation_cache_key (remote_codecs, current_codec_associations,
+      multi_stream);
+
+  if (negotiation_cache_lookup (key, &new_codec_associations))
+  {
+    GST_DEBUG ("Using cached negotiation result");
+
+    if (mode == NEGOTIATION_CACHE_VERIFY)
+    {
+      GList *uncached = negotiate_stream_codecs_uncached (remote_codecs,
+          current_codec_associations, multi_stream);
+
+      if (!codec_association_lists_are_identical (new_codec_associations,
+              uncached))
+        g_warning ("Cached codec negotiation result differs from the"
+            " uncached one");
+
+      codec_association_list_destroy (new_codec_associations);
+      new_codec_associations = uncached;
+    }
+
+    g_free (key);
+    return new_codec_associations;
+  }
+
+  new_codec_associations = negotiate_stream_codecs_uncached (remote_codecs,
+      current_codec_associations, multi_stream);
+  negotiation_cache_insert (key, new_codec_associations);
+
+  return new_codec_associations;
+}
+
 static void
 keep_config_from_old_codec (FsCodec *new_codec, FsCodec *old_codec)
 {
@@ -1305,8 +1654,15 @@ codec_association_list_destroy (GList *list)
   g_list_free (list);
 }
 
+/**
+ * codec_association_copy:
+ * @ca: a #CodecAssociation
+ *
+ * Returns: a deep copy of @ca, to be freed with
+ *  codec_association_list_destroy()
+ */
 
-static CodecAssociation *
+CodecAssociation *
 codec_association_copy (CodecAssociation *ca)
 {
   CodecAssociation *newca = g_slice_new (CodecAssociation);
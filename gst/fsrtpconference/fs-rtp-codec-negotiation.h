@@ -125,6 +125,9 @@ codec_associations_list_are_equal (GList *list1, GList *list2);
 void
 codec_association_list_destroy (GList *list);
 
+CodecAssociation *
+codec_association_copy (CodecAssociation *ca);
+
 typedef gboolean (*CAFindFunc) (CodecAssociation *ca, gpointer user_data);
 
 CodecAssociation *
@@ -377,19 +377,14 @@ codec_has_config_data_named (FsCodec *codec, const gchar *param_name)
     return FALSE;
 }
 
-/**
- * codec_copy_filtered
- * @codec: a #FsCodec
- * @paramtypes: bitmask of types of parameters to remove
- *
- * Makes a copy of a #FsCodec, but removes all parameters that match
- * of the bits from the paramtypes element
- *
- * Returns: the newly-allocated #FsCodec
+/*
+ * Makes a copy of a #FsCodec without the parameters that match one of the
+ * bits of @paramtypes, unless they also match one of the bits of @keeptypes.
  */
 
-FsCodec *
-codec_copy_filtered (FsCodec *codec, FsParamType paramtypes)
+static FsCodec *
+codec_copy_filtered_keep (FsCodec *codec, FsParamType paramtypes,
+    FsParamType keeptypes)
 {
   FsCodec *copy = fs_codec_copy (codec);
   GList *item = NULL;
@@ -404,7 +399,8 @@ codec_copy_filtered (FsCodec *codec, FsParamType paramtypes)
       FsCodecParameter *param = item->data;
       GList *next = g_list_next (item);
 
-      if (codec_param_check_type (nf, param->name, paramtypes))
+      if (codec_param_check_type (nf, param->name, paramtypes) &&
+          !codec_param_check_type (nf, param->name, keeptypes))
         fs_codec_remove_optional_parameter (copy, param);
 
       item = next;
@@ -414,6 +410,72 @@ codec_copy_filtered (FsCodec *codec, FsParamType paramtypes)
   return copy;
 }
 
+/**
+ * codec_copy_filtered
+ * @codec: a #FsCodec
+ * @paramtypes: bitmask of types of parameters to remove
+ *
+ * Makes a copy of a #FsCodec, but removes all parameters that match
+ * of the bits from the paramtypes element
+ *
+ * Returns: the newly-allocated #FsCodec
+ */
+
+FsCodec *
+codec_copy_filtered (FsCodec *codec, FsParamType paramtypes)
+{
+  return codec_copy_filtered_keep (codec, paramtypes, 0);
+}
+
+
+/**
+ * codec_config_is_equal:
+ * @old_codec: a #FsCodec
+ * @new_codec: a #FsCodec
+ *
+ * Checks if two codecs would be produced by identically configured
+ * encoders. They may differ in their payload type, their feedback parameters
+ * and in the parameters that are known to not be configuration parameters.
+ *
+ * Returns: %TRUE if the same encoder can be used for both codecs
+ */
+
+gboolean
+codec_config_is_equal (FsCodec *old_codec, FsCodec *new_codec)
+{
+  FsCodec *old_copy, *new_copy;
+  gboolean ret;
+
+  g_return_val_if_fail (old_codec, FALSE);
+  g_return_val_if_fail (new_codec, FALSE);
+
+  if (old_codec->media_type != new_codec->media_type ||
+      old_codec->clock_rate != new_codec->clock_rate ||
+      old_codec->channels != new_codec->channels ||
+      !old_codec->encoding_name || !new_codec->encoding_name ||
+      g_ascii_strcasecmp (old_codec->encoding_name, new_codec->encoding_name))
+    return FALSE;
+
+  /* Unknown parameters are kept because they could be anything */
+  old_copy = codec_copy_filtered_keep (old_codec,
+      FS_PARAM_TYPE_ALL | FS_PARAM_TYPE_MANDATORY, FS_PARAM_TYPE_CONFIG);
+  new_copy = codec_copy_filtered_keep (new_codec,
+      FS_PARAM_TYPE_ALL | FS_PARAM_TYPE_MANDATORY, FS_PARAM_TYPE_CONFIG);
+
+  new_copy->id = old_copy->id;
+  new_copy->minimum_reporting_interval = old_copy->minimum_reporting_interval;
+  while (old_copy->feedback_params)
+    fs_codec_remove_feedback_parameter (old_copy, old_copy->feedback_params);
+  while (new_copy->feedback_params)
+    fs_codec_remove_feedback_parameter (new_copy, new_copy->feedback_params);
+
+  ret = fs_codec_are_equal (old_copy, new_copy);
+
+  fs_codec_destroy (old_copy);
+  fs_codec_destroy (new_copy);
+
+  return ret;
+}
 
 /**
  * sdp_negotiate_codec:
@@ -73,6 +73,9 @@ codec_copy_filtered (FsCodec *codec, FsParamType types);
 GList *
 codecs_list_has_codec_config_changed (GList *old, GList *new);
 
+gboolean
+codec_config_is_equal (FsCodec *old_codec, FsCodec *new_codec);
+
 G_END_DECLS
 
 #endif
@@ -33,6 +33,22 @@
  *
  * The various sdes property allow you to set the content of the SDES packet
  * in the sent RTCP reports.
+ *
+ * If #FsRtpConference:deferred-teardown is set, destroying sessions and
+ * streams only detaches their elements from the conference, they are then
+ * stopped and freed on a separate thread. Once all of the detached elements
+ * have been stopped, the following message is posted:
+ *
+ * <refsect2><title>The "<literal>farstream-teardown-complete</literal>"
+ *   message</title>
+ * |[
+ * "farstream-teardown-complete"
+ * ]|
+ * <para>
+ * All of the elements of the destroyed sessions and streams have now been
+ * stopped and released.
+ * </para>
+ * </refsect2>
  */
 
 #ifdef HAVE_CONFIG_H
@@ -66,6 +82,7 @@ enum
 {
   PROP_0,
   PROP_SDES,
+  PROP_DEFERRED_TEARDOWN
 };
 
 
@@ -96,8 +113,19 @@ struct _FsRtpConferencePrivate
 
   GList *participants;
 
-  /* Array of all internal threads, as GThreads */
-  GPtrArray *threads;
+  /* Stops the detached elements when deferred_teardown is set, and
+   * runs the other teardown jobs, protected by GST_OBJECT_LOCK */
+  gboolean deferred_teardown;
+  GThreadPool *reaper;
+  guint reaping;
+};
+
+/* A job of the reaper, either an element to stop or a function to run */
+struct ReaperJob
+{
+  GstElement *element;
+  GFunc func;
+  gpointer data;
 };
 
 G_DEFINE_TYPE (FsRtpConference, fs_rtp_conference, FS_TYPE_CONFERENCE);
@@ -166,6 +194,14 @@ fs_rtp_conference_dispose (GObject * object)
   if (self->priv->disposed)
     return;
 
+  /* Every job holds a reference on the conference, so none is left, but
+   * this may run on the reaper thread when a job drops the last one */
+  if (self->priv->reaper)
+  {
+    g_thread_pool_free (self->priv->reaper, FALSE, FALSE);
+    self->priv->reaper = NULL;
+  }
+
   if (self->rtpbin) {
     gst_object_unref (self->rtpbin);
     self->rtpbin = NULL;
@@ -200,8 +236,6 @@ fs_rtp_conference_finalize (GObject * object)
   /* Peek will always succeed here because we 'refed the class in the _init */
   g_type_class_unref (g_type_class_peek (FS_TYPE_RTP_SUB_STREAM));
 
-  g_ptr_array_free (self->priv->threads, TRUE);
-
   G_OBJECT_CLASS (fs_rtp_conference_parent_class)->finalize (object);
 }
 
@@ -255,6 +289,15 @@ fs_rtp_conference_class_init (FsRtpConferenceClass * klass)
       g_param_spec_boxed ("sdes", "SDES Items for this conference",
           "SDES items to use for sessions in this conference",
           GST_TYPE_STRUCTURE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_DEFERRED_TEARDOWN,
+      g_param_spec_boolean ("deferred-teardown",
+          "Stop the elements of destroyed objects in a separate thread",
+          "Only detach the elements of destroyed sessions and streams and"
+          " stop them in a separate thread, so fs_session_destroy() and"
+          " fs_stream_destroy() return quickly",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -267,8 +310,6 @@ fs_rtp_conference_init (FsRtpConference *conf)
   conf->priv->disposed = FALSE;
   conf->priv->max_session_id = 1;
 
-  conf->priv->threads = g_ptr_array_new ();
-
   conf->rtpbin = gst_element_factory_make ("rtpbin", NULL);
 
   if (!conf->rtpbin) {
@@ -318,6 +359,11 @@ fs_rtp_conference_get_property (GObject *object,
     case PROP_SDES:
       g_object_get_property (G_OBJECT (self->rtpbin), "sdes", value);
       break;
+    case PROP_DEFERRED_TEARDOWN:
+      GST_OBJECT_LOCK (self);
+      g_value_set_boolean (value, self->priv->deferred_teardown);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -340,6 +386,11 @@ fs_rtp_conference_set_property (GObject *object,
     case PROP_SDES:
       g_object_set_property (G_OBJECT (self->rtpbin), "sdes", value);
       break;
+    case PROP_DEFERRED_TEARDOWN:
+      GST_OBJECT_LOCK (self);
+      self->priv->deferred_teardown = g_value_get_boolean (value);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -647,41 +698,6 @@ fs_rtp_conference_handle_message (
       }
     }
     break;
-    case GST_MESSAGE_STREAM_STATUS:
-    {
-      GstStreamStatusType type;
-      guint i;
-
-      gst_message_parse_stream_status (message, &type, NULL);
-
-      switch (type)
-      {
-        case GST_STREAM_STATUS_TYPE_ENTER:
-          GST_OBJECT_LOCK (self);
-          for (i = 0; i < self->priv->threads->len; i++)
-          {
-            if (g_ptr_array_index (self->priv->threads, i) ==
-                g_thread_self ())
-              goto done;
-          }
-          g_ptr_array_add (self->priv->threads, g_thread_self ());
-        done:
-          GST_OBJECT_UNLOCK (self);
-          break;
-
-        case GST_STREAM_STATUS_TYPE_LEAVE:
-          GST_OBJECT_LOCK (self);
-          while (g_ptr_array_remove_fast (self->priv->threads,
-                  g_thread_self ()));
-          GST_OBJECT_UNLOCK (self);
-          break;
-
-        default:
-          /* Do nothing */
-          break;
-      }
-    }
-      break;
     default:
       break;
   }
@@ -845,22 +861,163 @@ _rtpbin_on_ssrc_validated (GstElement *rtpbin,
   }
 }
 
+static void
+_reap_element (gpointer data, gpointer user_data)
+{
+  struct ReaperJob *job = data;
+  GstElement *element = job->element;
+  FsRtpConference *self = user_data;
+  gboolean done;
+
+  if (job->func)
+  {
+    job->func (job->data, self);
+    g_slice_free (struct ReaperJob, job);
+    gst_object_unref (self);
+    return;
+  }
+
+  g_slice_free (struct ReaperJob, job);
+
+  if (gst_element_set_state (element, GST_STATE_NULL) !=
+      GST_STATE_CHANGE_SUCCESS)
+    GST_WARNING_OBJECT (self, "Could not set %s to GST_STATE_NULL",
+        GST_ELEMENT_NAME (element));
+  gst_object_unref (element);
+
+  GST_OBJECT_LOCK (self);
+  done = (--self->priv->reaping == 0);
+  GST_OBJECT_UNLOCK (self);
+
+  if (done)
+    gst_element_post_message (GST_ELEMENT (self),
+        gst_message_new_element (GST_OBJECT (self),
+            gst_structure_new_empty ("farstream-teardown-complete")));
+
+  gst_object_unref (self);
+}
+
+/**
+ * fs_rtp_conference_has_deferred_teardown:
+ * @self: a #FsRtpConference
+ *
+ * Returns: %TRUE if the elements removed with
+ * fs_rtp_conference_remove_element() are stopped in a separate thread
+ */
+
+gboolean
+fs_rtp_conference_has_deferred_teardown (FsRtpConference *self)
+{
+  gboolean deferred;
+
+  GST_OBJECT_LOCK (self);
+  deferred = self->priv->deferred_teardown;
+  GST_OBJECT_UNLOCK (self);
+
+  return deferred;
+}
+
+/**
+ * fs_rtp_conference_remove_element:
+ * @self: a #FsRtpConference
+ * @element: an element inside the conference
+ *
+ * Removes @element from the conference and sets it to the NULL state. If
+ * #FsRtpConference:deferred-teardown is set, the element is only detached
+ * and the state change is done on a separate thread.
+ */
+
+/* Must be called with the object lock held */
+static gboolean
+fs_rtp_conference_start_reaper_locked (FsRtpConference *self)
+{
+  GError *error = NULL;
+
+  if (self->priv->disposed)
+    return FALSE;
+
+  if (self->priv->reaper)
+    return TRUE;
+
+  self->priv->reaper = g_thread_pool_new (_reap_element, self, 1, FALSE,
+      &error);
+  if (self->priv->reaper)
+    return TRUE;
+
+  GST_WARNING_OBJECT (self, "Could not start the teardown thread: %s",
+      error->message);
+  g_clear_error (&error);
+  return FALSE;
+}
+
+void
+fs_rtp_conference_remove_element (FsRtpConference *self, GstElement *element)
+{
+  gst_element_set_locked_state (element, TRUE);
+
+  GST_OBJECT_LOCK (self);
+  if (self->priv->deferred_teardown &&
+      fs_rtp_conference_start_reaper_locked (self))
+  {
+    struct ReaperJob *job = g_slice_new0 (struct ReaperJob);
+
+    self->priv->reaping++;
+    GST_OBJECT_UNLOCK (self);
+
+    gst_object_ref (element);
+    if (!gst_bin_remove (GST_BIN (self), element))
+      GST_WARNING_OBJECT (self, "Could not remove %s",
+          GST_ELEMENT_NAME (element));
+    job->element = element;
+    gst_object_ref (self);
+    g_thread_pool_push (self->priv->reaper, job, NULL);
+    return;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (gst_element_set_state (element, GST_STATE_NULL) !=
+      GST_STATE_CHANGE_SUCCESS)
+    GST_WARNING_OBJECT (self, "Could not set %s to GST_STATE_NULL",
+        GST_ELEMENT_NAME (element));
+  if (!gst_bin_remove (GST_BIN (self), element))
+    GST_WARNING_OBJECT (self, "Could not remove %s",
+        GST_ELEMENT_NAME (element));
+}
+
+/**
+ * fs_rtp_conference_queue_teardown:
+ * @self: a #FsRtpConference
+ * @func: the function to run
+ * @data: the data passed to @func, the conference is its user data
+ *
+ * Runs @func on the thread that stops the elements removed with
+ * fs_rtp_conference_remove_element(), for teardowns that would block on
+ * state changes. It is started even if #FsRtpConference:deferred-teardown
+ * is not set, and the jobs run in the order they are queued.
+ *
+ * Returns: %TRUE if @func was queued, %FALSE if the conference is disposed
+ * or the thread could not be started
+ */
+
 gboolean
-fs_rtp_conference_is_internal_thread (FsRtpConference *self)
+fs_rtp_conference_queue_teardown (FsRtpConference *self, GFunc func,
+    gpointer data)
 {
-  guint i;
-  gboolean ret = FALSE;
+  struct ReaperJob *job;
 
   GST_OBJECT_LOCK (self);
-  for (i = 0; i < self->priv->threads->len; i++)
+  if (!fs_rtp_conference_start_reaper_locked (self))
   {
-    if (g_ptr_array_index (self->priv->threads, i) == g_thread_self ())
-    {
-      ret = TRUE;
-      break;
-    }
+    GST_OBJECT_UNLOCK (self);
+    return FALSE;
   }
+
+  job = g_slice_new0 (struct ReaperJob);
+  job->func = func;
+  job->data = data;
+  gst_object_ref (self);
+  g_thread_pool_push (self->priv->reaper, job, NULL);
   GST_OBJECT_UNLOCK (self);
 
-  return ret;
+  return TRUE;
 }
@@ -77,7 +77,11 @@ GST_DEBUG_CATEGORY_EXTERN (fsrtpconference_nego);
 GstCaps *fs_codec_to_gst_caps (const FsCodec *codec);
 GstCaps *fs_codec_to_gst_caps_with_ptime (const FsCodec *codec);
 
-gboolean fs_rtp_conference_is_internal_thread (FsRtpConference *self);
+gboolean fs_rtp_conference_has_deferred_teardown (FsRtpConference *self);
+void fs_rtp_conference_remove_element (FsRtpConference *self,
+    GstElement *element);
+gboolean fs_rtp_conference_queue_teardown (FsRtpConference *self,
+    GFunc func, gpointer data);
 
 G_END_DECLS
 
@@ -86,6 +86,7 @@ static void codec_blueprints_add_caps (FsMediaType media_type);
 
 static GList *list_codec_blueprints[FS_MEDIA_TYPE_LAST+1] = { NULL };
 static gint codecs_lists_ref[FS_MEDIA_TYPE_LAST+1] = { 0 };
+static guint codecs_lists_generation = 0;
 G_LOCK_DEFINE_STATIC (codecs_lists);
 
 
@@ -1083,12 +1084,35 @@ fs_rtp_blueprints_unref (FsMediaType media_type)
       }
       g_list_free (list_codec_blueprints[media_type]);
       list_codec_blueprints[media_type] = NULL;
+      codecs_lists_generation++;
     }
   }
 
   G_UNLOCK (codecs_lists);
 }
 
+/**
+ * fs_rtp_blueprints_get_generation:
+ *
+ * Returns a counter that changes every time a list of blueprints is freed,
+ * so anything that remembers #CodecBlueprint pointers can know that
+ * they may have been reused for different blueprints.
+ *
+ * Returns: the current generation of the blueprint lists
+ */
+
+guint
+fs_rtp_blueprints_get_generation (void)
+{
+  guint generation;
+
+  G_LOCK (codecs_lists);
+  generation = codecs_lists_generation;
+  G_UNLOCK (codecs_lists);
+
+  return generation;
+}
+
 
 /* check if caps are found on given element */
 static gboolean
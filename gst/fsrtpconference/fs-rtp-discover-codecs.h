@@ -57,6 +57,7 @@ typedef struct _CodecBlueprint
 
 GList *fs_rtp_blueprints_get (FsMediaType media_type, GError **error);
 void fs_rtp_blueprints_unref (FsMediaType media_type);
+guint fs_rtp_blueprints_get_generation (void);
 
 gboolean codec_blueprint_has_factory (CodecBlueprint *blueprint,
     FsStreamDirection direction);
@@ -29,6 +29,8 @@
 
 #include "fs-rtp-packet-modder.h"
 
+#include <farstream/fs-transmitter.h>
+
 GST_DEBUG_CATEGORY_STATIC (fs_rtp_packet_modder_debug);
 #define GST_CAT_DEFAULT fs_rtp_packet_modder_debug
 
@@ -164,6 +166,33 @@ fs_rtp_packet_modder_sync_to_clock (FsRtpPacketModder *self,
   GST_OBJECT_UNLOCK (self);
 }
 
+/* Transmitters come and go, so ask again from time to time */
+#define SEND_TIME_QUERY_INTERVAL G_USEC_PER_SEC
+
+static gboolean
+fs_rtp_packet_modder_is_paced_downstream (FsRtpPacketModder *self)
+{
+  gint64 now = g_get_monotonic_time ();
+  GstQuery *query;
+
+  if (self->last_send_time_query &&
+      now - self->last_send_time_query < SEND_TIME_QUERY_INTERVAL)
+    return self->paced_downstream;
+
+  self->last_send_time_query = now;
+
+  query = fs_send_time_query_new ();
+  if (!gst_pad_peer_query (self->srcpad, query) ||
+      !fs_send_time_query_parse (query, &self->paced_downstream))
+    self->paced_downstream = FALSE;
+  gst_query_unref (query);
+
+  GST_DEBUG_OBJECT (self, "The packets are %spaced downstream",
+      self->paced_downstream ? "" : "not ");
+
+  return self->paced_downstream;
+}
+
 static GstFlowReturn
 fs_rtp_packet_modder_chain (GstPad *pad, GstObject *parent, GstBuffer *buffer)
 {
@@ -175,7 +204,28 @@ fs_rtp_packet_modder_chain (GstPad *pad, GstObject *parent, GstBuffer *buffer)
     buffer_ts = self->sync_func (self, buffer, self->user_data);
 
   if (GST_CLOCK_TIME_IS_VALID (buffer_ts))
-    fs_rtp_packet_modder_sync_to_clock (self, buffer_ts);
+  {
+    if (fs_rtp_packet_modder_is_paced_downstream (self))
+    {
+      GstClockTime send_time;
+
+      /* The sync function moves the timestamp of the packets it delays, let
+       * the transmitter send them then instead of blocking this thread */
+      GST_OBJECT_LOCK (self);
+      send_time = gst_segment_to_running_time (&self->segment,
+          GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (buffer));
+      if (GST_CLOCK_TIME_IS_VALID (send_time))
+        send_time += self->peer_latency;
+      GST_OBJECT_UNLOCK (self);
+
+      buffer = gst_buffer_make_writable (buffer);
+      fs_buffer_add_send_time_meta (buffer, send_time);
+    }
+    else
+    {
+      fs_rtp_packet_modder_sync_to_clock (self, buffer_ts);
+    }
+  }
 
   buffer = self->modder_func (self, buffer, buffer_ts, self->user_data);
 
@@ -271,6 +321,8 @@ fs_rtp_packet_modder_change_state (GstElement *element,
       /* reset negotiated values */
       self->peer_latency = 0;
       GST_OBJECT_UNLOCK (self);
+      self->paced_downstream = FALSE;
+      self->last_send_time_query = 0;
       break;
     default:
       break;
@@ -75,6 +75,12 @@ struct _FsRtpPacketModder {
   /* the latency of the upstream peer, we have to take this into account when
    * synchronizing the buffers. */
   GstClockTime peer_latency;
+
+  /* Only touched from the streaming thread. Whether the transmitters send
+   * the packets at the time of their FsSendTimeMeta, so they do not have to
+   * be held back here */
+  gboolean paced_downstream;
+  gint64 last_send_time_query;
 };
 
 struct _FsRtpPacketModderClass {
@@ -125,6 +125,7 @@
 #include "fs-rtp-stream.h"
 #include "fs-rtp-participant.h"
 #include "fs-rtp-discover-codecs.h"
+#include "fs-rtp-codec-cache.h"
 #include "fs-rtp-codec-negotiation.h"
 #include "fs-rtp-substream.h"
 #include "fs-rtp-special-source.h"
@@ -160,11 +161,48 @@ enum
   PROP_ALLOWED_SINK_CAPS,
   PROP_ALLOWED_SRC_CAPS,
   PROP_ENCRYPTION_PARAMETERS,
-  PROP_INTERNAL_SESSION
+  PROP_INTERNAL_SESSION,
+  PROP_MAX_PREBUILT_RECV_CODEC_BINS,
+  PROP_MAX_PARALLEL_CODEC_DISCOVERY,
+  PROP_USE_CODEC_CONFIG_CACHE,
+  PROP_PACED_SENDING,
+  PROP_MAX_SEND_MTU
 };
 
+#define DEFAULT_MAX_PARALLEL_CODEC_DISCOVERY (4)
+
 #define DEFAULT_NO_RTCP_TIMEOUT (7000)
 
+/* Receive buffers to preallocate per port in the transmitters that have
+ * receive pools: enough for what a jitterbuffer usually holds */
+#define AUDIO_RECEIVE_BUFFERS (12)
+#define VIDEO_RECEIVE_BUFFERS (64)
+
+/* Left out of the path MTU when setting the MTU of the payloaders, for the
+ * RTP header extensions and the SRTP authentication tag */
+#define SEND_MTU_HEADROOM (32)
+
+/* The receive buffers of the other side are usually sized for ethernet */
+#define DEFAULT_MAX_SEND_MTU (1500)
+
+/*
+ * The state that the streaming threads need for every new payload type or
+ * SSRC. It is published as an immutable refcounted snapshot every time it
+ * changes, so that they never have to wait for the session lock, which
+ * is held for a long time while negotiating.
+ */
+struct DataPlaneSnapshot
+{
+  gint refcount;
+
+  /* The caps for each payload type, without the config, NULL if unknown */
+  GstCaps *pt_caps[128];
+  FsCodec *current_send_codec;
+  /* ssrc -> FsRtpStream, the streams are not reffed and must never be
+   * dereferenced */
+  GHashTable *ssrc_streams;
+};
+
 struct _FsRtpSessionPrivate
 {
   FsMediaType media_type;
@@ -187,6 +225,9 @@ struct _FsRtpSessionPrivate
   GstElement *transmitter_rtcp_funnel;
 
   GstElement *rtpmuxer;
+
+  /* Only created and spliced in once encryption or decryption is needed,
+   * protected by the session lock */
   GstElement *srtpenc;
   GstElement *srtpdec;
 
@@ -205,15 +246,17 @@ struct _FsRtpSessionPrivate
   /* The discovery elements are only created when codec parameter discovery is
    * under progress.
    * They are normally destroyed when the caps are found but may be destroyed
-   * by the dispose function too, we hold refs to them
-   * These three elements can only be modified from the streaming threads
-   * and are protected by the stream lock
+   * by the dispose function too.
+   * The tee can only be modified from the streaming threads
+   * and is protected by the stream lock
    */
-  GstElement *discovery_fakesink;
-  GstElement *discovery_capsfilter;
-  GstElement *discovery_codecbin;
-  /* This one is protected by the session lock */
-  FsCodec *discovery_codec;
+  GstElement *discovery_tee;
+  /* List of struct DiscoveryBranch, one per codec being discovered
+   * The list is protected by the session lock */
+  GList *discovery_branches;
+  /* Protected by the session lock */
+  guint max_parallel_codec_discovery;
+  gboolean use_codec_config_cache;
 
   /* Request pad to release on dispose */
   GstPad *rtpbin_send_rtp_sink;
@@ -231,6 +274,12 @@ struct _FsRtpSessionPrivate
   GstElement *send_codecbin;
   GList *extra_send_capsfilters;
 
+  /* What the current send codec bin was built from, used to know if it can
+   * be re-used for a new send codec. Protected by the session mutex */
+  CodecBlueprint *send_codecbin_blueprint;
+  gchar *send_codecbin_profile;
+  FsCodec *send_codecbin_codec;
+
   /* These lists are protected by the session mutex */
   GList *streams;
   guint streams_cookie;
@@ -257,6 +306,15 @@ struct _FsRtpSessionPrivate
   gboolean telephony_event_running;
   GList *extra_sources;
 
+  /* Receive codec bins built in advance for the negotiated codecs, so that
+   * a substream for a new payload type does not have to wait for its
+   * elements to be created. Queue of struct PrebuiltCodecBin.
+   * Protected by the session mutex */
+  GQueue prebuilt_recv_codecbins;
+  guint max_prebuilt_recv_codecbins;
+  /* Protected by the session lock, changes for each prebuild */
+  guint prebuild_cookie;
+
   /* This is a ht of ssrc->streams
    * It is protected by the session mutex */
   GHashTable *ssrc_streams;
@@ -269,11 +327,29 @@ struct _FsRtpSessionPrivate
 
   /* IP Type of Service, protext by session mutex */
   guint tos;
+  /* Protected by session mutex */
+  gboolean paced_sending;
 
   /* Protected by session mutex */
   guint send_bitrate;
+  /* The rate the TFRC receivers report, 0 without TFRC.
+   * Protected by session mutex */
+  guint tfrc_receive_bitrate;
+  /* The receive bitrate last given to the transmitters.
+   * Protected by session mutex */
+  guint receive_bitrate;
+  /* What the remote sources had sent when the receive bitrate was last
+   * measured. Only used from the RTCP thread */
+  guint64 measured_octets;
+  gint64 measured_time;
   GstStructure *encryption_parameters;
 
+  /* The MTU given to the payloaders, 0 to leave their default, and the
+   * largest path MTU it is taken from, 0 for no limit.
+   * Protected by session mutex */
+  guint send_mtu;
+  guint max_send_mtu;
+
   /* Protected by session mutex */
   guint caps_generation;
   GstCaps *input_caps;
@@ -283,6 +359,11 @@ struct _FsRtpSessionPrivate
   FsRtpTfrc *rtp_tfrc;
   FsRtpKeyunitManager *keyunit_manager;
 
+  /* Only held to replace or ref the data plane snapshot, never
+   * take the session lock while holding it */
+  GMutex data_plane_mutex;
+  struct DataPlaneSnapshot *data_plane;
+
   /* Can only be used while using the lock */
   GRWLock disposed_lock;
   gboolean disposed;
@@ -323,6 +404,10 @@ static gboolean fs_rtp_session_set_codec_preferences (FsSession *session,
     GError **error);
 static void fs_rtp_session_verify_send_codec_bin_locked (FsRtpSession *self);
 
+static void data_plane_snapshot_unref (struct DataPlaneSnapshot *snapshot);
+static struct DataPlaneSnapshot *fs_rtp_session_get_data_plane (
+    FsRtpSession *self);
+
 static gchar **fs_rtp_session_list_transmitters (FsSession *session);
 static GType fs_rtp_session_get_stream_transmitter_type (FsSession *session,
     const gchar *transmitter);
@@ -375,6 +460,18 @@ static void
 fs_rtp_session_associate_free_substreams (FsRtpSession *session,
     FsRtpStream *stream, guint32 ssrc);
 
+struct PrebuiltCodecBin;
+
+static GList *
+fs_rtp_session_steal_prebuilt_recv_codec_bins_locked (FsRtpSession *session,
+    guint max);
+static void
+prebuilt_codec_bin_free (struct PrebuiltCodecBin *prebuilt);
+static void
+fs_rtp_session_prebuild_recv_codec_bins (FsRtpSession *session);
+static void
+fs_rtp_session_apply_cached_codec_config_locked (FsRtpSession *session);
+
 static void
 _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session);
 static GstPadProbeReturn
@@ -383,8 +480,14 @@ _discovery_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
 
 static void
 fs_rtp_session_set_send_bitrate (FsRtpSession *self, guint bitrate);
+static struct CodecBinBitrateSetters *
+codecbin_get_bitrate_setters (GstElement *codecbin);
 static gboolean
 codecbin_set_bitrate (GstElement *codecbin, guint bitrate);
+static void
+codecbin_set_mtu (GstElement *codecbin, guint mtu);
+static void
+fs_rtp_session_update_send_mtu_locked (FsRtpSession *self);
 static gboolean
 fs_rtp_session_set_allowed_caps (FsSession *session, GstCaps *sink_caps,
     GstCaps *src_caps, GError **error);
@@ -396,7 +499,13 @@ fs_rtp_session_set_encryption_parameters (FsSession *session,
 static GstCaps *
 _srtpdec_request_key (GstElement *srtpdec, guint ssrc, gpointer user_data);
 static gboolean
+_stream_decrypt_prepare_cb (FsRtpStream *stream, gpointer user_data);
+static gboolean
 _stream_decrypt_clear_locked_cb (FsRtpStream *stream, gpointer user_data);
+static void
+_stream_mtu_changed (FsRtpStream *stream, gpointer user_data);
+static gboolean
+fs_rtp_session_insert_srtpdec (FsRtpSession *self);
 
 
 //static guint signals[LAST_SIGNAL] = { 0 };
@@ -506,6 +615,59 @@ fs_rtp_session_class_init (FsRtpSessionClass *klass)
           G_TYPE_OBJECT,
           G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_MAX_PREBUILT_RECV_CODEC_BINS,
+      g_param_spec_uint ("max-prebuilt-recv-codec-bins",
+          "Maximum number of prebuilt receive codec bins",
+          "The maximum number of receive codec bins that are built in advance"
+          " for the negotiated codecs, so that the remote side can switch to"
+          " a new payload type without a gap while the decoder is created."
+          " 0 disables it",
+          0, 128, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MAX_PARALLEL_CODEC_DISCOVERY,
+      g_param_spec_uint ("max-parallel-codec-discovery",
+          "Maximum number of codecs whose configuration is discovered at once",
+          "The maximum number of encoders that are run in parallel to"
+          " discover the configuration of the codecs that need it",
+          1, 64, DEFAULT_MAX_PARALLEL_CODEC_DISCOVERY,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_USE_CODEC_CONFIG_CACHE,
+      g_param_spec_boolean ("use-codec-config-cache",
+          "Use the codec configuration cache",
+          "Re-use the codec configuration (like sprop-parameter-sets or"
+          " Vorbis/Theora headers) discovered by earlier sessions that used"
+          " the same encoder and codec parameters, instead of running the"
+          " encoder to discover it again. Only enable it if the encoder"
+          " properties are not changed by the application",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_PACED_SENDING,
+      g_param_spec_boolean ("paced-sending",
+          "Let the transmitters pace the sending",
+          "Have the transmitters that support it send the packets delayed by"
+          " the TFRC rate control at their departure time, instead of"
+          " holding them back in the streaming thread. Transmitters that"
+          " do not support it keep being fed at the paced rate",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MAX_SEND_MTU,
+      g_param_spec_uint ("max-send-mtu",
+          "Maximum path MTU given to the payloaders",
+          "The largest path MTU the payloaders are given, whatever the"
+          " transmitters report. The packets must fit in the receive"
+          " buffers of the other side, like the receive-mtu of a Farstream"
+          " raw UDP transmitter. 0 for no limit",
+          0, 65535, DEFAULT_MAX_SEND_MTU,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->dispose = fs_rtp_session_dispose;
   gobject_class->finalize = fs_rtp_session_finalize;
 
@@ -525,8 +687,16 @@ fs_rtp_session_init (FsRtpSession *self)
 
   g_mutex_init (&self->mutex);
 
+  codec_config_cache_ref ();
+
   g_rw_lock_init (&self->priv->disposed_lock);
 
+  g_mutex_init (&self->priv->data_plane_mutex);
+  self->priv->data_plane = g_slice_new0 (struct DataPlaneSnapshot);
+  self->priv->data_plane->refcount = 1;
+  self->priv->data_plane->ssrc_streams = g_hash_table_new (g_direct_hash,
+      g_direct_equal);
+
   self->priv->media_type = FS_MEDIA_TYPE_LAST + 1;
 
   self->priv->no_rtcp_timeout = DEFAULT_NO_RTCP_TIMEOUT;
@@ -536,6 +706,10 @@ fs_rtp_session_init (FsRtpSession *self)
       g_direct_equal);
 
   g_queue_init (&self->priv->telephony_events);
+  g_queue_init (&self->priv->prebuilt_recv_codecbins);
+  self->priv->max_parallel_codec_discovery =
+      DEFAULT_MAX_PARALLEL_CODEC_DISCOVERY;
+  self->priv->max_send_mtu = DEFAULT_MAX_SEND_MTU;
 }
 
 static void
@@ -547,13 +721,8 @@ _remove_transmitter (gpointer key, gpointer value, gpointer user_data)
 
   g_object_get (transmitter, "gst-sink", &sink, "gst-src", &src, NULL);
 
-  gst_element_set_locked_state (src, TRUE);
-  gst_element_set_state (src, GST_STATE_NULL);
-  gst_bin_remove (GST_BIN (self->priv->conference), src);
-
-  gst_element_set_locked_state (sink, TRUE);
-  gst_element_set_state (sink, GST_STATE_NULL);
-  gst_bin_remove (GST_BIN (self->priv->conference), sink);
+  fs_rtp_conference_remove_element (self->priv->conference, src);
+  fs_rtp_conference_remove_element (self->priv->conference, sink);
 
   gst_object_unref (src);
   gst_object_unref (sink);
@@ -611,8 +780,13 @@ remove_element (GstBin *conf, GstElement **element, gboolean unref)
 static void
 stop_and_remove (GstBin *conf, GstElement **element, gboolean unref)
 {
-  stop_element (*element);
-  remove_element (conf, element, unref);
+  if (*element == NULL)
+    return;
+
+  fs_rtp_conference_remove_element (FS_RTP_CONFERENCE (conf), *element);
+  if (unref)
+    gst_object_unref (*element);
+  *element = NULL;
 }
 
 static void
@@ -620,12 +794,15 @@ fs_rtp_session_dispose (GObject *obj)
 {
   FsRtpSession *self = FS_RTP_SESSION (obj);
   GList *item = NULL;
+  GList *prebuilt;
   GstBin *conferencebin = NULL;
+  gboolean deferred;
 
   if (fs_rtp_session_has_disposed_enter (self, NULL))
     return;
 
-  if (fs_rtp_conference_is_internal_thread (self->priv->conference))
+  if (fs_conference_is_internal_thread (
+          FS_CONFERENCE (self->priv->conference)))
   {
     g_critical ("You MUST call fs_session_destroy() from your main thread, "
         "this FsSession may now be leaked");
@@ -653,15 +830,19 @@ fs_rtp_session_dispose (GObject *obj)
     g_object_unref (self->priv->keyunit_manager);
   self->priv->keyunit_manager = NULL;
 
-  /* Lets stop all of the elements sink to source */
+  /* Lets stop all of the elements sink to source, with deferred teardown
+   * they are only detached and the transmitter elements are only stopped
+   * when they are removed */
+  deferred = fs_rtp_conference_has_deferred_teardown (self->priv->conference);
 
   /* First the send pipeline */
-  if (self->priv->transmitters)
+  if (self->priv->transmitters && !deferred)
     g_hash_table_foreach (self->priv->transmitters, _stop_transmitter_elem,
       "gst-sink");
 
   stop_and_remove (conferencebin, &self->priv->transmitter_rtp_tee, TRUE);
   stop_and_remove (conferencebin, &self->priv->transmitter_rtcp_tee, TRUE);
+  stop_and_remove (conferencebin, &self->priv->srtpenc, TRUE);
 
   if (self->priv->rtpbin_send_rtcp_src)
     gst_pad_set_active (self->priv->rtpbin_send_rtcp_src, FALSE);
@@ -754,6 +935,12 @@ fs_rtp_session_dispose (GObject *obj)
 
 
   /* Now the recv pipeline */
+  FS_RTP_SESSION_LOCK (self);
+  self->priv->prebuild_cookie++;
+  prebuilt = fs_rtp_session_steal_prebuilt_recv_codec_bins_locked (self, 0);
+  FS_RTP_SESSION_UNLOCK (self);
+  g_list_free_full (prebuilt, (GDestroyNotify) prebuilt_codec_bin_free);
+
   if (self->priv->free_substreams)
     g_list_foreach (self->priv->free_substreams, (GFunc) fs_rtp_sub_stream_stop,
       NULL);
@@ -765,12 +952,13 @@ fs_rtp_session_dispose (GObject *obj)
   stop_element (self->priv->transmitter_rtp_funnel);
   stop_element (self->priv->transmitter_rtcp_funnel);
 
-  if (self->priv->transmitters)
+  if (self->priv->transmitters && !deferred)
     g_hash_table_foreach (self->priv->transmitters, _stop_transmitter_elem,
       "gst-src");
 
   remove_element (conferencebin, &self->priv->transmitter_rtp_funnel, TRUE);
   remove_element (conferencebin, &self->priv->transmitter_rtcp_funnel, TRUE);
+  stop_and_remove (conferencebin, &self->priv->srtpdec, TRUE);
 
   self->priv->extra_sources =
     fs_rtp_special_sources_destroy (self->priv->extra_sources);
@@ -826,9 +1014,6 @@ fs_rtp_session_dispose (GObject *obj)
     self->priv->rtpbin_recv_rtcp_sink = NULL;
   }
 
-  g_clear_object (&self->priv->srtpenc);
-  g_clear_object (&self->priv->srtpdec);
-
   if (self->priv->transmitters)
   {
     g_hash_table_foreach (self->priv->transmitters, _remove_transmitter,
@@ -876,14 +1061,28 @@ fs_rtp_session_finalize (GObject *object)
 {
   FsRtpSession *self = FS_RTP_SESSION (object);
 
+#ifdef FS_LOCK_PROFILING
+  GST_INFO ("Session %u lock taken %" G_GUINT64_FORMAT " times, waited %"
+      G_GINT64_FORMAT " us and held %" G_GINT64_FORMAT " us in total,"
+      " longest hold %" G_GINT64_FORMAT " us in %s", self->id,
+      self->lock_count, self->lock_wait_total, self->lock_hold_total,
+      self->lock_hold_max, self->lock_hold_max_location);
+#endif
+
   g_mutex_clear (&self->mutex);
 
+  data_plane_snapshot_unref (self->priv->data_plane);
+  g_mutex_clear (&self->priv->data_plane_mutex);
+
   if (self->priv->blueprints)
   {
     fs_rtp_blueprints_unref (self->priv->media_type);
     self->priv->blueprints = NULL;
   }
 
+  /* Waits for the last session's config cache write */
+  codec_config_cache_unref ();
+
   g_list_free_full (self->priv->codec_preferences,
       (GDestroyNotify) codec_preference_destroy);
   codec_association_list_destroy (self->priv->codec_associations);
@@ -897,6 +1096,9 @@ fs_rtp_session_finalize (GObject *object)
   if (self->priv->requested_send_codec)
     fs_codec_destroy (self->priv->requested_send_codec);
 
+  fs_codec_destroy (self->priv->send_codecbin_codec);
+  g_free (self->priv->send_codecbin_profile);
+
   if (self->priv->ssrc_streams)
     g_hash_table_destroy (self->priv->ssrc_streams);
   if (self->priv->ssrc_streams_manual)
@@ -1012,9 +1214,12 @@ fs_rtp_session_get_property (GObject *object,
       g_value_set_object (value, self->priv->conference);
       break;
     case PROP_CURRENT_SEND_CODEC:
-      FS_RTP_SESSION_LOCK (self);
-      g_value_set_boxed (value, self->priv->current_send_codec);
-      FS_RTP_SESSION_UNLOCK (self);
+      {
+        struct DataPlaneSnapshot *snapshot =
+            fs_rtp_session_get_data_plane (self);
+        g_value_set_boxed (value, snapshot->current_send_codec);
+        data_plane_snapshot_unref (snapshot);
+      }
       break;
     case PROP_NO_RTCP_TIMEOUT:
       FS_RTP_SESSION_LOCK (self);
@@ -1050,6 +1255,31 @@ fs_rtp_session_get_property (GObject *object,
       g_value_set_uint (value, self->priv->send_bitrate);
       FS_RTP_SESSION_UNLOCK (self);
       break;
+    case PROP_MAX_PREBUILT_RECV_CODEC_BINS:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->max_prebuilt_recv_codecbins);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_MAX_PARALLEL_CODEC_DISCOVERY:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->max_parallel_codec_discovery);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_USE_CODEC_CONFIG_CACHE:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_boolean (value, self->priv->use_codec_config_cache);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_PACED_SENDING:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_boolean (value, self->priv->paced_sending);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_MAX_SEND_MTU:
+      FS_RTP_SESSION_LOCK (self);
+      g_value_set_uint (value, self->priv->max_send_mtu);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
     case PROP_RTP_HEADER_EXTENSIONS:
       FS_RTP_SESSION_LOCK (self);
       g_value_set_boxed (value, self->priv->hdrext_negotiated);
@@ -1095,6 +1325,38 @@ set_tos (gpointer key, gpointer val, gpointer user_data)
   g_object_set (trans, "tos", tos, NULL);
 }
 
+static void
+set_paced_sending (gpointer key, gpointer val, gpointer user_data)
+{
+  FsTransmitter *trans = val;
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (trans),
+          "paced-sending"))
+    g_object_set (trans, "paced-sending", GPOINTER_TO_INT (user_data), NULL);
+}
+
+/* The UDP transmitters size their socket buffers from these */
+static void
+set_send_bitrate (gpointer key, gpointer val, gpointer user_data)
+{
+  FsTransmitter *trans = val;
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (trans),
+          "send-bitrate"))
+    g_object_set (trans, "send-bitrate", GPOINTER_TO_UINT (user_data), NULL);
+}
+
+static void
+set_receive_bitrate (gpointer key, gpointer val, gpointer user_data)
+{
+  FsTransmitter *trans = val;
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (trans),
+          "receive-bitrate"))
+    g_object_set (trans, "receive-bitrate", GPOINTER_TO_UINT (user_data),
+        NULL);
+}
+
 static void
 fs_rtp_session_set_property (GObject *object,
                              guint prop_id,
@@ -1136,6 +1398,42 @@ fs_rtp_session_set_property (GObject *object,
     case PROP_SEND_BITRATE:
       fs_rtp_session_set_send_bitrate (self, g_value_get_uint (value));
       break;
+    case PROP_MAX_PREBUILT_RECV_CODEC_BINS:
+      {
+        GList *prebuilt;
+
+        FS_RTP_SESSION_LOCK (self);
+        self->priv->max_prebuilt_recv_codecbins = g_value_get_uint (value);
+        prebuilt = fs_rtp_session_steal_prebuilt_recv_codec_bins_locked (self,
+            self->priv->max_prebuilt_recv_codecbins);
+        FS_RTP_SESSION_UNLOCK (self);
+        g_list_free_full (prebuilt, (GDestroyNotify) prebuilt_codec_bin_free);
+        fs_rtp_session_prebuild_recv_codec_bins (self);
+      }
+      break;
+    case PROP_MAX_PARALLEL_CODEC_DISCOVERY:
+      FS_RTP_SESSION_LOCK (self);
+      self->priv->max_parallel_codec_discovery = g_value_get_uint (value);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_USE_CODEC_CONFIG_CACHE:
+      FS_RTP_SESSION_LOCK (self);
+      self->priv->use_codec_config_cache = g_value_get_boolean (value);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_PACED_SENDING:
+      FS_RTP_SESSION_LOCK (self);
+      self->priv->paced_sending = g_value_get_boolean (value);
+      g_hash_table_foreach (self->priv->transmitters, set_paced_sending,
+          GINT_TO_POINTER (self->priv->paced_sending));
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
+    case PROP_MAX_SEND_MTU:
+      FS_RTP_SESSION_LOCK (self);
+      self->priv->max_send_mtu = g_value_get_uint (value);
+      fs_rtp_session_update_send_mtu_locked (self);
+      FS_RTP_SESSION_UNLOCK (self);
+      break;
     case PROP_RTP_HEADER_EXTENSION_PREFERENCES:
       FS_RTP_SESSION_LOCK (self);
       fs_rtp_header_extension_list_destroy (self->priv->hdrext_preferences);
@@ -1176,33 +1474,118 @@ _rtp_tfrc_bitrate_changed (GObject *rtp_tfrc, GParamSpec *pspec,
   fs_rtp_session_set_send_bitrate (self, bitrate);
 }
 
+/*
+ * The transmitters resize their socket buffers from the receive bitrate, so
+ * they are only told when it moves by more than a quarter.
+ *
+ * Must be called with the session lock held
+ */
+static void
+fs_rtp_session_set_receive_bitrate_locked (FsRtpSession *self, guint bitrate)
+{
+  guint old = self->priv->receive_bitrate;
 
+  if (bitrate == old)
+    return;
 
-static GstElement *
-_rtpbin_request_encoder (GstElement *rtpbin, guint session_id,
-    gpointer user_data)
+  if (old && bitrate &&
+      (bitrate > old ? bitrate - old : old - bitrate) <= old / 4)
+    return;
+
+  GST_DEBUG ("Receiving at %u bits/s", bitrate);
+
+  self->priv->receive_bitrate = bitrate;
+  if (self->priv->transmitters)
+    g_hash_table_foreach (self->priv->transmitters, set_receive_bitrate,
+        GUINT_TO_POINTER (bitrate));
+}
+
+static void
+_rtp_tfrc_receive_bitrate_changed (GObject *rtp_tfrc, GParamSpec *pspec,
+    FsRtpSession *self)
 {
-  FsRtpSession *self = FS_RTP_SESSION (user_data);
+  guint bitrate;
 
-  if (self->id == session_id && self->priv->srtpenc) {
-    return gst_object_ref (self->priv->srtpenc);
-  } else {
-    return NULL;
-  }
+  g_object_get (rtp_tfrc, "receive-bitrate", &bitrate, NULL);
+
+  FS_RTP_SESSION_LOCK (self);
+  self->priv->tfrc_receive_bitrate = bitrate;
+  /* Without TFRC feedback, the measured bitrate takes over at the next RTCP
+   * packet */
+  if (bitrate)
+    fs_rtp_session_set_receive_bitrate_locked (self, bitrate);
+  FS_RTP_SESSION_UNLOCK (self);
 }
 
-static GstElement *
-_rtpbin_request_decoder (GstElement *rtpbin, guint session_id,
-    gpointer user_data)
+/*
+ * When TFRC does not report the receive bitrate, it is measured from how
+ * many bytes the remote sources sent since the last measurement. It is done
+ * when RTCP is sent, but at most once per second.
+ */
+static gboolean
+_rtpbin_internal_session_sending_rtcp (GObject *internal_session,
+    GstBuffer *buffer, gboolean is_early, FsRtpSession *self)
 {
-  FsRtpSession *self = FS_RTP_SESSION (user_data);
+  GValueArray *sources;
+  guint64 octets = 0;
+  gint64 now;
+  guint i;
+
+  now = g_get_monotonic_time ();
+  if (self->priv->measured_time &&
+      now - self->priv->measured_time < G_USEC_PER_SEC)
+    return FALSE;
 
-  if (self->id == session_id && self->priv->srtpdec)
-    return gst_object_ref (self->priv->srtpdec);
-  else
-    return NULL;
+  if (fs_rtp_session_has_disposed_enter (self, NULL))
+    return FALSE;
+
+  G_GNUC_BEGIN_IGNORE_DEPRECATIONS
+  g_object_get (internal_session, "sources", &sources, NULL);
+  for (i = 0; sources && i < sources->n_values; i++)
+  {
+    GObject *source = g_value_get_object (g_value_array_get_nth (sources, i));
+    GstStructure *stats = NULL;
+    gboolean internal;
+    guint64 source_octets;
+
+    g_object_get (source, "stats", &stats, NULL);
+    if (!stats)
+      continue;
+
+    if (gst_structure_get_boolean (stats, "internal", &internal) &&
+        !internal &&
+        gst_structure_get_uint64 (stats, "octets-received", &source_octets))
+      octets += source_octets;
+    gst_structure_free (stats);
+  }
+  if (sources)
+    g_value_array_free (sources);
+  G_GNUC_END_IGNORE_DEPRECATIONS
+
+  /* A source that went away takes its bytes with it, start over */
+  if (self->priv->measured_time && octets >= self->priv->measured_octets)
+  {
+    guint64 bitrate = (octets - self->priv->measured_octets) * 8 *
+        G_USEC_PER_SEC / (now - self->priv->measured_time);
+
+    FS_RTP_SESSION_LOCK (self);
+    if (!self->priv->tfrc_receive_bitrate)
+      fs_rtp_session_set_receive_bitrate_locked (self,
+          MIN (bitrate, G_MAXUINT));
+    FS_RTP_SESSION_UNLOCK (self);
+  }
+
+  self->priv->measured_octets = octets;
+  self->priv->measured_time = now;
+
+  fs_rtp_session_has_disposed_exit (self);
+
+  /* Nothing was added to the packet */
+  return FALSE;
 }
 
+
+
 static void
 fs_rtp_session_constructed (GObject *object)
 {
@@ -1220,10 +1603,6 @@ fs_rtp_session_constructed (GObject *object)
   GstPad *pad;
   GstPadLinkReturn ret;
   gchar *tmp;
-  gulong request_rtp_encoder_id = 0;
-  gulong request_rtp_decoder_id = 0;
-  gulong request_rtcp_encoder_id = 0;
-  gulong request_rtcp_decoder_id = 0;
 
   if (self->id == 0)
   {
@@ -1338,51 +1717,9 @@ fs_rtp_session_constructed (GObject *object)
 
   gst_object_unref (tee_sink_pad);
 
-  /* Create the SRTP encoder & decoder */
-
-  tmp = g_strdup_printf ("srtpenc_%u", self->id);
-  self->priv->srtpenc = gst_element_factory_make ("srtpenc", tmp);
-  g_free (tmp);
-  if (self->priv->srtpenc) {
-    GstPad *tmppad;
-    gst_object_ref_sink (self->priv->srtpenc);
-
-    g_object_set (self->priv->srtpenc,
-        "rtp-cipher", 0, "rtp-auth", 0, "rtcp-cipher", 0, "rtcp-auth", 0, NULL);
-
-    tmp = g_strdup_printf ("rtp_sink_%u", self->id);
-    tmppad = gst_element_get_request_pad (self->priv->srtpenc, tmp);
-    gst_object_unref (tmppad);
-    g_free (tmp);
-
-    tmp = g_strdup_printf ("rtcp_sink_%u", self->id);
-    tmppad = gst_element_get_request_pad (self->priv->srtpenc, tmp);
-    gst_object_unref (tmppad);
-    g_free (tmp);
-  }
-  tmp = g_strdup_printf ("srtpdec_%u", self->id);
-  self->priv->srtpdec = gst_element_factory_make ("srtpdec", tmp);
-  g_free (tmp);
-  if (self->priv->srtpdec) {
-    gst_object_ref_sink (self->priv->srtpdec);
-    g_signal_connect_object (self->priv->srtpdec, "request-key",
-        G_CALLBACK (_srtpdec_request_key), self, 0);
-  }
-
-  request_rtp_encoder_id =
-      g_signal_connect (self->priv->conference->rtpbin, "request-rtp-encoder",
-          G_CALLBACK (_rtpbin_request_encoder), self);
-  request_rtp_decoder_id =
-      g_signal_connect (self->priv->conference->rtpbin, "request-rtp-decoder",
-          G_CALLBACK (_rtpbin_request_decoder), self);
-  request_rtcp_encoder_id =
-      g_signal_connect (self->priv->conference->rtpbin, "request-rtcp-encoder",
-          G_CALLBACK (_rtpbin_request_encoder), self);
-  request_rtcp_decoder_id =
-      g_signal_connect (self->priv->conference->rtpbin, "request-rtcp-decoder",
-          G_CALLBACK (_rtpbin_request_decoder), self);
-
-  /* Request the parts of rtpbin */
+  /* Request the parts of rtpbin, the SRTP encoder and decoder are only
+   * spliced in front of them once encryption is enabled, so plain RTP
+   * sessions do not go through them */
 
 
   tmp = g_strdup_printf ("recv_rtp_sink_%u", self->id);
@@ -1406,15 +1743,6 @@ fs_rtp_session_constructed (GObject *object)
     gst_element_get_request_pad (self->priv->conference->rtpbin, tmp);
   g_free (tmp);
 
-  g_signal_handler_disconnect (self->priv->conference->rtpbin,
-      request_rtp_encoder_id);
-  g_signal_handler_disconnect (self->priv->conference->rtpbin,
-      request_rtp_decoder_id);
-  g_signal_handler_disconnect (self->priv->conference->rtpbin,
-      request_rtcp_encoder_id);
-  g_signal_handler_disconnect (self->priv->conference->rtpbin,
-      request_rtcp_decoder_id);
-
   if (!self->priv->rtpbin_recv_rtp_sink)
   {
      self->priv->construction_error = g_error_new (FS_ERROR,
@@ -1654,6 +1982,9 @@ fs_rtp_session_constructed (GObject *object)
   g_signal_connect (self->priv->rtpbin_internal_session,
       "notify::internal-ssrc",
       G_CALLBACK (_rtpbin_internal_session_notify_internal_ssrc), self);
+  g_signal_connect_object (self->priv->rtpbin_internal_session,
+      "on-sending-rtcp",
+      G_CALLBACK (_rtpbin_internal_session_sending_rtcp), self, 0);
 
   g_object_set (self->priv->rtpbin_internal_session,
       "favor-new", TRUE,
@@ -1717,6 +2048,8 @@ fs_rtp_session_constructed (GObject *object)
 
     g_signal_connect_object (self->priv->rtp_tfrc, "notify::bitrate",
         G_CALLBACK (_rtp_tfrc_bitrate_changed), self, 0);
+    g_signal_connect_object (self->priv->rtp_tfrc, "notify::receive-bitrate",
+        G_CALLBACK (_rtp_tfrc_receive_bitrate_changed), self, 0);
   }
 
   self->priv->keyunit_manager = fs_rtp_keyunit_manager_new (
@@ -1875,6 +2208,141 @@ GET_MEMBER (GObject, rtpbin_internal_session)
 GET_MEMBER (GstElement, rtpmuxer)
 #undef GET_MEMBER
 
+static void
+data_plane_snapshot_unref (struct DataPlaneSnapshot *snapshot)
+{
+  guint i;
+
+  if (!g_atomic_int_dec_and_test (&snapshot->refcount))
+    return;
+
+  for (i = 0; i < G_N_ELEMENTS (snapshot->pt_caps); i++)
+    if (snapshot->pt_caps[i])
+      gst_caps_unref (snapshot->pt_caps[i]);
+  fs_codec_destroy (snapshot->current_send_codec);
+  g_hash_table_unref (snapshot->ssrc_streams);
+  g_slice_free (struct DataPlaneSnapshot, snapshot);
+}
+
+/*
+ * Returns a reference to the current data plane snapshot, does not take the
+ * session lock.
+ */
+
+static struct DataPlaneSnapshot *
+fs_rtp_session_get_data_plane (FsRtpSession *self)
+{
+  struct DataPlaneSnapshot *snapshot;
+
+  g_mutex_lock (&self->priv->data_plane_mutex);
+  snapshot = self->priv->data_plane;
+  g_atomic_int_inc (&snapshot->refcount);
+  g_mutex_unlock (&self->priv->data_plane_mutex);
+
+  return snapshot;
+}
+
+/*
+ * Must be called with the session lock held after changing the codec
+ * associations (with @codecs_changed set), the current send codec or the
+ * ssrc to stream mapping.
+ */
+
+static void
+fs_rtp_session_publish_data_plane_locked (FsRtpSession *self,
+    gboolean codecs_changed)
+{
+  struct DataPlaneSnapshot *old = self->priv->data_plane;
+  struct DataPlaneSnapshot *snapshot = g_slice_new0 (struct DataPlaneSnapshot);
+  GHashTableIter iter;
+  gpointer key, value;
+  guint i;
+
+  snapshot->refcount = 1;
+
+  for (i = 0; i < G_N_ELEMENTS (snapshot->pt_caps); i++)
+  {
+    if (codecs_changed)
+    {
+      CodecAssociation *ca = lookup_codec_association_by_pt (
+          self->priv->codec_associations, i);
+
+      if (ca)
+      {
+        FsCodec *tmpcodec = codec_copy_filtered (ca->codec,
+            FS_PARAM_TYPE_CONFIG);
+        snapshot->pt_caps[i] = fs_codec_to_gst_caps (tmpcodec);
+        fs_codec_destroy (tmpcodec);
+      }
+    }
+    else if (old->pt_caps[i])
+    {
+      snapshot->pt_caps[i] = gst_caps_ref (old->pt_caps[i]);
+    }
+  }
+
+  snapshot->current_send_codec = fs_codec_copy (
+      self->priv->current_send_codec);
+
+  snapshot->ssrc_streams = g_hash_table_new (g_direct_hash, g_direct_equal);
+  g_hash_table_iter_init (&iter, self->priv->ssrc_streams);
+  while (g_hash_table_iter_next (&iter, &key, &value))
+    g_hash_table_insert (snapshot->ssrc_streams, key, value);
+
+  g_mutex_lock (&self->priv->data_plane_mutex);
+  self->priv->data_plane = snapshot;
+  g_mutex_unlock (&self->priv->data_plane_mutex);
+
+  data_plane_snapshot_unref (old);
+}
+
+#ifdef FS_LOCK_PROFILING
+
+/* Holding the session lock for longer than this is logged */
+#define LOCK_HOLD_WARNING_TIME (10 * G_TIME_SPAN_MILLISECOND)
+
+void
+fs_rtp_session_lock_profiled (FsRtpSession *self, const gchar *location)
+{
+  gint64 start = g_get_monotonic_time ();
+
+  g_mutex_lock (&self->mutex);
+#ifdef DEBUG_MUTEXES
+  g_assert (self->count == 0);
+  self->count++;
+#endif
+
+  self->lock_acquired = g_get_monotonic_time ();
+  self->lock_location = location;
+  self->lock_count++;
+  self->lock_wait_total += self->lock_acquired - start;
+}
+
+void
+fs_rtp_session_unlock_profiled (FsRtpSession *self)
+{
+  gint64 held = g_get_monotonic_time () - self->lock_acquired;
+
+  self->lock_hold_total += held;
+  if (held > self->lock_hold_max)
+  {
+    self->lock_hold_max = held;
+    self->lock_hold_max_location = self->lock_location;
+  }
+
+  if (held > LOCK_HOLD_WARNING_TIME)
+    GST_DEBUG ("Session %u lock held for %" G_GINT64_FORMAT " us from %s",
+        self->id, held, self->lock_location);
+
+#ifdef DEBUG_MUTEXES
+  g_assert (self->count == 1);
+  self->count--;
+#endif
+  g_mutex_unlock (&self->mutex);
+}
+
+#endif
+
 static gboolean
 fs_rtp_session_add_ssrc_stream_locked (FsRtpSession *self, guint32 ssrc,
     FsRtpStream *stream)
@@ -1884,6 +2352,7 @@ fs_rtp_session_add_ssrc_stream_locked (FsRtpSession *self, guint32 ssrc,
   {
     g_hash_table_insert (self->priv->ssrc_streams, GUINT_TO_POINTER (ssrc),
         stream);
+    fs_rtp_session_publish_data_plane_locked (self, FALSE);
     if (self->priv->srtpdec)
       g_signal_emit_by_name (self->priv->srtpdec, "remove-key", ssrc);
     return TRUE;
@@ -1900,6 +2369,8 @@ _stream_known_source_packet_received (FsRtpStream *stream, guint component,
   FsRtpSession *self = FS_RTP_SESSION_CAST (user_data);
   gboolean valid = FALSE;
   GstRTPBuffer rtpbuffer = GST_RTP_BUFFER_INIT;
+  struct DataPlaneSnapshot *snapshot;
+  gboolean known;
 
   if (fs_rtp_session_has_disposed_enter (self, NULL))
     return;
@@ -1955,9 +2426,22 @@ _stream_known_source_packet_received (FsRtpStream *stream, guint component,
     return;
   }
 
-  FS_RTP_SESSION_LOCK (self);
+  /* Every packet from a known source goes through here, the common case of
+   * an SSRC that is already associated is answered from the snapshot */
+  snapshot = fs_rtp_session_get_data_plane (self);
+  known = g_hash_table_contains (snapshot->ssrc_streams,
+      GUINT_TO_POINTER (ssrc));
+  data_plane_snapshot_unref (snapshot);
 
-  if (fs_rtp_session_add_ssrc_stream_locked (self, ssrc, stream))
+  if (known)
+  {
+    fs_rtp_session_has_disposed_exit (self);
+    return;
+  }
+
+  FS_RTP_SESSION_LOCK (self);
+
+  if (fs_rtp_session_add_ssrc_stream_locked (self, ssrc, stream))
   {
     FS_RTP_SESSION_UNLOCK (self);
 
@@ -2042,6 +2526,8 @@ _remove_stream (gpointer user_data,
       where_the_object_was);
   g_hash_table_foreach_remove (self->priv->ssrc_streams_manual,
       _remove_stream_from_ht, where_the_object_was);
+  fs_rtp_session_publish_data_plane_locked (self, FALSE);
+  fs_rtp_session_update_send_mtu_locked (self);
   FS_RTP_SESSION_UNLOCK (self);
 
   fs_rtp_session_has_disposed_exit (self);
@@ -2090,7 +2576,9 @@ fs_rtp_session_new_stream (FsSession *session,
           _stream_sending_changed_locked,
           _stream_ssrc_added_cb,
           _stream_get_new_stream_transmitter,
+          _stream_decrypt_prepare_cb,
           _stream_decrypt_clear_locked_cb,
+          _stream_mtu_changed,
           self));
 
   if (new_stream)
@@ -2449,24 +2937,17 @@ GstCaps *
 fs_rtp_session_request_pt_map (FsRtpSession *session, guint pt)
 {
   GstCaps *caps = NULL;
-  CodecAssociation *ca = NULL;
+  struct DataPlaneSnapshot *snapshot;
 
   if (fs_rtp_session_has_disposed_enter (session, NULL))
     return NULL;
 
-  FS_RTP_SESSION_LOCK (session);
-
-  ca = lookup_codec_association_by_pt (
-      session->priv->codec_associations, pt);
-
-  if (ca)
-  {
-    FsCodec *tmpcodec = codec_copy_filtered (ca->codec, FS_PARAM_TYPE_CONFIG);
-    caps = fs_codec_to_gst_caps (tmpcodec);
-    fs_codec_destroy (tmpcodec);
-  }
-
-  FS_RTP_SESSION_UNLOCK (session);
+  /* Called from the streaming thread, so use the snapshot to not wait for
+   * a negotiation that may be going on */
+  snapshot = fs_rtp_session_get_data_plane (session);
+  if (pt < G_N_ELEMENTS (snapshot->pt_caps) && snapshot->pt_caps[pt])
+    caps = gst_caps_ref (snapshot->pt_caps[pt]);
+  data_plane_snapshot_unref (snapshot);
 
   if (!caps)
     GST_WARNING ("Could not get caps for payload type %u in session %d",
@@ -2591,6 +3072,8 @@ fs_rtp_session_get_transmitter (FsRtpSession *self,
   FsTransmitter *transmitter;
   GstElement *src = NULL;
   guint tos;
+  gboolean paced_sending;
+  guint send_bitrate, receive_bitrate;
 
   FS_RTP_SESSION_LOCK (self);
   transmitter = g_hash_table_lookup (self->priv->transmitters,
@@ -2603,12 +3086,27 @@ fs_rtp_session_get_transmitter (FsRtpSession *self,
     return transmitter;
   }
   tos = self->priv->tos;
+  paced_sending = self->priv->paced_sending;
+  send_bitrate = self->priv->send_bitrate;
+  receive_bitrate = self->priv->receive_bitrate;
   FS_RTP_SESSION_UNLOCK (self);
 
   transmitter = fs_transmitter_new (transmitter_name, 2, tos, error);
   if (!transmitter)
     return NULL;
 
+  set_paced_sending (NULL, transmitter, GINT_TO_POINTER (paced_sending));
+  set_send_bitrate (NULL, transmitter, GUINT_TO_POINTER (send_bitrate));
+  set_receive_bitrate (NULL, transmitter, GUINT_TO_POINTER (receive_bitrate));
+
+  /* Video comes in bursts of MTU sized packets, audio as a trickle of
+   * small ones */
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (transmitter),
+          "receive-buffers"))
+    g_object_set (transmitter, "receive-buffers",
+        self->priv->media_type == FS_MEDIA_TYPE_VIDEO ?
+        VIDEO_RECEIVE_BUFFERS : AUDIO_RECEIVE_BUFFERS, NULL);
+
   g_signal_connect (transmitter, "error", G_CALLBACK (_transmitter_error),
       self);
 
@@ -2994,6 +3492,7 @@ fs_rtp_session_negotiate_codecs_locked (FsRtpSession *session,
 
   codec_association_list_destroy (session->priv->codec_associations);
   session->priv->codec_associations = new_negotiated_codec_associations;
+  fs_rtp_session_publish_data_plane_locked (session, TRUE);
 
   new_hdrexts = finish_header_extensions_nego (new_hdrexts, hdrext_used_ids);
 
@@ -3058,6 +3557,8 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
     g_signal_emit_by_name (session->priv->conference->rtpbin,
         "clear-pt-map");
 
+  fs_rtp_session_apply_cached_codec_config_locked (session);
+
   fs_rtp_session_start_codec_param_gathering_locked (session);
 
   if (has_remotes)
@@ -3067,6 +3568,8 @@ fs_rtp_session_update_codecs (FsRtpSession *session,
 
   FS_RTP_SESSION_UNLOCK (session);
 
+  fs_rtp_session_prebuild_recv_codec_bins (session);
+
   if (is_new)
   {
     g_object_notify (G_OBJECT (session), "codecs");
@@ -3848,6 +4351,12 @@ fs_rtp_session_remove_send_codec_bin (FsRtpSession *self,
     GstElement *codecbin = self->priv->send_codecbin;
     self->priv->send_codecbin = NULL;
 
+    self->priv->send_codecbin_blueprint = NULL;
+    g_free (self->priv->send_codecbin_profile);
+    self->priv->send_codecbin_profile = NULL;
+    fs_codec_destroy (self->priv->send_codecbin_codec);
+    self->priv->send_codecbin_codec = NULL;
+
     FS_RTP_SESSION_UNLOCK (self);
 
     if (!codecbin)
@@ -3872,6 +4381,7 @@ fs_rtp_session_remove_send_codec_bin (FsRtpSession *self,
 
   fs_codec_destroy (self->priv->current_send_codec);
   self->priv->current_send_codec = NULL;
+  fs_rtp_session_publish_data_plane_locked (self, FALSE);
   FS_RTP_SESSION_UNLOCK (self);
 
   while (self->priv->extra_send_capsfilters)
@@ -3941,6 +4451,8 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
   struct link_data data;
   FsCodec *send_codec_copy = fs_codec_copy (ca->send_codec);
   FsCodec *codec_copy = fs_codec_copy (ca->codec);
+  CodecBlueprint *blueprint = ca->blueprint;
+  gchar *send_profile = g_strdup (ca->send_profile);
 
   GST_DEBUG ("Trying to add send codecbin for " FS_CODEC_FORMAT,
       FS_CODEC_ARGS (ca->send_codec));
@@ -3952,6 +4464,10 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
       codecs, 0, NULL, error);
   g_free (name);
 
+  /* Look up the elements with a bitrate once, before the bin starts */
+  if (codecbin)
+    codecbin_get_bitrate_setters (codecbin);
+
   sendcaps = fs_codec_to_gst_caps (ca->send_codec);
 
   if (session->priv->rtp_tfrc &&
@@ -3961,11 +4477,16 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
 
     g_object_get (session->priv->rtp_tfrc, "bitrate", &bitrate, NULL);
     session->priv->send_bitrate = bitrate;
+    g_hash_table_foreach (session->priv->transmitters, set_send_bitrate,
+        GUINT_TO_POINTER (bitrate));
   }
 
   if (codecbin)
     codecbin_set_bitrate (codecbin, session->priv->send_bitrate);
 
+  if (codecbin && session->priv->send_mtu)
+    codecbin_set_mtu (codecbin, session->priv->send_mtu);
+
   FS_RTP_SESSION_UNLOCK (session);
 
   if (!codecbin)
@@ -3976,6 +4497,7 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
     fs_codec_destroy (send_codec_copy);
     fs_codec_destroy (codec_copy);
     fs_codec_list_destroy (codecs);
+    g_free (send_profile);
     return NULL;
   }
 
@@ -3991,6 +4513,7 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
     fs_codec_destroy (send_codec_copy);
     fs_codec_destroy (codec_copy);
     gst_caps_unref (sendcaps);
+    g_free (send_profile);
     return NULL;
   }
 
@@ -4007,6 +4530,7 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
     gst_caps_unref (sendcaps);
     fs_codec_destroy (codec_copy);
     fs_codec_destroy (send_codec_copy);
+    g_free (send_profile);
     return NULL;
   }
 
@@ -4084,6 +4608,8 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
 
   /* Re-set it here in case in changed while we were unlocked */
   codecbin_set_bitrate (codecbin, session->priv->send_bitrate);
+  if (session->priv->send_mtu)
+    codecbin_set_mtu (codecbin, session->priv->send_mtu);
 
   if (session->priv->streams_sending &&
       g_hash_table_size (session->priv->transmitters))
@@ -4105,8 +4631,13 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
   }
 
   session->priv->send_codecbin = codecbin;
+  session->priv->send_codecbin_blueprint = blueprint;
+  session->priv->send_codecbin_profile = send_profile;
+  session->priv->send_codecbin_codec = send_codec_copy;
+  send_codec_copy = NULL;
 
   session->priv->current_send_codec = codec_copy;
+  fs_rtp_session_publish_data_plane_locked (session, FALSE);
   FS_RTP_SESSION_UNLOCK (session);
 
   fs_codec_list_destroy (codecs);
@@ -4120,9 +4651,91 @@ fs_rtp_session_add_send_codec_bin_unlock (FsRtpSession *session,
   fs_codec_list_destroy (codecs);
   fs_codec_destroy (codec_copy);
   fs_codec_destroy (send_codec_copy);
+  g_free (send_profile);
   return NULL;
 }
 
+static void
+codecbin_set_pt_func (const GValue *item, gpointer user_data)
+{
+  GstElement *elem = g_value_get_object (item);
+  guint *pt = user_data;
+
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (elem), "pt"))
+    g_object_set (elem, "pt", *pt, NULL);
+}
+
+/*
+ * Checks if the current send codec bin can be kept for a new codec
+ * association. That is the case if it would be built from the same blueprint
+ * or profile and if the encoder would be configured the same way, ie only the
+ * payload type or non-configuration parameters differ.
+ *
+ * Must be called with the session lock held
+ */
+
+static gboolean
+fs_rtp_session_can_reuse_send_codec_bin_locked (FsRtpSession *self,
+    CodecAssociation *ca)
+{
+  if (!self->priv->send_codecbin || !self->priv->send_codecbin_codec)
+    return FALSE;
+
+  /* Codec bins with more than one src pad are not updated in place */
+  if (self->priv->extra_send_capsfilters)
+    return FALSE;
+
+  if (ca->blueprint != self->priv->send_codecbin_blueprint ||
+      g_strcmp0 (ca->send_profile, self->priv->send_codecbin_profile))
+    return FALSE;
+
+  return codec_config_is_equal (self->priv->send_codecbin_codec,
+      ca->send_codec);
+}
+
+/*
+ * Updates the current send codec bin for a new codec association without
+ * re-creating it, so the encoder keeps running and no new keyframe is needed.
+ *
+ * Must be called with the session lock held from the streaming thread
+ * with the send pad blocked
+ */
+
+static void
+fs_rtp_session_update_send_codec_bin_locked (FsRtpSession *self,
+    CodecAssociation *ca)
+{
+  GstCaps *sendcaps;
+  guint pt = ca->send_codec->id;
+
+  GST_DEBUG ("Updating send codec bin in place from " FS_CODEC_FORMAT
+      " to " FS_CODEC_FORMAT, FS_CODEC_ARGS (self->priv->send_codecbin_codec),
+      FS_CODEC_ARGS (ca->send_codec));
+
+  if (pt != self->priv->send_codecbin_codec->id)
+  {
+    GstIterator *it;
+
+    it = gst_bin_iterate_recurse (GST_BIN (self->priv->send_codecbin));
+    while (gst_iterator_foreach (it, codecbin_set_pt_func, &pt) ==
+        GST_ITERATOR_RESYNC)
+      gst_iterator_resync (it);
+    gst_iterator_free (it);
+  }
+
+  /* The new caps make the payloader renegotiate its output */
+  sendcaps = fs_codec_to_gst_caps (ca->send_codec);
+  g_object_set (self->priv->send_capsfilter, "caps", sendcaps, NULL);
+  gst_caps_unref (sendcaps);
+
+  fs_codec_destroy (self->priv->send_codecbin_codec);
+  self->priv->send_codecbin_codec = fs_codec_copy (ca->send_codec);
+
+  fs_codec_destroy (self->priv->current_send_codec);
+  self->priv->current_send_codec = fs_codec_copy (ca->codec);
+  fs_rtp_session_publish_data_plane_locked (self, FALSE);
+}
+
 /**
  * _send_src_pad_blocked_callback:
  *
@@ -4184,6 +4797,28 @@ _send_src_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
     goto skip_main_codec;
   }
 
+  if (fs_rtp_session_can_reuse_send_codec_bin_locked (self, ca))
+  {
+    GstElement *codecbin = gst_object_ref (self->priv->send_codecbin);
+
+    fs_rtp_session_update_send_codec_bin_locked (self, ca);
+    codec_copy = fs_codec_copy (ca->codec);
+    FS_RTP_SESSION_UNLOCK (self);
+
+    fs_rtp_keyunit_manager_codecbin_changed (self->priv->keyunit_manager,
+        codecbin, send_codec_copy);
+    gst_object_unref (codecbin);
+
+    fs_rtp_special_sources_remove (
+        &self->priv->extra_sources,
+        &self->priv->codec_associations,
+        FS_RTP_SESSION_GET_LOCK (self),
+        codec_copy,
+        special_source_stopped, self);
+    changed = TRUE;
+    goto skip_main_codec;
+  }
+
   FS_RTP_SESSION_UNLOCK (self);
 
   g_object_set (self->priv->media_sink_valve, "drop", TRUE, NULL);
@@ -4295,6 +4930,213 @@ fs_rtp_session_verify_send_codec_bin_locked (FsRtpSession *self)
           _send_src_pad_blocked_callback, g_object_ref (self), g_object_unref);
 }
 
+struct PrebuiltCodecBin {
+  guint pt;
+  guint builder_hash;
+  /* We own the floating reference */
+  GstElement *codecbin;
+};
+
+static void
+prebuilt_codec_bin_free (struct PrebuiltCodecBin *prebuilt)
+{
+  gst_element_set_state (prebuilt->codecbin, GST_STATE_NULL);
+  gst_object_unref (prebuilt->codecbin);
+  g_slice_free (struct PrebuiltCodecBin, prebuilt);
+}
+
+/*
+ * Removes the prebuilt receive codec bins in excess of @max from the session
+ * and returns them, they must be freed with prebuilt_codec_bin_free() after
+ * the lock has been released.
+ */
+
+static GList *
+fs_rtp_session_steal_prebuilt_recv_codec_bins_locked (FsRtpSession *session,
+    guint max)
+{
+  GList *stolen = NULL;
+
+  while (session->priv->prebuilt_recv_codecbins.length > max)
+    stolen = g_list_prepend (stolen,
+        g_queue_pop_tail (&session->priv->prebuilt_recv_codecbins));
+
+  return stolen;
+}
+
+static GList *
+find_prebuilt_codec_bin_in_list (GList *list, guint pt)
+{
+  for (; list; list = list->next)
+  {
+    struct PrebuiltCodecBin *prebuilt = list->data;
+
+    if (prebuilt->pt == pt)
+      return list;
+  }
+
+  return NULL;
+}
+
+/*
+ * Makes sure there is a prebuilt receive codec bin for the negotiated
+ * codecs, in order, up to the configured maximum. Bins are only re-created
+ * if the way they would be built has changed.
+ *
+ * Must be called without the session lock, the codecs are copied with the
+ * lock held, but the bins are built and brought to READY without it. If
+ * another call started in the meantime, its result wins and ours is dropped.
+ */
+
+static void
+fs_rtp_session_prebuild_recv_codec_bins (FsRtpSession *session)
+{
+  GQueue prebuilt = G_QUEUE_INIT;
+  GList *codec_associations = NULL;
+  GList *old_bins;
+  GList *item;
+  guint cookie;
+
+  FS_RTP_SESSION_LOCK (session);
+  cookie = ++session->priv->prebuild_cookie;
+
+  /* Take the current ones, they are kept if they are still good */
+  old_bins = session->priv->prebuilt_recv_codecbins.head;
+  g_queue_init (&session->priv->prebuilt_recv_codecbins);
+
+  for (item = session->priv->codec_associations;
+       item && g_list_length (codec_associations) <
+           session->priv->max_prebuilt_recv_codecbins;
+       item = item->next)
+  {
+    CodecAssociation *ca = item->data;
+
+    if (ca->disable || ca->reserved ||
+        (!ca->recv_profile &&
+            (!ca->blueprint ||
+                !codec_blueprint_has_factory (ca->blueprint,
+                    FS_DIRECTION_RECV))))
+      continue;
+
+    codec_associations = g_list_prepend (codec_associations,
+        codec_association_copy (ca));
+  }
+  FS_RTP_SESSION_UNLOCK (session);
+
+  codec_associations = g_list_reverse (codec_associations);
+
+  for (item = codec_associations; item; item = item->next)
+  {
+    CodecAssociation *ca = item->data;
+    struct PrebuiltCodecBin *old = NULL;
+    GList *old_item;
+    GstElement *codecbin;
+    guint builder_hash = 0;
+    gchar *name;
+    GError *error = NULL;
+
+    old_item = find_prebuilt_codec_bin_in_list (old_bins, ca->codec->id);
+    if (old_item)
+    {
+      old = old_item->data;
+      old_bins = g_list_delete_link (old_bins, old_item);
+    }
+
+    name = g_strdup_printf ("recv_prebuilt_%u_%u", session->id,
+        ca->codec->id);
+    codecbin = _create_codec_bin (ca, ca->codec, name, FS_DIRECTION_RECV,
+        NULL, old ? old->builder_hash : 0, &builder_hash, &error);
+    g_free (name);
+
+    if (!codecbin)
+    {
+      /* Returns NULL without error if the old one is still good */
+      if (old && !error)
+        g_queue_push_tail (&prebuilt, old);
+      else if (old)
+        prebuilt_codec_bin_free (old);
+
+      if (error)
+        GST_DEBUG ("Could not prebuild receive codec bin for "
+            FS_CODEC_FORMAT ": %s", FS_CODEC_ARGS (ca->codec),
+            error->message);
+      g_clear_error (&error);
+      continue;
+    }
+
+    if (old)
+      prebuilt_codec_bin_free (old);
+
+    /* Go to READY so the decoder is already opened */
+    gst_element_set_state (codecbin, GST_STATE_READY);
+
+    old = g_slice_new (struct PrebuiltCodecBin);
+    old->pt = ca->codec->id;
+    old->builder_hash = builder_hash;
+    old->codecbin = codecbin;
+    g_queue_push_tail (&prebuilt, old);
+
+    GST_DEBUG ("Prebuilt receive codec bin for " FS_CODEC_FORMAT,
+        FS_CODEC_ARGS (ca->codec));
+  }
+
+  codec_association_list_destroy (codec_associations);
+
+  /* Drop the ones for codecs that are no longer negotiated */
+  g_list_free_full (old_bins, (GDestroyNotify) prebuilt_codec_bin_free);
+
+  FS_RTP_SESSION_LOCK (session);
+  if (cookie == session->priv->prebuild_cookie)
+  {
+    old_bins = fs_rtp_session_steal_prebuilt_recv_codec_bins_locked (session,
+        0);
+    session->priv->prebuilt_recv_codecbins = prebuilt;
+  }
+  else
+  {
+    GST_DEBUG ("Prebuilt receive codec bins superseded, dropping them");
+    old_bins = prebuilt.head;
+  }
+  FS_RTP_SESSION_UNLOCK (session);
+
+  g_list_free_full (old_bins, (GDestroyNotify) prebuilt_codec_bin_free);
+}
+
+/*
+ * Takes the prebuilt receive codec bin for this payload type if there is one
+ * and if it is different from the one currently used.
+ *
+ * Returns: a codec bin with a floating reference or %NULL
+ */
+
+static GstElement *
+fs_rtp_session_take_prebuilt_recv_codec_bin_locked (FsRtpSession *session,
+    guint pt, guint current_builder_hash, guint *new_builder_hash)
+{
+  struct PrebuiltCodecBin *prebuilt;
+  GstElement *codecbin;
+  GList *item;
+
+  item = find_prebuilt_codec_bin_in_list (
+      session->priv->prebuilt_recv_codecbins.head, pt);
+  if (!item)
+    return NULL;
+
+  prebuilt = item->data;
+  if (prebuilt->builder_hash == current_builder_hash)
+    return NULL;
+
+  g_queue_delete_link (&session->priv->prebuilt_recv_codecbins, item);
+
+  GST_DEBUG ("Using prebuilt receive codec bin for pt %u", pt);
+
+  codecbin = prebuilt->codecbin;
+  *new_builder_hash = prebuilt->builder_hash;
+  g_slice_free (struct PrebuiltCodecBin, prebuilt);
+
+  return codecbin;
+}
+
 /*
  * This callback is called when the pad of a substream has been locked because
  * the codec needs to be changed.
@@ -4325,8 +5167,13 @@ _substream_get_codec_bin (FsRtpSubStream *substream,
 
   name = g_strdup_printf ("recv_%u_%u_%u", session->id, substream->ssrc,
       substream->pt);
-  codecbin = _create_codec_bin (ca, *new_codec, name, FS_DIRECTION_RECV, NULL,
-      current_builder_hash, new_builder_hash, error);
+  codecbin = fs_rtp_session_take_prebuilt_recv_codec_bin_locked (session,
+      substream->pt, current_builder_hash, new_builder_hash);
+  if (codecbin)
+    gst_element_set_name (codecbin, name);
+  else
+    codecbin = _create_codec_bin (ca, *new_codec, name, FS_DIRECTION_RECV,
+        NULL, current_builder_hash, new_builder_hash, error);
   g_free (name);
 
  out:
@@ -4539,6 +5386,7 @@ fs_rtp_session_bye_ssrc (FsRtpSession *session,
   if (!g_hash_table_lookup (session->priv->ssrc_streams_manual,
           GUINT_TO_POINTER (ssrc)))
     g_hash_table_remove (session->priv->ssrc_streams, GUINT_TO_POINTER (ssrc));
+  fs_rtp_session_publish_data_plane_locked (session, FALSE);
   FS_RTP_SESSION_UNLOCK (session);
 
   /*
@@ -4552,8 +5400,91 @@ fs_rtp_session_bye_ssrc (FsRtpSession *session,
 }
 
 
+/*
+ * The key of the codec config cache describes what the encoder produces:
+ * the send profile or the elements of the blueprint, and the send codec
+ * without its payload type and configuration.
+ */
+
+static gchar *
+get_codec_config_cache_key (CodecAssociation *ca)
+{
+  GString *key;
+  FsCodec *codec;
+  gchar *tmp;
+  GList *item, *item2;
+
+  if (!ca->send_codec)
+    return NULL;
+
+  key = g_string_new (NULL);
+
+  if (ca->send_profile)
+  {
+    g_string_append_printf (key, "profile:%s", ca->send_profile);
+  }
+  else if (ca->blueprint)
+  {
+    g_string_append (key, "blueprint:");
+    for (item = ca->blueprint->send_pipeline_factory; item; item = item->next)
+    {
+      for (item2 = item->data; item2; item2 = item2->next)
+        g_string_append_printf (key, "%s,",
+            gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (item2->data)));
+      g_string_append (key, "!");
+    }
+  }
+  else
+  {
+    g_string_free (key, TRUE);
+    return NULL;
+  }
+
+  codec = codec_copy_filtered (ca->send_codec, FS_PARAM_TYPE_CONFIG);
+  codec->id = 0;
+  tmp = fs_codec_to_string (codec);
+  g_string_append_printf (key, "\n%s", tmp);
+  g_free (tmp);
+  fs_codec_destroy (codec);
+
+  return g_string_free (key, FALSE);
+}
+
+/*
+ * Fills the codecs that need their configuration from the cache
+ * if it is enabled
+ */
+
+static void
+fs_rtp_session_apply_cached_codec_config_locked (FsRtpSession *session)
+{
+  GList *item;
+
+  if (!session->priv->use_codec_config_cache)
+    return;
+
+  for (item = session->priv->codec_associations; item; item = item->next)
+  {
+    CodecAssociation *ca = item->data;
+    gchar *key;
+
+    if (!ca->need_config || ca->disable)
+      continue;
+
+    key = get_codec_config_cache_key (ca);
+    if (key && lookup_codec_config_cache (key, ca->codec))
+    {
+      ca->need_config = codec_needs_config (ca->codec);
+      GST_DEBUG ("Using cached config for " FS_CODEC_FORMAT,
+          FS_CODEC_ARGS (ca->codec));
+    }
+    g_free (key);
+  }
+}
+
 static gboolean
-gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
+gather_caps_parameters (FsRtpSession *session, CodecAssociation *ca,
+    GstCaps *caps)
 {
   GstStructure *s = NULL;
   int i;
@@ -4609,6 +5540,15 @@ gather_caps_parameters (CodecAssociation *ca, GstCaps *caps)
 
   ca->need_config = FALSE;
 
+  if (session->priv->use_codec_config_cache)
+  {
+    gchar *key = get_codec_config_cache_key (ca);
+
+    if (key)
+      save_codec_config_cache (key, ca->codec);
+    g_free (key);
+  }
+
   return new_config;
 }
 
@@ -4646,7 +5586,7 @@ _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
    * Emit farstream-codecs-changed if the sending thread finds the config
    * for the last codec that needed it
    */
-  if (gather_caps_parameters (ca, caps))
+  if (gather_caps_parameters (session, ca, caps))
   {
     GList *item = NULL;
 
@@ -4684,51 +5624,125 @@ _send_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
   fs_rtp_session_has_disposed_exit (session);
 }
 
-static void
-_discovery_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
+/*
+ * Each codec that needs its configuration discovered gets its own branch
+ * behind the discovery tee:
+ * discovery_valve -> discovery_tee -> codecbin -> capsfilter -> fakesink
+ */
+
+struct DiscoveryBranch
 {
-  CodecAssociation *ca = NULL;
-  GstCaps *caps = NULL;
-  gboolean block = TRUE;
+  /* Protected by the session lock */
+  FsCodec *codec;
+  GstCaps *caps;
 
-  g_object_get (pad, "caps", &caps, NULL);
+  /* Set with the session lock held, it is how _discovery_caps_changed()
+   * finds the branch */
+  GstElement *capsfilter;
 
-  if (!caps)
-    return;
+  /* These are only modified from the streaming thread while the discovery
+   * pad is blocked, or after the discovery has been stopped */
+  GstPad *tee_pad;
+  GstElement *codecbin;
+  GstElement *fakesink;
+};
 
-  g_return_if_fail (GST_CAPS_IS_SIMPLE(caps));
+static void
+discovery_branch_destroy (FsRtpSession *session,
+    struct DiscoveryBranch *branch)
+{
+  GstBin *conferencebin = GST_BIN (session->priv->conference);
 
-  if (fs_rtp_session_has_disposed_enter (session, NULL))
-  {
-    gst_caps_unref (caps);
-    return;
-  }
+  stop_and_remove (conferencebin, &branch->fakesink, FALSE);
+  stop_and_remove (conferencebin, &branch->capsfilter, FALSE);
 
-  FS_RTP_SESSION_LOCK (session);
+  /* The codecbin is not in the conference yet if adding the branch failed */
+  if (branch->codecbin && !GST_OBJECT_PARENT (branch->codecbin))
+    gst_object_unref (branch->codecbin);
+  else
+    stop_and_remove (conferencebin, &branch->codecbin, FALSE);
 
-  /* If there is no codec, its because we're shutting down */
-  if (!session->priv->discovery_codec)
+  if (branch->tee_pad)
   {
-    GST_DEBUG ("Got caps while discovery is stopping");
-    goto out;
+    gst_element_release_request_pad (session->priv->discovery_tee,
+        branch->tee_pad);
+    gst_object_unref (branch->tee_pad);
+  }
+
+  fs_codec_destroy (branch->codec);
+  gst_caps_unref (branch->caps);
+  g_slice_free (struct DiscoveryBranch, branch);
+}
+
+static struct DiscoveryBranch *
+find_discovery_branch_locked (FsRtpSession *session, GstElement *capsfilter)
+{
+  GList *item;
+
+  for (item = session->priv->discovery_branches; item; item = item->next)
+  {
+    struct DiscoveryBranch *branch = item->data;
+
+    if (branch->capsfilter == capsfilter)
+      return branch;
+  }
+
+  return NULL;
+}
+
+static void
+_discovery_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
+{
+  CodecAssociation *ca = NULL;
+  GstCaps *caps = NULL;
+  gboolean block = TRUE;
+  struct DiscoveryBranch *branch;
+  GstElement *capsfilter;
+
+  g_object_get (pad, "caps", &caps, NULL);
+
+  if (!caps)
+    return;
+
+  g_return_if_fail (GST_CAPS_IS_SIMPLE(caps));
+
+  if (fs_rtp_session_has_disposed_enter (session, NULL))
+  {
+    gst_caps_unref (caps);
+    return;
+  }
+
+  capsfilter = gst_pad_get_parent_element (pad);
+
+  FS_RTP_SESSION_LOCK (session);
+
+  branch = find_discovery_branch_locked (session, capsfilter);
+
+  /* If there is no branch, its because we're shutting down */
+  if (!branch || !branch->codec)
+  {
+    GST_DEBUG ("Got caps while discovery is stopping");
+    goto out;
   }
 
   ca = lookup_codec_association_by_codec_for_sending (
-      session->priv->codec_associations,
-      session->priv->discovery_codec);
+      session->priv->codec_associations, branch->codec);
 
   if (ca && ca->need_config)
   {
-    gather_caps_parameters (ca, caps);
-    fs_codec_destroy (session->priv->discovery_codec);
-    session->priv->discovery_codec = fs_codec_copy (ca->codec);
+    gather_caps_parameters (session, ca, caps);
+    fs_codec_destroy (branch->codec);
+    branch->codec = fs_codec_copy (ca->codec);
     block = !ca->need_config;
   }
 
  out:
 
   gst_caps_unref (caps);
+  if (capsfilter)
+    gst_object_unref (capsfilter);
 
+  /* Remove the finished branch and start the next one */
   if (block && session->priv->discovery_pad_block_id == 0)
     session->priv->discovery_pad_block_id =
       gst_pad_add_probe (session->priv->send_tee_discovery_pad,
@@ -4741,235 +5755,228 @@ _discovery_caps_changed (GstPad *pad, GParamSpec *pspec, FsRtpSession *session)
 }
 
 /**
- * fs_rtp_session_get_codec_params_unlock:
+ * fs_rtp_session_new_discovery_branch_locked:
  * @session: a #FsRtpSession
  * @ca: the #CodecAssociaton to get params for
  *
- * Gets the parameters for the specified #CodecAssociation
+ * Creates the codec bin to get the parameters for the specified
+ * #CodecAssociation, the other elements are only created by
+ * fs_rtp_session_add_discovery_branch() once the session is unlocked.
  *
- * Returns: %TRUE on success, %FALSE on error
+ * Returns: a new branch or %NULL on error
  */
 
-static gboolean
-fs_rtp_session_get_codec_params_unlock (FsRtpSession *session,
+static struct DiscoveryBranch *
+fs_rtp_session_new_discovery_branch_locked (FsRtpSession *session,
     CodecAssociation *ca, GError **error)
 {
-  GstPad *pad = NULL;
+  struct DiscoveryBranch *branch;
+  GstElement *codecbin;
   gchar *tmp;
-  GstCaps *caps;
-  FsCodec *discovery_codec = fs_codec_copy (ca->codec);
-  FsCodec *send_codec = fs_codec_copy (ca->send_codec);
-  GstElement *codecbin = NULL;
 
   GST_LOG ("Gathering params for codec " FS_CODEC_FORMAT,
       FS_CODEC_ARGS (ca->send_codec));
 
-  fs_codec_destroy (session->priv->discovery_codec);
-  session->priv->discovery_codec = NULL;
-
   tmp = g_strdup_printf ("discoverAA_%u_%u", session->id, ca->send_codec->id);
   codecbin = _create_codec_bin (ca, ca->send_codec, tmp, FS_DIRECTION_SEND,
-      NULL,
-      0, NULL, error);
+      NULL, 0, NULL, error);
   g_free (tmp);
 
-  FS_RTP_SESSION_UNLOCK (session);
-  /* Invalidate CA because we've just unlocked */
-  ca = NULL;
+  if (!codecbin)
+    return NULL;
 
-  if (session->priv->discovery_codecbin)
-  {
-    gst_element_set_locked_state (session->priv->discovery_codecbin, TRUE);
-    gst_element_set_state (session->priv->discovery_codecbin, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_codecbin);
-    session->priv->discovery_codecbin = NULL;
-  }
+  branch = g_slice_new0 (struct DiscoveryBranch);
+  branch->codec = fs_codec_copy (ca->codec);
+  branch->caps = fs_codec_to_gst_caps (ca->send_codec);
+  branch->codecbin = codecbin;
+
+  return branch;
+}
+
+static GstElement *
+fs_rtp_session_add_discovery_element (FsRtpSession *session,
+    const gchar *factory, const gchar *prefix, guint pt, GError **error)
+{
+  GstElement *element;
+  gchar *tmp;
 
+  tmp = g_strdup_printf ("%s_%u_%u", prefix, session->id, pt);
+  element = gst_element_factory_make (factory, tmp);
+  g_free (tmp);
 
-  /* They must both exist or neither exists, anything else is wrong */
-  if ((session->priv->discovery_fakesink == NULL ||
-          session->priv->discovery_capsfilter == NULL) &&
-      session->priv->discovery_fakesink != session->priv->discovery_capsfilter)
+  if (!element)
   {
-    g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL,
-        "Capsfilter and fakesink not synchronized, fakesink:%p capsfilter:%p",
-        session->priv->discovery_fakesink, session->priv->discovery_capsfilter);
-    goto error;
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not make %s element", factory);
+    return NULL;
   }
 
-  if (session->priv->discovery_fakesink == NULL &&
-      session->priv->discovery_capsfilter == NULL)
+  if (!gst_bin_add (GST_BIN (session->priv->conference), element))
   {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the discovery %s to the bin", factory);
+    gst_object_unref (element);
+    return NULL;
+  }
 
-    tmp = g_strdup_printf ("discovery_fakesink_%u", session->id);
-    session->priv->discovery_fakesink =
-      gst_element_factory_make ("fakesink", tmp);
-    g_free (tmp);
-    if (!session->priv->discovery_fakesink)
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not make fakesink element");
-      goto error;
-    }
-    g_object_set (session->priv->discovery_fakesink,
-        "sync", FALSE,
-        "async", FALSE,
-        NULL);
-
-    if (!gst_bin_add (GST_BIN (session->priv->conference),
-            session->priv->discovery_fakesink))
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not add the discovery fakesink to the bin");
-      goto error;
-    }
-
-    if (!gst_element_sync_state_with_parent (session->priv->discovery_fakesink))
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not sync the discovery fakesink's state with its parent");
-      goto error;
-    }
+  return element;
+}
 
-    tmp = g_strdup_printf ("discovery_capsfilter_%u", session->id);
-    session->priv->discovery_capsfilter =
-      gst_element_factory_make ("capsfilter", tmp);
-    g_free (tmp);
-    if (!session->priv->discovery_capsfilter)
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not make capsfilter element");
-      goto error;
-    }
+/**
+ * fs_rtp_session_add_discovery_branch:
+ * @session: a #FsRtpSession
+ * @branch: a #DiscoveryBranch returned by
+ *  fs_rtp_session_new_discovery_branch_locked()
+ *
+ * Adds the elements of the branch to the conference and links them to the
+ * discovery tee. Must be called from the streaming thread while the
+ * discovery pad is blocked.
+ *
+ * Returns: %TRUE on success, %FALSE on error
+ */
 
-    if (!gst_bin_add (GST_BIN (session->priv->conference),
-            session->priv->discovery_capsfilter))
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not add the discovery capsfilter to the bin");
-      goto error;
-    }
+static gboolean
+fs_rtp_session_add_discovery_branch (FsRtpSession *session,
+    struct DiscoveryBranch *branch, GError **error)
+{
+  GstElement *capsfilter;
+  GstPad *pad;
+  GstPadLinkReturn ret;
 
-    if (!gst_element_sync_state_with_parent (
-            session->priv->discovery_capsfilter))
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not sync the discovery capsfilter's state with its parent");
-      goto error;
-    }
+  if (!gst_bin_add (GST_BIN (session->priv->conference), branch->codecbin))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the discovery codecbin to the bin");
+    return FALSE;
+  }
 
-    if (!gst_element_link_pads (session->priv->discovery_capsfilter, "src",
-            session->priv->discovery_fakesink, "sink"))
-    {
-      g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-          "Could not link discovery capsfilter and fakesink");
-      goto error;
-    }
+  branch->fakesink = fs_rtp_session_add_discovery_element (session,
+      "fakesink", "discovery_fakesink", branch->codec->id, error);
+  if (!branch->fakesink)
+    return FALSE;
+  g_object_set (branch->fakesink,
+      "sync", FALSE,
+      "async", FALSE,
+      NULL);
 
-    pad = gst_element_get_static_pad (session->priv->discovery_capsfilter,
-        "src");
-    g_signal_connect_object (pad, "notify::caps",
-        G_CALLBACK (_discovery_caps_changed), session, 0);
-    gst_object_unref (pad);
-  }
+  capsfilter = fs_rtp_session_add_discovery_element (session,
+      "capsfilter", "discovery_capsfilter", branch->codec->id, error);
+  if (!capsfilter)
+    return FALSE;
 
-  if (!codecbin)
-    goto error;
+  /* The branch is already in the list, other branches look it up */
+  FS_RTP_SESSION_LOCK (session);
+  branch->capsfilter = capsfilter;
+  FS_RTP_SESSION_UNLOCK (session);
 
-  session->priv->discovery_codecbin = codecbin;
-  codecbin = NULL;
+  g_object_set (branch->capsfilter,
+      "caps", branch->caps,
+      NULL);
 
-  if (!gst_bin_add (GST_BIN (session->priv->conference),
-            session->priv->discovery_codecbin))
+  if (!gst_element_sync_state_with_parent (branch->fakesink) ||
+      !gst_element_sync_state_with_parent (branch->capsfilter) ||
+      !gst_element_sync_state_with_parent (branch->codecbin))
   {
     g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-        "Could not add the discovery codecbin to the bin");
-    goto error;
+        "Could not sync the discovery elements' state with their parent");
+    return FALSE;
   }
 
-  if (!gst_element_sync_state_with_parent (session->priv->discovery_codecbin))
+  if (!gst_element_link_pads (branch->capsfilter, "src",
+          branch->fakesink, "sink"))
   {
     g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-        "Could not sync the discovery codecbin's state with its parent");
-    goto error;
+        "Could not link discovery capsfilter and fakesink");
+    return FALSE;
   }
 
-  caps = fs_codec_to_gst_caps (send_codec);
-  g_object_set (session->priv->discovery_capsfilter,
-      "caps", caps,
-      NULL);
-  gst_caps_unref (caps);
-
+  pad = gst_element_get_static_pad (branch->capsfilter, "src");
+  g_signal_connect_object (pad, "notify::caps",
+      G_CALLBACK (_discovery_caps_changed), session, 0);
+  gst_object_unref (pad);
 
-  if (!gst_element_link_pads (session->priv->discovery_codecbin, "src",
-            session->priv->discovery_capsfilter, "sink"))
+  if (!gst_element_link_pads (branch->codecbin, "src",
+          branch->capsfilter, "sink"))
   {
     g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
         "Could not link discovery codecbin and capsfilter");
-    goto error;
+    return FALSE;
   }
 
-  if (!gst_element_link (session->priv->discovery_valve,
-          session->priv->discovery_codecbin))
+  branch->tee_pad = gst_element_get_request_pad (session->priv->discovery_tee,
+      "src_%u");
+  if (!branch->tee_pad)
   {
     g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
-        "Could not link the valve and the discovery codecbin");
-    gst_object_unref (pad);
-    goto error;
+        "Could not get a src pad from the discovery tee");
+    return FALSE;
   }
 
-  g_object_set (session->priv->discovery_valve, "drop", FALSE, NULL);
-
+  pad = gst_element_get_static_pad (branch->codecbin, "sink");
+  ret = gst_pad_link (branch->tee_pad, pad);
+  gst_object_unref (pad);
 
-  fs_codec_destroy (send_codec);
-  session->priv->discovery_codec = discovery_codec;
+  if (GST_PAD_LINK_FAILED (ret))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the discovery tee and the discovery codecbin");
+    return FALSE;
+  }
 
   return TRUE;
+}
 
- error:
+static gboolean
+fs_rtp_session_ensure_discovery_tee (FsRtpSession *session, GError **error)
+{
+  gchar *tmp;
 
-  g_object_set (session->priv->discovery_valve, "drop", TRUE, NULL);
-  fs_codec_destroy (send_codec);
-  fs_codec_destroy (discovery_codec);
+  if (session->priv->discovery_tee)
+    return TRUE;
 
-  if (codecbin)
-    gst_object_unref (codecbin);
+  tmp = g_strdup_printf ("discovery_tee_%u", session->id);
+  session->priv->discovery_tee = gst_element_factory_make ("tee", tmp);
+  g_free (tmp);
 
-  if (session->priv->discovery_fakesink)
+  if (!session->priv->discovery_tee)
   {
-    gst_element_set_locked_state (session->priv->discovery_fakesink, TRUE);
-    gst_element_set_state (session->priv->discovery_fakesink, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_fakesink);
-    session->priv->discovery_fakesink = NULL;
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not make tee element");
+    return FALSE;
   }
 
-  if (session->priv->discovery_capsfilter)
+  if (!gst_bin_add (GST_BIN (session->priv->conference),
+          session->priv->discovery_tee))
   {
-    gst_element_set_locked_state (session->priv->discovery_capsfilter, TRUE);
-    gst_element_set_state (session->priv->discovery_capsfilter, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_capsfilter);
-    session->priv->discovery_capsfilter = NULL;
+    gst_object_unref (session->priv->discovery_tee);
+    session->priv->discovery_tee = NULL;
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the discovery tee to the bin");
+    return FALSE;
   }
 
-  if (session->priv->discovery_codecbin)
+  if (!gst_element_sync_state_with_parent (session->priv->discovery_tee))
   {
-    gst_element_set_locked_state (session->priv->discovery_codecbin, TRUE);
-    gst_element_set_state (session->priv->discovery_codecbin, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_codecbin);
-    session->priv->discovery_codecbin = NULL;
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not sync the discovery tee's state with its parent");
+    return FALSE;
   }
 
-  return FALSE;
+  if (!gst_element_link (session->priv->discovery_valve,
+          session->priv->discovery_tee))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the valve and the discovery tee");
+    return FALSE;
+  }
+
+  return TRUE;
 }
 
 /**
  * _discovery_pad_blocked_callback:
  *
- * This is the callback to change the discovery codecbin
+ * This is the callback to add and remove the discovery branches
  */
 
 static GstPadProbeReturn
@@ -4979,7 +5986,10 @@ _discovery_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
   FsRtpSession *session = user_data;
   GError *error = NULL;
   GList *item = NULL;
-  CodecAssociation *ca = NULL;
+  GList *next = NULL;
+  GList *finished = NULL;
+  GList *added = NULL;
+  gboolean need_config = FALSE;
 
   if (fs_rtp_session_has_disposed_enter (session, NULL))
   {
@@ -4997,11 +6007,14 @@ _discovery_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
        item;
        item = g_list_next (item))
   {
-    ca = item->data;
+    CodecAssociation *ca = item->data;
     if (ca->need_config)
+    {
+      need_config = TRUE;
       break;
+    }
   }
-  if (!item)
+  if (!need_config)
   {
     fs_rtp_session_stop_codec_param_gathering_unlock (session);
 
@@ -5012,31 +6025,88 @@ _discovery_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
                 "session", FS_TYPE_SESSION, session,
                 NULL)));
 
-    goto out_unlocked;
+    goto out;
   }
 
-  if (fs_codec_are_equal (ca->codec, session->priv->discovery_codec))
-    goto out_locked;
+  /* Remove the branches whose codec is done or no longer negotiated */
+  for (item = session->priv->discovery_branches; item; item = next)
+  {
+    struct DiscoveryBranch *branch = item->data;
+    CodecAssociation *ca = lookup_codec_association_by_codec_for_sending (
+        session->priv->codec_associations, branch->codec);
+
+    next = item->next;
 
-  if (!fs_rtp_session_get_codec_params_unlock (session, ca, &error))
+    if (!ca || !ca->need_config)
+    {
+      session->priv->discovery_branches = g_list_remove_link (
+          session->priv->discovery_branches, item);
+      finished = g_list_concat (item, finished);
+    }
+  }
+
+  /* Start as many new ones as allowed */
+  for (item = g_list_first (session->priv->codec_associations);
+       item && g_list_length (session->priv->discovery_branches) <
+           session->priv->max_parallel_codec_discovery;
+       item = g_list_next (item))
   {
-    FS_RTP_SESSION_LOCK (session);
-    fs_rtp_session_stop_codec_param_gathering_unlock (session);
-    g_prefix_error (&error,
-        "Error while discovering codec data, discovery cancelled: ");
-    fs_session_emit_error (FS_SESSION (session), error->code,
-        error->message);
+    CodecAssociation *ca = item->data;
+    struct DiscoveryBranch *branch;
+    GList *item2;
+
+    if (!ca->need_config)
+      continue;
+
+    for (item2 = session->priv->discovery_branches; item2; item2 = item2->next)
+    {
+      branch = item2->data;
+      if (fs_codec_are_equal (ca->codec, branch->codec))
+        break;
+    }
+    if (item2)
+      continue;
+
+    branch = fs_rtp_session_new_discovery_branch_locked (session, ca, &error);
+    if (!branch)
+      break;
+
+    session->priv->discovery_branches = g_list_append (
+        session->priv->discovery_branches, branch);
+    added = g_list_append (added, branch);
   }
 
-  g_clear_error (&error);
+  FS_RTP_SESSION_UNLOCK (session);
 
- out_unlocked:
+  for (item = finished; item; item = item->next)
+    discovery_branch_destroy (session, item->data);
+  g_list_free (finished);
+
+  if (!error && added && !fs_rtp_session_ensure_discovery_tee (session, &error))
+    goto error;
+
+  for (item = added; item && !error; item = item->next)
+    fs_rtp_session_add_discovery_branch (session, item->data, &error);
+
+  if (error)
+    goto error;
+
+  g_object_set (session->priv->discovery_valve, "drop", FALSE, NULL);
+
+ out:
+  g_list_free (added);
   fs_rtp_session_has_disposed_exit (session);
   return GST_PAD_PROBE_REMOVE;
 
- out_locked:
-  FS_RTP_SESSION_UNLOCK (session);
-  goto out_unlocked;
+ error:
+  FS_RTP_SESSION_LOCK (session);
+  fs_rtp_session_stop_codec_param_gathering_unlock (session);
+  g_prefix_error (&error,
+      "Error while discovering codec data, discovery cancelled: ");
+  fs_session_emit_error (FS_SESSION (session), error->code,
+      error->message);
+  g_clear_error (&error);
+  goto out;
 }
 
 /**
@@ -5085,47 +6155,25 @@ fs_rtp_session_start_codec_param_gathering_locked (FsRtpSession *session)
 static void
 fs_rtp_session_stop_codec_param_gathering_unlock (FsRtpSession *session)
 {
+  GList *branches;
+  GList *item;
 
   GST_DEBUG ("Stopping Codec Param discovery for session %d", session->id);
 
-  if (session->priv->discovery_codec)
-  {
-    fs_codec_destroy (session->priv->discovery_codec);
-    session->priv->discovery_codec = NULL;
-  }
+  branches = session->priv->discovery_branches;
+  session->priv->discovery_branches = NULL;
 
   if (session->priv->discovery_valve)
     g_object_set (session->priv->discovery_valve, "drop", TRUE, NULL);
 
   FS_RTP_SESSION_UNLOCK (session);
 
+  for (item = branches; item; item = item->next)
+    discovery_branch_destroy (session, item->data);
+  g_list_free (branches);
 
-  if (session->priv->discovery_fakesink)
-  {
-    gst_element_set_locked_state (session->priv->discovery_fakesink, TRUE);
-    gst_element_set_state (session->priv->discovery_fakesink, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_fakesink);
-    session->priv->discovery_fakesink = NULL;
-  }
-
-  if (session->priv->discovery_capsfilter)
-  {
-    gst_element_set_locked_state (session->priv->discovery_capsfilter, TRUE);
-    gst_element_set_state (session->priv->discovery_capsfilter, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_capsfilter);
-    session->priv->discovery_capsfilter = NULL;
-  }
-
-  if (session->priv->discovery_codecbin)
-  {
-    gst_element_set_locked_state (session->priv->discovery_codecbin, TRUE);
-    gst_element_set_state (session->priv->discovery_codecbin, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (session->priv->conference),
-        session->priv->discovery_codecbin);
-    session->priv->discovery_codecbin = NULL;
-  }
+  stop_and_remove (GST_BIN (session->priv->conference),
+      &session->priv->discovery_tee, FALSE);
 }
 
 static gchar **
@@ -5179,44 +6227,232 @@ fs_rtp_session_ssrc_validated (FsRtpSession *session,
   fs_rtp_session_has_disposed_exit (session);
 }
 
-struct CodecBinSetBitrateData
+/*
+ * List of the elements inside a codec bin that have a "bitrate" property,
+ * built once when the codec bin is created and attached to it, so that the
+ * frequent bitrate updates from TFRC don't have to walk the whole bin.
+ */
+
+struct BitrateSetter
 {
+  GstElement *element;
+  GParamSpec *spec;
+  guint unit;
+};
+
+struct CodecBinBitrateSetters
+{
+  GArray *setters;
+  /* Last bitrate set, used to skip redundant updates */
   guint bitrate;
-  gboolean ret;
 };
 
+static GQuark
+codecbin_bitrate_setters_quark (void)
+{
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY (quark == 0))
+    quark = g_quark_from_static_string ("fs-rtp-session-bitrate-setters");
+
+  return quark;
+}
+
+static struct CodecBinBitrateSetters *
+codecbin_bitrate_setters_new (void)
+{
+  struct CodecBinBitrateSetters *setters =
+    g_slice_new (struct CodecBinBitrateSetters);
+
+  setters->setters = g_array_new (FALSE, FALSE, sizeof (struct BitrateSetter));
+  setters->bitrate = 0;
+
+  return setters;
+}
+
 static void
-codecbin_set_bitrate_func (const GValue *item, gpointer user_data)
+codecbin_bitrate_setters_free (gpointer user_data)
+{
+  struct CodecBinBitrateSetters *setters = user_data;
+  guint i;
+
+  for (i = 0; i < setters->setters->len; i++)
+    gst_object_unref (g_array_index (setters->setters, struct BitrateSetter,
+            i).element);
+  g_array_unref (setters->setters);
+  g_slice_free (struct CodecBinBitrateSetters, setters);
+}
+
+static void
+codecbin_add_bitrate_setter_func (const GValue *item, gpointer user_data)
 {
   GstElement *elem = g_value_get_object (item);
-  struct CodecBinSetBitrateData *data = user_data;
+  struct CodecBinBitrateSetters *setters = user_data;
+  struct BitrateSetter setter;
+
+  setter.spec = g_object_class_find_property (G_OBJECT_GET_CLASS (elem),
+      "bitrate");
+  if (!setter.spec)
+    return;
+
+  setter.element = gst_object_ref (elem);
+  setter.unit = fs_utils_get_bitrate_unit (elem);
+  g_array_append_val (setters->setters, setter);
+}
 
-  if (g_object_class_find_property (G_OBJECT_GET_CLASS (elem), "bitrate"))
+static struct CodecBinBitrateSetters *
+codecbin_get_bitrate_setters (GstElement *codecbin)
+{
+  struct CodecBinBitrateSetters *setters;
+  GstIterator *it;
+
+  setters = g_object_get_qdata (G_OBJECT (codecbin),
+      codecbin_bitrate_setters_quark ());
+  if (setters)
+    return setters;
+
+  setters = codecbin_bitrate_setters_new ();
+
+  it = gst_bin_iterate_recurse (GST_BIN (codecbin));
+  while (gst_iterator_foreach (it, codecbin_add_bitrate_setter_func,
+          setters) == GST_ITERATOR_RESYNC)
   {
-    fs_utils_set_bitrate (elem, data->bitrate);
-    data->ret = TRUE;
+    codecbin_bitrate_setters_free (setters);
+    setters = codecbin_bitrate_setters_new ();
+    gst_iterator_resync (it);
   }
+  gst_iterator_free (it);
+
+  g_object_set_qdata_full (G_OBJECT (codecbin),
+      codecbin_bitrate_setters_quark (), setters,
+      codecbin_bitrate_setters_free);
+
+  return setters;
 }
 
+/* Must be called with the session lock held */
 static gboolean
 codecbin_set_bitrate (GstElement *codecbin, guint bitrate)
 {
-  GstIterator *it;
-  struct CodecBinSetBitrateData data;
+  struct CodecBinBitrateSetters *setters;
+  guint i;
 
   if (bitrate == 0)
     return FALSE;
 
+  setters = codecbin_get_bitrate_setters (codecbin);
+
+  if (setters->bitrate == bitrate)
+    return setters->setters->len > 0;
+
   GST_DEBUG ("Setting bitrate to %u bits/sec", bitrate);
 
-  data.bitrate = bitrate;
-  data.ret = FALSE;
+  setters->bitrate = bitrate;
+
+  for (i = 0; i < setters->setters->len; i++)
+  {
+    struct BitrateSetter *setter = &g_array_index (setters->setters,
+        struct BitrateSetter, i);
+
+    fs_utils_set_bitrate_full (setter->element, setter->spec, setter->unit,
+        bitrate);
+  }
+
+  return setters->setters->len > 0;
+}
+
+static void
+codecbin_set_mtu_func (const GValue *item, gpointer user_data)
+{
+  GstElement *elem = g_value_get_object (item);
+  guint *mtu = user_data;
+  GParamSpec *spec;
+
+  spec = g_object_class_find_property (G_OBJECT_GET_CLASS (elem), "mtu");
+  if (!spec || G_PARAM_SPEC_VALUE_TYPE (spec) != G_TYPE_UINT ||
+      !(spec->flags & G_PARAM_WRITABLE))
+    return;
+
+  /* 0 gives the element its own default back */
+  if (*mtu == 0)
+    g_object_set (elem, "mtu", G_PARAM_SPEC_UINT (spec)->default_value, NULL);
+  else
+    g_object_set (elem, "mtu",
+        CLAMP (*mtu, G_PARAM_SPEC_UINT (spec)->minimum,
+            G_PARAM_SPEC_UINT (spec)->maximum), NULL);
+}
+
+/* With a mtu of 0, the payloaders go back to their default.
+ * Must be called with the session lock held */
+static void
+codecbin_set_mtu (GstElement *codecbin, guint mtu)
+{
+  GstIterator *it;
+
+  if (mtu)
+    GST_DEBUG ("Setting the MTU of the payloaders to %u", mtu);
+  else
+    GST_DEBUG ("Restoring the default MTU of the payloaders");
 
   it = gst_bin_iterate_recurse (GST_BIN (codecbin));
-  gst_iterator_foreach (it, codecbin_set_bitrate_func, &data);
+  while (gst_iterator_foreach (it, codecbin_set_mtu_func, &mtu) ==
+      GST_ITERATOR_RESYNC)
+    gst_iterator_resync (it);
   gst_iterator_free (it);
+}
+
+/*
+ * The payloaders get the smallest path MTU of all the streams that report
+ * one, so that the packets are not fragmented on the way to any of them,
+ * but never more than the max-send-mtu. Once no stream reports one anymore,
+ * they go back to their default.
+ *
+ * Must be called with the session lock held
+ */
+static void
+fs_rtp_session_update_send_mtu_locked (FsRtpSession *self)
+{
+  GList *item;
+  guint mtu = 0;
+
+  for (item = self->priv->streams; item; item = g_list_next (item))
+  {
+    guint stream_mtu = fs_rtp_stream_get_mtu_locked (item->data);
 
-  return data.ret;
+    if (stream_mtu && (mtu == 0 || stream_mtu < mtu))
+      mtu = stream_mtu;
+  }
+
+  if (self->priv->max_send_mtu && mtu > self->priv->max_send_mtu)
+    mtu = self->priv->max_send_mtu;
+
+  if (mtu <= SEND_MTU_HEADROOM)
+    mtu = 0;
+  else
+    mtu -= SEND_MTU_HEADROOM;
+
+  if (mtu == self->priv->send_mtu)
+    return;
+
+  self->priv->send_mtu = mtu;
+
+  if (self->priv->send_codecbin)
+    codecbin_set_mtu (self->priv->send_codecbin, mtu);
+}
+
+static void
+_stream_mtu_changed (FsRtpStream *stream, gpointer user_data)
+{
+  FsRtpSession *self = FS_RTP_SESSION (user_data);
+
+  if (fs_rtp_session_has_disposed_enter (self, NULL))
+    return;
+
+  FS_RTP_SESSION_LOCK (self);
+  fs_rtp_session_update_send_mtu_locked (self);
+  FS_RTP_SESSION_UNLOCK (self);
+
+  fs_rtp_session_has_disposed_exit (self);
 }
 
 static void
@@ -5233,6 +6469,10 @@ fs_rtp_session_set_send_bitrate (FsRtpSession *self, guint bitrate)
   if (self->priv->send_bitrate_adapter)
     g_object_set (self->priv->send_bitrate_adapter, "bitrate", bitrate, NULL);
 
+  if (self->priv->transmitters)
+    g_hash_table_foreach (self->priv->transmitters, set_send_bitrate,
+        GUINT_TO_POINTER (self->priv->send_bitrate));
+
   FS_RTP_SESSION_UNLOCK (self);
 }
 
@@ -5466,6 +6706,226 @@ fs_rtp_session_set_allowed_caps (FsSession *session, GstCaps *sink_caps,
   return ret;
 }
 
+struct SrtpSplice {
+  GstPad *sinkpad;
+  GstPad *srcpad;
+};
+
+static void
+srtp_splice_free (gpointer data)
+{
+  struct SrtpSplice *splice = data;
+
+  gst_object_unref (splice->sinkpad);
+  gst_object_unref (splice->srcpad);
+  g_slice_free (struct SrtpSplice, splice);
+}
+
+static GstPadProbeReturn
+_splice_srtp_element (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  struct SrtpSplice *splice = user_data;
+  GstPad *peer = gst_pad_get_peer (pad);
+
+  if (peer)
+    gst_pad_unlink (pad, peer);
+
+  if (GST_PAD_LINK_FAILED (gst_pad_link (pad, splice->sinkpad)))
+    GST_WARNING_OBJECT (pad, "Could not link to %s",
+        GST_PAD_NAME (splice->sinkpad));
+
+  if (peer)
+  {
+    if (GST_PAD_LINK_FAILED (gst_pad_link (splice->srcpad, peer)))
+      GST_WARNING_OBJECT (pad, "Could not link %s to %s",
+          GST_PAD_NAME (splice->srcpad), GST_PAD_NAME (peer));
+    gst_object_unref (peer);
+  }
+
+  return GST_PAD_PROBE_REMOVE;
+}
+
+/*
+ * Inserts @element between @pad and its peer as soon as no data is
+ * flowing through @pad, the sticky events are sent again to @element when
+ * the next buffer goes through.
+ */
+
+static void
+splice_srtp_element (GstPad *pad, GstElement *element,
+    const gchar *sink_name, const gchar *src_name)
+{
+  struct SrtpSplice *splice;
+  GstPad *sinkpad = gst_element_get_static_pad (element, sink_name);
+  GstPad *srcpad = gst_element_get_static_pad (element, src_name);
+
+  if (!pad || !sinkpad || !srcpad)
+  {
+    GST_ERROR_OBJECT (element, "Could not get the pads to splice %s in",
+        GST_ELEMENT_NAME (element));
+    if (sinkpad)
+      gst_object_unref (sinkpad);
+    if (srcpad)
+      gst_object_unref (srcpad);
+    return;
+  }
+
+  splice = g_slice_new (struct SrtpSplice);
+  splice->sinkpad = sinkpad;
+  splice->srcpad = srcpad;
+
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_IDLE, _splice_srtp_element,
+      splice, srtp_splice_free);
+}
+
+static gboolean
+fs_rtp_session_insert_srtpenc (FsRtpSession *self, GError **error)
+{
+  GstElement *srtpenc;
+  GstPad *pad;
+  gchar *tmp;
+  gchar *tmp2;
+
+  FS_RTP_SESSION_LOCK (self);
+  srtpenc = self->priv->srtpenc;
+  FS_RTP_SESSION_UNLOCK (self);
+
+  if (srtpenc)
+    return TRUE;
+
+  tmp = g_strdup_printf ("srtpenc_%u", self->id);
+  srtpenc = gst_element_factory_make ("srtpenc", tmp);
+  g_free (tmp);
+
+  if (!srtpenc)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Can't set encryption because srtpenc is not installed");
+    return FALSE;
+  }
+
+  g_object_set (srtpenc,
+      "rtp-cipher", 0, "rtp-auth", 0, "rtcp-cipher", 0, "rtcp-auth", 0, NULL);
+
+  tmp = g_strdup_printf ("rtp_sink_%u", self->id);
+  pad = gst_element_get_request_pad (srtpenc, tmp);
+  gst_object_unref (pad);
+  g_free (tmp);
+
+  tmp = g_strdup_printf ("rtcp_sink_%u", self->id);
+  pad = gst_element_get_request_pad (srtpenc, tmp);
+  gst_object_unref (pad);
+  g_free (tmp);
+
+  FS_RTP_SESSION_LOCK (self);
+  if (self->priv->srtpenc)
+  {
+    /* Another thread was faster */
+    FS_RTP_SESSION_UNLOCK (self);
+    gst_object_unref (srtpenc);
+    return TRUE;
+  }
+  self->priv->srtpenc = gst_object_ref (srtpenc);
+  FS_RTP_SESSION_UNLOCK (self);
+
+  if (!gst_bin_add (GST_BIN (self->priv->conference), srtpenc))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the srtpenc element to the FsRtpConference");
+    FS_RTP_SESSION_LOCK (self);
+    self->priv->srtpenc = NULL;
+    FS_RTP_SESSION_UNLOCK (self);
+    gst_object_unref (srtpenc);
+    gst_object_unref (srtpenc);
+    return FALSE;
+  }
+
+  gst_element_sync_state_with_parent (srtpenc);
+
+  GST_DEBUG ("Splicing srtpenc into session %u", self->id);
+
+  tmp = g_strdup_printf ("send_rtp_src_%u", self->id);
+  pad = gst_element_get_static_pad (self->priv->conference->rtpbin, tmp);
+  g_free (tmp);
+  tmp = g_strdup_printf ("rtp_sink_%u", self->id);
+  tmp2 = g_strdup_printf ("rtp_src_%u", self->id);
+  splice_srtp_element (pad, srtpenc, tmp, tmp2);
+  g_free (tmp);
+  g_free (tmp2);
+  if (pad)
+    gst_object_unref (pad);
+
+  tmp = g_strdup_printf ("rtcp_sink_%u", self->id);
+  tmp2 = g_strdup_printf ("rtcp_src_%u", self->id);
+  splice_srtp_element (self->priv->rtpbin_send_rtcp_src, srtpenc, tmp, tmp2);
+  g_free (tmp);
+  g_free (tmp2);
+
+  return TRUE;
+}
+
+static gboolean
+fs_rtp_session_insert_srtpdec (FsRtpSession *self)
+{
+  GstElement *srtpdec;
+  GstPad *pad;
+  gchar *tmp;
+
+  FS_RTP_SESSION_LOCK (self);
+  srtpdec = self->priv->srtpdec;
+  FS_RTP_SESSION_UNLOCK (self);
+
+  if (srtpdec)
+    return TRUE;
+
+  tmp = g_strdup_printf ("srtpdec_%u", self->id);
+  srtpdec = gst_element_factory_make ("srtpdec", tmp);
+  g_free (tmp);
+
+  if (!srtpdec)
+    return FALSE;
+
+  g_signal_connect_object (srtpdec, "request-key",
+      G_CALLBACK (_srtpdec_request_key), self, 0);
+
+  FS_RTP_SESSION_LOCK (self);
+  if (self->priv->srtpdec)
+  {
+    /* Another thread was faster */
+    FS_RTP_SESSION_UNLOCK (self);
+    gst_object_unref (srtpdec);
+    return TRUE;
+  }
+  self->priv->srtpdec = gst_object_ref (srtpdec);
+  FS_RTP_SESSION_UNLOCK (self);
+
+  if (!gst_bin_add (GST_BIN (self->priv->conference), srtpdec))
+  {
+    GST_ERROR ("Could not add the srtpdec element to the FsRtpConference");
+    FS_RTP_SESSION_LOCK (self);
+    self->priv->srtpdec = NULL;
+    FS_RTP_SESSION_UNLOCK (self);
+    gst_object_unref (srtpdec);
+    gst_object_unref (srtpdec);
+    return FALSE;
+  }
+
+  gst_element_sync_state_with_parent (srtpdec);
+
+  GST_DEBUG ("Splicing srtpdec into session %u", self->id);
+
+  pad = gst_element_get_static_pad (self->priv->transmitter_rtp_funnel, "src");
+  splice_srtp_element (pad, srtpdec, "rtp_sink", "rtp_src");
+  gst_object_unref (pad);
+
+  pad = gst_element_get_static_pad (self->priv->transmitter_rtcp_funnel,
+      "src");
+  splice_srtp_element (pad, srtpdec, "rtcp_sink", "rtcp_src");
+  gst_object_unref (pad);
+
+  return TRUE;
+}
+
 static gboolean
 fs_rtp_session_set_encryption_parameters (FsSession *session,
     GstStructure *parameters, GError **error)
@@ -5478,6 +6938,7 @@ fs_rtp_session_set_encryption_parameters (FsSession *session,
   gint rtp_auth;
   gint rtcp_auth;
   guint replay_window_size;
+  GstElement *srtpenc;
 
   g_return_val_if_fail (FS_IS_RTP_SESSION (session), FALSE);
   g_return_val_if_fail (parameters == NULL ||
@@ -5490,12 +6951,10 @@ fs_rtp_session_set_encryption_parameters (FsSession *session,
   if (fs_rtp_session_has_disposed_enter (self, error))
     return FALSE;
 
-  if (!self->priv->srtpenc)
-  {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-        "Can't set encryption because srtpenc is not installed");
+  /* Without parameters and without an encoder, there is nothing to
+   * turn off */
+  if (parameters && !fs_rtp_session_insert_srtpenc (self, error))
     goto done;
-  }
 
   FS_RTP_SESSION_LOCK (self);
   if (self->priv->encryption_parameters)
@@ -5505,12 +6964,18 @@ fs_rtp_session_set_encryption_parameters (FsSession *session,
     self->priv->encryption_parameters = gst_structure_copy (parameters);
   else
     self->priv->encryption_parameters = NULL;
+  srtpenc = self->priv->srtpenc ? gst_object_ref (self->priv->srtpenc) : NULL;
   FS_RTP_SESSION_UNLOCK (self);
 
-  g_object_set (self->priv->srtpenc,
-      "replay-window-size", replay_window_size,
-      "rtp-auth", rtp_auth, "rtcp-auth", rtcp_auth,
-      "rtp-cipher", rtp_cipher, "rtcp-cipher", rtcp_cipher, "key", key, NULL);
+  if (srtpenc)
+  {
+    g_object_set (srtpenc,
+        "replay-window-size", replay_window_size,
+        "rtp-auth", rtp_auth, "rtcp-auth", rtcp_auth,
+        "rtp-cipher", rtp_cipher, "rtcp-cipher", rtcp_cipher, "key", key,
+        NULL);
+    gst_object_unref (srtpenc);
+  }
 
   ret = TRUE;
 
@@ -5571,6 +7036,23 @@ _srtpdec_request_key (GstElement *srtpdec, guint ssrc, gpointer user_data)
   return caps;
 }
 
+static gboolean
+_stream_decrypt_prepare_cb (FsRtpStream *stream, gpointer user_data)
+{
+  FsRtpSession *self = FS_RTP_SESSION (user_data);
+  gboolean ret;
+
+  if (fs_rtp_session_has_disposed_enter (self, NULL))
+    return FALSE;
+
+  /* The decoder is only added once a stream needs it */
+  ret = fs_rtp_session_insert_srtpdec (self);
+
+  fs_rtp_session_has_disposed_exit (self);
+
+  return ret;
+}
+
 static gboolean
 _stream_decrypt_clear_locked_cb (FsRtpStream *stream, gpointer user_data)
 {
@@ -5578,8 +7060,9 @@ _stream_decrypt_clear_locked_cb (FsRtpStream *stream, gpointer user_data)
   GHashTableIter iter;
   gpointer key, value;
 
+  /* Without a decoder, no key has been handed out yet */
   if (!self->priv->srtpdec)
-    return FALSE;
+    return TRUE;
 
   g_hash_table_iter_init (&iter, self->priv->ssrc_streams);
 
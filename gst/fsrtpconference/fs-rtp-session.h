@@ -76,10 +76,35 @@ struct _FsRtpSession
   guint count;
 #endif
 
+#ifdef FS_LOCK_PROFILING
+  gint64 lock_acquired;
+  const gchar *lock_location;
+  guint64 lock_count;
+  gint64 lock_wait_total;
+  gint64 lock_hold_total;
+  gint64 lock_hold_max;
+  const gchar *lock_hold_max_location;
+#endif
+
   FsRtpSessionPrivate *priv;
 };
 
-#ifdef DEBUG_MUTEXES
+#ifdef FS_LOCK_PROFILING
+
+/* Measures how long the lock is waited for and held. g_cond_wait() on
+ * FS_RTP_SESSION_GET_LOCK() releases the lock behind the back of the
+ * profiler, so holds around such waits are only approximate */
+#define FS_RTP_SESSION_LOCK(session) \
+  fs_rtp_session_lock_profiled (FS_RTP_SESSION_CAST (session), G_STRLOC)
+#define FS_RTP_SESSION_UNLOCK(session) \
+  fs_rtp_session_unlock_profiled (FS_RTP_SESSION_CAST (session))
+#define FS_RTP_SESSION_GET_LOCK(session) \
+  (&FS_RTP_SESSION_CAST (session)->mutex)
+
+void fs_rtp_session_lock_profiled (FsRtpSession *self, const gchar *location);
+void fs_rtp_session_unlock_profiled (FsRtpSession *self);
+
+#elif defined (DEBUG_MUTEXES)
 
 #define FS_RTP_SESSION_LOCK(session) \
   do { \
@@ -64,7 +64,7 @@ struct _FsRtpSpecialSourcePrivate {
   GstPad *muxer_request_pad;
   GstElement *src;
 
-  GThread *stop_thread;
+  gboolean stopping;
 
   fs_rtp_special_source_stopped_callback stopped_callback;
   gpointer stopped_data;
@@ -145,15 +145,17 @@ fs_rtp_special_source_init (FsRtpSpecialSource *self)
 }
 
 /**
- * stop_source_thread:
+ * stop_source_worker:
  * @data: a pointer to the current #FsRtpSpecialSource
+ * @user_data: the conference, unused
  *
- * This functioin will lock on the source's state change until its release
- * and only then let the source be disposed of
+ * This function will lock on the source's state change until its release
+ * and only then let the source be disposed of. It runs on the teardown
+ * thread of the conference, see fs_rtp_conference_queue_teardown().
  */
 
-static gpointer
-stop_source_thread (gpointer data)
+static void
+stop_source_worker (gpointer data, gpointer user_data)
 {
   FsRtpSpecialSource *self = FS_RTP_SPECIAL_SOURCE (data);
 
@@ -177,6 +179,12 @@ stop_source_thread (gpointer data)
     self->priv->stopped_callback (self, self->priv->stopped_data);
 
   g_object_unref (self);
+}
+
+static gpointer
+stop_source_thread (gpointer data)
+{
+  stop_source_worker (data, NULL);
 
   return NULL;
 }
@@ -187,7 +195,7 @@ fs_rtp_special_source_is_stopping (FsRtpSpecialSource *self)
   gboolean stopping;
 
   FS_RTP_SPECIAL_SOURCE_LOCK (self);
-  stopping = !!self->priv->stop_thread;
+  stopping = self->priv->stopping;
   FS_RTP_SPECIAL_SOURCE_UNLOCK (self);
 
   return stopping;
@@ -203,22 +211,30 @@ fs_rtp_special_source_stop_locked (FsRtpSpecialSource *self)
 
   if (self->priv->src)
   {
-    if (self->priv->stop_thread)
+    if (self->priv->stopping)
     {
-      GST_DEBUG ("stopping thread for special source already running");
+      GST_DEBUG ("stopping of special source already queued");
       return TRUE;
     }
 
+    self->priv->stopping = TRUE;
     g_object_ref (self);
-    self->priv->stop_thread = g_thread_new ("special-source-stop",
-        stop_source_thread, self);
-    g_thread_unref (self->priv->stop_thread);
+
+    /* The conference stops the sources of all its sessions from its
+     * teardown thread, so renegotiating many of them at once does not
+     * create a burst of threads */
+    if (!FS_IS_RTP_CONFERENCE (self->priv->outer_bin) ||
+        !fs_rtp_conference_queue_teardown (
+            FS_RTP_CONFERENCE (self->priv->outer_bin), stop_source_worker,
+            self))
+      g_thread_unref (g_thread_new ("special-source-stop",
+              stop_source_thread, self));
 
     return TRUE;
   }
   else
   {
-    self->priv->stop_thread = GUINT_TO_POINTER (1);
+    self->priv->stopping = TRUE;
     return FALSE;
   }
 }
@@ -43,6 +43,17 @@
  * documentation</link> for details.
  *
  * </para> </refsect2>
+ * <refsect2><title>Decoding on demand</title>
+ * <para>
+ *
+ * Setting the #FsRtpStream:decoding property to %FALSE stops decoding
+ * the media received on this stream, the packets are dropped right after
+ * the RTP session has processed them, so RTCP and the statistics keep
+ * working. The same happens to a single source pad if the application
+ * unlinks it. When decoding is resumed, the decoder is re-created and a
+ * keyframe is requested from the sender.
+ *
+ * </para> </refsect2>
  */
 
 #ifdef HAVE_CONFIG_H
@@ -78,7 +89,8 @@ enum
   PROP_RTP_HEADER_EXTENSIONS,
   PROP_DECRYPTION_PARAMETERS,
   PROP_SEND_RTCP_MUX,
-  PROP_REQUIRE_ENCRYPTION
+  PROP_REQUIRE_ENCRYPTION,
+  PROP_DECODING
 };
 
 struct _FsRtpStreamPrivate
@@ -94,12 +106,17 @@ struct _FsRtpStreamPrivate
   stream_sending_changed_locked_cb sending_changed_locked_cb;
   stream_ssrc_added_cb ssrc_added_cb;
   stream_get_new_stream_transmitter_cb get_new_stream_transmitter_cb;
+  stream_decrypt_prepare_cb decrypt_prepare_cb;
   stream_decrypt_clear_locked_cb decrypt_clear_locked_cb;
+  stream_mtu_changed_cb mtu_changed_cb;
   gpointer user_data_for_cb;
 
   /* protected by session lock */
   GstStructure *decryption_parameters;
   gboolean encrypted;
+  gboolean decoding;
+  /* The path MTU reported by the stream transmitter, 0 if unknown */
+  guint mtu;
 
   gulong local_candidates_prepared_handler_id;
   gulong new_active_candidate_pair_handler_id;
@@ -107,6 +124,8 @@ struct _FsRtpStreamPrivate
   gulong error_handler_id;
   gulong known_source_packet_received_handler_id;
   gulong state_changed_handler_id;
+  /* 0 if the stream transmitter has no "mtu" property */
+  gulong mtu_handler_id;
 
   GMutex mutex;
 };
@@ -179,6 +198,9 @@ static void _state_changed (FsStreamTransmitter *stream_transmitter,
     guint component,
     FsStreamState state,
     gpointer user_data);
+static void _transmitter_mtu_changed (FsStreamTransmitter *stream_transmitter,
+    GParamSpec *pspec,
+    gpointer user_data);
 
 // static guint signals[LAST_SIGNAL] = { 0 };
 
@@ -246,6 +268,14 @@ fs_rtp_stream_class_init (FsRtpStreamClass *klass)
           "Send RTCP muxed with on the same RTP connection",
           FALSE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_DECODING,
+      g_param_spec_boolean ("decoding",
+          "Decode the received media",
+          "Whether the media received on this stream is decoded",
+          TRUE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 }
 
 static void
@@ -257,6 +287,7 @@ fs_rtp_stream_init (FsRtpStream *self)
   self->priv->session = NULL;
   self->participant = NULL;
   self->priv->stream_transmitter = NULL;
+  self->priv->decoding = TRUE;
 
   g_mutex_init (&self->priv->mutex);
 
@@ -347,6 +378,8 @@ fs_rtp_stream_dispose (GObject *object)
         self->priv->known_source_packet_received_handler_id);
     g_signal_handler_disconnect (st,
         self->priv->state_changed_handler_id);
+    if (self->priv->mtu_handler_id)
+      g_signal_handler_disconnect (st, self->priv->mtu_handler_id);
 
     FS_RTP_SESSION_UNLOCK (session);
     fs_stream_transmitter_stop (st);
@@ -486,6 +519,11 @@ fs_rtp_stream_get_property (GObject *object,
       g_value_set_boolean (value, fs_rtp_stream_requires_crypto_locked (self));
       FS_RTP_SESSION_UNLOCK (session);
       break;
+    case PROP_DECODING:
+      FS_RTP_SESSION_LOCK (session);
+      g_value_set_boolean (value, self->priv->decoding);
+      FS_RTP_SESSION_UNLOCK (session);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -595,6 +633,16 @@ fs_rtp_stream_set_property (GObject *object,
         FsRtpSession *session = fs_rtp_stream_get_session (self, NULL);
 
         if (session) {
+          /* The decoder is added without holding the session lock */
+          if (g_value_get_boolean (value) &&
+              !self->priv->decrypt_prepare_cb (self,
+                  self->priv->user_data_for_cb)) {
+            g_warning ("Can't set encryption because srtpdec is not"
+                " installed");
+            g_object_unref (session);
+            break;
+          }
+
           FS_RTP_SESSION_LOCK (session);
 
           if (self->priv->encrypted != g_value_get_boolean (value))
@@ -609,9 +657,29 @@ fs_rtp_stream_set_property (GObject *object,
             }
           }
           FS_RTP_SESSION_UNLOCK (session);
+          g_object_unref (session);
         }
       }
       break;
+    case PROP_DECODING:
+      {
+        FsRtpSession *session = fs_rtp_stream_get_session (self, NULL);
+
+        if (!session)
+        {
+          self->priv->decoding = g_value_get_boolean (value);
+          return;
+        }
+
+        FS_RTP_SESSION_LOCK (session);
+        self->priv->decoding = g_value_get_boolean (value);
+        for (item = self->substreams; item; item = item->next)
+          fs_rtp_sub_stream_set_decoding_locked (item->data,
+              self->priv->decoding);
+        FS_RTP_SESSION_UNLOCK (session);
+        g_object_unref (session);
+      }
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -785,7 +853,9 @@ fs_rtp_stream_new (FsRtpSession *session,
     stream_sending_changed_locked_cb sending_changed_locked_cb,
     stream_ssrc_added_cb ssrc_added_cb,
     stream_get_new_stream_transmitter_cb get_new_stream_transmitter_cb,
+    stream_decrypt_prepare_cb decrypt_prepare_cb,
     stream_decrypt_clear_locked_cb decrypt_clear_locked_cb,
+    stream_mtu_changed_cb mtu_changed_cb,
     gpointer user_data_for_cb)
 {
   FsRtpStream *self;
@@ -806,7 +876,9 @@ fs_rtp_stream_new (FsRtpSession *session,
   self->priv->sending_changed_locked_cb = sending_changed_locked_cb;
   self->priv->ssrc_added_cb = ssrc_added_cb;
   self->priv->get_new_stream_transmitter_cb = get_new_stream_transmitter_cb;
+  self->priv->decrypt_prepare_cb = decrypt_prepare_cb;
   self->priv->decrypt_clear_locked_cb = decrypt_clear_locked_cb;
+  self->priv->mtu_changed_cb = mtu_changed_cb;
 
   self->priv->user_data_for_cb = user_data_for_cb;
 
@@ -930,6 +1002,30 @@ _known_source_packet_received (FsStreamTransmitter *st,
       self->priv->user_data_for_cb);
 }
 
+static void
+_transmitter_mtu_changed (FsStreamTransmitter *stream_transmitter,
+    GParamSpec *pspec,
+    gpointer user_data)
+{
+  FsRtpStream *self = FS_RTP_STREAM (user_data);
+  FsRtpSession *session = fs_rtp_stream_get_session (self, NULL);
+  guint mtu;
+
+  if (!session)
+    return;
+
+  g_object_get (stream_transmitter, "mtu", &mtu, NULL);
+
+  FS_RTP_SESSION_LOCK (session);
+  self->priv->mtu = mtu;
+  FS_RTP_SESSION_UNLOCK (session);
+
+  if (self->priv->mtu_changed_cb)
+    self->priv->mtu_changed_cb (self, self->priv->user_data_for_cb);
+
+  g_object_unref (session);
+}
+
 static void
 _state_changed (FsStreamTransmitter *stream_transmitter,
     guint component,
@@ -1044,6 +1140,7 @@ fs_rtp_stream_add_substream_unlock (FsRtpStream *stream,
       "stream", stream,
       "receiving", ((stream->priv->direction & FS_DIRECTION_RECV) != 0),
       NULL);
+  fs_rtp_sub_stream_set_decoding_locked (substream, stream->priv->decoding);
 
   g_signal_connect_object (substream, "unlinked",
       G_CALLBACK (_substream_unlinked), stream, 0);
@@ -1265,6 +1362,12 @@ fs_rtp_stream_set_transmitter (FsStream *stream,
         "state-changed",
         G_CALLBACK (_state_changed),
         self, 0);
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (st), "mtu"))
+    self->priv->mtu_handler_id =
+      g_signal_connect_object (st,
+          "notify::mtu",
+          G_CALLBACK (_transmitter_mtu_changed),
+          self, 0);
 
 
   FS_RTP_SESSION_LOCK (session);
@@ -1497,6 +1600,15 @@ fs_rtp_stream_set_decryption_parameters (FsStream *stream,
   if (!session)
     return FALSE;
 
+  /* The decoder is added without holding the session lock */
+  if (parameters &&
+      !self->priv->decrypt_prepare_cb (self, self->priv->user_data_for_cb))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Can't set encryption because srtpdec is not installed");
+    g_object_unref (session);
+    return FALSE;
+  }
 
   FS_RTP_SESSION_LOCK (session);
   if (self->priv->decryption_parameters != parameters &&
@@ -1611,3 +1723,9 @@ fs_rtp_stream_requires_crypto_locked (FsRtpStream *self)
 {
   return self->priv->encrypted;
 }
+
+guint
+fs_rtp_stream_get_mtu_locked (FsRtpStream *self)
+{
+  return self->priv->mtu;
+}
@@ -101,8 +101,12 @@ typedef FsStreamTransmitter* (*stream_get_new_stream_transmitter_cb) (
   FsRtpStream *stream,  FsParticipant *participant,
   const gchar *transmitter_name, GParameter *parameters, guint n_parameters,
   GError **error, gpointer user_data);
+typedef gboolean (*stream_decrypt_prepare_cb) (FsRtpStream *stream,
+    gpointer user_data);
 typedef gboolean (*stream_decrypt_clear_locked_cb) (FsRtpStream *stream,
     gpointer user_data);
+typedef void (*stream_mtu_changed_cb) (FsRtpStream *stream,
+    gpointer user_data);
 
 FsRtpStream *fs_rtp_stream_new (FsRtpSession *session,
     FsRtpParticipant *participant,
@@ -112,7 +116,9 @@ FsRtpStream *fs_rtp_stream_new (FsRtpSession *session,
     stream_sending_changed_locked_cb sending_changed_locked_cb,
     stream_ssrc_added_cb ssrc_added_cb,
     stream_get_new_stream_transmitter_cb get_new_stream_transmitter_cb,
+    stream_decrypt_prepare_cb decrypt_prepare_cb,
     stream_decrypt_clear_locked_cb decrypt_clear_locked_cb,
+    stream_mtu_changed_cb mtu_changed_cb,
     gpointer user_data_for_cb);
 
 gboolean fs_rtp_stream_add_substream_unlock (FsRtpStream *stream,
@@ -135,6 +141,9 @@ fs_rtp_stream_get_srtp_caps_locked (FsRtpStream *self);
 gboolean
 fs_rtp_stream_requires_crypto_locked (FsRtpStream *self);
 
+guint
+fs_rtp_stream_get_mtu_locked (FsRtpStream *self);
+
 G_END_DECLS
 
 #endif /* __FS_RTP_STREAM_H__ */
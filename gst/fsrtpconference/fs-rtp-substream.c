@@ -45,6 +45,12 @@
  *
  * rtpbin_pad -> input_valve -> capsfilter -> codecbin -> output_valve -> output_ghostad
  *
+ * If the substream is not decoding, either because it has been turned off
+ * with fs_rtp_sub_stream_set_decoding_locked() or because the application
+ * has unlinked the output ghostpad, the codecbin is removed and the packets
+ * are dropped by the input_valve, after rtpbin has processed them, so the
+ * RTCP and the statistics are kept alive.
+ *
  */
 
 /* signals */
@@ -118,6 +124,11 @@ struct _FsRtpSubStreamPrivate {
    */
   gboolean receiving;
 
+  /* Protected by the session mutex */
+  gboolean decoding;
+  gboolean output_linked;
+  gboolean request_keyframe;
+
   /* Protected by the this mutex */
   GMutex mutex;
   GstClockID no_rtcp_timeout_id;
@@ -410,6 +421,8 @@ fs_rtp_sub_stream_init (FsRtpSubStream *self)
 {
   self->priv = FS_RTP_SUB_STREAM_GET_PRIVATE (self);
   self->priv->receiving = TRUE;
+  self->priv->decoding = TRUE;
+  self->priv->output_linked = TRUE;
   g_mutex_init (&self->priv->mutex);
 
   g_rw_lock_init (&self->priv->stopped_lock);
@@ -535,6 +548,87 @@ rtpbin_pad_unlinked (GstPad *pad, GstPad *peer, gpointer user_data)
   g_signal_emit (self, signals[UNLINKED], 0);
 }
 
+static gboolean
+fs_rtp_sub_stream_is_decoding_locked (FsRtpSubStream *self)
+{
+  return self->priv->decoding && self->priv->output_linked;
+}
+
+static void
+fs_rtp_sub_stream_update_input_valve (FsRtpSubStream *self)
+{
+  if (self->priv->input_valve)
+    g_object_set (G_OBJECT (self->priv->input_valve),
+        "drop",
+        !self->priv->receiving || !fs_rtp_sub_stream_is_decoding_locked (self),
+        NULL);
+}
+
+/*
+ * Must be called after anything that can change the result of
+ * fs_rtp_sub_stream_is_decoding_locked(), the codecbin is removed or
+ * re-created from the streaming thread when the next buffer arrives.
+ */
+
+static void
+fs_rtp_sub_stream_decoding_changed_locked (FsRtpSubStream *self,
+    gboolean was_decoding)
+{
+  gboolean decoding = fs_rtp_sub_stream_is_decoding_locked (self);
+
+  if (decoding == was_decoding)
+    return;
+
+  GST_DEBUG ("Substream with SSRC:%x pt:%d is %s decoding", self->ssrc,
+      self->pt, decoding ? "now" : "no longer");
+
+  fs_rtp_sub_stream_update_input_valve (self);
+
+  if (decoding)
+    self->priv->request_keyframe = TRUE;
+
+  fs_rtp_sub_stream_verify_codec_locked (self);
+}
+
+/**
+ * fs_rtp_sub_stream_set_decoding_locked:
+ * @substream: a #FsRtpSubStream
+ * @decoding: %FALSE to drop the packets after rtpbin instead of decoding them
+ *
+ * Turns decoding on or off for this substream. When it is turned back on,
+ * the codec bin is re-created and a keyframe is requested from the sender.
+ *
+ * You must hold the session lock to call it.
+ */
+
+void
+fs_rtp_sub_stream_set_decoding_locked (FsRtpSubStream *substream,
+    gboolean decoding)
+{
+  gboolean was_decoding = fs_rtp_sub_stream_is_decoding_locked (substream);
+
+  substream->priv->decoding = decoding;
+  fs_rtp_sub_stream_decoding_changed_locked (substream, was_decoding);
+}
+
+static void
+_output_ghostpad_link_changed (GstPad *pad, GstPad *peer, gpointer user_data)
+{
+  FsRtpSubStream *self = user_data;
+  gboolean was_decoding;
+
+  if (fs_rtp_sub_stream_has_stopped_enter (self))
+    return;
+
+  FS_RTP_SESSION_LOCK (self->priv->session);
+  was_decoding = fs_rtp_sub_stream_is_decoding_locked (self);
+  self->priv->output_linked = gst_pad_is_linked (pad);
+  fs_rtp_sub_stream_decoding_changed_locked (self, was_decoding);
+  FS_RTP_SESSION_UNLOCK (self->priv->session);
+
+  fs_rtp_sub_stream_has_stopped_exit (self);
+}
+
 static void
 fs_rtp_sub_stream_constructed (GObject *object)
 {
@@ -698,36 +792,34 @@ fs_rtp_sub_stream_dispose (GObject *object)
   fs_rtp_sub_stream_stop_no_rtcp_timeout_thread (self);
 
   if (self->priv->output_ghostpad) {
+    g_signal_handlers_disconnect_by_func (self->priv->output_ghostpad,
+        _output_ghostpad_link_changed, self);
     gst_element_remove_pad (GST_ELEMENT (self->priv->conference),
       self->priv->output_ghostpad);
     self->priv->output_ghostpad = NULL;
   }
 
   if (self->priv->output_valve) {
-    gst_element_set_locked_state (self->priv->output_valve, TRUE);
-    gst_element_set_state (self->priv->output_valve, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (self->priv->conference), self->priv->output_valve);
+    fs_rtp_conference_remove_element (self->priv->conference,
+        self->priv->output_valve);
     self->priv->output_valve = NULL;
   }
 
   if (self->priv->codecbin) {
-    gst_element_set_locked_state (self->priv->codecbin, TRUE);
-    gst_element_set_state (self->priv->codecbin, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (self->priv->conference), self->priv->codecbin);
+    fs_rtp_conference_remove_element (self->priv->conference,
+        self->priv->codecbin);
     self->priv->codecbin = NULL;
   }
 
   if (self->priv->capsfilter) {
-    gst_element_set_locked_state (self->priv->capsfilter, TRUE);
-    gst_element_set_state (self->priv->capsfilter, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (self->priv->conference), self->priv->capsfilter);
+    fs_rtp_conference_remove_element (self->priv->conference,
+        self->priv->capsfilter);
     self->priv->capsfilter = NULL;
   }
 
   if (self->priv->input_valve) {
-    gst_element_set_locked_state (self->priv->input_valve, TRUE);
-    gst_element_set_state (self->priv->input_valve, GST_STATE_NULL);
-    gst_bin_remove (GST_BIN (self->priv->conference), self->priv->input_valve);
+    fs_rtp_conference_remove_element (self->priv->conference,
+        self->priv->input_valve);
     self->priv->input_valve = NULL;
   }
 
@@ -790,10 +882,7 @@ fs_rtp_sub_stream_set_property (GObject *object,
       break;
     case PROP_RECEIVING:
       self->priv->receiving = g_value_get_boolean (value);
-      if (self->priv->input_valve)
-        g_object_set (G_OBJECT (self->priv->input_valve),
-            "drop", !self->priv->receiving,
-            NULL);
+      fs_rtp_sub_stream_update_input_valve (self);
       break;
     case PROP_NO_RTCP_TIMEOUT:
       self->no_rtcp_timeout = g_value_get_int (value);
@@ -865,6 +954,36 @@ fs_rtp_sub_stream_get_property (GObject *object,
  * Returns: TRUE on success
  */
 
+static gboolean
+fs_rtp_sub_stream_remove_codecbin (FsRtpSubStream *substream,
+    GError **error)
+{
+  if (!substream->priv->codecbin)
+    return TRUE;
+
+  gst_element_set_locked_state (substream->priv->codecbin, TRUE);
+  if (gst_element_set_state (substream->priv->codecbin, GST_STATE_NULL) !=
+      GST_STATE_CHANGE_SUCCESS)
+  {
+    gst_element_set_locked_state (substream->priv->codecbin, FALSE);
+    g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL,
+        "Could not set the codec bin for ssrc %u"
+        " and payload type %d to the state NULL", substream->ssrc,
+        substream->pt);
+    return FALSE;
+  }
+
+  gst_bin_remove (GST_BIN (substream->priv->conference),
+      substream->priv->codecbin);
+
+  FS_RTP_SESSION_LOCK (substream->priv->session);
+  substream->priv->codecbin = NULL;
+  substream->priv->builder_hash = 0;
+  FS_RTP_SESSION_UNLOCK (substream->priv->session);
+
+  return TRUE;
+}
+
 static gboolean
 fs_rtp_sub_stream_set_codecbin (FsRtpSubStream *substream,
     GstElement *codecbin,
@@ -874,28 +993,10 @@ fs_rtp_sub_stream_set_codecbin (FsRtpSubStream *substream,
   gboolean ret = FALSE;
   GstPad *pad;
 
-  if (substream->priv->codecbin)
+  if (!fs_rtp_sub_stream_remove_codecbin (substream, error))
   {
-    gst_element_set_locked_state (substream->priv->codecbin, TRUE);
-    if (gst_element_set_state (substream->priv->codecbin, GST_STATE_NULL) !=
-        GST_STATE_CHANGE_SUCCESS)
-    {
-      gst_element_set_locked_state (substream->priv->codecbin, FALSE);
-      g_set_error (error, FS_ERROR, FS_ERROR_INTERNAL,
-          "Could not set the codec bin for ssrc %u"
-          " and payload type %d to the state NULL", substream->ssrc,
-          substream->pt);
-      gst_object_unref (codecbin);
-      return FALSE;
-    }
-
-    gst_bin_remove (GST_BIN (substream->priv->conference),
-        substream->priv->codecbin);
-
-    FS_RTP_SESSION_LOCK (substream->priv->session);
-    substream->priv->codecbin = NULL;
-    substream->priv->builder_hash = 0;
-    FS_RTP_SESSION_UNLOCK (substream->priv->session);
+    gst_object_unref (codecbin);
+    return FALSE;
   }
 
 
@@ -1036,6 +1137,15 @@ fs_rtp_sub_stream_stop (FsRtpSubStream *substream)
   if (substream->priv->output_ghostpad)
     gst_pad_set_active (substream->priv->output_ghostpad, FALSE);
 
+  /* With deferred teardown, only stop the data and let the elements be
+   * stopped on the teardown thread when they are removed */
+  if (fs_rtp_conference_has_deferred_teardown (substream->priv->conference))
+  {
+    if (substream->priv->input_valve)
+      g_object_set (substream->priv->input_valve, "drop", TRUE, NULL);
+    return;
+  }
+
   if (substream->priv->output_valve)
   {
     gst_element_set_locked_state (substream->priv->output_valve, TRUE);
@@ -1141,6 +1251,11 @@ fs_rtp_sub_stream_add_output_ghostpad_unlock (FsRtpSubStream *substream,
     goto error;
   }
 
+  g_signal_connect_object (ghostpad, "linked",
+      G_CALLBACK (_output_ghostpad_link_changed), substream, 0);
+  g_signal_connect_object (ghostpad, "unlinked",
+      G_CALLBACK (_output_ghostpad_link_changed), substream, 0);
+
   FS_RTP_SESSION_LOCK (substream->priv->session);
   substream->priv->output_ghostpad = ghostpad;
 
@@ -1231,6 +1346,7 @@ _rtpbin_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
   FsCodec *codec = NULL;
   FsRtpSession *session;
   GstCaps *caps = NULL;
+  gboolean request_keyframe = FALSE;
 
   if (GST_PAD_PROBE_INFO_TYPE (info) == GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM &&
       !GST_EVENT_IS_SERIALIZED (GST_PAD_PROBE_INFO_EVENT (info)))
@@ -1258,6 +1374,19 @@ _rtpbin_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
   GST_DEBUG ("Substream blocked for codec change (session:%d SSRC:%x pt:%d)",
       substream->priv->session->id, substream->ssrc, substream->pt);
 
+  FS_RTP_SESSION_LOCK (substream->priv->session);
+  if (!fs_rtp_sub_stream_is_decoding_locked (substream))
+  {
+    FS_RTP_SESSION_UNLOCK (substream->priv->session);
+    /* The input valve drops everything, no need to keep the decoder */
+    if (!fs_rtp_sub_stream_remove_codecbin (substream, &error))
+      goto error;
+    goto out;
+  }
+  request_keyframe = substream->priv->request_keyframe;
+  substream->priv->request_keyframe = FALSE;
+  FS_RTP_SESSION_UNLOCK (substream->priv->session);
+
   g_signal_emit (substream, signals[GET_CODEC_BIN], 0,
       substream->priv->stream, &codec,
       substream->priv->builder_hash, &new_builder_hash, &error, &codecbin);
@@ -1309,6 +1438,13 @@ _rtpbin_pad_blocked_callback (GstPad *pad, GstPadProbeInfo *info,
     gst_caps_unref (caps);
   }
 
+  if (request_keyframe)
+    gst_element_send_event (substream->priv->capsfilter,
+        gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
+            gst_structure_new ("GstForceKeyUnit",
+                "all-headers", G_TYPE_BOOLEAN, TRUE,
+                NULL)));
+
  out:
 
   g_clear_error (&error);
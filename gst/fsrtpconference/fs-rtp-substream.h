@@ -99,6 +99,9 @@ gboolean fs_rtp_sub_stream_add_output_ghostpad_unlock (
 
 void fs_rtp_sub_stream_verify_codec_locked (FsRtpSubStream *substream);
 
+void fs_rtp_sub_stream_set_decoding_locked (FsRtpSubStream *substream,
+    gboolean decoding);
+
 
 G_END_DECLS
 
@@ -50,7 +50,8 @@ enum
 {
   PROP_0,
   PROP_BITRATE,
-  PROP_SENDING
+  PROP_SENDING,
+  PROP_RECEIVE_BITRATE
 };
 
 static void fs_rtp_tfrc_get_property (GObject *object,
@@ -97,6 +98,13 @@ fs_rtp_tfrc_class_init (FsRtpTfrcClass *klass)
           "The bitrate at which data should be sent",
           "The bitrate that the session should try to send at in bits/sec",
           FALSE, G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BITRATE,
+      g_param_spec_uint ("receive-bitrate",
+          "The bitrate at which data is received",
+          "The sum of the receive rates reported to the senders in bits/sec",
+          0, G_MAXUINT, 0, G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
 }
 
 
@@ -254,6 +262,11 @@ fs_rtp_tfrc_get_property (GObject *object,
       g_value_set_uint (value, self->send_bitrate);
       GST_OBJECT_UNLOCK (self);
       break;
+    case PROP_RECEIVE_BITRATE:
+      GST_OBJECT_LOCK (self);
+      g_value_set_uint (value, self->receive_bitrate);
+      GST_OBJECT_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -603,6 +616,7 @@ tfrc_sources_process (gpointer key, gpointer value, gpointer user_data)
       src->last_ts, now - src->last_now, receive_rate, loss_event_rate);
 
   src->send_feedback = FALSE;
+  src->receive_rate = receive_rate;
 
   data->ret = TRUE;
 
@@ -610,11 +624,38 @@ done:
   fs_rtp_tfrc_set_receiver_timer_locked (data->self, src, now);
 }
 
+/* Returns TRUE if the receive bitrate changed */
+static gboolean
+fs_rtp_tfrc_update_receive_bitrate_locked (FsRtpTfrc *self)
+{
+  GHashTableIter iter;
+  gpointer value;
+  guint64 bitrate = 0;
+
+  g_hash_table_iter_init (&iter, self->tfrc_sources);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+  {
+    struct TrackedSource *src = value;
+
+    if (src->receiver)
+      bitrate += (guint64) src->receive_rate * 8;
+  }
+
+  bitrate = MIN (bitrate, G_MAXUINT);
+
+  if (bitrate == self->receive_bitrate)
+    return FALSE;
+
+  self->receive_bitrate = bitrate;
+  return TRUE;
+}
+
 static gboolean
 rtpsession_sending_rtcp (GObject *rtpsession, GstBuffer *buffer,
     gboolean is_early, FsRtpTfrc *self)
 {
   struct SendingRtcpData data = {NULL, GST_RTCP_BUFFER_INIT};
+  gboolean notify;
 
   gst_rtcp_buffer_map (buffer, GST_MAP_READWRITE, &data.rtcpbuffer);
 
@@ -625,10 +666,14 @@ rtpsession_sending_rtcp (GObject *rtpsession, GstBuffer *buffer,
 
   GST_OBJECT_LOCK (self);
   g_hash_table_foreach (self->tfrc_sources, tfrc_sources_process, &data);
+  notify = fs_rtp_tfrc_update_receive_bitrate_locked (self);
   GST_OBJECT_UNLOCK (self);
 
   gst_rtcp_buffer_unmap (&data.rtcpbuffer);
 
+  if (notify)
+    g_object_notify (G_OBJECT (self), "receive-bitrate");
+
   /* Return TRUE if something was added */
   return data.ret;
 }
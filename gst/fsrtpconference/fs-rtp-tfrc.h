@@ -83,6 +83,8 @@ struct TrackedSource {
   guint64 last_now;
   guint32 last_rtt;
   gboolean send_feedback;
+  /* X_recv of the last feedback, in bytes/sec */
+  guint receive_rate;
 
   guint64 next_feedback_timer;
 
@@ -126,6 +128,9 @@ struct _FsRtpTfrc
   GstClockTime last_sent_ts;
   guint send_bitrate;
 
+  /* Receiver stuff */
+  guint receive_bitrate;
+
   ExtensionType extension_type;
   guint extension_id;
 
@@ -0,0 +1,727 @@
+/*
+ * Farstream - io_uring UDP sink
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:element-fsuringudpsink
+ * @short_description: Sends UDP packets with batched io_uring submissions
+ *
+ * This element sends every buffer it gets to a list of destinations, through
+ * an already bound UDP socket given in the #FsUringUdpSink:socket property.
+ * The destinations are managed with the "add", "remove" and "clear" action
+ * signals, which behave like the ones of multiudpsink: adding the same
+ * destination twice means it has to be removed twice.
+ *
+ * Instead of one system call per packet and per destination, the packets
+ * of a buffer list are all queued as sendmsg requests on an io_uring and
+ * submitted together, so a list of packets sent to a few destinations costs a
+ * single system call.
+ *
+ * The destinations can be IP addresses or host names, which are resolved when
+ * they are added. IPv4 destinations are sent to as IPv4-mapped addresses
+ * when the socket is an IPv6 one, IPv6 destinations can not be reached
+ * through an IPv4 socket and adding one is an error.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fsuringudpsink.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+GST_DEBUG_CATEGORY_STATIC (fs_uring_udp_sink_debug);
+#define GST_CAT_DEFAULT (fs_uring_udp_sink_debug)
+
+#define DEFAULT_CLOSE_SOCKET TRUE
+
+/* The most sends submitted at once */
+#define RING_ENTRIES 256
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS_ANY);
+
+enum
+{
+  SIGNAL_ADD,
+  SIGNAL_REMOVE,
+  SIGNAL_CLEAR,
+  LAST_SIGNAL
+};
+
+enum
+{
+  PROP_0,
+  PROP_SOCKET,
+  PROP_CLOSE_SOCKET
+};
+
+typedef struct
+{
+  gchar *host;
+  gint port;
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+  guint refcount;
+} FsUringUdpSinkClient;
+
+/* The copy of the address of a client used while its packets are sent */
+typedef struct
+{
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+} FsUringUdpSinkDest;
+
+static guint signals[LAST_SIGNAL] = { 0 };
+
+G_DEFINE_TYPE (FsUringUdpSink, fs_uring_udp_sink, GST_TYPE_BASE_SINK);
+
+static void fs_uring_udp_sink_finalize (GObject *object);
+static void fs_uring_udp_sink_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec);
+static void fs_uring_udp_sink_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec);
+
+static gboolean fs_uring_udp_sink_start (GstBaseSink *sink);
+static gboolean fs_uring_udp_sink_stop (GstBaseSink *sink);
+static GstFlowReturn fs_uring_udp_sink_render (GstBaseSink *sink,
+    GstBuffer *buffer);
+static GstFlowReturn fs_uring_udp_sink_render_list (GstBaseSink *sink,
+    GstBufferList *list);
+
+static void fs_uring_udp_sink_add (FsUringUdpSink *self,
+    const gchar *host,
+    gint port);
+static void fs_uring_udp_sink_remove (FsUringUdpSink *self,
+    const gchar *host,
+    gint port);
+static void fs_uring_udp_sink_clear (FsUringUdpSink *self);
+
+
+static void
+fs_uring_udp_sink_class_init (FsUringUdpSinkClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+  GstBaseSinkClass *basesink_class = GST_BASE_SINK_CLASS (klass);
+
+  GST_DEBUG_CATEGORY_INIT (fs_uring_udp_sink_debug, "fsuringudpsink", 0,
+      "fsuringudpsink");
+
+  gobject_class->finalize = fs_uring_udp_sink_finalize;
+  gobject_class->get_property = fs_uring_udp_sink_get_property;
+  gobject_class->set_property = fs_uring_udp_sink_set_property;
+
+  basesink_class->start = GST_DEBUG_FUNCPTR (fs_uring_udp_sink_start);
+  basesink_class->stop = GST_DEBUG_FUNCPTR (fs_uring_udp_sink_stop);
+  basesink_class->render = GST_DEBUG_FUNCPTR (fs_uring_udp_sink_render);
+  basesink_class->render_list =
+    GST_DEBUG_FUNCPTR (fs_uring_udp_sink_render_list);
+
+  klass->add = fs_uring_udp_sink_add;
+  klass->remove = fs_uring_udp_sink_remove;
+  klass->clear = fs_uring_udp_sink_clear;
+
+  g_object_class_install_property (gobject_class,
+      PROP_SOCKET,
+      g_param_spec_object ("socket",
+          "Socket",
+          "The bound UDP socket to send from",
+          G_TYPE_SOCKET,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_CLOSE_SOCKET,
+      g_param_spec_boolean ("close-socket",
+          "Close socket",
+          "Close the socket when the element stops",
+          DEFAULT_CLOSE_SOCKET,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsUringUdpSink::add:
+   * @self: the #FsUringUdpSink
+   * @host: the IP address or the host name of the destination
+   * @port: the port of the destination
+   *
+   * Adds a destination, or another reference to it if it is already there.
+   */
+  signals[SIGNAL_ADD] = g_signal_new ("add",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (FsUringUdpSinkClass, add),
+      NULL, NULL, NULL,
+      G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_INT);
+
+  /**
+   * FsUringUdpSink::remove:
+   * @self: the #FsUringUdpSink
+   * @host: the destination, as given to #FsUringUdpSink::add
+   * @port: the port of the destination
+   *
+   * Drops a reference to a destination, it is removed with the last one.
+   */
+  signals[SIGNAL_REMOVE] = g_signal_new ("remove",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (FsUringUdpSinkClass, remove),
+      NULL, NULL, NULL,
+      G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_INT);
+
+  /**
+   * FsUringUdpSink::clear:
+   * @self: the #FsUringUdpSink
+   *
+   * Removes all the destinations.
+   */
+  signals[SIGNAL_CLEAR] = g_signal_new ("clear",
+      G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST | G_SIGNAL_ACTION,
+      G_STRUCT_OFFSET (FsUringUdpSinkClass, clear),
+      NULL, NULL, NULL,
+      G_TYPE_NONE, 0);
+
+  gst_element_class_add_pad_template (element_class,
+      gst_static_pad_template_get (&sink_template));
+
+  gst_element_class_set_metadata (element_class,
+      "io_uring UDP sink",
+      "Sink/Network",
+      "Sends packets to UDP destinations with batched io_uring submissions",
+      "Farstream developers <farstream@lists.freedesktop.org>");
+}
+
+static void
+fs_uring_udp_sink_client_clear (gpointer data)
+{
+  FsUringUdpSinkClient *client = data;
+
+  g_free (client->host);
+}
+
+static void
+fs_uring_udp_sink_init (FsUringUdpSink *self)
+{
+  self->close_socket = DEFAULT_CLOSE_SOCKET;
+
+  self->clients = g_array_new (FALSE, FALSE, sizeof (FsUringUdpSinkClient));
+  g_array_set_clear_func (self->clients, fs_uring_udp_sink_client_clear);
+
+  self->dests = g_array_new (FALSE, FALSE, sizeof (FsUringUdpSinkDest));
+  self->maps = g_array_new (FALSE, FALSE, sizeof (GstMapInfo));
+  self->iovs = g_array_new (FALSE, FALSE, sizeof (struct iovec));
+}
+
+static void
+fs_uring_udp_sink_finalize (GObject *object)
+{
+  FsUringUdpSink *self = FS_URING_UDP_SINK (object);
+
+  if (self->socket)
+    g_object_unref (self->socket);
+
+  g_array_unref (self->clients);
+  g_array_unref (self->dests);
+  g_array_unref (self->maps);
+  g_array_unref (self->iovs);
+
+  G_OBJECT_CLASS (fs_uring_udp_sink_parent_class)->finalize (object);
+}
+
+static void
+fs_uring_udp_sink_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsUringUdpSink *self = FS_URING_UDP_SINK (object);
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_SOCKET:
+      g_value_set_object (value, self->socket);
+      break;
+    case PROP_CLOSE_SOCKET:
+      g_value_set_boolean (value, self->close_socket);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_uring_udp_sink_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsUringUdpSink *self = FS_URING_UDP_SINK (object);
+  GSocket *old_socket = NULL;
+
+  GST_OBJECT_LOCK (self);
+  switch (prop_id)
+  {
+    case PROP_SOCKET:
+      old_socket = self->socket;
+      self->socket = g_value_dup_object (value);
+      break;
+    case PROP_CLOSE_SOCKET:
+      self->close_socket = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (old_socket)
+    g_object_unref (old_socket);
+}
+
+static gint
+fs_uring_udp_sink_find_client_locked (FsUringUdpSink *self,
+    const gchar *host,
+    gint port)
+{
+  guint i;
+
+  for (i = 0; i < self->clients->len; i++)
+  {
+    FsUringUdpSinkClient *client =
+      &g_array_index (self->clients, FsUringUdpSinkClient, i);
+
+    if (client->port == port && !strcmp (client->host, host))
+      return i;
+  }
+
+  return -1;
+}
+
+/* Returns an address of @host that can be reached from a socket of
+ * @family, which is G_SOCKET_FAMILY_INVALID if there is no socket yet, or
+ * NULL if there is none. Like multiudpsink, a bad destination is only
+ * skipped, it does not stop the other ones */
+static GInetAddress *
+fs_uring_udp_sink_resolve (FsUringUdpSink *self, const gchar *host,
+    GSocketFamily family)
+{
+  GInetAddress *addr;
+  GResolver *resolver;
+  GList *addresses, *item;
+  GError *error = NULL;
+
+  addr = g_inet_address_new_from_string (host);
+  if (addr)
+    goto check_family;
+
+  resolver = g_resolver_get_default ();
+  addresses = g_resolver_lookup_by_name (resolver, host, NULL, &error);
+  g_object_unref (resolver);
+  if (!addresses)
+  {
+    GST_WARNING_OBJECT (self, "Could not resolve %s, skipping it: %s", host,
+        error->message);
+    g_clear_error (&error);
+    return NULL;
+  }
+
+  /* Prefer an address of the family of the socket */
+  addr = addresses->data;
+  for (item = addresses; item; item = item->next)
+  {
+    if (g_inet_address_get_family (item->data) == family)
+    {
+      addr = item->data;
+      break;
+    }
+  }
+  g_object_ref (addr);
+  g_resolver_free_addresses (addresses);
+
+ check_family:
+  if (family == G_SOCKET_FAMILY_IPV4 &&
+      g_inet_address_get_family (addr) == G_SOCKET_FAMILY_IPV6)
+  {
+    GST_WARNING_OBJECT (self, "Can not send to the IPv6 destination %s from"
+        " an IPv4 socket, skipping it", host);
+    g_object_unref (addr);
+    return NULL;
+  }
+
+  return addr;
+}
+
+/* Writes the IPv4 address in @addr as an IPv4-mapped IPv6 address */
+static void
+map_to_ipv6 (struct sockaddr_storage *addr, socklen_t *addrlen)
+{
+  struct sockaddr_in in;
+  struct sockaddr_in6 *in6 = (struct sockaddr_in6 *) addr;
+
+  memcpy (&in, addr, sizeof (in));
+
+  memset (in6, 0, sizeof (*in6));
+  in6->sin6_family = AF_INET6;
+  in6->sin6_port = in.sin_port;
+  in6->sin6_addr.s6_addr[10] = 0xff;
+  in6->sin6_addr.s6_addr[11] = 0xff;
+  memcpy (&in6->sin6_addr.s6_addr[12], &in.sin_addr, 4);
+  *addrlen = sizeof (*in6);
+}
+
+static void
+fs_uring_udp_sink_add (FsUringUdpSink *self, const gchar *host, gint port)
+{
+  FsUringUdpSinkClient client;
+  GInetAddress *addr;
+  GSocketAddress *saddr;
+  GSocketFamily family = G_SOCKET_FAMILY_INVALID;
+  GError *error = NULL;
+  gint i;
+
+  GST_OBJECT_LOCK (self);
+  if (self->socket)
+    family = g_socket_get_family (self->socket);
+  GST_OBJECT_UNLOCK (self);
+
+  addr = fs_uring_udp_sink_resolve (self, host, family);
+  if (!addr)
+    return;
+
+  saddr = g_inet_socket_address_new (addr, port);
+  g_object_unref (addr);
+
+  memset (&client, 0, sizeof (client));
+  if (!g_socket_address_to_native (saddr, &client.addr, sizeof (client.addr),
+          &error))
+  {
+    GST_WARNING_OBJECT (self, "Could not convert %s:%d, skipping it: %s",
+        host, port, error->message);
+    g_clear_error (&error);
+    g_object_unref (saddr);
+    return;
+  }
+  client.addrlen = g_socket_address_get_native_size (saddr);
+  g_object_unref (saddr);
+
+  GST_OBJECT_LOCK (self);
+  i = fs_uring_udp_sink_find_client_locked (self, host, port);
+  if (i >= 0)
+  {
+    g_array_index (self->clients, FsUringUdpSinkClient, i).refcount++;
+  }
+  else
+  {
+    GST_DEBUG_OBJECT (self, "Adding destination %s:%d", host, port);
+    client.host = g_strdup (host);
+    client.port = port;
+    client.refcount = 1;
+    g_array_append_val (self->clients, client);
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_uring_udp_sink_remove (FsUringUdpSink *self, const gchar *host, gint port)
+{
+  FsUringUdpSinkClient *client;
+  gint i;
+
+  GST_OBJECT_LOCK (self);
+  i = fs_uring_udp_sink_find_client_locked (self, host, port);
+  if (i < 0)
+  {
+    GST_OBJECT_UNLOCK (self);
+    GST_WARNING_OBJECT (self, "Trying to remove unknown destination %s:%d",
+        host, port);
+    return;
+  }
+
+  client = &g_array_index (self->clients, FsUringUdpSinkClient, i);
+  client->refcount--;
+  if (client->refcount == 0)
+  {
+    GST_DEBUG_OBJECT (self, "Removing destination %s:%d", host, port);
+    g_array_remove_index_fast (self->clients, i);
+  }
+  GST_OBJECT_UNLOCK (self);
+}
+
+static void
+fs_uring_udp_sink_clear (FsUringUdpSink *self)
+{
+  GST_OBJECT_LOCK (self);
+  g_array_set_size (self->clients, 0);
+  GST_OBJECT_UNLOCK (self);
+}
+
+static gboolean
+fs_uring_udp_sink_start (GstBaseSink *sink)
+{
+  FsUringUdpSink *self = FS_URING_UDP_SINK (sink);
+  gint ret;
+
+  GST_OBJECT_LOCK (self);
+  if (!self->socket)
+  {
+    GST_OBJECT_UNLOCK (self);
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_WRITE, (NULL),
+        ("No socket was set"));
+    return FALSE;
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  ret = io_uring_queue_init (RING_ENTRIES, &self->ring, 0);
+  if (ret < 0)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, OPEN_WRITE, (NULL),
+        ("Could not create the io_uring: %s", g_strerror (-ret)));
+    return FALSE;
+  }
+  self->ring_ready = TRUE;
+
+  self->msgs = g_new0 (struct msghdr, RING_ENTRIES);
+
+  return TRUE;
+}
+
+static gboolean
+fs_uring_udp_sink_stop (GstBaseSink *sink)
+{
+  FsUringUdpSink *self = FS_URING_UDP_SINK (sink);
+  GSocket *socket = NULL;
+
+  if (self->ring_ready)
+    io_uring_queue_exit (&self->ring);
+  self->ring_ready = FALSE;
+
+  g_free (self->msgs);
+  self->msgs = NULL;
+
+  GST_OBJECT_LOCK (self);
+  if (self->close_socket && self->socket)
+    socket = g_object_ref (self->socket);
+  GST_OBJECT_UNLOCK (self);
+
+  if (socket)
+  {
+    g_socket_close (socket, NULL);
+    g_object_unref (socket);
+  }
+
+  return TRUE;
+}
+
+/* Submits the queued sends and waits for all of them to complete, as they
+ * point to the mapped buffers and to the copies of the destinations */
+static gboolean
+fs_uring_udp_sink_complete (FsUringUdpSink *self, guint pending)
+{
+  struct io_uring_cqe *cqe;
+  gint ret;
+
+  ret = io_uring_submit_and_wait (&self->ring, pending);
+  /* The requests have been submitted even if the wait was interrupted */
+  if (ret < 0 && ret != -EINTR)
+  {
+    GST_ELEMENT_ERROR (self, RESOURCE, WRITE, (NULL),
+        ("Could not submit the packets: %s", g_strerror (-ret)));
+    return FALSE;
+  }
+
+  while (pending > 0)
+  {
+    ret = io_uring_wait_cqe (&self->ring, &cqe);
+    if (ret == -EINTR)
+      continue;
+    if (ret < 0)
+    {
+      GST_ELEMENT_ERROR (self, RESOURCE, WRITE, (NULL),
+          ("Could not wait for the packets to be sent: %s",
+              g_strerror (-ret)));
+      return FALSE;
+    }
+
+    /* Like with multiudpsink, a destination that can not be reached must
+     * not stop the packets to the others */
+    if (cqe->res < 0)
+      GST_DEBUG_OBJECT (self, "Could not send a packet: %s",
+          g_strerror (-cqe->res));
+
+    io_uring_cqe_seen (&self->ring, cqe);
+    pending--;
+  }
+
+  return TRUE;
+}
+
+static GstFlowReturn
+fs_uring_udp_sink_send (FsUringUdpSink *self,
+    GstBuffer **buffers,
+    guint n_buffers)
+{
+  GstFlowReturn ret = GST_FLOW_OK;
+  guint pending = 0;
+  guint n_mapped;
+  GSocketFamily family;
+  gint fd;
+  guint i, j;
+
+  GST_OBJECT_LOCK (self);
+  fd = self->socket ? g_socket_get_fd (self->socket) : -1;
+  family = self->socket ? g_socket_get_family (self->socket) :
+      G_SOCKET_FAMILY_INVALID;
+  g_array_set_size (self->dests, 0);
+  for (j = 0; j < self->clients->len; j++)
+  {
+    FsUringUdpSinkClient *client =
+      &g_array_index (self->clients, FsUringUdpSinkClient, j);
+    FsUringUdpSinkDest dest;
+
+    /* The socket may have been set after the destination was added */
+    if (family == G_SOCKET_FAMILY_IPV4 && client->addr.ss_family == AF_INET6)
+      continue;
+
+    memcpy (&dest.addr, &client->addr, client->addrlen);
+    dest.addrlen = client->addrlen;
+    if (family == G_SOCKET_FAMILY_IPV6 && dest.addr.ss_family == AF_INET)
+      map_to_ipv6 (&dest.addr, &dest.addrlen);
+    g_array_append_val (self->dests, dest);
+  }
+  GST_OBJECT_UNLOCK (self);
+
+  if (self->dests->len == 0 || fd < 0)
+    return GST_FLOW_OK;
+
+  g_array_set_size (self->maps, n_buffers);
+  g_array_set_size (self->iovs, n_buffers);
+
+  for (n_mapped = 0; n_mapped < n_buffers; n_mapped++)
+  {
+    GstMapInfo *map = &g_array_index (self->maps, GstMapInfo, n_mapped);
+    struct iovec *iov = &g_array_index (self->iovs, struct iovec, n_mapped);
+
+    if (!gst_buffer_map (buffers[n_mapped], map, GST_MAP_READ))
+    {
+      GST_ELEMENT_ERROR (self, RESOURCE, WRITE, (NULL),
+          ("Could not map a buffer"));
+      ret = GST_FLOW_ERROR;
+      goto out;
+    }
+
+    iov->iov_base = map->data;
+    iov->iov_len = map->size;
+  }
+
+  for (i = 0; i < n_buffers; i++)
+  {
+    for (j = 0; j < self->dests->len; j++)
+    {
+      FsUringUdpSinkDest *dest =
+        &g_array_index (self->dests, FsUringUdpSinkDest, j);
+      struct msghdr *msg = &self->msgs[pending];
+      struct io_uring_sqe *sqe;
+
+      memset (msg, 0, sizeof (*msg));
+      msg->msg_name = &dest->addr;
+      msg->msg_namelen = dest->addrlen;
+      msg->msg_iov = &g_array_index (self->iovs, struct iovec, i);
+      msg->msg_iovlen = 1;
+
+      /* There is always room, the queue is flushed when it is full */
+      sqe = io_uring_get_sqe (&self->ring);
+      io_uring_prep_sendmsg (sqe, fd, msg, 0);
+      pending++;
+
+      if (pending == RING_ENTRIES)
+      {
+        if (!fs_uring_udp_sink_complete (self, pending))
+        {
+          ret = GST_FLOW_ERROR;
+          goto out;
+        }
+        pending = 0;
+      }
+    }
+  }
+
+  if (pending && !fs_uring_udp_sink_complete (self, pending))
+    ret = GST_FLOW_ERROR;
+
+ out:
+  for (i = 0; i < n_mapped; i++)
+    gst_buffer_unmap (buffers[i], &g_array_index (self->maps, GstMapInfo, i));
+
+  return ret;
+}
+
+static GstFlowReturn
+fs_uring_udp_sink_render (GstBaseSink *sink, GstBuffer *buffer)
+{
+  return fs_uring_udp_sink_send (FS_URING_UDP_SINK (sink), &buffer, 1);
+}
+
+static GstFlowReturn
+fs_uring_udp_sink_render_list (GstBaseSink *sink, GstBufferList *list)
+{
+  guint n_buffers = gst_buffer_list_length (list);
+  GstBuffer **buffers;
+  GstFlowReturn ret;
+  guint i;
+
+  if (n_buffers == 0)
+    return GST_FLOW_OK;
+
+  buffers = g_new (GstBuffer *, n_buffers);
+  for (i = 0; i < n_buffers; i++)
+    buffers[i] = gst_buffer_list_get (list, i);
+
+  ret = fs_uring_udp_sink_send (FS_URING_UDP_SINK (sink), buffers, n_buffers);
+
+  g_free (buffers);
+
+  return ret;
+}
+
+static gboolean
+fs_uring_udp_sink_plugin_init (GstPlugin *plugin)
+{
+  return gst_element_register (plugin, "fsuringudpsink",
+      GST_RANK_NONE, FS_TYPE_URING_UDP_SINK);
+}
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    fsuringudpsink,
+    "io_uring UDP sink",
+    fs_uring_udp_sink_plugin_init, VERSION, "LGPL", "Farstream",
+    "http://www.freedesktop.org/wiki/Software/Farstream")
@@ -0,0 +1,82 @@
+/*
+ * Farstream - io_uring UDP sink
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __FS_URING_UDP_SINK_H__
+#define __FS_URING_UDP_SINK_H__
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+#include <gio/gio.h>
+
+#include <liburing.h>
+
+G_BEGIN_DECLS
+
+/* #define's don't like whitespacey bits */
+#define FS_TYPE_URING_UDP_SINK \
+  (fs_uring_udp_sink_get_type())
+#define FS_URING_UDP_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), \
+  FS_TYPE_URING_UDP_SINK,FsUringUdpSink))
+#define FS_URING_UDP_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), \
+  FS_TYPE_URING_UDP_SINK,FsUringUdpSinkClass))
+#define FS_IS_URING_UDP_SINK(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj),FS_TYPE_URING_UDP_SINK))
+#define FS_IS_URING_UDP_SINK_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass),FS_TYPE_URING_UDP_SINK))
+
+typedef struct _FsUringUdpSink FsUringUdpSink;
+typedef struct _FsUringUdpSinkClass FsUringUdpSinkClass;
+
+struct _FsUringUdpSink
+{
+  GstBaseSink parent;
+
+  /* Protected by the object lock */
+  GSocket *socket;
+  gboolean close_socket;
+  GArray *clients;
+
+  /* Only used from the streaming thread, the ring exists between start
+   * and stop */
+  struct io_uring ring;
+  gboolean ring_ready;
+  GArray *dests;
+  GArray *maps;
+  GArray *iovs;
+  struct msghdr *msgs;
+};
+
+struct _FsUringUdpSinkClass
+{
+  GstBaseSinkClass parent_class;
+
+  /* action signals */
+  void (*add) (FsUringUdpSink *sink, const gchar *host, gint port);
+  void (*remove) (FsUringUdpSink *sink, const gchar *host, gint port);
+  void (*clear) (FsUringUdpSink *sink);
+};
+
+GType fs_uring_udp_sink_get_type (void);
+
+G_END_DECLS
+
+#endif /* __FS_URING_UDP_SINK_H__ */
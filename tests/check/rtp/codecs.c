@@ -23,6 +23,7 @@
 #endif
 
 #include <gst/check/gstcheck.h>
+#include <glib/gstdio.h>
 #include <farstream/fs-conference.h>
 #include <farstream/fs-rtp.h>
 
@@ -432,6 +433,147 @@ GST_START_TEST (test_rtpcodecs_invalid_remote_codecs)
 }
 GST_END_TEST;
 
+#define NEGOTIATION_COUNT 500
+
+static void
+run_repeated_negotiations (guint count, GstClockTime *elapsed)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL;
+  GList *codecs = NULL;
+  GList *shorter_codecs = NULL;
+  GList *first_nego[2] = { NULL, NULL };
+  GstClockTime start;
+  guint i;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  st = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  fail_unless (g_list_length (codecs) > 1, "Need at least two codecs");
+  shorter_codecs = fs_codec_list_copy (codecs->next);
+
+  start = gst_util_get_timestamp ();
+  for (i = 0; i < count; i++)
+  {
+    GError *error = NULL;
+    GList *nego = NULL;
+
+    fail_unless (fs_stream_set_remote_codecs (st->stream,
+            (i % 2) ? shorter_codecs : codecs, &error),
+        "Could not set remote codecs: %s", error ? error->message : "");
+
+    /* The cached results must be the same as the first negotiation */
+    if (i < 2)
+    {
+      g_object_get (st->stream, "negotiated-codecs", &first_nego[i], NULL);
+    }
+    else if (i == count - 1 || i == count - 2)
+    {
+      g_object_get (st->stream, "negotiated-codecs", &nego, NULL);
+      fail_unless (fs_codec_list_are_equal (nego, first_nego[i % 2]),
+          "Repeated negotiation gave a different result");
+      fs_codec_list_destroy (nego);
+    }
+  }
+  if (elapsed)
+    *elapsed = gst_util_get_timestamp () - start;
+
+  fs_codec_list_destroy (first_nego[0]);
+  fs_codec_list_destroy (first_nego[1]);
+  fs_codec_list_destroy (shorter_codecs);
+  fs_codec_list_destroy (codecs);
+
+  cleanup_simple_conference (dat);
+}
+
+GST_START_TEST (test_rtpcodecs_negotiation_cache_verify)
+{
+  /* Every cache hit is compared with a fresh negotiation, any difference
+   * is a warning and makes the test fail */
+  g_setenv ("FS_RTP_NEGOTIATION_CACHE", "verify", TRUE);
+
+  run_repeated_negotiations (20, NULL);
+
+  g_unsetenv ("FS_RTP_NEGOTIATION_CACHE");
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rtpcodecs_negotiation_benchmark)
+{
+  GstClockTime elapsed;
+
+  /* Run with FS_RTP_NEGOTIATION_CACHE=0 to get the uncached numbers */
+  run_repeated_negotiations (NEGOTIATION_COUNT, &elapsed);
+
+  GST_INFO ("%d negotiations took %" GST_TIME_FORMAT ", %.0f per second",
+      NEGOTIATION_COUNT, GST_TIME_ARGS (elapsed),
+      NEGOTIATION_COUNT / ((gdouble) MAX (elapsed, 1) / GST_SECOND));
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rtpcodecs_snapshots)
+{
+  struct SimpleTestConference *dat = NULL;
+  struct SimpleTestStream *st = NULL;
+  FsSessionSnapshot *session_snapshot, *session_snapshot2;
+  FsStreamSnapshot *stream_snapshot, *stream_snapshot2;
+  GList *codecs = NULL;
+  GList *remote_codecs = NULL;
+  GError *error = NULL;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  st = simple_conference_add_stream (dat, dat, "rawudp", 0, NULL);
+
+  session_snapshot = fs_session_get_snapshot (dat->session);
+  fail_if (session_snapshot == NULL, "Could not get session snapshot");
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  fail_unless (fs_codec_list_are_equal (codecs,
+          session_snapshot->codecs_without_config),
+      "Snapshot codecs differ from the property");
+
+  /* Nothing changed, so the same snapshot is returned */
+  session_snapshot2 = fs_session_get_snapshot (dat->session);
+  fail_unless (session_snapshot == session_snapshot2,
+      "Unchanged session returned a new snapshot");
+  fail_unless (session_snapshot->generation ==
+      fs_session_get_snapshot_generation (dat->session),
+      "Generation changed without changes");
+  fs_session_snapshot_unref (session_snapshot2);
+
+  stream_snapshot = fs_stream_get_snapshot (st->stream);
+  fail_unless (stream_snapshot->negotiated_codecs == NULL,
+      "Negotiated codecs before setting the remote codecs");
+
+  remote_codecs = fs_codec_list_copy (codecs);
+  fail_unless (fs_stream_set_remote_codecs (st->stream, remote_codecs,
+          &error), "Could not set remote codecs");
+
+  fail_if (stream_snapshot->generation ==
+      fs_stream_get_snapshot_generation (st->stream),
+      "Stream generation did not change after negotiation");
+  stream_snapshot2 = fs_stream_get_snapshot (st->stream);
+  fail_if (stream_snapshot == stream_snapshot2,
+      "Negotiation did not make a new stream snapshot");
+  fail_unless (fs_codec_list_are_equal (stream_snapshot2->remote_codecs,
+          remote_codecs), "Stream snapshot has the wrong remote codecs");
+  fail_if (stream_snapshot2->negotiated_codecs == NULL,
+      "Stream snapshot has no negotiated codecs");
+  fs_stream_snapshot_unref (stream_snapshot2);
+
+  /* The old snapshots stay valid */
+  fail_unless (stream_snapshot->negotiated_codecs == NULL,
+      "Old stream snapshot was modified");
+  fs_stream_snapshot_unref (stream_snapshot);
+  fs_session_snapshot_unref (session_snapshot);
+
+  fs_codec_list_destroy (remote_codecs);
+  fs_codec_list_destroy (codecs);
+
+  cleanup_simple_conference (dat);
+}
+GST_END_TEST;
+
 
 GST_START_TEST (test_rtpcodecs_reserved_pt)
 {
@@ -933,6 +1075,275 @@ GST_START_TEST (test_rtpcodecs_preset_config_data)
 GST_END_TEST;
 
 
+static GstClockTime config_ready_time = GST_CLOCK_TIME_NONE;
+static GMutex discovery_mutex;
+static guint discovery_bins = 0;
+static guint max_discovery_bins = 0;
+
+static gboolean
+is_discovery_codec_bin (GstElement *element)
+{
+  return g_str_has_prefix (GST_ELEMENT_NAME (element), "discoverAA_");
+}
+
+static void
+_discovery_bin_added (GstBin *bin, GstElement *element, gpointer user_data)
+{
+  if (!is_discovery_codec_bin (element))
+    return;
+
+  g_mutex_lock (&discovery_mutex);
+  discovery_bins++;
+  max_discovery_bins = MAX (max_discovery_bins, discovery_bins);
+  g_mutex_unlock (&discovery_mutex);
+}
+
+static void
+_discovery_bin_removed (GstBin *bin, GstElement *element, gpointer user_data)
+{
+  if (!is_discovery_codec_bin (element))
+    return;
+
+  g_mutex_lock (&discovery_mutex);
+  discovery_bins--;
+  g_mutex_unlock (&discovery_mutex);
+}
+
+static void
+_bus_message_config_ready (GstBus *bus, GstMessage *message,
+    struct SimpleTestConference *dat)
+{
+  const GstStructure *s = gst_message_get_structure (message);
+  GList *codecs = NULL;
+
+  if (!gst_structure_has_name (s, "farstream-codecs-changed"))
+    return;
+
+  g_object_get (dat->session, "codecs", &codecs, NULL);
+
+  /* Not ready, return */
+  if (!codecs)
+    return;
+
+  fs_codec_list_destroy (codecs);
+  config_ready_time = gst_util_get_timestamp ();
+  g_main_loop_quit (loop);
+}
+
+/*
+ * Returns the time it took from the pipeline starting to play to all the
+ * codecs being ready, or GST_CLOCK_TIME_NONE if there are less than two
+ * codecs that need their configuration to be discovered. Checks that at
+ * most @max_parallel of them were discovered at the same time, and that
+ * as many as possible were.
+ */
+
+static GstClockTime
+run_config_ready_time (guint max_parallel)
+{
+  struct SimpleTestConference *dat;
+  GList *codecs = NULL, *item;
+  GstClockTime start, ret = GST_CLOCK_TIME_NONE;
+  GstBus *bus;
+  guint vorbis_count = 0;
+  GError *error = NULL;
+
+  loop = g_main_loop_new (NULL, FALSE);
+  config_ready_time = GST_CLOCK_TIME_NONE;
+  discovery_bins = 0;
+  max_discovery_bins = 0;
+
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  g_object_set (dat->session, "max-parallel-codec-discovery", max_parallel,
+      NULL);
+  g_signal_connect (dat->conference, "element-added",
+      G_CALLBACK (_discovery_bin_added), NULL);
+  g_signal_connect (dat->conference, "element-removed",
+      G_CALLBACK (_discovery_bin_removed), NULL);
+
+  codecs = g_list_append (codecs, fs_codec_new (FS_CODEC_ID_ANY, "VORBIS",
+          FS_MEDIA_TYPE_AUDIO, 48000));
+  codecs = g_list_append (codecs, fs_codec_new (FS_CODEC_ID_ANY, "VORBIS",
+          FS_MEDIA_TYPE_AUDIO, 44100));
+  codecs = g_list_append (codecs, fs_codec_new (FS_CODEC_ID_ANY, "VORBIS",
+          FS_MEDIA_TYPE_AUDIO, 32000));
+  fail_unless (fs_session_set_codec_preferences (dat->session, codecs,
+          &error),
+      "Unable to set codec preferences: %s",
+      error ? error->message : "UNKNOWN");
+  fs_codec_list_destroy (codecs);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  for (item = codecs; item; item = item->next)
+  {
+    FsCodec *codec = item->data;
+
+    if (!g_ascii_strcasecmp ("VORBIS", codec->encoding_name))
+      vorbis_count++;
+  }
+  fs_codec_list_destroy (codecs);
+
+  if (vorbis_count < 2)
+    goto out;
+
+  setup_fakesrc (dat);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message::element",
+      G_CALLBACK (_bus_message_config_ready), dat);
+
+  start = gst_util_get_timestamp ();
+  fail_if (gst_element_set_state (dat->pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  g_main_loop_run (loop);
+  ret = config_ready_time - start;
+
+  gst_bus_remove_signal_watch (bus);
+  gst_object_unref (bus);
+
+  fail_if (gst_element_set_state (dat->pipeline, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to null");
+
+  /* The branches are all added from the same pad block */
+  g_mutex_lock (&discovery_mutex);
+  fail_unless (max_discovery_bins <= max_parallel,
+      "%u codecs were discovered at the same time, the maximum is %u",
+      max_discovery_bins, max_parallel);
+  fail_unless (max_discovery_bins >= MIN (max_parallel, vorbis_count),
+      "Only %u codecs were discovered at the same time, expected %u",
+      max_discovery_bins, MIN (max_parallel, vorbis_count));
+  g_mutex_unlock (&discovery_mutex);
+
+ out:
+  g_main_loop_unref (loop);
+  cleanup_simple_conference (dat);
+
+  return ret;
+}
+
+GST_START_TEST (test_rtpcodecs_config_data_parallel)
+{
+  GstClockTime serial, parallel;
+
+  serial = run_config_ready_time (1);
+  if (serial == GST_CLOCK_TIME_NONE)
+  {
+    GST_WARNING ("Could not find several Vorbis codecs,"
+        " so we are skipping the parallel config-data test");
+    return;
+  }
+  parallel = run_config_ready_time (4);
+
+  GST_INFO ("Time to ready codecs: %" GST_TIME_FORMAT " one at a time, %"
+      GST_TIME_FORMAT " in parallel", GST_TIME_ARGS (serial),
+      GST_TIME_ARGS (parallel));
+}
+GST_END_TEST;
+
+
+GST_START_TEST (test_rtpcodecs_config_cache)
+{
+  struct SimpleTestConference *dat;
+  GList *codecs = NULL, *item;
+  GstBus *bus;
+  GError *error = NULL;
+  gchar *cache_path;
+  FsCodec *codec;
+  guint i;
+
+  cache_path = g_build_filename (g_get_tmp_dir (),
+      "farstream-test-codecs-config.cache", NULL);
+  g_unlink (cache_path);
+  g_setenv ("FS_CODECS_CONFIG_CACHE", cache_path, TRUE);
+
+  loop = g_main_loop_new (NULL, FALSE);
+
+  /* The first session has to discover the config */
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  g_object_set (dat->session, "use-codec-config-cache", TRUE, NULL);
+
+  codecs = g_list_prepend (NULL, fs_codec_new (FS_CODEC_ID_ANY, "VORBIS",
+          FS_MEDIA_TYPE_AUDIO, 44100));
+  fail_unless (fs_session_set_codec_preferences (dat->session, codecs,
+          &error),
+      "Unable to set codec preferences: %s",
+      error ? error->message : "UNKNOWN");
+  fs_codec_list_destroy (codecs);
+
+  g_object_get (dat->session, "codecs-without-config", &codecs, NULL);
+  for (item = codecs; item; item = item->next)
+  {
+    codec = item->data;
+    if (!g_ascii_strcasecmp ("VORBIS", codec->encoding_name))
+      break;
+  }
+  fs_codec_list_destroy (codecs);
+
+  if (!item)
+  {
+    GST_WARNING ("Could not find Vorbis encoder/decoder/payloader/depayloaders,"
+        " so we are skipping the config cache test");
+    cleanup_simple_conference (dat);
+    goto out;
+  }
+
+  g_object_get (dat->session, "codecs", &codecs, NULL);
+  fail_if (codecs, "Codecs are ready before the config has been discovered");
+
+  setup_fakesrc (dat);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+  gst_bus_add_signal_watch (bus);
+  g_signal_connect (bus, "message::element",
+      G_CALLBACK (_bus_message_config_ready), dat);
+
+  fail_if (gst_element_set_state (dat->pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+  g_main_loop_run (loop);
+
+  gst_bus_remove_signal_watch (bus);
+  gst_object_unref (bus);
+
+  fail_if (gst_element_set_state (dat->pipeline, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to null");
+  cleanup_simple_conference (dat);
+
+  /* It is written from another thread */
+  for (i = 0; i < 500 && !g_file_test (cache_path, G_FILE_TEST_EXISTS); i++)
+    g_usleep (G_USEC_PER_SEC / 100);
+  fail_unless (g_file_test (cache_path, G_FILE_TEST_EXISTS),
+      "The codec config cache was not written");
+
+  /* The second one gets it from the cache without playing */
+  dat = setup_simple_conference (1, "fsrtpconference", "bob@127.0.0.1");
+  g_object_set (dat->session, "use-codec-config-cache", TRUE, NULL);
+
+  codecs = g_list_prepend (NULL, fs_codec_new (FS_CODEC_ID_ANY, "VORBIS",
+          FS_MEDIA_TYPE_AUDIO, 44100));
+  fail_unless (fs_session_set_codec_preferences (dat->session, codecs,
+          &error),
+      "Unable to set codec preferences: %s",
+      error ? error->message : "UNKNOWN");
+  fs_codec_list_destroy (codecs);
+
+  g_object_get (dat->session, "codecs", &codecs, NULL);
+  fail_unless (codecs != NULL, "Codecs are not ready from the cache");
+  check_vorbis_and_configuration ("codecs from the cache", codecs, NULL);
+  fs_codec_list_destroy (codecs);
+
+  cleanup_simple_conference (dat);
+
+ out:
+  g_main_loop_unref (loop);
+  g_unlink (cache_path);
+  g_unsetenv ("FS_CODECS_CONFIG_CACHE");
+  g_free (cache_path);
+}
+GST_END_TEST;
+
+
 static void
 profile_test (const gchar *send_profile, const gchar *recv_profile,
     gboolean is_valid)
@@ -1047,6 +1458,67 @@ GST_START_TEST (test_rtpcodecs_profile)
 GST_END_TEST;
 
 
+#define PROFILE_PREF_COUNT 12
+#define PROFILE_SESSION_COUNT 10
+
+GST_START_TEST (test_rtpcodecs_profile_validation_benchmark)
+{
+  GstElement *conf;
+  GList *prefs = NULL;
+  GstClockTime start, first = 0, total = 0;
+  guint i;
+
+  for (i = 0; i < PROFILE_PREF_COUNT; i++)
+  {
+    FsCodec *codec = fs_codec_new (96 + i, (i % 2) ? "PCMU" : "PCMA",
+        FS_MEDIA_TYPE_AUDIO, 8000);
+
+    fs_codec_add_optional_parameter (codec, "farstream-send-profile",
+        (i % 2) ?
+        "audioconvert ! audioresample ! audioconvert ! mulawenc ! rtppcmupay" :
+        "audioconvert ! audioresample ! audioconvert ! alawenc ! rtppcmapay");
+    fs_codec_add_optional_parameter (codec, "farstream-recv-profile",
+        (i % 2) ? "rtppcmudepay ! mulawdec" : "rtppcmadepay ! alawdec");
+    prefs = g_list_append (prefs, codec);
+  }
+
+  conf = gst_element_factory_make ("fsrtpconference", NULL);
+  fail_if (conf == NULL, "Could not make fsrtpconference");
+
+  for (i = 0; i < PROFILE_SESSION_COUNT; i++)
+  {
+    FsSession *session;
+    GstClockTime elapsed;
+
+    start = gst_util_get_timestamp ();
+
+    session = fs_conference_new_session (FS_CONFERENCE (conf),
+        FS_MEDIA_TYPE_AUDIO, NULL);
+    fail_if (session == NULL, "Could not make new session");
+    fail_unless (fs_session_set_codec_preferences (session, prefs, NULL),
+        "Could not set codec preferences");
+
+    elapsed = gst_util_get_timestamp () - start;
+    if (i == 0)
+      first = elapsed;
+    else
+      total += elapsed;
+
+    fs_session_destroy (session);
+    g_object_unref (session);
+  }
+
+  GST_INFO ("Session creation with %d profiles took %" GST_TIME_FORMAT
+      " the first time and %" GST_TIME_FORMAT " on average afterwards",
+      PROFILE_PREF_COUNT, GST_TIME_ARGS (first),
+      GST_TIME_ARGS (total / (PROFILE_SESSION_COUNT - 1)));
+
+  gst_object_unref (conf);
+  fs_codec_list_destroy (prefs);
+}
+GST_END_TEST;
+
+
 GST_START_TEST (test_rtpcodecs_dynamic_pt)
 {
   struct SimpleTestConference *dat = NULL;
@@ -2763,6 +3235,18 @@ fsrtpcodecs_suite (void)
   tcase_add_test (tc_chain, test_rtpcodecs_invalid_remote_codecs);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpcodecs_snapshots");
+  tcase_add_test (tc_chain, test_rtpcodecs_snapshots);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpcodecs_negotiation_cache_verify");
+  tcase_add_test (tc_chain, test_rtpcodecs_negotiation_cache_verify);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpcodecs_negotiation_benchmark");
+  tcase_add_test (tc_chain, test_rtpcodecs_negotiation_benchmark);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpcodecs_reserved_pt");
   tcase_add_test (tc_chain, test_rtpcodecs_reserved_pt);
   suite_add_tcase (s, tc_chain);
@@ -2775,6 +3259,14 @@ fsrtpcodecs_suite (void)
   tcase_add_test (tc_chain, test_rtpcodecs_preset_config_data);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpcodecs_config_data_parallel");
+  tcase_add_test (tc_chain, test_rtpcodecs_config_data_parallel);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpcodecs_config_cache");
+  tcase_add_test (tc_chain, test_rtpcodecs_config_cache);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpcodecs_test_codec_profile");
   tcase_add_test (tc_chain, test_rtpcodecs_profile);
   suite_add_tcase (s, tc_chain);
@@ -2835,6 +3327,13 @@ fsrtpcodecs_suite (void)
   tcase_add_test (tc_chain, test_rtpcodecs_application_xdata);
   suite_add_tcase (s, tc_chain);
 
+  /* They only log timings, which only mean something on an idle machine */
+  if (g_getenv ("FS_BENCHMARKS")) {
+    tc_chain = tcase_create ("fsrtpcodecs_profile_validation_benchmark");
+    tcase_add_test (tc_chain, test_rtpcodecs_profile_validation_benchmark);
+    suite_add_tcase (s, tc_chain);
+  }
+
   return s;
 }
 
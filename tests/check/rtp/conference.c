@@ -23,10 +23,18 @@
 #endif
 
 #include <stdio.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 #include <gst/check/gstcheck.h>
 #include <farstream/fs-conference.h>
 #include <farstream/fs-stream-transmitter.h>
+#include <farstream/fs-transmitter.h>
 
 #include "check-threadsafe.h"
 
@@ -1063,6 +1071,151 @@ GST_START_TEST (test_rtpconference_no_rtcp)
 }
 GST_END_TEST;
 
+/* Raising the nice level is always allowed, but lowering it back is not,
+ * so the streaming tasks run on threads of their own that end with them */
+#define JITTERBUFFER_NICE 19
+
+typedef GstTaskPool FsTestThreadPool;
+typedef GstTaskPoolClass FsTestThreadPoolClass;
+
+static GType fs_test_thread_pool_get_type (void);
+G_DEFINE_TYPE (FsTestThreadPool, fs_test_thread_pool, GST_TYPE_TASK_POOL);
+
+struct TestPoolTask {
+  GstTaskPoolFunction func;
+  gpointer user_data;
+};
+
+static gpointer
+test_pool_thread (gpointer data)
+{
+  struct TestPoolTask *task = data;
+
+  task->func (task->user_data);
+  g_slice_free (struct TestPoolTask, task);
+
+  return NULL;
+}
+
+static void
+fs_test_thread_pool_prepare (GstTaskPool *pool, GError **error)
+{
+}
+
+static void
+fs_test_thread_pool_cleanup (GstTaskPool *pool)
+{
+}
+
+static gpointer
+fs_test_thread_pool_push (GstTaskPool *pool, GstTaskPoolFunction func,
+    gpointer user_data, GError **error)
+{
+  struct TestPoolTask *task = g_slice_new (struct TestPoolTask);
+
+  task->func = func;
+  task->user_data = user_data;
+
+  return g_thread_try_new ("fstestthread", test_pool_thread, task, error);
+}
+
+static void
+fs_test_thread_pool_join (GstTaskPool *pool, gpointer id)
+{
+  g_thread_join (id);
+}
+
+static void
+fs_test_thread_pool_class_init (FsTestThreadPoolClass *klass)
+{
+  klass->prepare = fs_test_thread_pool_prepare;
+  klass->cleanup = fs_test_thread_pool_cleanup;
+  klass->push = fs_test_thread_pool_push;
+  klass->join = fs_test_thread_pool_join;
+}
+
+static void
+fs_test_thread_pool_init (FsTestThreadPool *pool)
+{
+}
+
+static GstTaskPool *thread_policy_pool = NULL;
+
+static GstBusSyncReply
+_thread_policy_sync_handler (GstBus *bus, GstMessage *message, gpointer data)
+{
+  GstStreamStatusType type;
+  GstElement *owner;
+  const GValue *value;
+
+  if (GST_MESSAGE_TYPE (message) != GST_MESSAGE_STREAM_STATUS)
+    return GST_BUS_PASS;
+
+  gst_message_parse_stream_status (message, &type, &owner);
+  value = gst_message_get_stream_status_object (message);
+  if (type == GST_STREAM_STATUS_TYPE_CREATE && value &&
+      G_VALUE_HOLDS (value, GST_TYPE_TASK))
+    gst_task_set_pool (g_value_get_object (value), thread_policy_pool);
+
+  return GST_BUS_PASS;
+}
+
+static void
+_thread_policy_handoff_handler (GstElement *element, GstBuffer *buffer,
+    GstPad *pad, gpointer user_data)
+{
+  struct SimpleTestStream *st = user_data;
+
+  /* The buffers are pushed out of rtpbin by the jitterbuffer thread */
+  ts_fail_unless (fs_conference_is_internal_thread (
+          FS_CONFERENCE (st->dat->conference)),
+      "The handoff is not called from a thread of the conference");
+#ifdef __linux__
+  ts_fail_unless (
+      getpriority (PRIO_PROCESS, syscall (SYS_gettid)) == JITTERBUFFER_NICE,
+      "The thread policy was not applied to the jitterbuffer thread");
+#endif
+
+  _normal_handoff_handler (element, buffer, pad, user_data);
+}
+
+static void
+_thread_policy_conf_init (struct SimpleTestConference *dat, guint confid)
+{
+  GstStructure *policy;
+  GstBus *bus;
+
+  policy = gst_structure_new ("thread-policy",
+      "jitterbuffer-priority", G_TYPE_INT, JITTERBUFFER_NICE,
+      NULL);
+  g_object_set (dat->conference, "thread-policy", policy, NULL);
+  gst_structure_free (policy);
+
+  bus = gst_pipeline_get_bus (GST_PIPELINE (dat->pipeline));
+  gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+  gst_bus_set_sync_handler (bus, _thread_policy_sync_handler, dat, NULL);
+  gst_object_unref (bus);
+}
+
+static void
+_thread_policy_stream_init (struct SimpleTestStream *st, guint confid,
+    guint streamid)
+{
+  st->handoff_handler = G_CALLBACK (_thread_policy_handoff_handler);
+}
+
+GST_START_TEST (test_rtpconference_thread_policy)
+{
+  thread_policy_pool = g_object_new (fs_test_thread_pool_get_type (), NULL);
+
+  nway_test (2, _thread_policy_conf_init, _thread_policy_stream_init,
+      "rawudp", 0, NULL);
+
+  gst_object_unref (thread_policy_pool);
+  thread_policy_pool = NULL;
+}
+GST_END_TEST;
+
 /* Disabled because somehow broken */
 
 #if 0
@@ -1198,6 +1351,181 @@ GST_START_TEST (test_rtpconference_double_codec_profile)
 }
 GST_END_TEST;
 
+/*
+ * A bin with a "bitrate" property that counts how many times it is set, put
+ * in the send profile in the place of an encoder
+ */
+
+typedef struct {
+  GstBin parent;
+  guint bitrate;
+  volatile gint sets;
+} FsTestBitrateBin;
+
+typedef GstBinClass FsTestBitrateBinClass;
+
+static GType fs_test_bitrate_bin_get_type (void);
+
+G_DEFINE_TYPE (FsTestBitrateBin, fs_test_bitrate_bin, GST_TYPE_BIN);
+
+enum {
+  PROP_BITRATE = 1
+};
+
+static void
+fs_test_bitrate_bin_set_property (GObject *object, guint prop_id,
+    const GValue *value, GParamSpec *pspec)
+{
+  FsTestBitrateBin *self = (FsTestBitrateBin *) object;
+
+  self->bitrate = g_value_get_uint (value);
+  g_atomic_int_inc (&self->sets);
+}
+
+static void
+fs_test_bitrate_bin_get_property (GObject *object, guint prop_id,
+    GValue *value, GParamSpec *pspec)
+{
+  FsTestBitrateBin *self = (FsTestBitrateBin *) object;
+
+  g_value_set_uint (value, self->bitrate);
+}
+
+static void
+fs_test_bitrate_bin_class_init (FsTestBitrateBinClass *klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->set_property = fs_test_bitrate_bin_set_property;
+  gobject_class->get_property = fs_test_bitrate_bin_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_BITRATE,
+      g_param_spec_uint ("bitrate", "Bitrate", "Bitrate in bits/sec",
+          0, G_MAXUINT, 0, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+}
+
+static void
+fs_test_bitrate_bin_init (FsTestBitrateBin *self)
+{
+  GstElement *identity = gst_element_factory_make ("identity", NULL);
+  GstPad *pad;
+
+  ts_fail_if (identity == NULL, "Could not make identity");
+  gst_bin_add (GST_BIN (self), identity);
+
+  pad = gst_element_get_static_pad (identity, "sink");
+  gst_element_add_pad (GST_ELEMENT (self), gst_ghost_pad_new ("sink", pad));
+  gst_object_unref (pad);
+
+  pad = gst_element_get_static_pad (identity, "src");
+  gst_element_add_pad (GST_ELEMENT (self), gst_ghost_pad_new ("src", pad));
+  gst_object_unref (pad);
+}
+
+static gboolean
+_find_bitrate_bin (const GValue *item, GValue *found, gpointer user_data)
+{
+  GstElement *element = g_value_get_object (item);
+
+  if (!G_TYPE_CHECK_INSTANCE_TYPE (element, fs_test_bitrate_bin_get_type ()))
+    return TRUE;
+
+  g_value_set_object (found, element);
+  return FALSE;
+}
+
+static FsTestBitrateBin *
+get_bitrate_bin (struct SimpleTestConference *dat)
+{
+  GstIterator *iter = gst_bin_iterate_recurse (GST_BIN (dat->conference));
+  GValue found = G_VALUE_INIT;
+  FsTestBitrateBin *bin = NULL;
+
+  g_value_init (&found, G_TYPE_OBJECT);
+  while (gst_iterator_fold (iter, _find_bitrate_bin, &found, NULL) ==
+      GST_ITERATOR_RESYNC)
+    gst_iterator_resync (iter);
+  gst_iterator_free (iter);
+
+  bin = g_value_dup_object (&found);
+  g_value_unset (&found);
+
+  return bin;
+}
+
+static void
+_bitrate_handoff_handler (GstElement *element, GstBuffer *buffer,
+    GstPad *pad, gpointer user_data)
+{
+  struct SimpleTestStream *st = user_data;
+
+  /* The send codec bin of the sender is running */
+  if (st->buffer_count == 10)
+  {
+    FsTestBitrateBin *bin = get_bitrate_bin (st->target);
+    gint sets;
+
+    ts_fail_if (bin == NULL, "The send codec bin has no bitrate bin");
+    sets = g_atomic_int_get (&bin->sets);
+
+    g_object_set (st->target->session, "send-bitrate", 64000, NULL);
+    ts_fail_unless (bin->bitrate == 64000,
+        "The bitrate was set to %u instead of 64000", bin->bitrate);
+    ts_fail_unless (g_atomic_int_get (&bin->sets) == sets + 1,
+        "The bitrate was set %d times", g_atomic_int_get (&bin->sets) - sets);
+
+    /* The same bitrate again is skipped */
+    g_object_set (st->target->session, "send-bitrate", 64000, NULL);
+    ts_fail_unless (g_atomic_int_get (&bin->sets) == sets + 1,
+        "Setting the same bitrate again reached the element");
+
+    g_object_set (st->target->session, "send-bitrate", 32000, NULL);
+    ts_fail_unless (bin->bitrate == 32000,
+        "The bitrate was set to %u instead of 32000", bin->bitrate);
+    ts_fail_unless (g_atomic_int_get (&bin->sets) == sets + 2,
+        "The bitrate was set %d times", g_atomic_int_get (&bin->sets) - sets);
+
+    gst_object_unref (bin);
+  }
+
+  _normal_handoff_handler (element, buffer, pad, user_data);
+}
+
+static void
+_bitrate_profile_init (struct SimpleTestStream *st, guint confid,
+    guint streamid)
+{
+  GList *prefs = NULL;
+  FsCodec *codec = NULL;
+  gboolean ret;
+
+  st->handoff_handler = G_CALLBACK (_bitrate_handoff_handler);
+
+  codec = fs_codec_new (0, "PCMU", FS_MEDIA_TYPE_AUDIO, 8000);
+  fs_codec_add_optional_parameter (codec, "farstream-send-profile",
+      "audioconvert ! audioresample ! audioconvert ! fstestbitratebin !"
+      " mulawenc ! rtppcmupay");
+  prefs = g_list_append (NULL, codec);
+
+  ret = fs_session_set_codec_preferences (st->dat->session, prefs, NULL);
+  ts_fail_unless (ret, "set codec prefs");
+
+  fs_codec_list_destroy (prefs);
+}
+
+/* The bitrate setters of the send codec bin are looked up once, and only
+ * changes of the bitrate reach them */
+
+GST_START_TEST (test_rtpconference_send_bitrate)
+{
+  ts_fail_unless (gst_element_register (NULL, "fstestbitratebin",
+          GST_RANK_NONE, fs_test_bitrate_bin_get_type ()),
+      "Could not register the bitrate bin");
+
+  nway_test (2, NULL, _bitrate_profile_init, "rawudp", 0, NULL);
+}
+GST_END_TEST;
+
 
 GST_START_TEST (test_rtpconference_dispose)
 {
@@ -1274,6 +1602,156 @@ GST_START_TEST (test_rtpconference_dispose)
 }
 GST_END_TEST;
 
+#define TEARDOWN_STREAM_COUNT 20
+
+static void
+_teardown_element_removed (GstBin *bin, GstElement *element,
+    GPtrArray *removed)
+{
+  g_ptr_array_add (removed, gst_object_ref (element));
+}
+
+static gboolean
+all_elements_stopped (GPtrArray *elements)
+{
+  guint i;
+
+  for (i = 0; i < elements->len; i++)
+  {
+    GstState state;
+
+    gst_element_get_state (g_ptr_array_index (elements, i), &state, NULL, 0);
+    if (state != GST_STATE_NULL)
+      return FALSE;
+  }
+
+  return TRUE;
+}
+
+/*
+ * Hangs up all the streams and the session, and checks that every element
+ * removed from the conference is stopped once the teardown is complete.
+ * Returns the time it took fs_stream_destroy() and fs_session_destroy() to
+ * return.
+ */
+
+static GstClockTime
+run_teardown (gboolean deferred)
+{
+  GstElement *pipeline;
+  GstElement *conf;
+  FsSession *session;
+  GList *streams = NULL, *participants = NULL, *item;
+  GPtrArray *removed;
+  GError *error = NULL;
+  GstClockTime start, elapsed;
+  guint i;
+
+  pipeline = gst_pipeline_new (NULL);
+  conf = gst_element_factory_make ("fsrtpconference", NULL);
+  fail_if (conf == NULL);
+  g_object_set (conf, "deferred-teardown", deferred, NULL);
+  fail_unless (gst_bin_add (GST_BIN (pipeline), conf));
+
+  session = fs_conference_new_session (FS_CONFERENCE (conf),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  fail_if (session == NULL || error != NULL);
+
+  for (i = 0; i < TEARDOWN_STREAM_COUNT; i++)
+  {
+    FsParticipant *part;
+    FsStream *stream;
+
+    part = fs_conference_new_participant (FS_CONFERENCE (conf), &error);
+    fail_if (part == NULL || error != NULL);
+    stream = fs_session_new_stream (session, part, FS_DIRECTION_BOTH, &error);
+    fail_if (stream == NULL || error != NULL);
+    fail_unless (fs_stream_set_transmitter (stream, "rawudp", NULL, 0,
+            &error));
+
+    participants = g_list_prepend (participants, part);
+    streams = g_list_prepend (streams, stream);
+  }
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  removed = g_ptr_array_new_with_free_func (gst_object_unref);
+  g_signal_connect (conf, "element-removed",
+      G_CALLBACK (_teardown_element_removed), removed);
+
+  start = gst_util_get_timestamp ();
+  for (item = streams; item; item = item->next)
+  {
+    fs_stream_destroy (item->data);
+    g_object_unref (item->data);
+  }
+  fs_session_destroy (session);
+  elapsed = gst_util_get_timestamp () - start;
+
+  g_signal_handlers_disconnect_by_func (conf, _teardown_element_removed,
+      removed);
+  fail_unless (removed->len > 0, "No element was removed from the conference");
+
+  if (deferred)
+  {
+    GstBus *bus = gst_pipeline_get_bus (GST_PIPELINE (pipeline));
+    GstMessage *message;
+    gboolean done;
+
+    /* The teardown thread can catch up between two destroys, so wait for
+     * the message that comes after the last element is stopped */
+    do
+    {
+      message = gst_bus_timed_pop_filtered (bus, 10 * GST_SECOND,
+          GST_MESSAGE_ELEMENT);
+      fail_if (message == NULL, "Teardown did not complete");
+      done = gst_message_has_name (message, "farstream-teardown-complete") &&
+          all_elements_stopped (removed);
+      gst_message_unref (message);
+    } while (!done);
+    gst_object_unref (bus);
+  }
+  else
+  {
+    fail_unless (all_elements_stopped (removed),
+        "The removed elements were not stopped when the streams and session"
+        " were destroyed");
+  }
+
+  g_ptr_array_unref (removed);
+
+  g_object_unref (session);
+  g_list_free (streams);
+  g_list_free_full (participants, g_object_unref);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  return elapsed;
+}
+
+GST_START_TEST (test_rtpconference_deferred_teardown)
+{
+  run_teardown (FALSE);
+  run_teardown (TRUE);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rtpconference_deferred_teardown_benchmark)
+{
+  GstClockTime sync_time, deferred_time;
+
+  sync_time = run_teardown (FALSE);
+  deferred_time = run_teardown (TRUE);
+
+  GST_INFO ("Hanging up %d streams took %" GST_TIME_FORMAT
+      " synchronously and %" GST_TIME_FORMAT " with deferred teardown",
+      TEARDOWN_STREAM_COUNT, GST_TIME_ARGS (sync_time),
+      GST_TIME_ARGS (deferred_time));
+}
+GST_END_TEST;
+
 static void
 multicast_init (struct SimpleTestStream *st, guint confid, guint streamid)
 {
@@ -1475,6 +1953,340 @@ GST_START_TEST (test_rtpconference_ten_way_srtp)
 }
 GST_END_TEST;
 
+static GMutex srtp_bench_mutex;
+static guint srtp_bench_packets;
+static gint64 srtp_bench_first_time;
+static gint64 srtp_bench_last_time;
+static clock_t srtp_bench_first_cpu;
+static clock_t srtp_bench_last_cpu;
+static guint srtp_bench_srtp_elements;
+
+static void
+_count_srtp_element (const GValue *item, gpointer user_data)
+{
+  GstElement *element = g_value_get_object (item);
+  GstElementFactory *factory = gst_element_get_factory (element);
+  guint *count = user_data;
+
+  if (factory && g_str_has_prefix (GST_OBJECT_NAME (factory), "srtp"))
+    (*count)++;
+}
+
+static guint
+count_srtp_elements (GstElement *conference)
+{
+  GstIterator *iter = gst_bin_iterate_recurse (GST_BIN (conference));
+  guint count = 0;
+
+  while (gst_iterator_foreach (iter, _count_srtp_element, &count) ==
+      GST_ITERATOR_RESYNC)
+  {
+    count = 0;
+    gst_iterator_resync (iter);
+  }
+  gst_iterator_free (iter);
+
+  return count;
+}
+
+static void
+_srtp_bench_handoff_handler (GstElement *element, GstBuffer *buffer,
+    GstPad *pad, gpointer user_data)
+{
+  struct SimpleTestStream *st = user_data;
+  guint srtp_elements = count_srtp_elements (st->dat->conference);
+
+  g_mutex_lock (&srtp_bench_mutex);
+  srtp_bench_srtp_elements = MAX (srtp_bench_srtp_elements, srtp_elements);
+  if (srtp_bench_packets++ == 0)
+  {
+    srtp_bench_first_time = g_get_monotonic_time ();
+    srtp_bench_first_cpu = clock ();
+  }
+  srtp_bench_last_time = g_get_monotonic_time ();
+  srtp_bench_last_cpu = clock ();
+  g_mutex_unlock (&srtp_bench_mutex);
+
+  _normal_handoff_handler (element, buffer, pad, user_data);
+}
+
+static void
+setup_null_srtp_sender (struct SimpleTestConference *dat, guint confid)
+{
+  GstBuffer *key;
+  GstStructure *s;
+  GError *error = NULL;
+
+  key = gst_buffer_new_allocate (NULL, 30, NULL);
+  gst_buffer_memset (key, 0, 0, 30);
+
+  s = gst_structure_new ("FarstreamSRTP",
+      "auth", G_TYPE_STRING, "null",
+      "cipher", G_TYPE_STRING, "null",
+      "key", GST_TYPE_BUFFER, key, NULL);
+  gst_buffer_unref (key);
+
+  fail_unless (fs_session_set_encryption_parameters (dat->session, s,
+          &error));
+  g_assert_no_error (error);
+
+  gst_structure_free (s);
+}
+
+static void
+setup_null_srtp_receiver (struct SimpleTestStream *st, guint confid,
+    guint streamid)
+{
+  setup_srtp_receiver (st, confid, streamid);
+  st->handoff_handler = G_CALLBACK (_srtp_bench_handoff_handler);
+}
+
+static void
+setup_plain_rtp_receiver (struct SimpleTestStream *st, guint confid,
+    guint streamid)
+{
+  st->handoff_handler = G_CALLBACK (_srtp_bench_handoff_handler);
+}
+
+static void
+run_srtp_bypass_benchmark (gboolean through_srtp, gdouble *packets_per_second,
+    gdouble *cpu_us_per_packet)
+{
+  gint64 elapsed;
+
+  srtp_bench_packets = 0;
+  srtp_bench_srtp_elements = 0;
+
+  if (through_srtp)
+    nway_test (2, setup_null_srtp_sender, setup_null_srtp_receiver,
+        "rawudp", 0, NULL);
+  else
+    nway_test (2, NULL, setup_plain_rtp_receiver, "rawudp", 0, NULL);
+
+  ts_fail_unless (srtp_bench_packets > 1);
+
+  /* Without encryption, the packets must not go through srtpenc or
+   * srtpdec at all */
+  if (through_srtp)
+    ts_fail_unless (srtp_bench_srtp_elements > 0,
+        "No SRTP element in a conference with SRTP parameters");
+  else
+    ts_fail_unless (srtp_bench_srtp_elements == 0,
+        "%u SRTP elements in a conference without encryption",
+        srtp_bench_srtp_elements);
+
+  elapsed = MAX (srtp_bench_last_time - srtp_bench_first_time, 1);
+  *packets_per_second = (srtp_bench_packets - 1) * (gdouble) G_USEC_PER_SEC /
+      elapsed;
+  *cpu_us_per_packet = (srtp_bench_last_cpu - srtp_bench_first_cpu) *
+      (gdouble) G_USEC_PER_SEC / CLOCKS_PER_SEC / (srtp_bench_packets - 1);
+}
+
+/* Compares a plain RTP session, which no longer goes through the SRTP
+ * elements, with one that has null SRTP parameters, which is what every
+ * session used to go through */
+
+GST_START_TEST (test_rtpconference_srtp_bypass_benchmark)
+{
+  gdouble plain_pps, plain_cpu;
+  gdouble srtp_pps, srtp_cpu;
+
+  run_srtp_bypass_benchmark (FALSE, &plain_pps, &plain_cpu);
+  run_srtp_bypass_benchmark (TRUE, &srtp_pps, &srtp_cpu);
+
+  GST_INFO ("Plain RTP: %.1f packets/s, %.2fus of CPU per packet",
+      plain_pps, plain_cpu);
+  GST_INFO ("Null SRTP: %.1f packets/s, %.2fus of CPU per packet",
+      srtp_pps, srtp_cpu);
+}
+GST_END_TEST;
+
+/* What the session gives the payloaders for a path MTU of 1500 or more, the
+ * loopback has a much larger one */
+#define EXPECTED_SEND_MTU (1500 - 32)
+/* Still above the default MTU of the payloaders, which the first packets
+ * can go out with */
+#define SMALL_MAX_SEND_MTU (1450)
+
+static GMutex payloader_mtu_mutex;
+static guint payloader_mtu;
+
+static void
+_record_payloader_mtu (const GValue *item, gpointer user_data)
+{
+  GstElement *element = g_value_get_object (item);
+  GstElementFactory *factory = gst_element_get_factory (element);
+  guint *max_mtu = user_data;
+  const gchar *klass;
+  guint mtu;
+
+  if (!factory ||
+      !g_object_class_find_property (G_OBJECT_GET_CLASS (element), "mtu"))
+    return;
+
+  klass = gst_element_factory_get_metadata (factory,
+      GST_ELEMENT_METADATA_KLASS);
+  if (!klass || !g_strrstr (klass, "Payloader"))
+    return;
+
+  g_object_get (element, "mtu", &mtu, NULL);
+  *max_mtu = MAX (*max_mtu, mtu);
+}
+
+static void
+_mtu_handoff_handler (GstElement *element, GstBuffer *buffer, GstPad *pad,
+    gpointer user_data)
+{
+  struct SimpleTestStream *st = user_data;
+  GstIterator *iter = gst_bin_iterate_recurse (GST_BIN (st->dat->conference));
+  guint mtu = 0;
+
+  while (gst_iterator_foreach (iter, _record_payloader_mtu, &mtu) ==
+      GST_ITERATOR_RESYNC)
+  {
+    mtu = 0;
+    gst_iterator_resync (iter);
+  }
+  gst_iterator_free (iter);
+
+  g_mutex_lock (&payloader_mtu_mutex);
+  payloader_mtu = MAX (payloader_mtu, mtu);
+  g_mutex_unlock (&payloader_mtu_mutex);
+
+  _normal_handoff_handler (element, buffer, pad, user_data);
+}
+
+static void
+setup_mtu_receiver (struct SimpleTestStream *st, guint confid,
+    guint streamid)
+{
+  st->handoff_handler = G_CALLBACK (_mtu_handoff_handler);
+}
+
+static void
+setup_small_max_send_mtu (struct SimpleTestConference *dat, guint confid)
+{
+  g_object_set (dat->session, "max-send-mtu", SMALL_MAX_SEND_MTU, NULL);
+}
+
+/* The path MTU of the loopback must not go to the payloaders as is, the
+ * other side could not receive such large packets */
+
+GST_START_TEST (test_rtpconference_send_mtu)
+{
+  payloader_mtu = 0;
+
+  nway_test (2, NULL, setup_mtu_receiver, "rawudp", 0, NULL);
+
+  ts_fail_unless (payloader_mtu == EXPECTED_SEND_MTU,
+      "The payloaders have a MTU of %u instead of %u", payloader_mtu,
+      EXPECTED_SEND_MTU);
+
+  payloader_mtu = 0;
+
+  nway_test (2, setup_small_max_send_mtu, setup_mtu_receiver, "rawudp", 0,
+      NULL);
+
+  ts_fail_unless (payloader_mtu == SMALL_MAX_SEND_MTU - 32,
+      "The payloaders have a MTU of %u instead of %u with a max-send-mtu"
+      " of %u", payloader_mtu, SMALL_MAX_SEND_MTU - 32, SMALL_MAX_SEND_MTU);
+}
+GST_END_TEST;
+
+/* Asks like the TFRC packet modder does from where it sits, in front of the
+ * RTP muxer of the session, whether the transmitters pace the packets */
+
+static GMutex send_time_mutex;
+static gint send_time_answered;
+static gint send_time_paced;
+
+static void
+_query_send_time (struct SimpleTestConference *dat)
+{
+  GstElement *muxer;
+  GstIterator *iter;
+  GValue item = G_VALUE_INIT;
+  GstQuery *query;
+  gboolean answered = FALSE, paced = FALSE;
+  guint id;
+  gchar *name;
+
+  g_object_get (dat->session, "id", &id, NULL);
+  name = g_strdup_printf ("send_rtp_muxer_%u", id);
+  muxer = gst_bin_get_by_name (GST_BIN (dat->conference), name);
+  g_free (name);
+  ts_fail_if (muxer == NULL, "The session has no RTP muxer");
+
+  iter = gst_element_iterate_sink_pads (muxer);
+  while (!answered && gst_iterator_next (iter, &item) == GST_ITERATOR_OK)
+  {
+    GstPad *pad = g_value_get_object (&item);
+
+    if (gst_pad_is_linked (pad))
+    {
+      query = fs_send_time_query_new ();
+      answered = gst_pad_query (pad, query);
+      if (answered)
+        ts_fail_unless (fs_send_time_query_parse (query, &paced),
+            "The send time query was not recognized");
+      gst_query_unref (query);
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (iter);
+  gst_object_unref (muxer);
+
+  g_mutex_lock (&send_time_mutex);
+  send_time_answered = answered;
+  send_time_paced = paced;
+  g_mutex_unlock (&send_time_mutex);
+}
+
+static void
+_send_time_handoff_handler (GstElement *element, GstBuffer *buffer,
+    GstPad *pad, gpointer user_data)
+{
+  struct SimpleTestStream *st = user_data;
+
+  /* Packets are flowing, so the transmitters are linked */
+  if (st->buffer_count == 0)
+    _query_send_time (st->target);
+
+  _normal_handoff_handler (element, buffer, pad, user_data);
+}
+
+static void
+setup_paced_sending (struct SimpleTestConference *dat, guint confid)
+{
+  g_object_set (dat->session, "paced-sending", TRUE, NULL);
+}
+
+static void
+setup_send_time_receiver (struct SimpleTestStream *st, guint confid,
+    guint streamid)
+{
+  st->handoff_handler = G_CALLBACK (_send_time_handoff_handler);
+}
+
+GST_START_TEST (test_rtpconference_paced_sending)
+{
+  send_time_answered = -1;
+  nway_test (2, setup_paced_sending, setup_send_time_receiver, "rawudp", 0,
+      NULL);
+  ts_fail_unless (send_time_answered == TRUE,
+      "The rawudp transmitter did not answer the send time query");
+  ts_fail_unless (send_time_paced == TRUE,
+      "The rawudp transmitter does not pace the packets");
+
+  /* Without paced sending, the packet modder keeps waiting on the clock */
+  send_time_answered = -1;
+  nway_test (2, NULL, setup_send_time_receiver, "rawudp", 0, NULL);
+  ts_fail_unless (send_time_answered == FALSE,
+      "The send time query was answered without paced sending");
+}
+GST_END_TEST;
+
 static void
 multicast_srtp_init (struct SimpleTestStream *st, guint confid, guint streamid)
 {
@@ -1560,10 +2372,22 @@ fsrtpconference_suite (void)
   tcase_add_test (tc_chain, test_rtpconference_double_codec_profile);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpconference_send_bitrate");
+  tcase_add_test (tc_chain, test_rtpconference_send_bitrate);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpconference_dispose");
   tcase_add_test (tc_chain, test_rtpconference_dispose);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpconference_thread_policy");
+  tcase_add_test (tc_chain, test_rtpconference_thread_policy);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpconference_deferred_teardown");
+  tcase_add_test (tc_chain, test_rtpconference_deferred_teardown);
+  suite_add_tcase (s, tc_chain);
+
 #if 0
   tc_chain = tcase_create ("fsrtpconference_multicast_three_way_cname_assoc");
   min_timeout (tc_chain, 30);
@@ -1579,6 +2403,18 @@ fsrtpconference_suite (void)
   tcase_add_test (tc_chain, test_rtpconference_unref_session_in_pad_added);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpconference_srtp_bypass_benchmark");
+  tcase_add_test (tc_chain, test_rtpconference_srtp_bypass_benchmark);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpconference_paced_sending");
+  tcase_add_test (tc_chain, test_rtpconference_paced_sending);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpconference_send_mtu");
+  tcase_add_test (tc_chain, test_rtpconference_send_mtu);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpconference_two_way_srtp");
   tcase_add_test (tc_chain, test_rtpconference_two_way_srtp);
   suite_add_tcase (s, tc_chain);
@@ -1597,6 +2433,13 @@ fsrtpconference_suite (void)
       test_rtpconference_multicast_three_way_ssrc_assoc_srtp);
   suite_add_tcase (s, tc_chain);
 
+  /* They only log timings, which only mean something on an idle machine */
+  if (g_getenv ("FS_BENCHMARKS")) {
+    tc_chain = tcase_create ("fsrtpconference_deferred_teardown_benchmark");
+    tcase_add_test (tc_chain, test_rtpconference_deferred_teardown_benchmark);
+    suite_add_tcase (s, tc_chain);
+  }
+
   return s;
 }
 
@@ -374,6 +374,377 @@ GST_START_TEST (test_rtprecv_inband_config_data)
 GST_END_TEST;
 
 
+static GstClockTime switch_time = GST_CLOCK_TIME_NONE;
+static GstClockTime first_switched_buffer_time = GST_CLOCK_TIME_NONE;
+static guint alawdec_count = 0;
+static guint alawdec_built_count = 0;
+
+/* A prebuilt decoder is already in READY when its codec bin is added to the
+ * conference, one built for the switch is still in NULL */
+static void
+alawdec_added (FsElementAddedNotifier *notif, GstBin *bin,
+    GstElement *element, gpointer user_data)
+{
+  GstElementFactory *fact = gst_element_get_factory (element);
+
+  if (!fact || strcmp (gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (fact)),
+          "alawdec"))
+    return;
+
+  g_atomic_int_inc (&alawdec_count);
+  if (GST_STATE (element) == GST_STATE_NULL)
+    g_atomic_int_inc (&alawdec_built_count);
+}
+
+static void
+switch_handoff_handler (GstElement *fakesink, GstBuffer *buffer, GstPad *pad,
+    gpointer user_data)
+{
+  guint pt = GPOINTER_TO_UINT (user_data);
+
+  g_mutex_lock (&count_mutex);
+  if (pt == 8 && first_switched_buffer_time == GST_CLOCK_TIME_NONE)
+  {
+    first_switched_buffer_time = gst_util_get_timestamp ();
+    g_cond_broadcast (&count_cond);
+  }
+  else if (pt == 0)
+  {
+    buffer_count++;
+    if (buffer_count == BUFFER_COUNT)
+      g_cond_broadcast (&count_cond);
+  }
+  g_mutex_unlock (&count_mutex);
+}
+
+static void
+switch_src_pad_added_cb (FsStream *self, GstPad *pad, FsCodec *codec,
+    GstElement *pipeline)
+{
+  GstElement *sink;
+  GstPad *sinkpad;
+
+  sink = gst_element_factory_make ("fakesink", NULL);
+  g_object_set (sink, "sync", FALSE, "async", FALSE,
+      "signal-handoffs", TRUE, NULL);
+  g_signal_connect (sink, "handoff", G_CALLBACK (switch_handoff_handler),
+      GUINT_TO_POINTER (codec->id));
+  fail_unless (gst_bin_add (GST_BIN (pipeline), sink));
+  gst_element_set_state (sink, GST_STATE_PLAYING);
+  sinkpad = gst_element_get_static_pad (sink, "sink");
+  fail_unless (GST_PAD_LINK_SUCCESSFUL (gst_pad_link (pad, sinkpad)));
+  gst_object_unref (sinkpad);
+
+  GST_DEBUG ("Pad added for " FS_CODEC_FORMAT, FS_CODEC_ARGS (codec));
+}
+
+static guint
+get_host_port (GstElement *fspipeline)
+{
+  GstBus *bus = gst_element_get_bus (fspipeline);
+  guint port = 0;
+
+  while (port == 0)
+  {
+    GstMessage *msg;
+    const GstStructure *s;
+
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        GST_MESSAGE_ELEMENT);
+    fail_unless (msg != NULL);
+    s = gst_message_get_structure (msg);
+
+    if (gst_structure_has_name (s, "farstream-new-local-candidate"))
+    {
+      FsCandidate *candidate = g_value_get_boxed (
+          gst_structure_get_value (s, "candidate"));
+
+      if (candidate->type == FS_CANDIDATE_TYPE_HOST)
+        port = candidate->port;
+    }
+
+    gst_message_unref (msg);
+  }
+
+  gst_object_unref (bus);
+
+  return port;
+}
+
+static GstClockTime
+run_pt_switch (guint max_prebuilt)
+{
+  FsParticipant *participant;
+  FsStream *stream;
+  FsSession *session;
+  FsElementAddedNotifier *notif;
+  GstElement *fspipeline;
+  GstElement *conference;
+  GstElement *pcmu_pipeline;
+  GstElement *pcma_pipeline;
+  GList *codecs = NULL;
+  GError *error = NULL;
+  GstClockTime gap;
+  gchar *desc;
+  guint port;
+
+  buffer_count = 0;
+  switch_time = GST_CLOCK_TIME_NONE;
+  first_switched_buffer_time = GST_CLOCK_TIME_NONE;
+  alawdec_count = 0;
+  alawdec_built_count = 0;
+
+  fspipeline = gst_pipeline_new (NULL);
+  conference = gst_element_factory_make ("fsrtpconference", NULL);
+  fail_unless (gst_bin_add (GST_BIN (fspipeline), conference));
+
+  notif = fs_element_added_notifier_new ();
+  fs_element_added_notifier_add (notif, GST_BIN (fspipeline));
+  g_signal_connect (notif, "element-added", G_CALLBACK (alawdec_added), NULL);
+
+  session = fs_conference_new_session (FS_CONFERENCE (conference),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  fail_if (session == NULL, "Could not make session: %s",
+      error ? error->message : "UNKNOWN");
+  g_object_set (session, "no-rtcp-timeout", 0,
+      "max-prebuilt-recv-codec-bins", max_prebuilt, NULL);
+
+  participant = fs_conference_new_participant (FS_CONFERENCE (conference),
+      &error);
+  fail_if (participant == NULL, "Could not make participant: %s",
+      error ? error->message : "UNKNOWN");
+
+  stream = fs_session_new_stream (session, participant, FS_DIRECTION_RECV,
+      &error);
+  fail_if (stream == NULL, "Could not make stream: %s",
+      error ? error->message : "UNKNOWN");
+  fail_unless (fs_stream_set_transmitter (stream, "rawudp", NULL, 0, &error));
+  fail_unless (error == NULL);
+
+  g_signal_connect (stream, "src-pad-added",
+      G_CALLBACK (switch_src_pad_added_cb), fspipeline);
+
+  codecs = g_list_append (codecs, fs_codec_new (0, "PCMU",
+          FS_MEDIA_TYPE_AUDIO, 8000));
+  codecs = g_list_append (codecs, fs_codec_new (8, "PCMA",
+          FS_MEDIA_TYPE_AUDIO, 8000));
+  fail_unless (fs_stream_set_remote_codecs (stream, codecs, &error),
+      "Unable to set remote codecs: %s", error ? error->message : "UNKNOWN");
+  fs_codec_list_destroy (codecs);
+
+  gst_element_set_state (fspipeline, GST_STATE_PLAYING);
+  port = get_host_port (fspipeline);
+
+  /* Each 1024 sample buffer fits in a single packet, so continue the
+   * sequence numbers and timestamps of the first pipeline */
+  desc = g_strdup_printf ("audiotestsrc is-live=1 samplesperbuffer=1024"
+      " num-buffers=%u ! mulawenc ! rtppcmupay !"
+      " application/x-rtp, ssrc=(uint)12345678 !"
+      " udpsink host=127.0.0.1 port=%u", SEND_BUFFER_COUNT, port);
+  pcmu_pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  desc = g_strdup_printf ("audiotestsrc is-live=1 samplesperbuffer=1024"
+      " num-buffers=%u ! alawenc ! rtppcmapay seqnum-offset=%u"
+      " timestamp-offset=%u ! application/x-rtp, ssrc=(uint)12345678 !"
+      " udpsink host=127.0.0.1 port=%u", SEND_BUFFER_COUNT, BUFFER_COUNT,
+      BUFFER_COUNT * 1024, port);
+  pcma_pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pcmu_pipeline != NULL && pcma_pipeline != NULL);
+
+  gst_element_set_state (pcmu_pipeline, GST_STATE_PLAYING);
+
+  g_mutex_lock (&count_mutex);
+  while (buffer_count < BUFFER_COUNT)
+    g_cond_wait (&count_cond, &count_mutex);
+  g_mutex_unlock (&count_mutex);
+
+  gst_element_set_state (pcmu_pipeline, GST_STATE_NULL);
+
+  g_mutex_lock (&count_mutex);
+  switch_time = gst_util_get_timestamp ();
+  g_mutex_unlock (&count_mutex);
+
+  gst_element_set_state (pcma_pipeline, GST_STATE_PLAYING);
+
+  g_mutex_lock (&count_mutex);
+  while (first_switched_buffer_time == GST_CLOCK_TIME_NONE)
+    g_cond_wait (&count_cond, &count_mutex);
+  gap = first_switched_buffer_time - switch_time;
+  g_mutex_unlock (&count_mutex);
+
+  gst_element_set_state (pcma_pipeline, GST_STATE_NULL);
+  gst_object_unref (pcmu_pipeline);
+  gst_object_unref (pcma_pipeline);
+
+  /* Exactly one decoder was added for the switch */
+  fail_unless (g_atomic_int_get (&alawdec_count) == 1,
+      "%u PCMA decoders were added", g_atomic_int_get (&alawdec_count));
+  if (max_prebuilt)
+    fail_unless (g_atomic_int_get (&alawdec_built_count) == 0,
+        "The PCMA codec bin was built on the switch instead of prebuilt");
+  else
+    fail_unless (g_atomic_int_get (&alawdec_built_count) == 1,
+        "The PCMA codec bin was not built on the switch");
+
+  fs_element_added_notifier_remove (notif, GST_BIN (fspipeline));
+  g_object_unref (notif);
+
+  gst_object_unref (participant);
+  gst_object_unref (stream);
+  gst_object_unref (session);
+
+  gst_element_set_state (fspipeline, GST_STATE_NULL);
+  gst_object_unref (fspipeline);
+
+  return gap;
+}
+
+GST_START_TEST (test_rtprecv_pt_switch_prebuilt)
+{
+  GstClockTime gap_on_demand, gap_prebuilt;
+
+  g_mutex_init (&count_mutex);
+  g_cond_init (&count_cond);
+
+  gap_on_demand = run_pt_switch (0);
+  gap_prebuilt = run_pt_switch (2);
+
+  GST_INFO ("Gap when switching payload type: %" GST_TIME_FORMAT
+      " building the decoder on demand, %" GST_TIME_FORMAT " prebuilt",
+      GST_TIME_ARGS (gap_on_demand), GST_TIME_ARGS (gap_prebuilt));
+
+  g_mutex_clear (&count_mutex);
+  g_cond_clear (&count_cond);
+}
+GST_END_TEST;
+
+
+static guint mulawdec_count = 0;
+
+static void
+mulawdec_added (FsElementAddedNotifier *notif, GstBin *bin,
+    GstElement *element, gpointer user_data)
+{
+  GstElementFactory *fact = gst_element_get_factory (element);
+
+  if (fact && !strcmp (gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (fact)),
+          "mulawdec"))
+    g_atomic_int_inc (&mulawdec_count);
+}
+
+static void
+wait_for_buffers (void)
+{
+  g_mutex_lock (&count_mutex);
+  buffer_count = 0;
+  while (buffer_count < BUFFER_COUNT)
+    g_cond_wait (&count_cond, &count_mutex);
+  g_mutex_unlock (&count_mutex);
+}
+
+GST_START_TEST (test_rtprecv_decoding_toggle)
+{
+  FsParticipant *participant;
+  FsStream *stream;
+  FsSession *session;
+  GstElement *fspipeline;
+  GstElement *conference;
+  GstElement *pipeline;
+  FsElementAddedNotifier *notif;
+  GList *codecs = NULL;
+  GError *error = NULL;
+  gchar *desc;
+  guint count;
+
+  g_mutex_init (&count_mutex);
+  g_cond_init (&count_cond);
+  mulawdec_count = 0;
+
+  fspipeline = gst_pipeline_new (NULL);
+  notif = fs_element_added_notifier_new ();
+  fs_element_added_notifier_add (notif, GST_BIN (fspipeline));
+  g_signal_connect (notif, "element-added", G_CALLBACK (mulawdec_added), NULL);
+
+  conference = gst_element_factory_make ("fsrtpconference", NULL);
+  fail_unless (gst_bin_add (GST_BIN (fspipeline), conference));
+
+  session = fs_conference_new_session (FS_CONFERENCE (conference),
+      FS_MEDIA_TYPE_AUDIO, &error);
+  fail_if (session == NULL, "Could not make session: %s",
+      error ? error->message : "UNKNOWN");
+  g_object_set (session, "no-rtcp-timeout", 0, NULL);
+
+  participant = fs_conference_new_participant (FS_CONFERENCE (conference),
+      &error);
+  fail_if (participant == NULL, "Could not make participant: %s",
+      error ? error->message : "UNKNOWN");
+
+  stream = fs_session_new_stream (session, participant, FS_DIRECTION_RECV,
+      &error);
+  fail_if (stream == NULL, "Could not make stream: %s",
+      error ? error->message : "UNKNOWN");
+  fail_unless (fs_stream_set_transmitter (stream, "rawudp", NULL, 0, &error));
+  fail_unless (error == NULL);
+
+  g_signal_connect (stream, "src-pad-added",
+      G_CALLBACK (switch_src_pad_added_cb), fspipeline);
+
+  codecs = g_list_append (codecs, fs_codec_new (0, "PCMU",
+          FS_MEDIA_TYPE_AUDIO, 8000));
+  fail_unless (fs_stream_set_remote_codecs (stream, codecs, &error),
+      "Unable to set remote codecs: %s", error ? error->message : "UNKNOWN");
+  fs_codec_list_destroy (codecs);
+
+  gst_element_set_state (fspipeline, GST_STATE_PLAYING);
+
+  desc = g_strdup_printf ("audiotestsrc is-live=1 samplesperbuffer=160"
+      " ! mulawenc ! rtppcmupay ! application/x-rtp, ssrc=(uint)12345678 !"
+      " udpsink host=127.0.0.1 port=%u", get_host_port (fspipeline));
+  pipeline = gst_parse_launch (desc, NULL);
+  g_free (desc);
+  fail_unless (pipeline != NULL);
+  gst_element_set_state (pipeline, GST_STATE_PLAYING);
+
+  wait_for_buffers ();
+  fail_unless (g_atomic_int_get (&mulawdec_count) == 1);
+
+  g_object_set (stream, "decoding", FALSE, NULL);
+
+  /* Give the in-flight buffers time to go through */
+  g_usleep (G_USEC_PER_SEC / 5);
+  g_mutex_lock (&count_mutex);
+  count = buffer_count;
+  g_mutex_unlock (&count_mutex);
+  g_usleep (G_USEC_PER_SEC / 2);
+  g_mutex_lock (&count_mutex);
+  fail_unless (buffer_count == count,
+      "Got %u buffers while not decoding", buffer_count - count);
+  g_mutex_unlock (&count_mutex);
+
+  g_object_set (stream, "decoding", TRUE, NULL);
+
+  wait_for_buffers ();
+  fail_unless (g_atomic_int_get (&mulawdec_count) == 2,
+      "The decoder was not re-created when decoding was turned back on");
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (pipeline);
+
+  gst_object_unref (participant);
+  gst_object_unref (stream);
+  gst_object_unref (session);
+
+  gst_element_set_state (fspipeline, GST_STATE_NULL);
+  gst_object_unref (fspipeline);
+  g_object_unref (notif);
+
+  g_mutex_clear (&count_mutex);
+  g_cond_clear (&count_cond);
+}
+GST_END_TEST;
+
+
 static Suite *
 fsrtprecvcodecs_suite (void)
 {
@@ -389,6 +760,14 @@ fsrtprecvcodecs_suite (void)
   tcase_add_test (tc_chain, test_rtprecv_inband_config_data);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtprecv_pt_switch_prebuilt");
+  tcase_add_test (tc_chain, test_rtprecv_pt_switch_prebuilt);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtprecv_decoding_toggle");
+  tcase_add_test (tc_chain, test_rtprecv_decoding_toggle);
+  suite_add_tcase (s, tc_chain);
+
   return s;
 }
 
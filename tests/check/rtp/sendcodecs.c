@@ -26,9 +26,11 @@
 #include <gst/rtp/gstrtpbuffer.h>
 
 #include <farstream/fs-conference.h>
+#include <farstream/fs-element-added-notifier.h>
 
 #include "check-threadsafe.h"
 #include "generic.h"
+#include "testutils.h"
 
 GMainLoop *loop = NULL;
 
@@ -43,6 +45,10 @@ gboolean filter_telephone_event = FALSE;
 struct SimpleTestConference *dat = NULL;
 FsStream *stream = NULL;
 
+static void (*setup_conference_hook) (struct SimpleTestConference *dat) =
+    NULL;
+static FsMediaType media_type = FS_MEDIA_TYPE_AUDIO;
+
 static gboolean
 _start_pipeline (gpointer user_data)
 {
@@ -227,7 +233,12 @@ set_codecs (struct SimpleTestConference *dat, FsStream *stream)
   for (item = g_list_first (codecs); item; item = g_list_next (item))
   {
     FsCodec *codec = item->data;
-    if (codec->id == 0)
+    if (media_type == FS_MEDIA_TYPE_VIDEO)
+    {
+      if (!g_ascii_strcasecmp (codec->encoding_name, "THEORA"))
+        filtered_codecs = g_list_append (filtered_codecs, codec);
+    }
+    else if (codec->id == 0)
     {
       filtered_codecs = g_list_append (filtered_codecs, codec);
     }
@@ -245,8 +256,11 @@ set_codecs (struct SimpleTestConference *dat, FsStream *stream)
   ts_fail_if (filtered_codecs == NULL, "PCMA and PCMU are not in the codecs"
       " you must install gst-plugins-good");
 
-  ts_fail_unless (dtmf_codec != NULL);
-  dtmf_codec->id = dtmf_id;
+  if (media_type == FS_MEDIA_TYPE_AUDIO)
+  {
+    ts_fail_unless (dtmf_codec != NULL);
+    dtmf_codec->id = dtmf_id;
+  }
 
   if (!fs_stream_set_remote_codecs (stream, filtered_codecs, &error))
   {
@@ -263,6 +277,32 @@ set_codecs (struct SimpleTestConference *dat, FsStream *stream)
   fs_codec_list_destroy (codecs);
 }
 
+static void
+setup_videosrc (struct SimpleTestConference *dat)
+{
+  GstElement *src;
+  GstPad *sinkpad = NULL, *srcpad = NULL;
+
+  g_object_get (dat->session, "sink-pad", &sinkpad, NULL);
+  fail_if (sinkpad == NULL, "Could not get session sinkpad");
+
+  src = gst_parse_bin_from_description ("videotestsrc is-live=1 !"
+      " video/x-raw, width=(int)64, height=(int)48,"
+      " framerate=(fraction)30/1", TRUE, NULL);
+  fail_if (src == NULL, "Could not make videotestsrc");
+  gst_bin_add (GST_BIN (dat->pipeline), src);
+
+  srcpad = gst_element_get_static_pad (src, "src");
+  fail_unless (gst_pad_link (srcpad, sinkpad) == GST_PAD_LINK_OK,
+      "Could not link the videotestsrc and the fsrtpconference");
+
+  gst_object_unref (sinkpad);
+  gst_object_unref (srcpad);
+
+  if (dat->started)
+    gst_element_set_state (dat->pipeline, GST_STATE_PLAYING);
+}
+
 static void
 one_way (GstElement *recv_pipeline, gint port)
 {
@@ -279,7 +319,11 @@ one_way (GstElement *recv_pipeline, gint port)
 
   loop = g_main_loop_new (NULL, FALSE);
 
-  dat = setup_simple_conference (1, "fsrtpconference", "tester@123445");
+  dat = setup_simple_conference_full (1, "fsrtpconference", "tester@123445",
+      media_type);
+
+  if (setup_conference_hook)
+    setup_conference_hook (dat);
 
   bus = gst_element_get_bus (dat->pipeline);
   gst_bus_add_watch (bus, _bus_callback, dat);
@@ -317,7 +361,10 @@ one_way (GstElement *recv_pipeline, gint port)
 
   set_codecs (dat, stream);
 
-  setup_fakesrc (dat);
+  if (media_type == FS_MEDIA_TYPE_VIDEO)
+    setup_videosrc (dat);
+  else
+    setup_fakesrc (dat);
 
   g_main_loop_run (loop);
 
@@ -516,6 +563,77 @@ GST_START_TEST (test_senddtmf_change_auto)
 }
 GST_END_TEST;
 
+#define DTMF_RENEGOTIATIONS 60
+#define DTMF_RENEGOTIATION_MAX_EXTRA_THREADS 4
+
+static guint renegotiations = 0;
+static guint baseline_threads = 0;
+static guint peak_threads = 0;
+
+static gboolean
+renegotiate_dtmf_loop (gpointer data)
+{
+  GstState state;
+  guint threads;
+
+  if (!dat || !dat->pipeline || !dat->session)
+    return TRUE;
+
+  if (gst_element_get_state (dat->pipeline, &state, NULL, 0) !=
+      GST_STATE_CHANGE_SUCCESS || state != GST_STATE_PLAYING)
+    return TRUE;
+
+  /* Wait for the previous renegotiation to reach the send codec */
+  if (!ready_to_send)
+    return TRUE;
+
+  threads = count_threads ();
+  if (baseline_threads == 0)
+    baseline_threads = threads;
+  peak_threads = MAX (peak_threads, threads);
+
+  if (renegotiations++ == DTMF_RENEGOTIATIONS)
+  {
+    g_main_loop_quit (loop);
+    return FALSE;
+  }
+
+  /* Changing the telephone-event payload type replaces the DTMF source,
+   * so every iteration stops one special source */
+  dtmf_id = (dtmf_id == 105) ? 106 : 105;
+  ready_to_send = FALSE;
+  set_codecs (dat, stream);
+
+  return TRUE;
+}
+
+GST_START_TEST (test_senddtmf_renegotiate_threads)
+{
+  gint port;
+  GstElement *recv_pipeline = build_recv_pipeline (
+      send_dmtf_buffer_handler, NULL, &port);
+
+  renegotiations = 0;
+  baseline_threads = 0;
+  peak_threads = 0;
+
+  g_timeout_add (20, renegotiate_dtmf_loop, NULL);
+  one_way (recv_pipeline, port);
+
+  fail_unless (renegotiations > DTMF_RENEGOTIATIONS);
+
+  if (baseline_threads == 0)
+    return;
+
+  GST_INFO ("%u threads while idle, peak of %u while renegotiating",
+      baseline_threads, peak_threads);
+  fail_unless (peak_threads <=
+      baseline_threads + DTMF_RENEGOTIATION_MAX_EXTRA_THREADS,
+      "Renegotiating DTMF created too many threads (%u, baseline %u)",
+      peak_threads, baseline_threads);
+}
+GST_END_TEST;
+
 gboolean checked = FALSE;
 
 static GstPadProbeReturn
@@ -571,6 +689,204 @@ GST_START_TEST (test_change_ssrc)
 }
 GST_END_TEST;
 
+#define PT_CHANGES 6
+
+guint current_pt = 0;
+guint pt_changes = 0;
+gint64 pt_change_time = 0;
+gint encoders_created = 0;
+gint keyframes_encoded = 0;
+
+static gboolean
+change_send_pt (gpointer user_data)
+{
+  GList *codecs = NULL;
+  GError *error = NULL;
+
+  current_pt = 110 + pt_changes % 2;
+  if (media_type == FS_MEDIA_TYPE_VIDEO)
+    codecs = g_list_append (NULL, fs_codec_new (current_pt, "THEORA",
+            FS_MEDIA_TYPE_VIDEO, 90000));
+  else
+    codecs = g_list_append (NULL, fs_codec_new (current_pt, "PCMU",
+            FS_MEDIA_TYPE_AUDIO, 8000));
+
+  pt_change_time = g_get_monotonic_time ();
+  if (!fs_stream_set_remote_codecs (stream, codecs, &error))
+    ts_fail ("Could not set the remote codecs on stream (%d): %s",
+        error->code, error->message);
+  fs_codec_list_destroy (codecs);
+
+  return FALSE;
+}
+
+static GstPadProbeReturn
+change_pt_buffer_handler (GstPad *pad, GstPadProbeInfo *info,
+    gpointer user_data)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstRTPBuffer rtpbuf = GST_RTP_BUFFER_INIT;
+  guint pt;
+
+  ts_fail_unless (gst_rtp_buffer_map (buf, GST_MAP_READ, &rtpbuf));
+  pt = gst_rtp_buffer_get_payload_type (&rtpbuf);
+  gst_rtp_buffer_unmap (&rtpbuf);
+
+  /* Starts with whatever payload type was negotiated */
+  if ((pt != current_pt && pt_change_time != 0) || pt_change_time == -1)
+    return GST_PAD_PROBE_OK;
+
+  if (pt_change_time)
+    GST_INFO ("PT change %u to %u took %" G_GINT64_FORMAT "us",
+        pt_changes, pt, g_get_monotonic_time () - pt_change_time);
+
+  if (pt_changes == PT_CHANGES)
+  {
+    pt_change_time = -1;
+    g_main_loop_quit (loop);
+    return GST_PAD_PROBE_OK;
+  }
+
+  pt_changes++;
+  pt_change_time = -1;
+  g_idle_add (change_send_pt, NULL);
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+_count_keyframes (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (!GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_DELTA_UNIT) &&
+      !GST_BUFFER_FLAG_IS_SET (buf, GST_BUFFER_FLAG_HEADER))
+    g_atomic_int_inc (&keyframes_encoded);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* The codec configuration is discovered by other encoders */
+static gboolean
+is_in_discovery_bin (GstElement *element)
+{
+  GstObject *parent;
+  gboolean ret = FALSE;
+
+  for (parent = gst_object_get_parent (GST_OBJECT (element)); parent && !ret;)
+  {
+    GstObject *next = gst_object_get_parent (parent);
+    gchar *name = gst_object_get_name (parent);
+
+    ret = g_str_has_prefix (name, "discover");
+    g_free (name);
+    gst_object_unref (parent);
+    parent = next;
+  }
+
+  if (parent)
+    gst_object_unref (parent);
+
+  return ret;
+}
+
+static void
+_count_encoders (FsElementAddedNotifier *notifier, GstBin *bin,
+    GstElement *element, gpointer user_data)
+{
+  GstElementFactory *factory = gst_element_get_factory (element);
+  const gchar *encoder = media_type == FS_MEDIA_TYPE_VIDEO ?
+      "theoraenc" : "mulawenc";
+  GstPad *pad;
+
+  if (!factory || g_strcmp0 (encoder,
+          gst_plugin_feature_get_name (GST_PLUGIN_FEATURE (factory))) ||
+      is_in_discovery_bin (element))
+    return;
+
+  g_atomic_int_inc (&encoders_created);
+
+  /* Only the first frame is a keyframe, unless the encoder starts over */
+  if (media_type == FS_MEDIA_TYPE_VIDEO)
+    g_object_set (element,
+        "keyframe-auto", FALSE,
+        "keyframe-freq", 32768,
+        "keyframe-force", 32768,
+        NULL);
+
+  pad = gst_element_get_static_pad (element, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, _count_keyframes, NULL,
+      NULL);
+  gst_object_unref (pad);
+}
+
+static void
+count_encoders_init (struct SimpleTestConference *dat)
+{
+  FsElementAddedNotifier *notifier = fs_element_added_notifier_new ();
+
+  g_signal_connect (notifier, "element-added", G_CALLBACK (_count_encoders),
+      NULL);
+  fs_element_added_notifier_add (notifier, GST_BIN (dat->conference));
+  g_object_set_data_full (G_OBJECT (dat->conference), "encoder-counter",
+      notifier, g_object_unref);
+}
+
+static void
+run_pt_changes (void)
+{
+  gint port;
+  GstElement *recv_pipeline = build_recv_pipeline (
+      change_pt_buffer_handler, NULL, &port);
+
+  current_pt = 0;
+  pt_changes = 0;
+  pt_change_time = 0;
+  encoders_created = 0;
+  keyframes_encoded = 0;
+  filter_telephone_event = TRUE;
+  setup_conference_hook = count_encoders_init;
+  one_way (recv_pipeline, port);
+  setup_conference_hook = NULL;
+  filter_telephone_event = FALSE;
+
+  fail_unless (pt_changes == PT_CHANGES);
+  fail_unless (encoders_created == 1,
+      "%d encoders were created for %d payload type changes",
+      encoders_created, PT_CHANGES);
+}
+
+/* Re-offers that only change the payload type must keep the same encoder */
+
+GST_START_TEST (test_change_pt_keeps_encoder)
+{
+  run_pt_changes ();
+}
+GST_END_TEST;
+
+/* A video encoder that keeps running does not start over with a new
+ * keyframe, only the first frame is one */
+
+GST_START_TEST (test_change_pt_keeps_keyframes)
+{
+  GstElement *enc = gst_element_factory_make ("theoraenc", NULL);
+
+  if (!enc)
+  {
+    GST_WARNING ("theoraenc is not installed, skipping the keyframe test");
+    return;
+  }
+  gst_object_unref (enc);
+
+  media_type = FS_MEDIA_TYPE_VIDEO;
+  run_pt_changes ();
+  media_type = FS_MEDIA_TYPE_AUDIO;
+
+  fail_unless (keyframes_encoded == 1,
+      "%d keyframes were encoded across %d payload type changes",
+      keyframes_encoded, PT_CHANGES);
+}
+GST_END_TEST;
 
 static Suite *
 fsrtpsendcodecs_suite (void)
@@ -598,10 +914,22 @@ fsrtpsendcodecs_suite (void)
   tcase_add_test (tc_chain, test_senddtmf_change_auto);
   //suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpsenddtmf_renegotiate_threads");
+  tcase_add_test (tc_chain, test_senddtmf_renegotiate_threads);
+  suite_add_tcase (s, tc_chain);
+
   tc_chain = tcase_create ("fsrtpchangessrc");
   tcase_add_test (tc_chain, test_change_ssrc);
   suite_add_tcase (s, tc_chain);
 
+  tc_chain = tcase_create ("fsrtpchangept");
+  tcase_add_test (tc_chain, test_change_pt_keeps_encoder);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("fsrtpchangept_keyframes");
+  tcase_add_test (tc_chain, test_change_pt_keeps_keyframes);
+  suite_add_tcase (s, tc_chain);
+
   return s;
 }
 
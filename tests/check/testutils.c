@@ -93,3 +93,34 @@ get_fullpath (const gchar *filename)
   else
     return g_strdup (filename);
 }
+
+static guint
+count_dir_entries (const gchar *path)
+{
+  GDir *dir;
+  guint count = 0;
+
+  dir = g_dir_open (path, 0, NULL);
+  if (!dir)
+    return 0;
+
+  while (g_dir_read_name (dir))
+    count++;
+  g_dir_close (dir);
+
+  return count;
+}
+
+/* These return 0 if they can not count on this platform */
+
+guint
+count_threads (void)
+{
+  return count_dir_entries ("/proc/self/task");
+}
+
+guint
+count_fds (void)
+{
+  return count_dir_entries ("/proc/self/fd");
+}
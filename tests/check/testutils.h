@@ -29,6 +29,9 @@ gchar *find_multicast_capable_address (void);
 
 gchar *get_fullpath (const gchar *filename);
 
+guint count_threads (void);
+guint count_fds (void);
+
 G_END_DECLS
 
 #endif /* __UTILS_H__ */
@@ -242,4 +242,3 @@ teardown_stund (void)
   g_spawn_close_pid (stund_pid);
   stund_pid = 0;
 }
-
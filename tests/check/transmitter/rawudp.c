@@ -28,6 +28,10 @@
 
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <stdio.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
 
 #include <unistd.h>
 
@@ -64,6 +68,14 @@ enum {
 #define RTP_PORT 9828
 #define RTCP_PORT 9829
 
+/* The same tests are run on the "uring" transmitter, which only differs
+ * from this one by how it uses the sockets */
+#ifdef TEST_URING_TRANSMITTER
+# define RAWUDP_TRANSMITTER "uring"
+#else
+# define RAWUDP_TRANSMITTER "rawudp"
+#endif
+
 
 GST_START_TEST (test_rawudptransmitter_new)
 {
@@ -74,7 +86,7 @@ GST_START_TEST (test_rawudptransmitter_new)
   transmitters = fs_transmitter_list_available ();
   for (i=0; transmitters != NULL && transmitters[i]; i++)
   {
-    if (!strcmp ("rawudp", transmitters[i]))
+    if (!strcmp (RAWUDP_TRANSMITTER, transmitters[i]))
     {
       found_it = TRUE;
       break;
@@ -82,10 +94,11 @@ GST_START_TEST (test_rawudptransmitter_new)
   }
   g_strfreev (transmitters);
 
-  ts_fail_unless (found_it, "Did not find rawudp transmitter");
+  ts_fail_unless (found_it, "Did not find the %s transmitter",
+      RAWUDP_TRANSMITTER);
 
-  test_transmitter_creation ("rawudp");
-  test_transmitter_creation ("rawudp");
+  test_transmitter_creation (RAWUDP_TRANSMITTER);
+  test_transmitter_creation (RAWUDP_TRANSMITTER);
 }
 GST_END_TEST;
 
@@ -289,7 +302,7 @@ run_rawudp_transmitter_test (gint n_parameters, GParameter *params,
   }
 
   loop = g_main_loop_new (NULL, FALSE);
-  trans = fs_transmitter_new ("rawudp", 2, 0, &error);
+  trans = fs_transmitter_new (RAWUDP_TRANSMITTER, 2, 0, &error);
 
   if (error) {
     ts_fail ("Error creating transmitter: (%s:%d) %s",
@@ -577,7 +590,7 @@ GST_START_TEST (test_rawudptransmitter_stop_stream)
   has_stun = FALSE;
 
   loop = g_main_loop_new (NULL, FALSE);
-  trans = fs_transmitter_new ("rawudp", 2, 0, &error);
+  trans = fs_transmitter_new (RAWUDP_TRANSMITTER, 2, 0, &error);
 
   if (error) {
     ts_fail ("Error creating transmitter: (%s:%d) %s",
@@ -850,7 +863,7 @@ GST_START_TEST (test_rawudptransmitter_strange_arguments)
   FsCandidate *cand;
   GList *list;
 
-  trans = fs_transmitter_new ("rawudp", 3, 0, &error);
+  trans = fs_transmitter_new (RAWUDP_TRANSMITTER, 3, 0, &error);
   ts_fail_if (trans == NULL);
   ts_fail_unless (error == NULL);
 
@@ -924,102 +937,2000 @@ teardown_stund_stunalternd (void)
   teardown_stunalternd ();
 }
 
+/*
+ * Most of the tests below share this fixture: one stream transmitter with
+ * its RTP candidate on the loopback, in a pipeline whose fakesinks call the
+ * given handoff callback. With send_to_self, the stream sends to its own
+ * candidates and srcpad is linked to the RTP sink of the transmitter, ready
+ * to push packets into it.
+ *
+ * The benchmarks among them take long and what they measure depends on the
+ * machine, so they are only run when FS_BENCHMARKS is set in the
+ * environment. The checks that always run use the same code with fewer
+ * packets, and only assert what does not depend on timing.
+ */
 
-static Suite *
-rawudptransmitter_suite (void)
+typedef struct {
+  FsTransmitter *trans;
+  FsStreamTransmitter *st;
+  GstPad *srcpad;
+  GstPad *sinkpad;
+  gboolean send_to_self;
+  guint rtp_port;
+  /* How many times the path MTU was notified */
+  guint mtu_notified;
+} LoopbackStream;
+
+static void
+_loopback_new_local_candidate (FsStreamTransmitter *st,
+    FsCandidate *candidate, gpointer user_data)
 {
-  Suite *s = suite_create ("rawudptransmitter");
-  TCase *tc_chain;
-  GLogLevelFlags fatal_mask;
+  LoopbackStream *ls = user_data;
+  GError *error = NULL;
+  GList *item;
+  gboolean ret;
 
-  fatal_mask = g_log_set_always_fatal (G_LOG_FATAL_MASK);
-  fatal_mask |= G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL;
-  g_log_set_always_fatal (fatal_mask);
+  if (candidate->component_id == FS_COMPONENT_RTP)
+    ls->rtp_port = candidate->port;
 
-  tc_chain = tcase_create ("rawudptransmitter_new");
-  tcase_add_test (tc_chain, test_rawudptransmitter_new);
-  suite_add_tcase (s, tc_chain);
+  if (!ls->send_to_self)
+    return;
 
-  tc_chain = tcase_create ("rawudptransmitter_nostun");
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun);
-  suite_add_tcase (s, tc_chain);
+  item = g_list_prepend (NULL, candidate);
+  ret = fs_stream_transmitter_force_remote_candidates (st, item, &error);
+  g_list_free (item);
 
-  tc_chain = tcase_create ("rawudptransmitter_nostun_nosource");
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun_nosource);
-  suite_add_tcase (s, tc_chain);
+  if (error)
+    ts_fail ("Error while adding candidate: (%s:%d) %s",
+      g_quark_to_string (error->domain), error->code, error->message);
+  ts_fail_unless (ret, "No detailed error from force_remote_candidates");
+}
 
-  tc_chain = tcase_create ("rawudptransmitter-stun-timeout");
-  tcase_set_timeout (tc_chain, 10);
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_invalid_stun);
-  suite_add_tcase (s, tc_chain);
+static void
+_local_candidates_prepared_quit (FsStreamTransmitter *st, gpointer user_data)
+{
+  g_main_loop_quit (loop);
+}
 
-  tc_chain = tcase_create ("rawudptransmitter-stund");
-  tcase_set_timeout (tc_chain, 15);
-  tcase_add_checked_fixture (tc_chain, setup_stund, teardown_stund);
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_stund);
-  suite_add_tcase (s, tc_chain);
+static void
+_loopback_mtu_notify (GObject *object, GParamSpec *pspec, gpointer user_data)
+{
+  LoopbackStream *ls = user_data;
 
-  tc_chain = tcase_create ("rawudptransmitter-local-candidates");
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_local_candidates);
-  suite_add_tcase (s, tc_chain);
+  ls->mtu_notified++;
+}
 
-  tc_chain = tcase_create ("rawudptransmitter-stop-stream");
-  tcase_add_test (tc_chain, test_rawudptransmitter_stop_stream);
-  suite_add_tcase (s, tc_chain);
+/*
+ * @uint_param is the name of an extra guint parameter of the stream
+ * transmitter, or NULL. It is followed by properties of the transmitter,
+ * terminated by NULL, which are set before it creates its first port.
+ */
+static void
+loopback_stream_start (LoopbackStream *ls, const gchar *transmitter,
+    guint port, gboolean send_to_self, GCallback handoff,
+    const gchar *uint_param, guint uint_value,
+    const gchar *first_property, ...)
+{
+  GError *error = NULL;
+  GParameter params[3];
+  guint n_params = 2;
+  guint i;
 
-#if defined(HAVE_GUPNP_CORE_10) || defined (HAVE_GUPNP_CORE_12)
-  if (g_getenv ("UPNP")) {
-    gchar *multicast_addr;
+  memset (ls, 0, sizeof (LoopbackStream));
+  memset (params, 0, sizeof (GParameter) * 3);
+  ls->send_to_self = send_to_self;
 
-    multicast_addr = find_multicast_capable_address ();
-    g_free (multicast_addr);
+  params[0].name = "preferred-local-candidates";
+  g_value_init (&params[0].value, FS_TYPE_CANDIDATE_LIST);
+  g_value_take_boxed (&params[0].value, g_list_prepend (NULL,
+          fs_candidate_new ("L1", FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST,
+              FS_NETWORK_PROTOCOL_UDP, "127.0.0.1", port)));
 
-    if (multicast_addr)
-    {
-      tc_chain = tcase_create ("rawudptransmitter-upnp-discovery");
-      tcase_add_test (tc_chain, test_rawudptransmitter_run_upnp_discovery);
-      suite_add_tcase (s, tc_chain);
+  params[1].name = "upnp-discovery";
+  g_value_init (&params[1].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[1].value, FALSE);
 
-      tc_chain = tcase_create ("rawudptransmitter-upnp-fallback");
-      tcase_add_test (tc_chain, test_rawudptransmitter_run_upnp_fallback);
-      suite_add_tcase (s, tc_chain);
+  if (uint_param)
+  {
+    params[2].name = uint_param;
+    g_value_init (&params[2].value, G_TYPE_UINT);
+    g_value_set_uint (&params[2].value, uint_value);
+    n_params++;
+  }
 
-      tc_chain = tcase_create ("rawudptransmitter-upnp-ignored");
-      tcase_add_checked_fixture (tc_chain, setup_stund, teardown_stund);
-      tcase_add_test (tc_chain, test_rawudptransmitter_run_upnp_ignored);
-      suite_add_tcase (s, tc_chain);
-    }
+  loop = g_main_loop_new (NULL, FALSE);
+  ls->trans = fs_transmitter_new (transmitter, 2, 0, &error);
+  if (error)
+    ts_fail ("Error creating the %s transmitter: (%s:%d) %s", transmitter,
+        g_quark_to_string (error->domain), error->code, error->message);
+
+  if (first_property)
+  {
+    va_list var_args;
+
+    va_start (var_args, first_property);
+    g_object_set_valist (G_OBJECT (ls->trans), first_property, var_args);
+    va_end (var_args);
+  }
+
+  pipeline = setup_pipeline (ls->trans, handoff);
+
+  if (send_to_self)
+  {
+    GstElement *trans_sink;
+
+    g_object_get (ls->trans, "gst-sink", &trans_sink, NULL);
+    ls->sinkpad = gst_element_get_static_pad (trans_sink, "sink_1");
+    gst_object_unref (trans_sink);
+    ls->srcpad = gst_pad_new ("src", GST_PAD_SRC);
+    gst_pad_set_active (ls->srcpad, TRUE);
+    ts_fail_unless (gst_pad_link (ls->srcpad, ls->sinkpad) ==
+        GST_PAD_LINK_OK, "Could not link to the transmitter sink");
+  }
+
+  ts_fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+    GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  ls->st = fs_transmitter_new_stream_transmitter (ls->trans, NULL, n_params,
+      params, &error);
+  if (error)
+    ts_fail ("Error creating stream transmitter: (%s:%d) %s",
+        g_quark_to_string (error->domain), error->code, error->message);
+
+  for (i = 0; i < n_params; i++)
+    g_value_unset (&params[i].value);
+
+  g_signal_connect (ls->st, "error", G_CALLBACK (stream_transmitter_error),
+      NULL);
+  g_signal_connect (ls->st, "notify::mtu", G_CALLBACK (_loopback_mtu_notify),
+      ls);
+  g_signal_connect (ls->st, "new-local-candidate",
+      G_CALLBACK (_loopback_new_local_candidate), ls);
+  g_signal_connect (ls->st, "local-candidates-prepared",
+      G_CALLBACK (_local_candidates_prepared_quit), NULL);
+  ts_fail_unless (fs_stream_transmitter_gather_local_candidates (ls->st,
+          &error), "Could not start gathering local candidates");
+  g_main_loop_run (loop);
+
+  ts_fail_if (ls->rtp_port == 0, "Did not get the local RTP port");
+
+  if (send_to_self)
+  {
+    GstSegment segment;
+
+    gst_pad_push_event (ls->srcpad, gst_event_new_stream_start (transmitter));
+    gst_segment_init (&segment, GST_FORMAT_TIME);
+    gst_pad_push_event (ls->srcpad, gst_event_new_segment (&segment));
+  }
+}
+
+static void
+loopback_stream_stop (LoopbackStream *ls)
+{
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  fs_stream_transmitter_stop (ls->st);
+  g_object_unref (ls->st);
+
+  if (ls->srcpad)
+  {
+    gst_pad_unlink (ls->srcpad, ls->sinkpad);
+    gst_object_unref (ls->sinkpad);
+    gst_object_unref (ls->srcpad);
+  }
+
+  g_object_unref (ls->trans);
+  gst_object_unref (pipeline);
+  pipeline = NULL;
+  g_main_loop_unref (loop);
+  loop = NULL;
+}
+
+/*
+ * Several senders, each from its own port, flood the RTP port of one stream
+ * transmitter. With receive shards, the flows are spread over several
+ * receive threads.
+ */
+
+#define FLOOD_PACKETS_PER_SENDER 1000
+
+static GMutex flood_mutex;
+static GHashTable *flood_threads = NULL;
+static guint flood_received = 0;
+
+static void
+_flood_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  if (GPOINTER_TO_INT (user_data) != FS_COMPONENT_RTP)
+    return;
+
+  g_mutex_lock (&flood_mutex);
+  g_hash_table_add (flood_threads, g_thread_self ());
+  flood_received++;
+  g_mutex_unlock (&flood_mutex);
+}
+
+static gpointer
+_flood_sender_thread (gpointer user_data)
+{
+  GSocket *socket;
+  GInetAddress *addr;
+  GSocketAddress *dest;
+  gchar packet[160];
+  guint i;
+
+  memset (packet, 0, sizeof (packet));
+  /* RTP version 2, so the STUN probe lets it through */
+  packet[0] = 0x80;
+
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  ts_fail_unless (socket != NULL, "Could not create the sender socket");
+
+  addr = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  dest = g_inet_socket_address_new (addr, GPOINTER_TO_UINT (user_data));
+  g_object_unref (addr);
+
+  for (i = 0; i < FLOOD_PACKETS_PER_SENDER; i++)
+  {
+    g_socket_send_to (socket, dest, packet, sizeof (packet), NULL, NULL);
+    /* Pace a little so the loopback does not just overflow */
+    if (i % 50 == 49)
+      g_usleep (1000);
   }
+
+  g_object_unref (dest);
+  g_socket_close (socket, NULL);
+  g_object_unref (socket);
+
+  return NULL;
+}
+
+/* Returns how long it took until the receive side drained the sockets */
+static gint64
+flood_rtp_port (LoopbackStream *ls, guint n_senders, guint *n_threads,
+    guint *received)
+{
+  GThread **senders = g_new (GThread *, n_senders);
+  guint last_received;
+  gint64 start;
+  guint i;
+
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < n_senders; i++)
+    senders[i] = g_thread_new ("flood sender", _flood_sender_thread,
+        GUINT_TO_POINTER (ls->rtp_port));
+  for (i = 0; i < n_senders; i++)
+    g_thread_join (senders[i]);
+  g_free (senders);
+
+  do {
+    g_mutex_lock (&flood_mutex);
+    last_received = flood_received;
+    g_mutex_unlock (&flood_mutex);
+    g_usleep (G_USEC_PER_SEC / 10);
+    g_mutex_lock (&flood_mutex);
+    *received = flood_received;
+    g_mutex_unlock (&flood_mutex);
+  } while (*received != last_received);
+
+  g_mutex_lock (&flood_mutex);
+  *n_threads = g_hash_table_size (flood_threads);
+  g_mutex_unlock (&flood_mutex);
+
+  return g_get_monotonic_time () - start - G_USEC_PER_SEC / 10;
+}
+
+static void
+flood_reset (void)
+{
+  g_mutex_lock (&flood_mutex);
+  if (flood_threads)
+    g_hash_table_unref (flood_threads);
+  flood_threads = g_hash_table_new (NULL, NULL);
+  flood_received = 0;
+  g_mutex_unlock (&flood_mutex);
+}
+
+static void
+run_receive_shards (guint receive_shards, guint n_senders, guint *n_threads,
+    guint *received)
+{
+  LoopbackStream ls;
+  gint64 elapsed;
+
+  flood_reset ();
+
+  loopback_stream_start (&ls, RAWUDP_TRANSMITTER, RTP_PORT, FALSE,
+      G_CALLBACK (_flood_handoff), "receive-shards", receive_shards, NULL);
+
+  elapsed = flood_rtp_port (&ls, n_senders, n_threads, received);
+
+  GST_INFO ("%u shards: received %u/%u packets from %u senders in %"
+      G_GINT64_FORMAT " us (%" G_GINT64_FORMAT " pps) on %u threads",
+      receive_shards, *received, n_senders * FLOOD_PACKETS_PER_SENDER,
+      n_senders, elapsed, (gint64) *received * G_USEC_PER_SEC /
+      MAX (elapsed, 1), *n_threads);
+
+  loopback_stream_stop (&ls);
+}
+
+GST_START_TEST (test_rawudptransmitter_receive_shards)
+{
+  guint n_threads, received;
+
+  run_receive_shards (1, 2, &n_threads, &received);
+  ts_fail_if (received == 0, "Did not receive anything without shards");
+  ts_fail_unless (n_threads == 1, "Received on %u threads without shards",
+      n_threads);
+
+  run_receive_shards (4, 2, &n_threads, &received);
+  ts_fail_if (received == 0, "Did not receive anything with shards");
+  ts_fail_unless (n_threads >= 1 && n_threads <= 4,
+      "Received on %u threads with 4 shards", n_threads);
+}
+GST_END_TEST;
+
+/* It reports the receive rate, and with enough senders the kernel is all
+ * but certain to hash the flows to more than one shard */
+
+#define SHARD_SENDERS 16
+
+GST_START_TEST (test_rawudptransmitter_receive_shards_benchmark)
+{
+  guint n_threads, received;
+
+  run_receive_shards (1, SHARD_SENDERS, &n_threads, &received);
+  ts_fail_if (received == 0, "Did not receive anything without shards");
+
+  run_receive_shards (4, SHARD_SENDERS, &n_threads, &received);
+  ts_fail_if (received == 0, "Did not receive anything with shards");
+#ifdef SO_REUSEPORT
+  ts_fail_unless (n_threads > 1 && n_threads <= 4,
+      "Received on %u threads with 4 shards", n_threads);
 #endif
+}
+GST_END_TEST;
 
-  tc_chain = tcase_create ("rawudptransmitter-sending-half");
-  tcase_add_test (tc_chain, test_rawudptransmitter_sending_half);
-  suite_add_tcase (s, tc_chain);
+/*
+ * Receive pools: a few senders flood the RTP port, with and without the
+ * receive pools. The memory allocations are counted by a default allocator
+ * that wraps the system one, and the benchmark also reports how much the
+ * resident set grew.
+ */
 
-  tc_chain = tcase_create ("rawudptransmitter-stunalternd");
-  tcase_set_timeout (tc_chain, 5);
-  tcase_add_checked_fixture (tc_chain, setup_stund_stunalternd,
-      teardown_stund_stunalternd);
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_stunalternd);
-  suite_add_tcase (s, tc_chain);
+#define POOL_SENDERS 4
 
-  tc_chain = tcase_create ("rawudptransmitter-stunalternd-to-nowhere");
-  tcase_set_timeout (tc_chain, 20);
-  tcase_add_checked_fixture (tc_chain, setup_stunalternd_valid,
-      teardown_stunalternd);
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_stun_altern_to_nowhere);
-  suite_add_tcase (s, tc_chain);
+typedef struct {
+  GstAllocator parent;
+  GstAllocator *sysmem;
+} CountingAllocator;
 
-  tc_chain = tcase_create ("rawudptransmitter-stunalternd-loop");
-  tcase_set_timeout (tc_chain, 20);
-  tcase_add_checked_fixture (tc_chain, setup_stunalternd_loop,
-      teardown_stunalternd);
-  tcase_add_test (tc_chain, test_rawudptransmitter_run_stun_altern_to_nowhere);
-  suite_add_tcase (s, tc_chain);
+typedef GstAllocatorClass CountingAllocatorClass;
 
-  tc_chain = tcase_create ("rawudptransmitter-strange-arguments");
-  tcase_add_test (tc_chain, test_rawudptransmitter_strange_arguments);
-  suite_add_tcase (s, tc_chain);
+static volatile gint counted_allocations = 0;
+
+static GType counting_allocator_get_type (void);
+
+G_DEFINE_TYPE (CountingAllocator, counting_allocator, GST_TYPE_ALLOCATOR);
+
+static GstMemory *
+counting_allocator_alloc (GstAllocator *allocator, gsize size,
+    GstAllocationParams *params)
+{
+  CountingAllocator *self = (CountingAllocator *) allocator;
+
+  g_atomic_int_inc (&counted_allocations);
+
+  /* The memory belongs to the system allocator, which also frees it */
+  return gst_allocator_alloc (self->sysmem, size, params);
+}
+
+static void
+counting_allocator_free (GstAllocator *allocator, GstMemory *memory)
+{
+  g_assert_not_reached ();
+}
+
+static void
+counting_allocator_finalize (GObject *object)
+{
+  CountingAllocator *self = (CountingAllocator *) object;
+
+  gst_object_unref (self->sysmem);
+
+  G_OBJECT_CLASS (counting_allocator_parent_class)->finalize (object);
+}
+
+static void
+counting_allocator_class_init (CountingAllocatorClass *klass)
+{
+  G_OBJECT_CLASS (klass)->finalize = counting_allocator_finalize;
+  klass->alloc = counting_allocator_alloc;
+  klass->free = counting_allocator_free;
+}
+
+static void
+counting_allocator_init (CountingAllocator *self)
+{
+  self->sysmem = gst_allocator_find (GST_ALLOCATOR_SYSMEM);
+}
+
+static gsize
+get_resident_size (void)
+{
+  gchar *contents;
+  gulong size, resident = 0;
+
+  if (g_file_get_contents ("/proc/self/statm", &contents, NULL, NULL))
+  {
+    if (sscanf (contents, "%lu %lu", &size, &resident) != 2)
+      resident = 0;
+    g_free (contents);
+  }
+
+  return resident * sysconf (_SC_PAGESIZE);
+}
+
+static void
+run_receive_pool (guint receive_mtu, guint receive_threads,
+    guint n_senders, guint *allocations, guint *received)
+{
+  LoopbackStream ls;
+  guint n_threads;
+  gint start_allocations;
+  gsize start_rss;
+  gint64 elapsed;
+
+  flood_reset ();
+
+  loopback_stream_start (&ls, RAWUDP_TRANSMITTER, RTP_PORT, FALSE,
+      G_CALLBACK (_flood_handoff), "receive-threads", receive_threads,
+      "receive-mtu", receive_mtu, NULL);
+
+  start_allocations = g_atomic_int_get (&counted_allocations);
+  start_rss = get_resident_size ();
+
+  elapsed = flood_rtp_port (&ls, n_senders, &n_threads, received);
+  *allocations = g_atomic_int_get (&counted_allocations) - start_allocations;
+
+  GST_INFO ("MTU %u, %u receive threads: received %u/%u packets with %u"
+      " allocations (%" G_GINT64_FORMAT " allocations/s), the resident set"
+      " grew by %" G_GSSIZE_FORMAT " bytes", receive_mtu, receive_threads,
+      *received, n_senders * FLOOD_PACKETS_PER_SENDER, *allocations,
+      (gint64) *allocations * G_USEC_PER_SEC / MAX (elapsed, 1),
+      (gssize) (get_resident_size () - start_rss));
+
+  loopback_stream_stop (&ls);
+}
+
+static void
+set_counting_allocator (gboolean counting)
+{
+  if (counting)
+    gst_allocator_set_default (
+        gst_object_ref_sink (g_object_new (counting_allocator_get_type (),
+                NULL)));
+  else
+    gst_allocator_set_default (gst_allocator_find (GST_ALLOCATOR_SYSMEM));
+}
+
+GST_START_TEST (test_rawudptransmitter_receive_pool)
+{
+  guint allocations, received;
+
+  set_counting_allocator (TRUE);
+
+  /* The pools are only used by fsmultiudpsrc, without them every packet
+   * gets its own memory */
+  run_receive_pool (0, 1, 1, &allocations, &received);
+  ts_fail_if (received == 0, "Did not receive anything without a pool");
+  ts_fail_unless (allocations >= received,
+      "Only %u allocations for %u packets without a pool", allocations,
+      received);
+
+  run_receive_pool (1500, 1, 1, &allocations, &received);
+  ts_fail_if (received == 0, "Did not receive anything with a pool");
+
+  /* The packets are bigger than the buffers of the pool, they must still
+   * get through */
+  run_receive_pool (100, 1, 1, &allocations, &received);
+  ts_fail_if (received == 0, "Did not receive the packets bigger than the"
+      " receive-mtu");
+
+  set_counting_allocator (FALSE);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_receive_pool_benchmark)
+{
+  guint allocations, pooled_allocations, received;
+
+  set_counting_allocator (TRUE);
+
+  run_receive_pool (0, 1, POOL_SENDERS, &allocations, &received);
+  ts_fail_if (received == 0, "Did not receive anything without a pool");
+
+  run_receive_pool (1500, 1, POOL_SENDERS, &pooled_allocations, &received);
+  ts_fail_if (received == 0, "Did not receive anything with a pool");
+  ts_fail_unless (pooled_allocations * 10 < received,
+      "%u allocations for %u packets with a pool", pooled_allocations,
+      received);
+
+  set_counting_allocator (FALSE);
+}
+GST_END_TEST;
+
+/*
+ * Server mode: hundreds of stream transmitters share one local port with
+ * RTCP-mux. Every participant sends one RTP and one RTCP packet, each one
+ * must be reported by its own stream transmitter only. It reports the file
+ * descriptors, threads and CPU time used.
+ */
+
+#define SERVER_PARTICIPANTS 300
+#define SERVER_PORT 9878
+
+static volatile gint server_known[SERVER_PARTICIPANTS][2];
+static volatile gint server_received[2];
+static guint server_ports[2];
+
+static void
+_server_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  g_atomic_int_inc (&server_received[GPOINTER_TO_INT (user_data) - 1]);
+}
+
+static void
+_server_known_source_packet_received (FsStreamTransmitter *st,
+    guint component_id, GstBuffer *buffer, gpointer user_data)
+{
+  g_atomic_int_inc (
+      &server_known[GPOINTER_TO_INT (user_data)][component_id - 1]);
+}
+
+static void
+_server_new_local_candidate (FsStreamTransmitter *st, FsCandidate *candidate,
+  gpointer user_data)
+{
+  server_ports[candidate->component_id - 1] = candidate->port;
+}
+
+GST_START_TEST (test_rawudptransmitter_server_mode)
+{
+  GError *error = NULL;
+  FsTransmitter *trans;
+  FsStreamTransmitter *st[SERVER_PARTICIPANTS];
+  GSocket *senders[SERVER_PARTICIPANTS];
+  GParameter params[3];
+  GList *list = NULL;
+  GInetAddress *loopback;
+  GSocketAddress *server_addr;
+  guint fds_before, threads_before;
+  guint fds_after, threads_after;
+  clock_t cpu_start, cpu_end;
+  gint64 start;
+  guint8 rtp_packet[172], rtcp_packet[28];
+  guint i;
+
+  memset (params, 0, sizeof (GParameter) * 3);
+  memset ((gpointer) server_known, 0, sizeof (server_known));
+  server_received[0] = server_received[1] = 0;
+  server_ports[0] = server_ports[1] = 0;
+
+  list = g_list_prepend (list, fs_candidate_new ("L1",
+          FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST,
+          FS_NETWORK_PROTOCOL_UDP, "127.0.0.1", SERVER_PORT));
+
+  params[0].name = "preferred-local-candidates";
+  g_value_init (&params[0].value, FS_TYPE_CANDIDATE_LIST);
+  g_value_set_boxed (&params[0].value, list);
+
+  params[1].name = "upnp-discovery";
+  g_value_init (&params[1].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[1].value, FALSE);
+
+  params[2].name = "rtcp-mux";
+  g_value_init (&params[2].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[2].value, TRUE);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  trans = fs_transmitter_new (RAWUDP_TRANSMITTER, 2, 0, &error);
+  if (error)
+    ts_fail ("Error creating transmitter: (%s:%d) %s",
+        g_quark_to_string (error->domain), error->code, error->message);
+
+  pipeline = setup_pipeline (trans, G_CALLBACK (_server_handoff));
+
+  ts_fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+    GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  fds_before = count_fds ();
+  threads_before = count_threads ();
+
+  for (i = 0; i < SERVER_PARTICIPANTS; i++)
+  {
+    st[i] = fs_transmitter_new_stream_transmitter (trans, NULL, 3, params,
+        &error);
+    if (error)
+      ts_fail ("Error creating stream transmitter %u: (%s:%d) %s", i,
+          g_quark_to_string (error->domain), error->code, error->message);
+
+    g_signal_connect (st[i], "known-source-packet-received",
+        G_CALLBACK (_server_known_source_packet_received),
+        GUINT_TO_POINTER (i));
+    g_signal_connect (st[i], "error",
+        G_CALLBACK (stream_transmitter_error), NULL);
+  }
+
+  g_signal_connect (st[0], "new-local-candidate",
+      G_CALLBACK (_server_new_local_candidate), NULL);
+  g_signal_connect (st[0], "local-candidates-prepared",
+      G_CALLBACK (_local_candidates_prepared_quit), NULL);
+  ts_fail_unless (fs_stream_transmitter_gather_local_candidates (st[0],
+          &error), "Could not start gathering local candidates");
+  g_main_loop_run (loop);
+  ts_fail_if (server_ports[0] == 0, "Did not get the local port");
+  ts_fail_unless (server_ports[0] == server_ports[1],
+      "The RTCP candidate is on port %u instead of the RTP port %u",
+      server_ports[1], server_ports[0]);
+
+  fds_after = count_fds ();
+  threads_after = count_threads ();
+
+  GST_INFO ("%d participants on port %u use %d fds and %d threads",
+      SERVER_PARTICIPANTS, server_ports[0], fds_after - fds_before,
+      threads_after - threads_before);
+
+  /* One socket, with the cancellable of its udpsrc */
+  ts_fail_unless (fds_after - fds_before <= 4,
+      "%d participants use %d fds", SERVER_PARTICIPANTS,
+      fds_after - fds_before);
+  ts_fail_unless (threads_after - threads_before <= 2,
+      "%d participants use %d threads", SERVER_PARTICIPANTS,
+      threads_after - threads_before);
+
+  loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  server_addr = g_inet_socket_address_new (loopback, server_ports[0]);
+
+  for (i = 0; i < SERVER_PARTICIPANTS; i++)
+  {
+    GSocketAddress *addr;
+    FsCandidate *candidate;
+    GList *remote;
+
+    senders[i] = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+        G_SOCKET_PROTOCOL_UDP, NULL);
+    ts_fail_unless (senders[i] != NULL, "Could not create a sender socket");
+
+    addr = g_inet_socket_address_new (loopback, 0);
+    ts_fail_unless (g_socket_bind (senders[i], addr, FALSE, NULL),
+        "Could not bind a sender socket");
+    g_object_unref (addr);
+
+    addr = g_socket_get_local_address (senders[i], NULL);
+    candidate = fs_candidate_new ("R1", FS_COMPONENT_RTP,
+        FS_CANDIDATE_TYPE_HOST, FS_NETWORK_PROTOCOL_UDP, "127.0.0.1",
+        g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (addr)));
+    g_object_unref (addr);
+
+    /* Only the RTP candidate, the RTCP one follows it with RTCP-mux */
+    remote = g_list_prepend (NULL, candidate);
+    ts_fail_unless (fs_stream_transmitter_force_remote_candidates (st[i],
+            remote, &error), "Could not set the remote candidate");
+    fs_candidate_list_destroy (remote);
+  }
+
+  memset (rtp_packet, 0, sizeof (rtp_packet));
+  rtp_packet[0] = 0x80;
+  rtp_packet[1] = 96;
+  memset (rtcp_packet, 0, sizeof (rtcp_packet));
+  rtcp_packet[0] = 0x80;
+  rtcp_packet[1] = 200;
+
+  cpu_start = clock ();
+
+  for (i = 0; i < SERVER_PARTICIPANTS; i++)
+  {
+    g_socket_send_to (senders[i], server_addr, (gchar *) rtp_packet,
+        sizeof (rtp_packet), NULL, NULL);
+    g_socket_send_to (senders[i], server_addr, (gchar *) rtcp_packet,
+        sizeof (rtcp_packet), NULL, NULL);
+    if (i % 20 == 19)
+      g_usleep (1000);
+  }
+
+  start = g_get_monotonic_time ();
+  while ((g_atomic_int_get (&server_received[0]) < SERVER_PARTICIPANTS ||
+          g_atomic_int_get (&server_received[1]) < SERVER_PARTICIPANTS) &&
+      g_get_monotonic_time () - start < 5 * G_USEC_PER_SEC)
+    g_usleep (G_USEC_PER_SEC / 100);
+
+  cpu_end = clock ();
+
+  GST_INFO ("Received %d RTP and %d RTCP packets, %ld us of CPU per packet",
+      server_received[0], server_received[1],
+      (long) ((cpu_end - cpu_start) * G_USEC_PER_SEC / CLOCKS_PER_SEC /
+          MAX (server_received[0] + server_received[1], 1)));
+
+  ts_fail_unless (server_received[0] == SERVER_PARTICIPANTS &&
+      server_received[1] == SERVER_PARTICIPANTS,
+      "Received %d RTP and %d RTCP packets instead of %d each",
+      server_received[0], server_received[1], SERVER_PARTICIPANTS);
+
+  for (i = 0; i < SERVER_PARTICIPANTS; i++)
+    ts_fail_unless (server_known[i][0] == 1 && server_known[i][1] == 1,
+        "Participant %u got %d RTP and %d RTCP known source packets", i,
+        server_known[i][0], server_known[i][1]);
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  for (i = 0; i < SERVER_PARTICIPANTS; i++)
+  {
+    fs_stream_transmitter_stop (st[i]);
+    g_object_unref (st[i]);
+    g_socket_close (senders[i], NULL);
+    g_object_unref (senders[i]);
+  }
+
+  g_object_unref (server_addr);
+  g_object_unref (loopback);
+  g_object_unref (trans);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+
+  g_value_reset (&params[0].value);
+  fs_candidate_list_destroy (list);
+}
+GST_END_TEST;
+
+/*
+ * Many ports: hundreds of local ports (both components of many stream
+ * transmitters), of which only the RTP ports of a few streams get traffic.
+ * With the shared epoll receive source, they do not need a thread each. The
+ * benchmark compares it with one udpsrc thread per port, reporting the
+ * threads, file descriptors and CPU time used.
+ */
+
+#define MANY_PORTS_STREAMS 500
+#define MANY_PORTS_HOT_STREAMS 4
+#define MANY_PORTS_PACKETS_PER_HOT_STREAM 1000
+#define MANY_PORTS_BASE_PORT 20000
+
+static volatile gint many_ports_received = 0;
+static guint many_ports_hot_ports[MANY_PORTS_HOT_STREAMS];
+
+static void
+_many_ports_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  if (GPOINTER_TO_INT (user_data) == FS_COMPONENT_RTP)
+    g_atomic_int_inc (&many_ports_received);
+}
+
+static void
+_many_ports_new_local_candidate (FsStreamTransmitter *st,
+    FsCandidate *candidate, gpointer user_data)
+{
+  if (candidate->component_id == FS_COMPONENT_RTP)
+    many_ports_hot_ports[GPOINTER_TO_UINT (user_data)] = candidate->port;
+}
+
+static void
+run_many_ports (guint receive_threads, guint n_streams,
+    guint packets_per_hot_stream, guint *n_threads, guint *received)
+{
+  GError *error = NULL;
+  FsTransmitter *trans;
+  FsStreamTransmitter **st = g_new (FsStreamTransmitter *, n_streams);
+  GParameter params[3];
+  GSocket *sender;
+  GInetAddress *loopback;
+  GSocketAddress *dests[MANY_PORTS_HOT_STREAMS];
+  guint fds_before, threads_before;
+  guint fds_after, threads_after;
+  clock_t cpu_start, cpu_end;
+  gint64 start, elapsed;
+  gchar packet[160];
+  guint i;
+
+  memset (params, 0, sizeof (GParameter) * 3);
+  many_ports_received = 0;
+  memset (many_ports_hot_ports, 0, sizeof (many_ports_hot_ports));
+
+  params[0].name = "preferred-local-candidates";
+  g_value_init (&params[0].value, FS_TYPE_CANDIDATE_LIST);
+
+  params[1].name = "upnp-discovery";
+  g_value_init (&params[1].value, G_TYPE_BOOLEAN);
+  g_value_set_boolean (&params[1].value, FALSE);
+
+  params[2].name = "receive-threads";
+  g_value_init (&params[2].value, G_TYPE_UINT);
+  g_value_set_uint (&params[2].value, receive_threads);
+
+  loop = g_main_loop_new (NULL, FALSE);
+  trans = fs_transmitter_new (RAWUDP_TRANSMITTER, 2, 0, &error);
+  if (error)
+    ts_fail ("Error creating transmitter: (%s:%d) %s",
+        g_quark_to_string (error->domain), error->code, error->message);
+
+  pipeline = setup_pipeline (trans, G_CALLBACK (_many_ports_handoff));
+
+  ts_fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+    GST_STATE_CHANGE_FAILURE, "Could not set the pipeline to playing");
+
+  fds_before = count_fds ();
+  threads_before = count_threads ();
+
+  for (i = 0; i < n_streams; i++)
+  {
+    GList *list;
+
+    /* A different port for each stream, otherwise they would share one */
+    list = g_list_prepend (NULL, fs_candidate_new ("L1",
+            FS_COMPONENT_RTP, FS_CANDIDATE_TYPE_HOST,
+            FS_NETWORK_PROTOCOL_UDP, "127.0.0.1",
+            MANY_PORTS_BASE_PORT + 2 * i));
+    g_value_take_boxed (&params[0].value, list);
+
+    st[i] = fs_transmitter_new_stream_transmitter (trans, NULL, 3, params,
+        &error);
+    if (error)
+      ts_fail ("Error creating stream transmitter %u: (%s:%d) %s", i,
+          g_quark_to_string (error->domain), error->code, error->message);
+
+    g_signal_connect (st[i], "error",
+        G_CALLBACK (stream_transmitter_error), NULL);
+  }
+
+  fds_after = count_fds ();
+  threads_after = count_threads ();
+  *n_threads = threads_after - threads_before;
+
+  for (i = 0; i < MANY_PORTS_HOT_STREAMS; i++)
+  {
+    g_signal_connect (st[i], "new-local-candidate",
+        G_CALLBACK (_many_ports_new_local_candidate), GUINT_TO_POINTER (i));
+    g_signal_connect (st[i], "local-candidates-prepared",
+        G_CALLBACK (_local_candidates_prepared_quit), NULL);
+    ts_fail_unless (fs_stream_transmitter_gather_local_candidates (st[i],
+            &error), "Could not start gathering local candidates");
+    g_main_loop_run (loop);
+    ts_fail_if (many_ports_hot_ports[i] == 0,
+        "Did not get the local port of stream %u", i);
+  }
+
+  sender = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  ts_fail_unless (sender != NULL, "Could not create the sender socket");
+
+  loopback = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  for (i = 0; i < MANY_PORTS_HOT_STREAMS; i++)
+    dests[i] = g_inet_socket_address_new (loopback, many_ports_hot_ports[i]);
+  g_object_unref (loopback);
+
+  memset (packet, 0, sizeof (packet));
+  /* RTP version 2, so the STUN probe lets it through */
+  packet[0] = 0x80;
+
+  cpu_start = clock ();
+  start = g_get_monotonic_time ();
+
+  for (i = 0; i < MANY_PORTS_HOT_STREAMS * packets_per_hot_stream; i++)
+  {
+    g_socket_send_to (sender, dests[i % MANY_PORTS_HOT_STREAMS], packet,
+        sizeof (packet), NULL, NULL);
+    /* Pace a little so the loopback does not just overflow */
+    if (i % 50 == 49)
+      g_usleep (1000);
+  }
+
+  while (g_atomic_int_get (&many_ports_received) <
+      MANY_PORTS_HOT_STREAMS * packets_per_hot_stream &&
+      g_get_monotonic_time () - start < 5 * G_USEC_PER_SEC)
+    g_usleep (G_USEC_PER_SEC / 100);
+
+  elapsed = g_get_monotonic_time () - start;
+  cpu_end = clock ();
+  *received = g_atomic_int_get (&many_ports_received);
+
+  GST_INFO ("%u receive threads: %u ports use %u fds and %u threads,"
+      " received %u/%u packets in %" G_GINT64_FORMAT " us with %ld us of"
+      " CPU per packet", receive_threads, n_streams * 2,
+      fds_after - fds_before, *n_threads, *received,
+      MANY_PORTS_HOT_STREAMS * packets_per_hot_stream, elapsed,
+      (long) ((cpu_end - cpu_start) * G_USEC_PER_SEC / CLOCKS_PER_SEC /
+          MAX (*received, 1)));
+
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+
+  for (i = 0; i < n_streams; i++)
+  {
+    fs_stream_transmitter_stop (st[i]);
+    g_object_unref (st[i]);
+  }
+  g_free (st);
+
+  for (i = 0; i < MANY_PORTS_HOT_STREAMS; i++)
+    g_object_unref (dests[i]);
+  g_socket_close (sender, NULL);
+  g_object_unref (sender);
+  g_object_unref (trans);
+  gst_object_unref (pipeline);
+  g_main_loop_unref (loop);
+
+  g_value_unset (&params[0].value);
+}
+
+/* Few enough ports to stay within the default file descriptor limit */
+#define FEW_PORTS_STREAMS 32
+
+GST_START_TEST (test_rawudptransmitter_many_ports)
+{
+  guint n_threads, received;
+
+  run_many_ports (2, FEW_PORTS_STREAMS, 10, &n_threads, &received);
+  ts_fail_unless (received == MANY_PORTS_HOT_STREAMS * 10,
+      "Received %u packets with the shared receive source", received);
+  ts_fail_unless (n_threads <= 2,
+      "%d ports use %u threads with 2 shared receive threads",
+      FEW_PORTS_STREAMS * 2, n_threads);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_many_ports_benchmark)
+{
+  struct rlimit rl;
+  guint n_threads, received;
+
+  /* A thousand sockets, plus the fds of the udpsrcs */
+  ts_fail_unless (getrlimit (RLIMIT_NOFILE, &rl) == 0,
+      "Could not get the file descriptor limit");
+  if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < 4 * MANY_PORTS_STREAMS +
+      256)
+  {
+    GST_WARNING ("The file descriptor limit (%lu) is too low for the many"
+        " ports benchmark", (gulong) rl.rlim_max);
+    return;
+  }
+  rl.rlim_cur = rl.rlim_max;
+  ts_fail_unless (setrlimit (RLIMIT_NOFILE, &rl) == 0,
+      "Could not raise the file descriptor limit");
+
+  run_many_ports (0, MANY_PORTS_STREAMS, MANY_PORTS_PACKETS_PER_HOT_STREAM,
+      &n_threads, &received);
+  ts_fail_unless (received ==
+      MANY_PORTS_HOT_STREAMS * MANY_PORTS_PACKETS_PER_HOT_STREAM,
+      "Received %u packets with one udpsrc per port", received);
+
+  run_many_ports (2, MANY_PORTS_STREAMS, MANY_PORTS_PACKETS_PER_HOT_STREAM,
+      &n_threads, &received);
+  ts_fail_unless (received ==
+      MANY_PORTS_HOT_STREAMS * MANY_PORTS_PACKETS_PER_HOT_STREAM,
+      "Received %u packets with the shared receive source", received);
+  ts_fail_unless (n_threads <= 2,
+      "%d ports use %u threads with 2 shared receive threads",
+      MANY_PORTS_STREAMS * 2, n_threads);
+}
+GST_END_TEST;
+
+/*
+ * Direct sending: a stream sends to itself over the loopback, single
+ * buffers are pushed into the transmitter sink. The port has a single
+ * destination, so with connect-single-destination its socket is connected
+ * once the first packet came back, and the packets skip the multiudpsink.
+ * The bytes the multiudpsink served tell which path was taken. The
+ * benchmark reports the CPU time the pushing thread spends per packet.
+ */
+
+#define DIRECT_PACKETS 20000
+#define DIRECT_PACKET_SIZE 200
+/* Stay well below what fits in the socket buffer */
+#define DIRECT_MAX_IN_FLIGHT 64
+
+static gint64
+get_thread_cpu_time (void)
+{
+  struct timespec ts;
+
+  ts_fail_unless (clock_gettime (CLOCK_THREAD_CPUTIME_ID, &ts) == 0,
+      "Could not get the CPU time of the thread");
+
+  return (gint64) ts.tv_sec * G_GINT64_CONSTANT (1000000000) + ts.tv_nsec;
+}
+
+/* Waits until the number of packets counted by @counter reaches @count */
+static void
+wait_for_packets (volatile gint *counter, gint count, gint64 timeout)
+{
+  gint64 start = g_get_monotonic_time ();
+
+  while (g_atomic_int_get (counter) < count &&
+      g_get_monotonic_time () - start < timeout)
+    g_usleep (G_USEC_PER_SEC / 100);
+}
+
+/* The uring transmitter always sends through fsuringudpsink, it neither
+ * connects its sockets nor paces the packets */
+#ifndef TEST_URING_TRANSMITTER
+
+static GstBuffer *
+_direct_new_buffer (void)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+
+  buffer = gst_buffer_new_allocate (NULL, DIRECT_PACKET_SIZE, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+  /* RTP version 2, so the STUN probe lets it through */
+  map.data[0] = 0x80;
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+static volatile gint direct_received = 0;
+
+static void
+_direct_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  if (GPOINTER_TO_INT (user_data) == FS_COMPONENT_RTP)
+    g_atomic_int_inc (&direct_received);
+}
+
+/* A packet from another port only arrives if the socket is not connected
+ * to its destination */
+static void
+send_from_another_port (guint port, gboolean connected)
+{
+  GSocket *foreign;
+  GInetAddress *inetaddr;
+  GSocketAddress *addr;
+  GstMapInfo map;
+  GstBuffer *buffer = _direct_new_buffer ();
+  gint before = g_atomic_int_get (&direct_received);
+
+  foreign = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  ts_fail_if (foreign == NULL, "Could not create a socket");
+  inetaddr = g_inet_address_new_from_string ("127.0.0.1");
+  addr = g_inet_socket_address_new (inetaddr, port);
+  gst_buffer_map (buffer, &map, GST_MAP_READ);
+  ts_fail_unless (g_socket_send_to (foreign, addr, (gchar *) map.data,
+          map.size, NULL, NULL) == (gssize) map.size,
+      "Could not send from another port");
+  gst_buffer_unmap (buffer, &map);
+  gst_buffer_unref (buffer);
+
+  wait_for_packets (&direct_received, before + 1,
+      connected ? G_USEC_PER_SEC / 5 : G_USEC_PER_SEC);
+  ts_fail_unless ((g_atomic_int_get (&direct_received) == before) ==
+      connected, "A packet from another port %s",
+      connected ? "arrived on a connected socket" : "did not arrive");
+
+  g_object_unref (addr);
+  g_object_unref (inetaddr);
+  g_object_unref (foreign);
+}
+
+/* Returns how many bytes went through the multiudpsinks */
+static guint64
+get_udpsink_bytes_served (FsTransmitter *trans)
+{
+  GstElement *trans_sink;
+  GstIterator *iter;
+  GValue item = G_VALUE_INIT;
+  guint64 total = 0;
+
+  g_object_get (trans, "gst-sink", &trans_sink, NULL);
+  iter = gst_bin_iterate_recurse (GST_BIN (trans_sink));
+  while (gst_iterator_next (iter, &item) == GST_ITERATOR_OK)
+  {
+    GstElement *element = g_value_get_object (&item);
+    GstElementFactory *factory = gst_element_get_factory (element);
+
+    if (factory && !strcmp (GST_OBJECT_NAME (factory), "multiudpsink"))
+    {
+      guint64 served;
+
+      g_object_get (element, "bytes-served", &served, NULL);
+      total += served;
+    }
+    g_value_reset (&item);
+  }
+  g_value_unset (&item);
+  gst_iterator_free (iter);
+  gst_object_unref (trans_sink);
+
+  return total;
+}
+
+static void
+run_direct_send (guint receive_threads, gboolean connect, guint packets,
+    guint *received, gint64 *ns_per_packet, gboolean *connected)
+{
+  LoopbackStream ls;
+  gint64 cpu_time = 0;
+  guint64 served;
+  guint sent;
+
+  direct_received = 0;
+
+  loopback_stream_start (&ls, RAWUDP_TRANSMITTER, 0, TRUE,
+      G_CALLBACK (_direct_handoff), "receive-threads", receive_threads,
+      "connect-single-destination", connect, NULL);
+
+  /* Wait for the first packet so the loop below only times the steady state */
+  ts_fail_unless (gst_pad_push (ls.srcpad, _direct_new_buffer ()) ==
+      GST_FLOW_OK, "Could not push a buffer into the transmitter");
+  wait_for_packets (&direct_received, 1, G_USEC_PER_SEC);
+  ts_fail_if (g_atomic_int_get (&direct_received) == 0,
+      "The first packet did not come back");
+
+  for (sent = 1; sent <= packets; sent++)
+  {
+    GstBuffer *buffer = _direct_new_buffer ();
+    gint64 stall_start, cpu_start;
+
+    cpu_start = get_thread_cpu_time ();
+    ts_fail_unless (gst_pad_push (ls.srcpad, buffer) == GST_FLOW_OK,
+        "Could not push a buffer into the transmitter");
+    cpu_time += get_thread_cpu_time () - cpu_start;
+
+    stall_start = g_get_monotonic_time ();
+    /* The first packet is counted too */
+    while ((gint) sent + 1 - g_atomic_int_get (&direct_received) >
+        DIRECT_MAX_IN_FLIGHT &&
+        g_get_monotonic_time () - stall_start < G_USEC_PER_SEC)
+      g_usleep (50);
+  }
+
+  wait_for_packets (&direct_received, packets + 1, 10 * G_USEC_PER_SEC);
+
+  /* Do not count the first packet */
+  *received = g_atomic_int_get (&direct_received) - 1;
+  *ns_per_packet = cpu_time / packets;
+
+  /* Only the first packet, sent before a packet came back, may have gone
+   * through the multiudpsink if the socket got connected */
+  served = get_udpsink_bytes_served (ls.trans);
+  *connected = served < 2 * DIRECT_PACKET_SIZE;
+  if (!*connected)
+    ts_fail_unless (served >= (guint64) packets * DIRECT_PACKET_SIZE,
+        "Only %" G_GUINT64_FORMAT " bytes went through the multiudpsink",
+        served);
+
+  GST_INFO ("%u receive threads, %sconnected: looped back %u/%u packets,"
+      " sending took %" G_GINT64_FORMAT " ns of CPU per packet",
+      receive_threads, *connected ? "" : "not ", *received, packets,
+      *ns_per_packet);
+
+  send_from_another_port (ls.rtp_port, *connected);
+
+  loopback_stream_stop (&ls);
+}
+
+GST_START_TEST (test_rawudptransmitter_direct_send)
+{
+  guint received;
+  gint64 ns;
+  gboolean connected;
+
+  /* By default, everything goes through the multiudpsink */
+  run_direct_send (1, FALSE, 100, &received, &ns, &connected);
+  ts_fail_unless (received == 100,
+      "Only %u packets came back to the fsmultiudpsrc", received);
+  ts_fail_if (connected, "The socket was connected without asking");
+
+  run_direct_send (1, TRUE, 100, &received, &ns, &connected);
+  ts_fail_unless (received == 100,
+      "Only %u packets came back to the connected socket", received);
+  ts_fail_unless (connected, "The packets did not skip the multiudpsink");
+
+  /* udpsrc would post the ICMP errors of a connected socket */
+  run_direct_send (0, TRUE, 100, &received, &ns, &connected);
+  ts_fail_unless (received == 100,
+      "Only %u packets came back to the udpsrc", received);
+  ts_fail_if (connected, "A socket read by udpsrc was connected");
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_direct_send_benchmark)
+{
+  guint received;
+  gint64 udpsink_ns, connected_ns;
+  gboolean connected;
+
+  run_direct_send (1, FALSE, DIRECT_PACKETS, &received, &udpsink_ns,
+      &connected);
+  ts_fail_unless (received > DIRECT_PACKETS / 2,
+      "Only %u packets came back through the multiudpsink", received);
+
+  run_direct_send (1, TRUE, DIRECT_PACKETS, &received, &connected_ns,
+      &connected);
+  ts_fail_unless (received > DIRECT_PACKETS / 2,
+      "Only %u packets came back through the connected socket", received);
+  ts_fail_unless (connected, "The packets did not skip the multiudpsink");
+
+  GST_INFO ("Sending costs %" G_GINT64_FORMAT " ns per packet through the"
+      " multiudpsink and %" G_GINT64_FORMAT " ns through the connected"
+      " socket", udpsink_ns, connected_ns);
+}
+GST_END_TEST;
+
+/*
+ * Paced sending: a stream sends to itself over the loopback, the packets
+ * are meant to leave one millisecond apart. They are either held back by
+ * clock waits in the pushing thread, like the TFRC packet modder does, or
+ * all pushed at once with a FsSendTimeMeta and paced by the transmitter.
+ * The benchmark reports how far the gaps between the arrivals are from the
+ * interval, and the CPU time of the whole process.
+ */
+
+#define PACED_PACKETS 500
+#define PACED_INTERVAL GST_MSECOND
+
+typedef enum {
+  PACED_BY_CLOCK_WAITS,
+  PACED_BY_THREAD,
+  PACED_BY_KERNEL
+} PacedMode;
+
+static const gchar *paced_mode_names[] = {
+  "clock waits", "the pacer thread", "the kernel"
+};
+
+static volatile gint paced_received = 0;
+/* Only written from the streaming thread of the RTP fakesink */
+static gint64 paced_arrivals[PACED_PACKETS];
+
+static void
+_paced_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  gint i;
+
+  if (GPOINTER_TO_INT (user_data) != FS_COMPONENT_RTP)
+    return;
+
+  i = g_atomic_int_add (&paced_received, 1);
+  if (i < PACED_PACKETS)
+    paced_arrivals[i] = g_get_monotonic_time ();
+}
+
+static void
+run_paced_send (PacedMode mode, guint packets, guint *received, gint64 *span,
+    gint64 *avg_error)
+{
+  LoopbackStream ls;
+  GstQuery *query;
+  GstClock *pipeline_clock;
+  GstClockTime base_time, first;
+  gboolean paced = FALSE;
+  gint64 error_sum = 0;
+  clock_t cpu_start, cpu_end;
+  guint i;
+
+  g_assert (packets <= PACED_PACKETS);
+  paced_received = 0;
+
+  loopback_stream_start (&ls, RAWUDP_TRANSMITTER, 0, TRUE,
+      G_CALLBACK (_paced_handoff), NULL, 0,
+      "paced-sending", mode != PACED_BY_CLOCK_WAITS,
+      "kernel-pacing", mode == PACED_BY_KERNEL,
+      NULL);
+
+  /* This is how the TFRC packet modder finds out */
+  query = fs_send_time_query_new ();
+  ts_fail_unless (gst_pad_peer_query (ls.srcpad, query) ==
+      (mode != PACED_BY_CLOCK_WAITS),
+      "The send time query was %sanswered",
+      mode != PACED_BY_CLOCK_WAITS ? "not " : "");
+  ts_fail_unless (fs_send_time_query_parse (query, &paced),
+      "The send time query was not recognized");
+  gst_query_unref (query);
+  ts_fail_unless (paced == (mode != PACED_BY_CLOCK_WAITS),
+      "The transmitter said the packets are %spaced", paced ? "" : "not ");
+
+  pipeline_clock = gst_element_get_clock (pipeline);
+  ts_fail_if (pipeline_clock == NULL, "The pipeline has no clock");
+  base_time = gst_element_get_base_time (pipeline);
+  first = gst_clock_get_time (pipeline_clock) - base_time + 20 * GST_MSECOND;
+
+  cpu_start = clock ();
+
+  for (i = 0; i < packets; i++)
+  {
+    GstBuffer *buffer = _direct_new_buffer ();
+    GstClockTime send_time = first + i * PACED_INTERVAL;
+
+    if (mode == PACED_BY_CLOCK_WAITS)
+    {
+      GstClockID id = gst_clock_new_single_shot_id (pipeline_clock,
+          send_time + base_time);
+
+      gst_clock_id_wait (id, NULL);
+      gst_clock_id_unref (id);
+    }
+    else
+    {
+      fs_buffer_add_send_time_meta (buffer, send_time);
+    }
+
+    ts_fail_unless (gst_pad_push (ls.srcpad, buffer) == GST_FLOW_OK,
+        "Could not push a buffer into the transmitter");
+  }
+
+  wait_for_packets (&paced_received, packets, 10 * G_USEC_PER_SEC);
+
+  cpu_end = clock ();
+  *received = MIN (g_atomic_int_get (&paced_received), packets);
+
+  *span = *received ? paced_arrivals[*received - 1] - paced_arrivals[0] : 0;
+  for (i = 1; i < *received; i++)
+    error_sum += ABS (paced_arrivals[i] - paced_arrivals[i - 1] -
+        (gint64) (PACED_INTERVAL / GST_USECOND));
+  *avg_error = error_sum / MAX ((gint) *received - 1, 1);
+
+  GST_INFO ("Paced by %s: received %u/%u packets over %" G_GINT64_FORMAT
+      " us, the gaps are off by %" G_GINT64_FORMAT " us on average, %ld us"
+      " of CPU were used", paced_mode_names[mode], *received, packets,
+      *span, *avg_error,
+      (long) ((cpu_end - cpu_start) * G_USEC_PER_SEC / CLOCKS_PER_SEC));
+
+  gst_object_unref (pipeline_clock);
+
+  loopback_stream_stop (&ls);
+}
+
+GST_START_TEST (test_rawudptransmitter_paced_send)
+{
+  guint received;
+  gint64 span, avg_error;
+
+  run_paced_send (PACED_BY_CLOCK_WAITS, 20, &received, &span, &avg_error);
+  ts_fail_unless (received == 20,
+      "Received %u packets paced by clock waits", received);
+
+  run_paced_send (PACED_BY_THREAD, 20, &received, &span, &avg_error);
+  ts_fail_unless (received == 20,
+      "Received %u packets paced by the pacer thread", received);
+
+  run_paced_send (PACED_BY_KERNEL, 20, &received, &span, &avg_error);
+  ts_fail_unless (received == 20,
+      "Received %u packets paced by the kernel", received);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_paced_send_benchmark)
+{
+  guint received;
+  gint64 span, avg_error;
+  gint64 min_span = (PACED_PACKETS - 1) * (PACED_INTERVAL / GST_USECOND) *
+      8 / 10;
+
+  run_paced_send (PACED_BY_CLOCK_WAITS, PACED_PACKETS, &received, &span,
+      &avg_error);
+  ts_fail_unless (received == PACED_PACKETS,
+      "Received %u packets paced by clock waits", received);
+
+  run_paced_send (PACED_BY_THREAD, PACED_PACKETS, &received, &span,
+      &avg_error);
+  ts_fail_unless (received == PACED_PACKETS,
+      "Received %u packets paced by the pacer thread", received);
+  ts_fail_unless (span >= min_span,
+      "The packets paced by the pacer thread came within %" G_GINT64_FORMAT
+      " us", span);
+
+  /* Without the fq qdisc on the loopback, the kernel sends right away, so
+   * it is only reported */
+  run_paced_send (PACED_BY_KERNEL, PACED_PACKETS, &received, &span,
+      &avg_error);
+  ts_fail_unless (received == PACED_PACKETS,
+      "Received %u packets paced by the kernel", received);
+}
+GST_END_TEST;
+
+#endif /* !TEST_URING_TRANSMITTER */
+
+/*
+ * Path MTU: a stream sends to itself over the loopback and reads the path
+ * MTU from its stream transmitter. Large video frames are then cut into RTP
+ * packets like a payloader does, with a 1400 bytes MTU or with the MTU of
+ * the loopback. The benchmark reports the packets per second and the CPU
+ * time the pushing thread spends per frame.
+ */
+
+#define PMTU_FRAMES 200
+#define PMTU_FRAME_SIZE (256 * 1024)
+#define PMTU_SMALL_MTU 1400
+#define PMTU_RTP_HEADER_SIZE 12
+/* Stay well below what fits in the socket buffer */
+#define PMTU_MAX_BYTES_IN_FLIGHT (128 * 1024)
+
+static volatile gint pmtu_received_bytes = 0;
+
+static void
+_pmtu_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  if (GPOINTER_TO_INT (user_data) == FS_COMPONENT_RTP)
+    g_atomic_int_add (&pmtu_received_bytes, gst_buffer_get_size (buffer));
+}
+
+static GstBuffer *
+_pmtu_new_packet (gsize payload_size)
+{
+  GstBuffer *buffer;
+  GstMapInfo map;
+
+  buffer = gst_buffer_new_allocate (NULL,
+      PMTU_RTP_HEADER_SIZE + payload_size, NULL);
+  gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+  memset (map.data, 0, map.size);
+  /* RTP version 2, so the STUN probe lets it through */
+  map.data[0] = 0x80;
+  gst_buffer_unmap (buffer, &map);
+
+  return buffer;
+}
+
+/* With a mtu of 0, the packets are as large as the path MTU */
+static void
+run_path_mtu (guint mtu, guint frames, guint *path_mtu,
+    guint *received_frames, gdouble *packets_per_sec, gint64 *ns_per_frame)
+{
+  LoopbackStream ls;
+  gint64 start, elapsed, cpu_time = 0;
+  guint frame, packets = 0;
+  gint sent_bytes = 0;
+
+  pmtu_received_bytes = 0;
+
+  /* The preallocated receive buffers are only large enough for ethernet */
+  loopback_stream_start (&ls, RAWUDP_TRANSMITTER, 0, TRUE,
+      G_CALLBACK (_pmtu_handoff), NULL, 0, "receive-mtu", 0, NULL);
+
+  /* Found when the remote candidate was set */
+  g_object_get (ls.st, "mtu", path_mtu, NULL);
+  ts_fail_unless (*path_mtu > 0, "The path MTU to the loopback is not known");
+  ts_fail_unless (ls.mtu_notified > 0, "The path MTU was not notified");
+  if (mtu == 0)
+    mtu = *path_mtu;
+
+  start = g_get_monotonic_time ();
+
+  for (frame = 0; frame < frames; frame++)
+  {
+    gsize left = PMTU_FRAME_SIZE;
+
+    while (left > 0)
+    {
+      gsize payload_size = MIN (left, mtu - PMTU_RTP_HEADER_SIZE);
+      gint64 stall_start, cpu_start;
+
+      cpu_start = get_thread_cpu_time ();
+      ts_fail_unless (gst_pad_push (ls.srcpad,
+              _pmtu_new_packet (payload_size)) == GST_FLOW_OK,
+          "Could not push a buffer into the transmitter");
+      cpu_time += get_thread_cpu_time () - cpu_start;
+
+      left -= payload_size;
+      sent_bytes += PMTU_RTP_HEADER_SIZE + payload_size;
+      packets++;
+
+      stall_start = g_get_monotonic_time ();
+      while (sent_bytes - g_atomic_int_get (&pmtu_received_bytes) >
+          PMTU_MAX_BYTES_IN_FLIGHT &&
+          g_get_monotonic_time () - stall_start < G_USEC_PER_SEC)
+        g_usleep (50);
+    }
+  }
+
+  wait_for_packets (&pmtu_received_bytes, sent_bytes, 10 * G_USEC_PER_SEC);
+
+  elapsed = g_get_monotonic_time () - start;
+
+  *received_frames = g_atomic_int_get (&pmtu_received_bytes) /
+      (PMTU_FRAME_SIZE + PMTU_RTP_HEADER_SIZE *
+          ((PMTU_FRAME_SIZE + mtu - PMTU_RTP_HEADER_SIZE - 1) /
+              (mtu - PMTU_RTP_HEADER_SIZE)));
+  *packets_per_sec = (gdouble) packets * G_USEC_PER_SEC / MAX (elapsed, 1);
+  *ns_per_frame = cpu_time / frames;
+
+  GST_INFO ("MTU %u (path MTU %u): %u packets for %u/%u frames, %.0f packets"
+      " per second, sending took %" G_GINT64_FORMAT " ns of CPU per frame",
+      mtu, *path_mtu, packets, *received_frames, frames,
+      *packets_per_sec, *ns_per_frame);
+
+  loopback_stream_stop (&ls);
+}
+
+GST_START_TEST (test_rawudptransmitter_path_mtu)
+{
+  guint path_mtu, received;
+  gdouble pps;
+  gint64 ns;
+
+  run_path_mtu (0, 2, &path_mtu, &received, &pps, &ns);
+  /* The loopback has a 64k MTU */
+  ts_fail_unless (path_mtu > PMTU_SMALL_MTU,
+      "The path MTU of the loopback is only %u", path_mtu);
+  ts_fail_unless (received == 2,
+      "Received %u frames with the path MTU", received);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_path_mtu_benchmark)
+{
+  guint path_mtu, received;
+  gdouble small_pps, path_pps;
+  gint64 small_ns, path_ns;
+
+  run_path_mtu (PMTU_SMALL_MTU, PMTU_FRAMES, &path_mtu, &received,
+      &small_pps, &small_ns);
+  ts_fail_unless (received == PMTU_FRAMES,
+      "Received %u frames with a %d bytes MTU", received, PMTU_SMALL_MTU);
+
+  run_path_mtu (0, PMTU_FRAMES, &path_mtu, &received, &path_pps, &path_ns);
+  ts_fail_unless (received == PMTU_FRAMES,
+      "Received %u frames with the path MTU", received);
+
+  GST_INFO ("Sending a frame costs %" G_GINT64_FORMAT " ns of CPU with the"
+      " path MTU instead of %" G_GINT64_FORMAT " ns (%.0f instead of %.0f"
+      " packets per second)", path_ns, small_ns, path_pps, small_pps);
+}
+GST_END_TEST;
+
+/*
+ * Socket buffers: a burst of packets is sent to the loopback while the
+ * receive thread is stalled, like the packets of a keyframe arriving while
+ * it is not scheduled. The socket buffers are left as the kernel made them,
+ * or sized from the receive bitrate before or after the socket exists. The
+ * statistics of the stream transmitter tell the size of the receive buffer
+ * and, for the benchmark, how many packets the kernel dropped.
+ */
+
+#define SOCKBUF_PACKETS 2000
+#define SOCKBUF_PACKET_SIZE 1200
+#define SOCKBUF_STALL (G_USEC_PER_SEC / 5)
+/* Half a second of it holds the burst several times over */
+#define SOCKBUF_BITRATE (SOCKBUF_PACKETS * SOCKBUF_PACKET_SIZE * 8 * 4)
+
+static volatile gint sockbuf_received = 0;
+static volatile gint sockbuf_stall = 0;
+
+static void
+_sockbuf_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  if (GPOINTER_TO_INT (user_data) != FS_COMPONENT_RTP)
+    return;
+
+  /* The burst piles up in the socket while this sleeps */
+  if (g_atomic_int_compare_and_exchange (&sockbuf_stall, 1, 0))
+    g_usleep (SOCKBUF_STALL);
+
+  g_atomic_int_inc (&sockbuf_received);
+}
+
+/* If resize is TRUE, the bitrate is only set once the socket exists */
+static void
+run_socket_buffer (guint bitrate, gboolean resize, guint packets,
+    guint *received, guint *drops, gint *buffer_size)
+{
+  LoopbackStream ls;
+  GstStructure *stats;
+  guint i;
+
+  sockbuf_received = 0;
+  sockbuf_stall = 0;
+
+  loopback_stream_start (&ls, RAWUDP_TRANSMITTER, 0, TRUE,
+      G_CALLBACK (_sockbuf_handoff), NULL, 0,
+      "receive-bitrate", resize ? 0 : bitrate, NULL);
+
+  if (resize)
+    g_object_set (ls.trans, "receive-bitrate", bitrate, NULL);
+
+  g_atomic_int_set (&sockbuf_stall, 1);
+
+  for (i = 0; i < packets; i++)
+    ts_fail_unless (gst_pad_push (ls.srcpad,
+            _pmtu_new_packet (SOCKBUF_PACKET_SIZE - PMTU_RTP_HEADER_SIZE)) ==
+        GST_FLOW_OK, "Could not push a buffer into the transmitter");
+
+  /* The dropped packets never come */
+  wait_for_packets (&sockbuf_received, packets,
+      SOCKBUF_STALL + 2 * G_USEC_PER_SEC);
+
+  *received = g_atomic_int_get (&sockbuf_received);
+
+  g_object_get (ls.st, "stats", &stats, NULL);
+  ts_fail_unless (stats != NULL, "The stream transmitter has no stats");
+  ts_fail_unless (gst_structure_get_uint (stats, "component1-receive-drops",
+          drops), "The stats have no drop counter: %" GST_PTR_FORMAT, stats);
+  ts_fail_unless (gst_structure_get_int (stats,
+          "component1-receive-buffer-size", buffer_size),
+      "The stats have no receive buffer size: %" GST_PTR_FORMAT, stats);
+  gst_structure_free (stats);
+
+  GST_INFO ("Receive bitrate %u%s: %d bytes of receive buffer, received"
+      " %u/%u packets, the kernel dropped %u", bitrate,
+      resize ? " (resized)" : "", *buffer_size, *received, packets, *drops);
+
+  loopback_stream_stop (&ls);
+}
+
+GST_START_TEST (test_rawudptransmitter_socket_buffer)
+{
+  guint received, drops;
+  gint buffer_size, tuned_buffer_size, resized_buffer_size;
+
+  run_socket_buffer (0, FALSE, 10, &received, &drops, &buffer_size);
+  run_socket_buffer (SOCKBUF_BITRATE, FALSE, 10, &received, &drops,
+      &tuned_buffer_size);
+  run_socket_buffer (SOCKBUF_BITRATE, TRUE, 10, &received, &drops,
+      &resized_buffer_size);
+
+  /* Without CAP_NET_ADMIN, the rmem_max sysctl may keep them as they are */
+  ts_fail_unless (tuned_buffer_size >= buffer_size,
+      "The receive buffer shrank from %d to %d", buffer_size,
+      tuned_buffer_size);
+  ts_fail_unless (resized_buffer_size == tuned_buffer_size,
+      "The receive buffer was resized to %d instead of %d",
+      resized_buffer_size, tuned_buffer_size);
+}
+GST_END_TEST;
+
+GST_START_TEST (test_rawudptransmitter_socket_buffer_benchmark)
+{
+  guint received, drops, tuned_received, tuned_drops;
+  guint resized_received, resized_drops;
+  gint buffer_size, tuned_buffer_size, resized_buffer_size;
+
+  run_socket_buffer (0, FALSE, SOCKBUF_PACKETS, &received, &drops,
+      &buffer_size);
+  run_socket_buffer (SOCKBUF_BITRATE, FALSE, SOCKBUF_PACKETS,
+      &tuned_received, &tuned_drops, &tuned_buffer_size);
+  run_socket_buffer (SOCKBUF_BITRATE, TRUE, SOCKBUF_PACKETS,
+      &resized_received, &resized_drops, &resized_buffer_size);
+
+  if (tuned_buffer_size > buffer_size)
+  {
+    ts_fail_unless (tuned_drops <= drops,
+        "The kernel dropped %u packets with a %d bytes buffer, but only %u"
+        " with %d bytes", tuned_drops, tuned_buffer_size, drops, buffer_size);
+    ts_fail_unless (tuned_received >= received,
+        "Received %u packets with a %d bytes buffer, but %u with %d bytes",
+        tuned_received, tuned_buffer_size, received, buffer_size);
+  }
+
+  GST_INFO ("The kernel dropped %u packets of the burst with the default"
+      " receive buffer, %u when it is sized from the bitrate and %u when it"
+      " is resized", drops, tuned_drops, resized_drops);
+}
+GST_END_TEST;
+
+#ifdef TEST_URING_TRANSMITTER
+
+/*
+ * Compares the "uring" transmitter with "rawudp": a stream sends to itself
+ * over the loopback, the packets are pushed into the transmitter sink in
+ * lists with the time at which they were sent, and the time until they
+ * come out of the transmitter src is measured.
+ */
+
+#define COMPARISON_PACKETS 20000
+#define COMPARISON_LIST_SIZE 16
+#define COMPARISON_PACKET_SIZE 200
+/* Stay well below what fits in the socket buffer */
+#define COMPARISON_MAX_IN_FLIGHT 64
+
+static volatile gint comparison_received = 0;
+/* Only touched from the streaming thread of the RTP fakesink */
+static gint64 comparison_latency_sum = 0;
+static gint64 comparison_latency_max = 0;
+
+static void
+_comparison_handoff (GstElement *element, GstBuffer *buffer, GstPad *pad,
+  gpointer user_data)
+{
+  GstMapInfo map;
+  gint64 sent, latency;
+
+  if (GPOINTER_TO_INT (user_data) != FS_COMPONENT_RTP)
+    return;
+
+  ts_fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ),
+      "Could not map a received buffer");
+  if (map.size >= 12 + sizeof (sent))
+  {
+    memcpy (&sent, map.data + 12, sizeof (sent));
+    latency = g_get_monotonic_time () - sent;
+    comparison_latency_sum += latency;
+    comparison_latency_max = MAX (comparison_latency_max, latency);
+    g_atomic_int_inc (&comparison_received);
+  }
+  gst_buffer_unmap (buffer, &map);
+}
+
+static void
+run_transmitter_comparison (const gchar *transmitter, guint *received,
+    gdouble *packets_per_sec, gint64 *avg_latency)
+{
+  LoopbackStream ls;
+  gint64 start, elapsed;
+  guint sent;
+
+  comparison_received = 0;
+  comparison_latency_sum = 0;
+  comparison_latency_max = 0;
+
+  /* Push into the transmitter directly, so buffer lists reach its sink */
+  loopback_stream_start (&ls, transmitter, 0, TRUE,
+      G_CALLBACK (_comparison_handoff), NULL, 0, NULL);
+
+  start = g_get_monotonic_time ();
+
+  for (sent = 0; sent < COMPARISON_PACKETS; sent += COMPARISON_LIST_SIZE)
+  {
+    GstBufferList *list = gst_buffer_list_new_sized (COMPARISON_LIST_SIZE);
+    gint64 stall_start = g_get_monotonic_time ();
+    guint i;
+
+    for (i = 0; i < COMPARISON_LIST_SIZE; i++)
+    {
+      GstBuffer *buffer;
+      GstMapInfo map;
+      gint64 now = g_get_monotonic_time ();
+
+      buffer = gst_buffer_new_allocate (NULL, COMPARISON_PACKET_SIZE, NULL);
+      gst_buffer_map (buffer, &map, GST_MAP_WRITE);
+      memset (map.data, 0, map.size);
+      /* RTP version 2, so the STUN probe lets it through */
+      map.data[0] = 0x80;
+      memcpy (map.data + 12, &now, sizeof (now));
+      gst_buffer_unmap (buffer, &map);
+      gst_buffer_list_add (list, buffer);
+    }
+
+    ts_fail_unless (gst_pad_push_list (ls.srcpad, list) == GST_FLOW_OK,
+        "Could not push a buffer list into the transmitter");
+
+    while (sent + COMPARISON_LIST_SIZE -
+        g_atomic_int_get (&comparison_received) > COMPARISON_MAX_IN_FLIGHT &&
+        g_get_monotonic_time () - stall_start < G_USEC_PER_SEC)
+      g_usleep (50);
+  }
+
+  while (g_atomic_int_get (&comparison_received) < COMPARISON_PACKETS &&
+      g_get_monotonic_time () - start < 10 * G_USEC_PER_SEC)
+    g_usleep (G_USEC_PER_SEC / 100);
+
+  elapsed = g_get_monotonic_time () - start;
+  *received = g_atomic_int_get (&comparison_received);
+  *packets_per_sec = (gdouble) *received * G_USEC_PER_SEC / elapsed;
+  *avg_latency = comparison_latency_sum / MAX (*received, 1);
+
+  GST_INFO ("%s: looped back %u/%d packets at %.0f packets/s, latency"
+      " %" G_GINT64_FORMAT " us on average and %" G_GINT64_FORMAT " us at"
+      " most", transmitter, *received, COMPARISON_PACKETS, *packets_per_sec,
+      *avg_latency, comparison_latency_max);
+
+  loopback_stream_stop (&ls);
+}
+
+GST_START_TEST (test_rawudptransmitter_uring_comparison)
+{
+  guint rawudp_received, uring_received;
+  gdouble rawudp_rate, uring_rate;
+  gint64 rawudp_latency, uring_latency;
+
+  run_transmitter_comparison ("rawudp", &rawudp_received, &rawudp_rate,
+      &rawudp_latency);
+  run_transmitter_comparison ("uring", &uring_received, &uring_rate,
+      &uring_latency);
+
+  /* The numbers depend too much on the machine to be compared here, but
+   * both must get nearly everything through */
+  ts_fail_unless (rawudp_received >= COMPARISON_PACKETS * 99 / 100,
+      "rawudp only looped back %u packets", rawudp_received);
+  ts_fail_unless (uring_received >= COMPARISON_PACKETS * 99 / 100,
+      "uring only looped back %u packets", uring_received);
+
+  GST_INFO ("uring/rawudp: %.2f times the throughput, %.2f times the latency",
+      uring_rate / MAX (rawudp_rate, 1),
+      (gdouble) uring_latency / MAX (rawudp_latency, 1));
+}
+GST_END_TEST;
+
+#endif /* TEST_URING_TRANSMITTER */
+
+
+static Suite *
+rawudptransmitter_suite (void)
+{
+  Suite *s = suite_create ("rawudptransmitter");
+  TCase *tc_chain;
+  GLogLevelFlags fatal_mask;
+
+  fatal_mask = g_log_set_always_fatal (G_LOG_FATAL_MASK);
+  fatal_mask |= G_LOG_LEVEL_WARNING | G_LOG_LEVEL_CRITICAL;
+  g_log_set_always_fatal (fatal_mask);
+
+  tc_chain = tcase_create ("rawudptransmitter_new");
+  tcase_add_test (tc_chain, test_rawudptransmitter_new);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter_nostun");
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter_nostun_nosource");
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_nostun_nosource);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stun-timeout");
+  tcase_set_timeout (tc_chain, 10);
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_invalid_stun);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stund");
+  tcase_set_timeout (tc_chain, 15);
+  tcase_add_checked_fixture (tc_chain, setup_stund, teardown_stund);
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_stund);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-local-candidates");
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_local_candidates);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stop-stream");
+  tcase_add_test (tc_chain, test_rawudptransmitter_stop_stream);
+  suite_add_tcase (s, tc_chain);
+
+#if defined(HAVE_GUPNP_CORE_10) || defined (HAVE_GUPNP_CORE_12)
+  if (g_getenv ("UPNP")) {
+    gchar *multicast_addr;
+
+    multicast_addr = find_multicast_capable_address ();
+    g_free (multicast_addr);
+
+    if (multicast_addr)
+    {
+      tc_chain = tcase_create ("rawudptransmitter-upnp-discovery");
+      tcase_add_test (tc_chain, test_rawudptransmitter_run_upnp_discovery);
+      suite_add_tcase (s, tc_chain);
+
+      tc_chain = tcase_create ("rawudptransmitter-upnp-fallback");
+      tcase_add_test (tc_chain, test_rawudptransmitter_run_upnp_fallback);
+      suite_add_tcase (s, tc_chain);
+
+      tc_chain = tcase_create ("rawudptransmitter-upnp-ignored");
+      tcase_add_checked_fixture (tc_chain, setup_stund, teardown_stund);
+      tcase_add_test (tc_chain, test_rawudptransmitter_run_upnp_ignored);
+      suite_add_tcase (s, tc_chain);
+    }
+  }
+#endif
+
+  tc_chain = tcase_create ("rawudptransmitter-sending-half");
+  tcase_add_test (tc_chain, test_rawudptransmitter_sending_half);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stunalternd");
+  tcase_set_timeout (tc_chain, 5);
+  tcase_add_checked_fixture (tc_chain, setup_stund_stunalternd,
+      teardown_stund_stunalternd);
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_stunalternd);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stunalternd-to-nowhere");
+  tcase_set_timeout (tc_chain, 20);
+  tcase_add_checked_fixture (tc_chain, setup_stunalternd_valid,
+      teardown_stunalternd);
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_stun_altern_to_nowhere);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-stunalternd-loop");
+  tcase_set_timeout (tc_chain, 20);
+  tcase_add_checked_fixture (tc_chain, setup_stunalternd_loop,
+      teardown_stunalternd);
+  tcase_add_test (tc_chain, test_rawudptransmitter_run_stun_altern_to_nowhere);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-strange-arguments");
+  tcase_add_test (tc_chain, test_rawudptransmitter_strange_arguments);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-receive-shards");
+  tcase_add_test (tc_chain, test_rawudptransmitter_receive_shards);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-receive-pool");
+  tcase_add_test (tc_chain, test_rawudptransmitter_receive_pool);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-server-mode");
+  tcase_set_timeout (tc_chain, 30);
+  tcase_add_test (tc_chain, test_rawudptransmitter_server_mode);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-many-ports");
+  tcase_add_test (tc_chain, test_rawudptransmitter_many_ports);
+  suite_add_tcase (s, tc_chain);
+
+#ifndef TEST_URING_TRANSMITTER
+  tc_chain = tcase_create ("rawudptransmitter-direct-send");
+  tcase_add_test (tc_chain, test_rawudptransmitter_direct_send);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-paced-send");
+  tcase_add_test (tc_chain, test_rawudptransmitter_paced_send);
+  suite_add_tcase (s, tc_chain);
+#endif
+
+  tc_chain = tcase_create ("rawudptransmitter-path-mtu");
+  tcase_add_test (tc_chain, test_rawudptransmitter_path_mtu);
+  suite_add_tcase (s, tc_chain);
+
+  tc_chain = tcase_create ("rawudptransmitter-socket-buffer");
+  tcase_add_test (tc_chain, test_rawudptransmitter_socket_buffer);
+  suite_add_tcase (s, tc_chain);
+
+  /* They take long and only mean something on an idle machine */
+  if (g_getenv ("FS_BENCHMARKS")) {
+    tc_chain = tcase_create ("rawudptransmitter-receive-shards-benchmark");
+    tcase_set_timeout (tc_chain, 30);
+    tcase_add_test (tc_chain, test_rawudptransmitter_receive_shards_benchmark);
+    suite_add_tcase (s, tc_chain);
+
+    tc_chain = tcase_create ("rawudptransmitter-receive-pool-benchmark");
+    tcase_set_timeout (tc_chain, 30);
+    tcase_add_test (tc_chain, test_rawudptransmitter_receive_pool_benchmark);
+    suite_add_tcase (s, tc_chain);
+
+    tc_chain = tcase_create ("rawudptransmitter-many-ports-benchmark");
+    tcase_set_timeout (tc_chain, 60);
+    tcase_add_test (tc_chain, test_rawudptransmitter_many_ports_benchmark);
+    suite_add_tcase (s, tc_chain);
+
+#ifndef TEST_URING_TRANSMITTER
+    tc_chain = tcase_create ("rawudptransmitter-direct-send-benchmark");
+    tcase_set_timeout (tc_chain, 60);
+    tcase_add_test (tc_chain, test_rawudptransmitter_direct_send_benchmark);
+    suite_add_tcase (s, tc_chain);
+
+    tc_chain = tcase_create ("rawudptransmitter-paced-send-benchmark");
+    tcase_set_timeout (tc_chain, 60);
+    tcase_add_test (tc_chain, test_rawudptransmitter_paced_send_benchmark);
+    suite_add_tcase (s, tc_chain);
+#endif
+
+    tc_chain = tcase_create ("rawudptransmitter-path-mtu-benchmark");
+    tcase_set_timeout (tc_chain, 60);
+    tcase_add_test (tc_chain, test_rawudptransmitter_path_mtu_benchmark);
+    suite_add_tcase (s, tc_chain);
+
+    tc_chain = tcase_create ("rawudptransmitter-socket-buffer-benchmark");
+    tcase_set_timeout (tc_chain, 60);
+    tcase_add_test (tc_chain, test_rawudptransmitter_socket_buffer_benchmark);
+    suite_add_tcase (s, tc_chain);
+
+#ifdef TEST_URING_TRANSMITTER
+    tc_chain = tcase_create ("rawudptransmitter-uring-comparison");
+    tcase_set_timeout (tc_chain, 60);
+    tcase_add_test (tc_chain, test_rawudptransmitter_uring_comparison);
+    suite_add_tcase (s, tc_chain);
+#endif
+  }
 
   return s;
 }
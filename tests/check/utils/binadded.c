@@ -186,6 +186,93 @@ GST_START_TEST (test_bin_added_recursive)
 }
 GST_END_TEST;
 
+#define NESTED_DEPTH 50
+#define NESTED_WIDTH 5
+
+static void
+_count_added_cb (FsElementAddedNotifier *notifier, GstBin *bin,
+    GstElement *element, gpointer user_data)
+{
+  guint *count = user_data;
+
+  (*count)++;
+}
+
+static GstElement *
+build_nested_bins (guint depth)
+{
+  GstElement *top = gst_bin_new (NULL);
+  GstElement *bin = top;
+  guint i, j;
+
+  for (i = 0; i < depth; i++)
+  {
+    GstElement *subbin = gst_bin_new (NULL);
+
+    for (j = 0; j < NESTED_WIDTH; j++)
+      fail_unless (gst_bin_add (GST_BIN (bin),
+              gst_element_factory_make ("identity", NULL)));
+    fail_unless (gst_bin_add (GST_BIN (bin), subbin));
+    bin = subbin;
+  }
+
+  return top;
+}
+
+GST_START_TEST (test_bin_added_nested)
+{
+  GstElement *pipeline = NULL;
+  FsElementAddedNotifier *notifier = NULL;
+  guint count = 0;
+  gint64 start;
+
+  pipeline = gst_pipeline_new (NULL);
+  fail_unless (gst_bin_add (GST_BIN (pipeline),
+          build_nested_bins (NESTED_DEPTH)));
+
+  notifier = fs_element_added_notifier_new ();
+  g_signal_connect (notifier, "element-added",
+      G_CALLBACK (_count_added_cb), &count);
+
+  /* Elements already present are each notified exactly once */
+  start = g_get_monotonic_time ();
+  fs_element_added_notifier_add (notifier, GST_BIN (pipeline));
+  GST_INFO ("Watching %u nested bins took %" G_GINT64_FORMAT "us",
+      NESTED_DEPTH, g_get_monotonic_time () - start);
+  fail_unless (count == 1 + NESTED_DEPTH * (NESTED_WIDTH + 1),
+      "Got %u notifications, expected %u", count,
+      1 + NESTED_DEPTH * (NESTED_WIDTH + 1));
+
+  /* Adding a whole new nested hierarchy is notified once per element too */
+  count = 0;
+  start = g_get_monotonic_time ();
+  fail_unless (gst_bin_add (GST_BIN (pipeline),
+          build_nested_bins (NESTED_DEPTH)));
+  GST_INFO ("Adding %u nested bins took %" G_GINT64_FORMAT "us",
+      NESTED_DEPTH, g_get_monotonic_time () - start);
+  fail_unless (count == 1 + NESTED_DEPTH * (NESTED_WIDTH + 1),
+      "Got %u notifications, expected %u", count,
+      1 + NESTED_DEPTH * (NESTED_WIDTH + 1));
+
+  /* Adding the same top-level bin twice must not double the handlers */
+  fs_element_added_notifier_add (notifier, GST_BIN (pipeline));
+  count = 0;
+  fail_unless (gst_bin_add (GST_BIN (pipeline),
+          gst_element_factory_make ("identity", NULL)));
+  fail_unless (count == 1, "Got %u notifications, expected 1", count);
+
+  fail_unless (
+      fs_element_added_notifier_remove (notifier, GST_BIN (pipeline)));
+  count = 0;
+  fail_unless (gst_bin_add (GST_BIN (pipeline),
+          build_nested_bins (2)));
+  fail_unless (count == 0, "Callback was removed, but was still called");
+
+  g_object_unref (notifier);
+  gst_object_unref (pipeline);
+}
+GST_END_TEST;
+
 static void
 test_keyfile (FsElementAddedNotifier *notifier)
 {
@@ -314,6 +401,7 @@ binadded_suite (void)
   suite_add_tcase (s, tc_chain);
   tcase_add_test (tc_chain, test_bin_added_simple);
   tcase_add_test (tc_chain, test_bin_added_recursive);
+  tcase_add_test (tc_chain, test_bin_added_nested);
   tcase_add_test (tc_chain, test_bin_keyfile);
   tcase_add_test (tc_chain, test_bin_file);
   tcase_add_test (tc_chain, test_bin_errors);
@@ -0,0 +1,161 @@
+/*
+ * Farstream - Farstream transmitter helpers
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * fs-multiudpsrc-pad.c - Reading sockets through a shared fsmultiudpsrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/*
+ * The rawudp and multicast transmitters can read all of their sockets
+ * with one fsmultiudpsrc element, which has one request pad per socket.
+ * These helpers create that element and its pads, the transmitters keep
+ * the element and do their own locking around its creation.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-multiudpsrc-pad.h"
+
+#include <farstream/fs-conference.h>
+
+/*
+ * Creates a fsmultiudpsrc, adds it to @bin and brings it to the state of
+ * @bin. The first socket decides the number of threads.
+ */
+
+GstElement *
+fs_multiudpsrc_new (GstBin *bin,
+    guint n_threads,
+    gboolean do_timestamp,
+    gboolean io_uring,
+    GError **error)
+{
+  GstElement *multiudpsrc;
+
+  multiudpsrc = gst_element_factory_make ("fsmultiudpsrc", NULL);
+  if (!multiudpsrc)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not create the fsmultiudpsrc element");
+    return NULL;
+  }
+
+  g_object_set (multiudpsrc,
+      "n-threads", n_threads,
+      "do-timestamp", do_timestamp,
+      NULL);
+  if (io_uring)
+    g_object_set (multiudpsrc, "io-uring", TRUE, NULL);
+
+  if (!gst_bin_add (bin, multiudpsrc))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the fsmultiudpsrc element to the transmitter src"
+        " bin");
+    gst_object_unref (multiudpsrc);
+    return NULL;
+  }
+
+  if (!gst_element_sync_state_with_parent (multiudpsrc))
+  {
+    GstStateChangeReturn ret;
+
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not sync the state of the fsmultiudpsrc with its parent");
+
+    gst_element_set_locked_state (multiudpsrc, TRUE);
+    ret = gst_element_set_state (multiudpsrc, GST_STATE_NULL);
+    if (ret != GST_STATE_CHANGE_SUCCESS)
+      GST_ERROR ("Error changing state of %s: %s",
+          GST_OBJECT_NAME (multiudpsrc),
+          gst_element_state_change_return_get_name (ret));
+    if (!gst_bin_remove (bin, multiudpsrc))
+      GST_ERROR ("Could not remove %s from the transmitter bin",
+          GST_OBJECT_NAME (multiudpsrc));
+    return NULL;
+  }
+
+  return multiudpsrc;
+}
+
+/*
+ * Requests a pad of @multiudpsrc reading from @socket and links it to a
+ * new request pad of @funnel, returned in @requested_pad.
+ */
+
+GstPad *
+fs_multiudpsrc_request_pad (GstElement *multiudpsrc,
+    GstElement *funnel,
+    GSocket *socket,
+    GstBufferPool *pool,
+    GstPad **requested_pad,
+    GError **error)
+{
+  GstPad *pad;
+  GstPadLinkReturn ret;
+
+  *requested_pad = gst_element_get_request_pad (funnel, "sink_%u");
+  if (!*requested_pad)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not get the sink request pad from the funnel");
+    return NULL;
+  }
+
+  pad = gst_element_get_request_pad (multiudpsrc, "src_%u");
+  if (!pad)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not get a src request pad from the fsmultiudpsrc");
+    return NULL;
+  }
+
+  ret = gst_pad_link (pad, *requested_pad);
+  if (GST_PAD_LINK_FAILED (ret))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the fsmultiudpsrc pad (%d)", ret);
+    gst_element_release_request_pad (multiudpsrc, pad);
+    gst_object_unref (pad);
+    return NULL;
+  }
+
+  /* Only start reading once the packets have somewhere to go */
+  g_object_set (pad,
+      "buffer-pool", pool,
+      "socket", socket,
+      NULL);
+
+  return pad;
+}
+
+void
+fs_multiudpsrc_release_pad (GstPad *pad)
+{
+  GstElement *multiudpsrc = gst_pad_get_parent_element (pad);
+
+  /* Waits until the pad is not pushing anymore */
+  if (multiudpsrc)
+  {
+    gst_element_release_request_pad (multiudpsrc, pad);
+    gst_object_unref (multiudpsrc);
+  }
+  gst_object_unref (pad);
+}
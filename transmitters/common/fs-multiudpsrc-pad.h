@@ -0,0 +1,48 @@
+/*
+ * Farstream - Farstream transmitter helpers
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * fs-multiudpsrc-pad.h - Reading sockets through a shared fsmultiudpsrc
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __FS_MULTIUDPSRC_PAD_H__
+#define __FS_MULTIUDPSRC_PAD_H__
+
+#include <gst/gst.h>
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+GstElement *fs_multiudpsrc_new (GstBin *bin,
+    guint n_threads,
+    gboolean do_timestamp,
+    gboolean io_uring,
+    GError **error);
+
+GstPad *fs_multiudpsrc_request_pad (GstElement *multiudpsrc,
+    GstElement *funnel,
+    GSocket *socket,
+    GstBufferPool *pool,
+    GstPad **requested_pad,
+    GError **error);
+
+void fs_multiudpsrc_release_pad (GstPad *pad);
+
+G_END_DECLS
+
+#endif /* __FS_MULTIUDPSRC_PAD_H__ */
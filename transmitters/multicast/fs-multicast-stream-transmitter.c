@@ -50,6 +50,20 @@
  * Packets sent will be looped back (so that other clients on the same session
  * can be on the same machine.
  *
+ * With the #FsMulticastStreamTransmitter:receive-threads property, the sockets
+ * are read by one fsmultiudpsrc element shared by the whole transmitter,
+ * which waits on them with epoll from a few threads, instead of by one
+ * udpsrc thread each.
+ *
+ * The #FsMulticastStreamTransmitter:mtu property tells how large the RTP
+ * packets sent to the group can be without being fragmented.
+ *
+ * The socket buffers are sized from the bitrates given to the transmitter
+ * with its #FsMulticastTransmitter:send-bitrate and
+ * #FsMulticastTransmitter:receive-bitrate properties, and the
+ * #FsMulticastStreamTransmitter:stats property tells how many packets the
+ * kernel dropped because they did not fit.
+ *
  * The name of this transmitter is "multicast".
  */
 
@@ -95,9 +109,14 @@ enum
 {
   PROP_0,
   PROP_SENDING,
-  PROP_PREFERRED_LOCAL_CANDIDATES
+  PROP_PREFERRED_LOCAL_CANDIDATES,
+  PROP_RECEIVE_THREADS,
+  PROP_MTU,
+  PROP_STATS
 };
 
+#define MAX_RECEIVE_THREADS (64)
+
 struct _FsMulticastStreamTransmitterPrivate
 {
   gboolean disposed;
@@ -123,7 +142,12 @@ struct _FsMulticastStreamTransmitterPrivate
   /* Protected by the mutex */
   UdpSock **udpsocks;
 
+  /* Protected by the mutex */
+  guint mtu;
+
   GList *preferred_local_candidates;
+
+  guint receive_threads;
 };
 
 #define FS_MULTICAST_STREAM_TRANSMITTER_GET_PRIVATE(o)  \
@@ -205,6 +229,54 @@ fs_multicast_stream_transmitter_class_init (FsMulticastStreamTransmitterClass *k
   g_object_class_override_property (gobject_class,
     PROP_PREFERRED_LOCAL_CANDIDATES, "preferred-local-candidates");
 
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_THREADS,
+      g_param_spec_uint ("receive-threads",
+          "The number of threads of the shared receive source",
+          "If not 0, the sockets are read by a receive source shared by"
+          " all the streams of the transmitter that also set this property,"
+          " using epoll on this many threads, instead of each having its own"
+          " udpsrc thread. The first stream to use it picks the number of"
+          " threads",
+          0, MAX_RECEIVE_THREADS, 0,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MTU,
+      g_param_spec_uint ("mtu",
+          "The MTU to the multicast group",
+          "The largest UDP payload that can be sent to the RTP multicast"
+          " group without being fragmented, 0 if it is not known yet",
+          0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsMulticastStreamTransmitter:stats:
+   *
+   * The statistics of the sockets, in a #GstStructure named
+   * "application/x-fs-udp-stats". For each component N that has a socket,
+   * it has the fields:
+   *
+   * "componentN-receive-drops" (#guint): the number of packets the kernel
+   * dropped on the socket, mostly because the receive buffer was full, as
+   * counted by SO_RXQ_OVFL. It is 0 where the kernel can not tell.
+   *
+   * "componentN-receive-buffer-size" (#gint): the size of the receive
+   * buffer
+   *
+   * "componentN-send-buffer-size" (#gint): the size of the send buffer
+   *
+   * The socket is shared by all the streams that join the same group on the
+   * same port, so are its statistics.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STATS,
+      g_param_spec_boxed ("stats",
+          "Socket statistics",
+          "The drop counters and buffer sizes of the sockets",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   gobject_class->dispose = fs_multicast_stream_transmitter_dispose;
   gobject_class->finalize = fs_multicast_stream_transmitter_finalize;
 
@@ -295,6 +367,46 @@ fs_multicast_stream_transmitter_finalize (GObject *object)
   parent_class->finalize (object);
 }
 
+static GstStructure *
+fs_multicast_stream_transmitter_get_stats (FsMulticastStreamTransmitter *self)
+{
+  GstStructure *stats = gst_structure_new_empty ("application/x-fs-udp-stats");
+  guint c;
+
+  FS_MULTICAST_STREAM_TRANSMITTER_LOCK (self);
+  if (!self->priv->udpsocks)
+    goto out;
+
+  for (c = 1; c <= self->priv->transmitter->components; c++)
+  {
+    guint drops;
+    gint rcvbuf, sndbuf;
+    gchar *drops_name, *rcvbuf_name, *sndbuf_name;
+
+    if (!self->priv->udpsocks[c])
+      continue;
+
+    fs_multicast_transmitter_udpsock_get_socket_stats (self->priv->udpsocks[c],
+        &drops, &rcvbuf, &sndbuf);
+
+    drops_name = g_strdup_printf ("component%u-receive-drops", c);
+    rcvbuf_name = g_strdup_printf ("component%u-receive-buffer-size", c);
+    sndbuf_name = g_strdup_printf ("component%u-send-buffer-size", c);
+    gst_structure_set (stats,
+        drops_name, G_TYPE_UINT, drops,
+        rcvbuf_name, G_TYPE_INT, rcvbuf,
+        sndbuf_name, G_TYPE_INT, sndbuf,
+        NULL);
+    g_free (drops_name);
+    g_free (rcvbuf_name);
+    g_free (sndbuf_name);
+  }
+
+ out:
+  FS_MULTICAST_STREAM_TRANSMITTER_UNLOCK (self);
+  return stats;
+}
+
 static void
 fs_multicast_stream_transmitter_get_property (GObject *object,
                                            guint prop_id,
@@ -313,6 +425,18 @@ fs_multicast_stream_transmitter_get_property (GObject *object,
     case PROP_PREFERRED_LOCAL_CANDIDATES:
       g_value_set_boxed (value, self->priv->preferred_local_candidates);
       break;
+    case PROP_RECEIVE_THREADS:
+      g_value_set_uint (value, self->priv->receive_threads);
+      break;
+    case PROP_MTU:
+      FS_MULTICAST_STREAM_TRANSMITTER_LOCK (self);
+      g_value_set_uint (value, self->priv->mtu);
+      FS_MULTICAST_STREAM_TRANSMITTER_UNLOCK (self);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value,
+          fs_multicast_stream_transmitter_get_stats (self));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -360,6 +484,9 @@ fs_multicast_stream_transmitter_set_property (GObject *object,
     case PROP_PREFERRED_LOCAL_CANDIDATES:
       self->priv->preferred_local_candidates = g_value_dup_boxed (value);
       break;
+    case PROP_RECEIVE_THREADS:
+      self->priv->receive_threads = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -452,6 +579,8 @@ fs_multicast_stream_transmitter_add_remote_candidate (
     GError **error)
 {
   UdpSock *newudpsock = NULL;
+  guint mtu = 0;
+  gboolean mtu_changed = FALSE;
 
   FS_MULTICAST_STREAM_TRANSMITTER_LOCK (self);
   if (self->priv->remote_candidate[candidate->component_id])
@@ -484,13 +613,23 @@ fs_multicast_stream_transmitter_add_remote_candidate (
       candidate->port,
       candidate->ttl,
       candidate->component_id == 1 ? self->priv->sending : TRUE,
+      self->priv->receive_threads,
       error);
 
   if (!newudpsock)
     return FALSE;
 
+  if (candidate->component_id == FS_COMPONENT_RTP)
+    mtu = fs_multicast_transmitter_udpsock_get_path_mtu (newudpsock);
+
   FS_MULTICAST_STREAM_TRANSMITTER_LOCK (self);
 
+  if (candidate->component_id == FS_COMPONENT_RTP && mtu != self->priv->mtu)
+  {
+    self->priv->mtu = mtu;
+    mtu_changed = TRUE;
+  }
+
   if (self->priv->udpsocks[candidate->component_id] &&
       candidate->component_id == 1)
   {
@@ -510,6 +649,9 @@ fs_multicast_stream_transmitter_add_remote_candidate (
 
   FS_MULTICAST_STREAM_TRANSMITTER_UNLOCK (self);
 
+  if (mtu_changed)
+    g_object_notify (G_OBJECT (self), "mtu");
+
   g_signal_emit_by_name (self, "new-active-candidate-pair",
       self->priv->local_candidate[candidate->component_id],
       self->priv->remote_candidate[candidate->component_id]);
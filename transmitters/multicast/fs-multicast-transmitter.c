@@ -36,6 +36,7 @@
 
 #include "fs-multicast-transmitter.h"
 #include "fs-multicast-stream-transmitter.h"
+#include "fs-multiudpsrc-pad.h"
 
 #include <farstream/fs-conference.h>
 #include <farstream/fs-plugin.h>
@@ -58,9 +59,39 @@
 # include <arpa/inet.h>
 #endif /*G_OS_WIN32*/
 
+#ifdef HAVE_LINUX_SOCK_DIAG_H
+# include <linux/sock_diag.h>
+# ifdef SO_MEMINFO
+#  define USE_SO_MEMINFO
+# endif
+#endif
+
 GST_DEBUG_CATEGORY (fs_multicast_transmitter_debug);
 #define GST_CAT_DEFAULT fs_multicast_transmitter_debug
 
+/* An ethernet frame */
+#define DEFAULT_RECEIVE_MTU 1500
+#define DEFAULT_RECEIVE_BUFFERS 16
+/* RTCP only has a few packets per second */
+#define RTCP_RECEIVE_BUFFERS 2
+
+/* The IP and UDP headers that the path MTU has to hold */
+#define IPV4_UDP_HEADERS (20 + 8)
+
+/* The socket buffers of the RTP sockets are sized to hold this much of the
+ * bitrate, so that the kernel does not drop the packets of a keyframe while
+ * the receive thread is not scheduled */
+#define SOCKET_BUFFER_TIME (GST_SECOND / 2)
+#define MAX_SOCKET_BUFFER_SIZE (16 * 1024 * 1024)
+
+#ifdef __linux__
+/* Linux doubles the size it is asked for to leave room for its own
+ * bookkeeping, and reports the doubled size */
+# define SOCKET_BUFFER_OVERHEAD 2
+#else
+# define SOCKET_BUFFER_OVERHEAD 1
+#endif
+
 /* Signals */
 enum
 {
@@ -75,7 +106,11 @@ enum
   PROP_GST_SRC,
   PROP_COMPONENTS,
   PROP_TYPE_OF_SERVICE,
-  PROP_DO_TIMESTAMP
+  PROP_DO_TIMESTAMP,
+  PROP_RECEIVE_MTU,
+  PROP_RECEIVE_BUFFERS,
+  PROP_SEND_BITRATE,
+  PROP_RECEIVE_BITRATE
 };
 
 struct _FsMulticastTransmitterPrivate
@@ -92,9 +127,16 @@ struct _FsMulticastTransmitterPrivate
 
   GMutex mutex;
   GList **udpsocks;
+  /* Created by the first socket that wants a shared receive source */
+  GstElement *multiudpsrc;
 
   gint type_of_service;
   gboolean do_timestamp;
+  /* Protected by the mutex */
+  guint receive_mtu;
+  guint receive_buffers;
+  guint send_bitrate;
+  guint receive_bitrate;
 
   gboolean disposed;
 };
@@ -133,6 +175,13 @@ static GType fs_multicast_transmitter_get_stream_transmitter_type (
 static void fs_multicast_transmitter_set_type_of_service (
     FsMulticastTransmitter *self,
     gint tos);
+static void fs_multicast_transmitter_set_bitrate (
+    FsMulticastTransmitter *self,
+    gboolean receive,
+    guint bitrate);
+static void _udpsock_update_buffer_sizes_locked (
+    FsMulticastTransmitter *trans,
+    UdpSock *udpsock);
 
 
 static GObjectClass *parent_class = NULL;
@@ -203,6 +252,90 @@ fs_multicast_transmitter_class_init (FsMulticastTransmitterClass *klass)
   g_object_class_override_property (gobject_class, PROP_DO_TIMESTAMP,
     "do-timestamp");
 
+  /**
+   * FsMulticastTransmitter:receive-mtu:
+   *
+   * The size of the buffers of the pool that the packets of each socket are
+   * received into. The buffers are recycled once downstream is done with
+   * them, instead of allocating one per packet. A datagram bigger than this
+   * can not be received whole, so it should not be smaller than the MTU of
+   * the network. 0 disables the pools.
+   *
+   * The pools are only used when the sockets are read by fsmultiudpsrc,
+   * that is when #FsMulticastStreamTransmitter:receive-threads is not 0,
+   * udpsrc always allocates its own buffers.
+   *
+   * It only applies to the sockets created after it is set.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_MTU,
+      g_param_spec_uint ("receive-mtu",
+          "Receive MTU",
+          "The size of the preallocated receive buffers (0 to allocate one"
+          " per packet)",
+          0, 65536,
+          DEFAULT_RECEIVE_MTU,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsMulticastTransmitter:receive-buffers:
+   *
+   * The number of buffers preallocated in the receive pool of each RTP
+   * socket. The pool grows if more packets are held downstream at once, so
+   * this should match how many packets of the media are usually in flight.
+   * The RTCP sockets preallocate at most 2.
+   *
+   * It only applies to the sockets created after it is set.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BUFFERS,
+      g_param_spec_uint ("receive-buffers",
+          "Receive buffers",
+          "The number of receive buffers preallocated per socket",
+          0, G_MAXUINT,
+          DEFAULT_RECEIVE_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsMulticastTransmitter:send-bitrate:
+   *
+   * The bitrate at which the RTP packets are sent, in bits per second. The
+   * send buffers of the RTP sockets are sized to hold half a second of it,
+   * but never made smaller than the size the kernel gave them, and they are
+   * resized when it changes by more than a quarter. 0 leaves them as the
+   * kernel made them.
+   *
+   * Going over the net.core.wmem_max sysctl requires CAP_NET_ADMIN.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_SEND_BITRATE,
+      g_param_spec_uint ("send-bitrate",
+          "Send bitrate",
+          "The bitrate the RTP send buffers are sized for, in bits/s"
+          " (0 for the default size)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsMulticastTransmitter:receive-bitrate:
+   *
+   * The bitrate at which the RTP packets are received from the group, in
+   * bits per second. The receive buffers of the RTP sockets are sized from
+   * it like the send buffers are from #FsMulticastTransmitter:send-bitrate.
+   * The #FsMulticastStreamTransmitter:stats property tells how many packets
+   * the kernel dropped because they did not fit.
+   *
+   * Going over the net.core.rmem_max sysctl requires CAP_NET_ADMIN.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BITRATE,
+      g_param_spec_uint ("receive-bitrate",
+          "Receive bitrate",
+          "The bitrate the RTP receive buffers are sized for, in bits/s"
+          " (0 for the default size)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   transmitter_class->new_stream_transmitter =
     fs_multicast_transmitter_new_stream_transmitter;
   transmitter_class->get_stream_transmitter_type =
@@ -225,6 +358,8 @@ fs_multicast_transmitter_init (FsMulticastTransmitter *self)
   self->components = 2;
   g_mutex_init (&self->priv->mutex);
   self->priv->do_timestamp = TRUE;
+  self->priv->receive_mtu = DEFAULT_RECEIVE_MTU;
+  self->priv->receive_buffers = DEFAULT_RECEIVE_BUFFERS;
 }
 
 static void
@@ -452,6 +587,26 @@ fs_multicast_transmitter_get_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       g_value_set_boolean (value, self->priv->do_timestamp);
       break;
+    case PROP_RECEIVE_MTU:
+      FS_MULTICAST_TRANSMITTER_LOCK (self);
+      g_value_set_uint (value, self->priv->receive_mtu);
+      FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+      break;
+    case PROP_RECEIVE_BUFFERS:
+      FS_MULTICAST_TRANSMITTER_LOCK (self);
+      g_value_set_uint (value, self->priv->receive_buffers);
+      FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+      break;
+    case PROP_SEND_BITRATE:
+      FS_MULTICAST_TRANSMITTER_LOCK (self);
+      g_value_set_uint (value, self->priv->send_bitrate);
+      FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+      break;
+    case PROP_RECEIVE_BITRATE:
+      FS_MULTICAST_TRANSMITTER_LOCK (self);
+      g_value_set_uint (value, self->priv->receive_bitrate);
+      FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -477,6 +632,24 @@ fs_multicast_transmitter_set_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       self->priv->do_timestamp = g_value_get_boolean (value);
       break;
+    case PROP_RECEIVE_MTU:
+      FS_MULTICAST_TRANSMITTER_LOCK (self);
+      self->priv->receive_mtu = g_value_get_uint (value);
+      FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+      break;
+    case PROP_RECEIVE_BUFFERS:
+      FS_MULTICAST_TRANSMITTER_LOCK (self);
+      self->priv->receive_buffers = g_value_get_uint (value);
+      FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+      break;
+    case PROP_SEND_BITRATE:
+      fs_multicast_transmitter_set_bitrate (self, FALSE,
+          g_value_get_uint (value));
+      break;
+    case PROP_RECEIVE_BITRATE:
+      fs_multicast_transmitter_set_bitrate (self, TRUE,
+          g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -517,7 +690,9 @@ fs_multicast_transmitter_new_stream_transmitter (FsTransmitter *transmitter,
 
 struct _UdpSock {
 
+  /* Either its own udpsrc or a pad of the shared fsmultiudpsrc */
   GstElement *udpsrc;
+  GstPad *multiudpsrc_pad;
   GstPad *udpsrc_requested_pad;
 
   GstElement *udpsink;
@@ -542,8 +717,63 @@ struct _UdpSock {
   guint component_id;
 
   gint sendcount;
+
+  /* The sizes last asked for the socket buffers, starting with the ones
+   * the kernel gave the socket, which are the smallest they get. Protected
+   * by the transmitter mutex */
+  gint default_rcvbuf;
+  gint default_sndbuf;
+  gint rcvbuf;
+  gint sndbuf;
 };
 
+static gint
+_get_socket_buffer_size (gint fd, gboolean receive)
+{
+  int size = 0;
+  socklen_t len = sizeof (size);
+
+  if (getsockopt (fd, SOL_SOCKET, receive ? SO_RCVBUF : SO_SNDBUF,
+          (void *) &size, &len) < 0)
+    return 0;
+
+  return size;
+}
+
+static void
+_set_socket_buffer_size (gint fd, gboolean receive, gint size)
+{
+#if defined (SO_RCVBUFFORCE) && defined (SO_SNDBUFFORCE)
+  /* Goes over the rmem_max and wmem_max sysctls if we have CAP_NET_ADMIN */
+  if (setsockopt (fd, SOL_SOCKET, receive ? SO_RCVBUFFORCE : SO_SNDBUFFORCE,
+          &size, sizeof (size)) == 0)
+    return;
+#endif
+
+  if (setsockopt (fd, SOL_SOCKET, receive ? SO_RCVBUF : SO_SNDBUF,
+          (const void *) &size, sizeof (size)) < 0)
+    GST_WARNING ("could not set the %s buffer size to %d: %s",
+        receive ? "receive" : "send", size, g_strerror (errno));
+}
+
+/* Returns the number of packets the kernel dropped on the socket, mostly
+ * because its receive buffer was full, the counter that SO_RXQ_OVFL would
+ * attach to every packet */
+static guint
+_get_socket_drops (gint fd)
+{
+#ifdef USE_SO_MEMINFO
+  guint32 meminfo[SK_MEMINFO_VARS];
+  socklen_t len = sizeof (meminfo);
+
+  if (getsockopt (fd, SOL_SOCKET, SO_MEMINFO, meminfo, &len) == 0 &&
+      len > SK_MEMINFO_DROPS * sizeof (guint32))
+    return meminfo[SK_MEMINFO_DROPS];
+#endif
+
+  return 0;
+}
+
 static gboolean
 _ip_string_into_sockaddr_in (const gchar *ip_as_string,
     struct sockaddr_in *sockaddr_in, GError **error)
@@ -695,6 +925,17 @@ _bind_port (
     GST_WARNING ("could not set TCLASS: %s", g_strerror (errno));
 #endif
 
+#ifdef IP_MTU_DISCOVER
+  {
+    int pmtudisc = IP_PMTUDISC_WANT;
+
+    if (setsockopt (sock, IPPROTO_IP, IP_MTU_DISCOVER,
+            &pmtudisc, sizeof (pmtudisc)) < 0)
+      GST_WARNING ("could not enable path MTU discovery: %s",
+          g_strerror (errno));
+  }
+#endif
+
   address.sin_port = htons (port);
   retval = bind (sock, (struct sockaddr *) &address, sizeof (address));
   if (retval != 0)
@@ -712,10 +953,45 @@ _bind_port (
   return -1;
 }
 
+/* A pool of MTU sized buffers for the packets of one socket, or NULL if the
+ * pools are disabled */
+static GstBufferPool *
+_create_receive_pool (FsMulticastTransmitter *trans, guint component_id)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+  guint mtu, buffers;
+
+  FS_MULTICAST_TRANSMITTER_LOCK (trans);
+  mtu = trans->priv->receive_mtu;
+  buffers = trans->priv->receive_buffers;
+  FS_MULTICAST_TRANSMITTER_UNLOCK (trans);
+
+  if (mtu == 0)
+    return NULL;
+
+  if (component_id == FS_COMPONENT_RTCP)
+    buffers = MIN (buffers, RTCP_RECEIVE_BUFFERS);
+
+  pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  /* No maximum, a burst must never block the receiving thread */
+  gst_buffer_pool_config_set_params (config, NULL, mtu, buffers, 0);
+  if (!gst_buffer_pool_set_config (pool, config)) {
+    GST_WARNING ("Could not configure a receive pool of %u buffers of %u"
+        " bytes", buffers, mtu);
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
 static GstElement *
 _create_sinksource (gchar *elementname, GstBin *bin,
     GstElement *teefunnel, GSocket *socket,
-    GstPadDirection direction, GstPad **requested_pad, GError **error)
+    GstPadDirection direction,
+    GstPad **requested_pad, GError **error)
 {
   GstElement *elem;
   GstPadLinkReturn ret = GST_PAD_LINK_OK;
@@ -810,6 +1086,40 @@ _create_sinksource (gchar *elementname, GstBin *bin,
   return NULL;
 }
 
+static GstPad *
+_create_multiudpsrc_pad (FsMulticastTransmitter *trans,
+    GstElement *funnel,
+    GSocket *socket,
+    guint receive_threads,
+    GstBufferPool *pool,
+    GstPad **requested_pad,
+    GError **error)
+{
+  GstElement *multiudpsrc;
+  GstPad *pad;
+
+  FS_MULTICAST_TRANSMITTER_LOCK (trans);
+  if (!trans->priv->multiudpsrc)
+  {
+    trans->priv->multiudpsrc = fs_multiudpsrc_new (
+        GST_BIN (trans->priv->gst_src), receive_threads,
+        trans->priv->do_timestamp, FALSE, error);
+    if (!trans->priv->multiudpsrc)
+    {
+      FS_MULTICAST_TRANSMITTER_UNLOCK (trans);
+      return NULL;
+    }
+  }
+  multiudpsrc = gst_object_ref (trans->priv->multiudpsrc);
+  FS_MULTICAST_TRANSMITTER_UNLOCK (trans);
+
+  pad = fs_multiudpsrc_request_pad (multiudpsrc, funnel, socket, pool,
+      requested_pad, error);
+
+  gst_object_unref (multiudpsrc);
+  return pad;
+}
+
 static UdpSock *
 fs_multicast_transmitter_get_udpsock_locked (FsMulticastTransmitter *trans,
     guint component_id,
@@ -864,11 +1174,13 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
     guint16 port,
     guint8 ttl,
     gboolean sending,
+    guint receive_threads,
     GError **error)
 {
   UdpSock *udpsock;
   UdpSock *tmpudpsock;
   GError *local_error = NULL;
+  GstBufferPool *pool;
   int tos;
 
   /* First lets check if we already have one */
@@ -919,20 +1231,42 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
   if (!udpsock->socket)
     goto error;
 
+  udpsock->default_rcvbuf =
+    _get_socket_buffer_size (udpsock->fd, TRUE) / SOCKET_BUFFER_OVERHEAD;
+  udpsock->default_sndbuf =
+    _get_socket_buffer_size (udpsock->fd, FALSE) / SOCKET_BUFFER_OVERHEAD;
+  udpsock->rcvbuf = udpsock->default_rcvbuf;
+  udpsock->sndbuf = udpsock->default_sndbuf;
+
   /* Now lets create the elements */
 
   udpsock->tee = trans->priv->udpsink_tees[component_id];
   udpsock->funnel = trans->priv->udpsrc_funnels[component_id];
 
-  udpsock->udpsrc = _create_sinksource ("udpsrc",
-      GST_BIN (trans->priv->gst_src), udpsock->funnel, udpsock->socket,
-      GST_PAD_SRC, &udpsock->udpsrc_requested_pad, error);
-  if (!udpsock->udpsrc)
+  if (receive_threads)
+  {
+    /* Only fsmultiudpsrc receives into the pool */
+    pool = _create_receive_pool (trans, component_id);
+    udpsock->multiudpsrc_pad = _create_multiudpsrc_pad (trans,
+        udpsock->funnel, udpsock->socket, receive_threads, pool,
+        &udpsock->udpsrc_requested_pad, error);
+    if (pool)
+      gst_object_unref (pool);
+  }
+  else
+  {
+    udpsock->udpsrc = _create_sinksource ("udpsrc",
+        GST_BIN (trans->priv->gst_src), udpsock->funnel, udpsock->socket,
+        GST_PAD_SRC, &udpsock->udpsrc_requested_pad, error);
+  }
+
+  if (!udpsock->multiudpsrc_pad && !udpsock->udpsrc)
     goto error;
 
   udpsock->udpsink = _create_sinksource ("multiudpsink",
       GST_BIN (trans->priv->gst_sink), udpsock->tee,
-      udpsock->socket, GST_PAD_SINK, &udpsock->udpsink_requested_pad, error);
+      udpsock->socket, GST_PAD_SINK, &udpsock->udpsink_requested_pad,
+      error);
   if (!udpsock->udpsink)
     goto error;
 
@@ -962,6 +1296,7 @@ fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
 
   trans->priv->udpsocks[component_id] =
     g_list_prepend (trans->priv->udpsocks[component_id], udpsock);
+  _udpsock_update_buffer_sizes_locked (trans, udpsock);
   FS_MULTICAST_TRANSMITTER_UNLOCK (trans);
 
   if (sending)
@@ -1031,6 +1366,9 @@ fs_multicast_transmitter_put_udpsock (FsMulticastTransmitter *trans,
 
   FS_MULTICAST_TRANSMITTER_UNLOCK (trans);
 
+  if (udpsock->multiudpsrc_pad)
+    fs_multiudpsrc_release_pad (udpsock->multiudpsrc_pad);
+
   if (udpsock->udpsrc)
   {
     GstStateChangeReturn ret;
@@ -1107,6 +1445,85 @@ fs_multicast_transmitter_udpsock_dec_sending (UdpSock *udpsock)
   }
 }
 
+/**
+ * fs_multicast_transmitter_udpsock_get_path_mtu:
+ * @udpsock: a #UdpSock
+ *
+ * Asks the kernel for the MTU of the route to the multicast group, from the
+ * local address of @udpsock. Routers do not report smaller MTUs for
+ * multicast packets, so that is the MTU of the outgoing interface.
+ *
+ * Returns: the largest UDP payload that fits in the MTU, or 0 if it is not
+ * known
+ */
+guint
+fs_multicast_transmitter_udpsock_get_path_mtu (UdpSock *udpsock)
+{
+#ifdef IP_MTU
+  struct sockaddr_in address;
+  int sock;
+  int mtu = 0;
+  socklen_t mtulen = sizeof (mtu);
+
+  if ((sock = socket (AF_INET, SOCK_DGRAM, IPPROTO_UDP)) < 0)
+    return 0;
+
+  if (udpsock->local_ip)
+  {
+    if (!_ip_string_into_sockaddr_in (udpsock->local_ip, &address, NULL))
+      goto error;
+    address.sin_port = 0;
+    if (bind (sock, (struct sockaddr *) &address, sizeof (address)) < 0)
+      goto error;
+  }
+
+  if (!_ip_string_into_sockaddr_in (udpsock->multicast_ip, &address, NULL))
+    goto error;
+  address.sin_port = htons (udpsock->port);
+
+  /* Connecting a UDP socket sends nothing, it only looks up the route */
+  if (connect (sock, (struct sockaddr *) &address, sizeof (address)) < 0 ||
+      getsockopt (sock, IPPROTO_IP, IP_MTU, &mtu, &mtulen) < 0)
+  {
+    GST_DEBUG ("Could not get the MTU to %s: %s", udpsock->multicast_ip,
+        g_strerror (errno));
+    mtu = 0;
+  }
+
+ error:
+  close (sock);
+
+  if (mtu <= IPV4_UDP_HEADERS)
+    return 0;
+
+  /* The total length of the packet is 16 bits */
+  return MIN (mtu, G_MAXUINT16) - IPV4_UDP_HEADERS;
+#else
+  return 0;
+#endif
+}
+
+/**
+ * fs_multicast_transmitter_udpsock_get_socket_stats:
+ * @udpsock: a #UdpSock
+ * @receive_drops: (out): the number of packets the kernel dropped
+ * @receive_buffer_size: (out): the size of the receive buffer
+ * @send_buffer_size: (out): the size of the send buffer
+ *
+ * Reads the statistics of the socket, the buffer sizes are the ones the
+ * kernel reports.
+ */
+void
+fs_multicast_transmitter_udpsock_get_socket_stats (UdpSock *udpsock,
+    guint *receive_drops,
+    gint *receive_buffer_size,
+    gint *send_buffer_size)
+{
+  *receive_drops = _get_socket_drops (udpsock->fd);
+  *receive_buffer_size = _get_socket_buffer_size (udpsock->fd, TRUE);
+  *send_buffer_size = _get_socket_buffer_size (udpsock->fd, FALSE);
+}
+
 static GType
 fs_multicast_transmitter_get_stream_transmitter_type (
     FsTransmitter *transmitter)
@@ -1159,3 +1576,76 @@ fs_multicast_transmitter_set_type_of_service (FsMulticastTransmitter *self,
  out:
   FS_MULTICAST_TRANSMITTER_UNLOCK (self);
 }
+
+/* Returns the size to ask for a socket buffer that holds SOCKET_BUFFER_TIME
+ * of the bitrate */
+static gint
+_socket_buffer_size_for_bitrate (guint bitrate, gint default_size)
+{
+  guint64 size = gst_util_uint64_scale (bitrate, SOCKET_BUFFER_TIME,
+      8 * GST_SECOND);
+
+  return CLAMP (size, default_size, MAX_SOCKET_BUFFER_SIZE);
+}
+
+/* Sizes within a quarter of the current one are ignored so that a bitrate
+ * that moves a little does not make a system call on every change */
+static gboolean
+_socket_buffer_size_changed (gint old_size, gint new_size)
+{
+  return ABS (new_size - old_size) > old_size / 4;
+}
+
+/* Must be called with the transmitter mutex held */
+static void
+_udpsock_update_buffer_sizes_locked (FsMulticastTransmitter *trans,
+    UdpSock *udpsock)
+{
+  gint size;
+
+  /* The RTCP sockets see too little traffic to need it */
+  if (udpsock->component_id != FS_COMPONENT_RTP)
+    return;
+
+  size = _socket_buffer_size_for_bitrate (trans->priv->receive_bitrate,
+      udpsock->default_rcvbuf);
+  if (_socket_buffer_size_changed (udpsock->rcvbuf, size))
+  {
+    GST_DEBUG ("Resizing the receive buffer of %s:%u from %d to %d",
+        udpsock->multicast_ip, udpsock->port, udpsock->rcvbuf, size);
+    _set_socket_buffer_size (udpsock->fd, TRUE, size);
+    udpsock->rcvbuf = size;
+  }
+
+  size = _socket_buffer_size_for_bitrate (trans->priv->send_bitrate,
+      udpsock->default_sndbuf);
+  if (_socket_buffer_size_changed (udpsock->sndbuf, size))
+  {
+    GST_DEBUG ("Resizing the send buffer of %s:%u from %d to %d",
+        udpsock->multicast_ip, udpsock->port, udpsock->sndbuf, size);
+    _set_socket_buffer_size (udpsock->fd, FALSE, size);
+    udpsock->sndbuf = size;
+  }
+}
+
+static void
+fs_multicast_transmitter_set_bitrate (FsMulticastTransmitter *self,
+    gboolean receive,
+    guint bitrate)
+{
+  GList *item;
+
+  FS_MULTICAST_TRANSMITTER_LOCK (self);
+  if (receive)
+    self->priv->receive_bitrate = bitrate;
+  else
+    self->priv->send_bitrate = bitrate;
+
+  /* The sockets only exist once constructed */
+  if (self->priv->udpsocks)
+    for (item = self->priv->udpsocks[FS_COMPONENT_RTP]; item;
+         item = item->next)
+      _udpsock_update_buffer_sizes_locked (self, item->data);
+
+  FS_MULTICAST_TRANSMITTER_UNLOCK (self);
+}
@@ -94,6 +94,7 @@ UdpSock *fs_multicast_transmitter_get_udpsock (FsMulticastTransmitter *trans,
     guint16 port,
     guint8 ttl,
     gboolean sending,
+    guint receive_threads,
     GError **error);
 
 void fs_multicast_transmitter_put_udpsock (FsMulticastTransmitter *trans,
@@ -106,6 +107,13 @@ void fs_multicast_transmitter_udpsock_dec_sending (UdpSock *udpsock);
 void fs_multicast_transmitter_udpsock_ref (FsMulticastTransmitter *trans,
     UdpSock *udpsock, guint8 ttl);
 
+guint fs_multicast_transmitter_udpsock_get_path_mtu (UdpSock *udpsock);
+
+void fs_multicast_transmitter_udpsock_get_socket_stats (UdpSock *udpsock,
+    guint *receive_drops,
+    gint *receive_buffer_size,
+    gint *send_buffer_size);
+
 
 G_END_DECLS
 
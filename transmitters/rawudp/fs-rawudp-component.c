@@ -57,6 +57,10 @@
 #define DEFAULT_UPNP_MAPPING_TIMEOUT (600)
 #define DEFAULT_UPNP_DISCOVERY_TIMEOUT (2)
 
+/* The kernel forgets learnt path MTUs after 10 minutes, and can learn a
+ * smaller one at any time, so it is asked again regularly */
+#define MTU_REFRESH_INTERVAL (10 * GST_SECOND)
+
 /* Signals */
 enum
 {
@@ -75,6 +79,9 @@ enum
   PROP_COMPONENT,
   PROP_IP,
   PROP_PORT,
+  PROP_RECEIVE_SHARDS,
+  PROP_RECEIVE_THREADS,
+  PROP_RTCP_MUX,
   PROP_STUN_IP,
   PROP_STUN_PORT,
   PROP_STUN_TIMEOUT,
@@ -82,6 +89,7 @@ enum
   PROP_TRANSMITTER,
   PROP_FORCED_CANDIDATE,
   PROP_ASSOCIATE_ON_SOURCE,
+  PROP_MTU,
 #ifdef HAVE_GUPNP
   PROP_UPNP_MAPPING,
   PROP_UPNP_DISCOVERY,
@@ -104,6 +112,9 @@ struct _FsRawUdpComponentPrivate
 
   gchar *ip;
   guint port;
+  guint receive_shards;
+  guint receive_threads;
+  gboolean rtcp_mux;
 
   gchar *stun_ip;
   guint stun_port;
@@ -143,8 +154,6 @@ struct _FsRawUdpComponentPrivate
 
   gulong stun_recv_id;
 
-  gulong buffer_recv_id;
-
   GstClockID stun_timeout_id;
   GThread *stun_timeout_thread;
   gboolean stun_stop;
@@ -153,6 +162,11 @@ struct _FsRawUdpComponentPrivate
 
   gboolean remote_is_unique;
 
+  /* The path MTU to the remote candidate and the periodic clock id that
+   * refreshes it, which holds a reference to the component */
+  guint mtu;
+  GstClockID mtu_refresh_id;
+
 #ifdef HAVE_GUPNP
   GSource *upnp_discovery_timeout_src;
   FsCandidate *local_upnp_candidate;
@@ -211,8 +225,8 @@ static GstPadProbeReturn
 stun_recv_cb (GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
 static gpointer
 stun_timeout_func (gpointer user_data);
-static GstPadProbeReturn
-buffer_recv_cb (GstPad *pad, GstPadProbeInfo *info, gpointer user_data);
+static void
+known_source_packet_cb (GstBuffer *buffer, gpointer user_data);
 
 static void
 remote_is_unique_cb (gboolean unique, GSocketAddress *address,
@@ -302,6 +316,33 @@ fs_rawudp_component_class_init (FsRawUdpComponentClass *klass)
           1, 65535, 7078,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_SHARDS,
+      g_param_spec_uint ("receive-shards",
+          "The number of receive sockets for the local port",
+          "The number of SO_REUSEPORT sockets and threads receiving on the"
+          " local port",
+          1, MAX_RECEIVE_SHARDS, 1,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_THREADS,
+      g_param_spec_uint ("receive-threads",
+          "The number of threads of the shared receive source",
+          "If not 0, the local port is read by the receive source shared by"
+          " the transmitter, which has this many threads, instead of by its"
+          " own udpsrc",
+          0, MAX_RECEIVE_THREADS, 0,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RTCP_MUX,
+      g_param_spec_boolean ("rtcp-mux",
+          "Multiplex this component on the RTP port",
+          "Share the port of the RTP component and receive the RTCP packets"
+          " that arrive on it",
+          FALSE,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
   g_object_class_install_property (gobject_class,
       PROP_STUN_IP,
@@ -354,6 +395,15 @@ fs_rawudp_component_class_init (FsRawUdpComponentClass *klass)
           TRUE,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_MTU,
+      g_param_spec_uint ("mtu",
+          "The path MTU to the remote candidate",
+          "The largest UDP payload that can be sent to the remote candidate"
+          " without being fragmented, 0 if it is not known",
+          0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
 #ifdef HAVE_GUPNP
     g_object_class_install_property (gobject_class,
       PROP_UPNP_MAPPING,
@@ -504,6 +554,7 @@ fs_rawudp_component_init (FsRawUdpComponent *self)
 
   self->priv->sending = TRUE;
   self->priv->port = 7078;
+  self->priv->receive_shards = 1;
 
   self->priv->associate_on_source = TRUE;
 
@@ -538,6 +589,9 @@ fs_rawudp_constructed (GObject *object)
         self->priv->component,
         self->priv->ip,
         self->priv->port,
+        self->priv->receive_shards,
+        self->priv->receive_threads,
+        self->priv->rtcp_mux,
         &self->priv->construction_error);
   if (!self->priv->udpport)
   {
@@ -547,11 +601,6 @@ fs_rawudp_constructed (GObject *object)
     return;
   }
 
-  if (self->priv->associate_on_source)
-    self->priv->buffer_recv_id =
-      fs_rawudp_transmitter_udpport_connect_recv (
-          self->priv->udpport, buffer_recv_cb, self);
-
   GST_CALL_PARENT (G_OBJECT_CLASS, constructed, (object));
 }
 
@@ -611,6 +660,13 @@ fs_rawudp_component_stop (FsRawUdpComponent *self)
     self->priv->stun_timeout_thread = NULL;
   }
 
+  if (self->priv->mtu_refresh_id)
+  {
+    gst_clock_id_unschedule (self->priv->mtu_refresh_id);
+    gst_clock_id_unref (self->priv->mtu_refresh_id);
+    self->priv->mtu_refresh_id = NULL;
+  }
+
   udpport = self->priv->udpport;
   self->priv->udpport = NULL;
 
@@ -628,14 +684,6 @@ fs_rawudp_component_stop (FsRawUdpComponent *self)
     }
 #endif
 
-    if (self->priv->buffer_recv_id)
-    {
-      fs_rawudp_transmitter_udpport_disconnect_recv (
-          udpport,
-          self->priv->buffer_recv_id);
-      self->priv->buffer_recv_id = 0;
-    }
-
     if (self->priv->remote_candidate)
     {
       if (self->priv->sending)
@@ -703,6 +751,11 @@ fs_rawudp_component_get_property (GObject *object,
     case PROP_COMPONENT:
       g_value_set_uint (value, self->priv->component);
       break;
+    case PROP_MTU:
+      FS_RAWUDP_COMPONENT_LOCK (self);
+      g_value_set_uint (value, self->priv->mtu);
+      FS_RAWUDP_COMPONENT_UNLOCK (self);
+      break;
 #ifdef HAVE_GUPNP
     case PROP_UPNP_MAPPING:
       g_value_set_boolean (value, self->priv->upnp_mapping);
@@ -775,6 +828,15 @@ fs_rawudp_component_set_property (GObject *object,
     case PROP_PORT:
       self->priv->port = g_value_get_uint (value);
       break;
+    case PROP_RECEIVE_SHARDS:
+      self->priv->receive_shards = g_value_get_uint (value);
+      break;
+    case PROP_RECEIVE_THREADS:
+      self->priv->receive_threads = g_value_get_uint (value);
+      break;
+    case PROP_RTCP_MUX:
+      self->priv->rtcp_mux = g_value_get_boolean (value);
+      break;
     case PROP_STUN_IP:
       g_free (self->priv->stun_ip);
       self->priv->stun_ip = g_value_dup_string (value);
@@ -830,6 +892,9 @@ fs_rawudp_component_new (
     gboolean associate_on_source,
     const gchar *ip,
     guint port,
+    guint receive_shards,
+    guint receive_threads,
+    gboolean rtcp_mux,
     const gchar *stun_ip,
     guint stun_port,
     guint stun_timeout,
@@ -849,6 +914,9 @@ fs_rawudp_component_new (
       "associate-on-source", associate_on_source,
       "ip", ip,
       "port", port,
+      "receive-shards", receive_shards,
+      "receive-threads", receive_threads,
+      "rtcp-mux", rtcp_mux,
       "stun-ip", stun_ip,
       "stun-port", stun_port,
       "stun-timeout", stun_timeout,
@@ -901,6 +969,90 @@ remote_is_unique_cb (gboolean unique, GSocketAddress *address,
   FS_RAWUDP_COMPONENT_UNLOCK (self);
 }
 
+static void
+fs_rawudp_component_update_mtu (FsRawUdpComponent *self)
+{
+  guint mtu;
+  gboolean changed;
+
+  FS_RAWUDP_COMPONENT_LOCK (self);
+  if (!self->priv->udpport || !self->priv->remote_address)
+  {
+    FS_RAWUDP_COMPONENT_UNLOCK (self);
+    return;
+  }
+
+  mtu = fs_rawudp_transmitter_udpport_get_path_mtu (self->priv->udpport,
+      self->priv->remote_address);
+  changed = (mtu != self->priv->mtu);
+  self->priv->mtu = mtu;
+  FS_RAWUDP_COMPONENT_UNLOCK (self);
+
+  if (changed)
+  {
+    GST_DEBUG ("C:%u path MTU is now %u", self->priv->component, mtu);
+    g_object_notify (G_OBJECT (self), "mtu");
+  }
+}
+
+/**
+ * fs_rawudp_component_get_socket_stats:
+ * @self: a #FsRawUdpComponent
+ * @receive_drops: (out): the number of packets the kernel dropped
+ * @receive_buffer_size: (out): the size of the receive buffer
+ * @send_buffer_size: (out): the size of the send buffer
+ *
+ * Reads the statistics of the socket of the component, see
+ * fs_rawudp_transmitter_udpport_get_socket_stats().
+ *
+ * Returns: %FALSE if the component has no socket
+ */
+gboolean
+fs_rawudp_component_get_socket_stats (FsRawUdpComponent *self,
+    guint *receive_drops,
+    gint *receive_buffer_size,
+    gint *send_buffer_size)
+{
+  FS_RAWUDP_COMPONENT_LOCK (self);
+  if (!self->priv->udpport)
+  {
+    FS_RAWUDP_COMPONENT_UNLOCK (self);
+    return FALSE;
+  }
+
+  fs_rawudp_transmitter_udpport_get_socket_stats (self->priv->udpport,
+      receive_drops, receive_buffer_size, send_buffer_size);
+  FS_RAWUDP_COMPONENT_UNLOCK (self);
+
+  return TRUE;
+}
+
+static gboolean
+_mtu_refresh (GstClock *clock, GstClockTime time, GstClockID id,
+    gpointer user_data)
+{
+  fs_rawudp_component_update_mtu (FS_RAWUDP_COMPONENT (user_data));
+
+  return TRUE;
+}
+
+/* Must be called with the lock held */
+static void
+fs_rawudp_component_start_mtu_refresh_locked (FsRawUdpComponent *self)
+{
+  GstClock *sysclock;
+
+  if (self->priv->mtu_refresh_id)
+    return;
+
+  sysclock = gst_system_clock_obtain ();
+  self->priv->mtu_refresh_id = gst_clock_new_periodic_id (sysclock,
+      gst_clock_get_time (sysclock) + MTU_REFRESH_INTERVAL,
+      MTU_REFRESH_INTERVAL);
+  gst_clock_id_wait_async (self->priv->mtu_refresh_id, _mtu_refresh,
+      g_object_ref (self), g_object_unref);
+  gst_object_unref (sysclock);
+}
 
 gboolean
 fs_rawudp_component_set_remote_candidate (FsRawUdpComponent *self,
@@ -955,7 +1107,11 @@ fs_rawudp_component_set_remote_candidate (FsRawUdpComponent *self,
 
   self->priv->remote_is_unique =
     fs_rawudp_transmitter_udpport_add_known_address (self->priv->udpport,
-        self->priv->remote_address, remote_is_unique_cb, self);
+        self->priv->remote_address, remote_is_unique_cb,
+        self->priv->associate_on_source ? known_source_packet_cb : NULL,
+        self);
+
+  fs_rawudp_component_start_mtu_refresh_locked (self);
 
   FS_RAWUDP_COMPONENT_UNLOCK (self);
 
@@ -972,6 +1128,8 @@ fs_rawudp_component_set_remote_candidate (FsRawUdpComponent *self,
     fs_candidate_destroy (old_candidate);
   }
 
+  fs_rawudp_component_update_mtu (self);
+
   fs_rawudp_component_maybe_new_active_candidate_pair (self);
 
   return TRUE;
@@ -1661,36 +1819,14 @@ fs_rawudp_component_emit_candidate (FsRawUdpComponent *self,
 }
 
 /*
- * This is a has "have-data" signal handler, so we return %TRUE to not
- * drop the buffer
+ * Called by the UdpPort for every packet received from our remote address
+ * while it is unique
  */
-static GstPadProbeReturn
-buffer_recv_cb (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+static void
+known_source_packet_cb (GstBuffer *buffer, gpointer user_data)
 {
   FsRawUdpComponent *self = FS_RAWUDP_COMPONENT (user_data);
-  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
-  GstNetAddressMeta *netmeta = gst_buffer_get_net_address_meta (buffer);
-
-  if (netmeta)
-  {
-    FS_RAWUDP_COMPONENT_LOCK (self);
-    if (self->priv->remote_is_unique &&
-        fs_g_inet_socket_address_equal (self->priv->remote_address,
-            netmeta->addr))
-    {
-      FS_RAWUDP_COMPONENT_UNLOCK (self);
-      g_signal_emit (self, signals[KNOWN_SOURCE_PACKET_RECEIVED], 0,
-          self->priv->component, buffer);
-    }
-    else
-    {
-      FS_RAWUDP_COMPONENT_UNLOCK (self);
-    }
-  }
-  else
-  {
-    GST_WARNING ("received buffer that does not contain a GstNetAddressMeta");
-  }
 
-  return GST_PAD_PROBE_OK;
+  g_signal_emit (self, signals[KNOWN_SOURCE_PACKET_RECEIVED], 0,
+      self->priv->component, buffer);
 }
@@ -59,6 +59,8 @@ typedef struct _FsRawUdpComponentPrivate FsRawUdpComponentPrivate;
 
 #define MAX_STUN_TIMEOUT (60)
 #define DEFAULT_STUN_TIMEOUT (30)
+#define MAX_RECEIVE_SHARDS (64)
+#define MAX_RECEIVE_THREADS (64)
 
 
 /**
@@ -100,6 +102,9 @@ fs_rawudp_component_new (
     gboolean associate_on_source,
     const gchar *ip,
     guint port,
+    guint receive_shards,
+    guint receive_threads,
+    gboolean rtcp_mux,
     const gchar *stun_ip,
     guint stun_port,
     guint stun_timeout,
@@ -123,6 +128,12 @@ fs_rawudp_component_gather_local_candidates (FsRawUdpComponent *self,
 void
 fs_rawudp_component_stop (FsRawUdpComponent *self);
 
+gboolean
+fs_rawudp_component_get_socket_stats (FsRawUdpComponent *self,
+    guint *receive_drops,
+    gint *receive_buffer_size,
+    gint *send_buffer_size);
+
 G_END_DECLS
 
 #endif /* __FS_RAWUDP_COMPONENT_H__ */
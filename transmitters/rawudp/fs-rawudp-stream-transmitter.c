@@ -55,6 +55,34 @@
  * ({component_id=RTP, ip=IP, port=9080},{component_id=RTCP, ip=IP, port=9081}).
  * The default port starts at 7078 for the first component.
  *
+ * On busy ports, the #FsRawUdpStreamTransmitter:receive-shards property
+ * can be used to receive on several SO_REUSEPORT sockets, each read from its
+ * own thread. The kernel keeps all the packets from one remote address on
+ * the same socket, so they are not reordered.
+ *
+ * Servers can put every stream of a session on a single local port by
+ * giving all of them the same preferred local candidates: the streams then
+ * share one socket and receive thread, and the incoming packets are
+ * associated with each stream by a hash lookup on their source address. With
+ * the #FsRawUdpStreamTransmitter:rtcp-mux property, the RTCP is also sent and
+ * received on that port.
+ *
+ * Servers with many ports that are mostly idle can set the
+ * #FsRawUdpStreamTransmitter:receive-threads property. The ports of those
+ * streams are then all read by one fsmultiudpsrc element, which waits on
+ * them with epoll from a few threads, instead of by one udpsrc thread each.
+ *
+ * The sockets do path MTU discovery, and the #FsRawUdpStreamTransmitter:mtu
+ * property tells how large the RTP packets sent to the remote candidate can
+ * be without being fragmented. It is checked again every few seconds and
+ * notified when it changes.
+ *
+ * The socket buffers are sized from the bitrates given to the transmitter
+ * with its #FsRawUdpTransmitter:send-bitrate and
+ * #FsRawUdpTransmitter:receive-bitrate properties. The
+ * #FsRawUdpStreamTransmitter:stats property tells how many packets the
+ * kernel dropped because they did not fit.
+ *
  * The name of this transmitter is "rawudp".
  */
 
@@ -99,6 +127,11 @@ enum
   PROP_STUN_IP,
   PROP_STUN_PORT,
   PROP_STUN_TIMEOUT,
+  PROP_RECEIVE_SHARDS,
+  PROP_RECEIVE_THREADS,
+  PROP_RTCP_MUX,
+  PROP_MTU,
+  PROP_STATS,
   PROP_UPNP_MAPPING,
   PROP_UPNP_DISCOVERY,
   PROP_UPNP_MAPPING_TIMEOUT,
@@ -124,6 +157,10 @@ struct _FsRawUdpStreamTransmitterPrivate
   guint stun_port;
   guint stun_timeout;
 
+  guint receive_shards;
+  guint receive_threads;
+  gboolean rtcp_mux;
+
   GList *preferred_local_candidates;
   guint next_candidate_id;
 
@@ -197,6 +234,9 @@ _component_error (FsRawUdpComponent *component,
 static void
 _component_known_source_packet_received (FsRawUdpComponent *component,
     guint component_id, GstBuffer *buffer, gpointer user_data);
+static void
+_component_mtu_changed (FsRawUdpComponent *component, GParamSpec *pspec,
+    gpointer user_data);
 
 static GObjectClass *parent_class = NULL;
 // static guint signals[LAST_SIGNAL] = { 0 };
@@ -280,6 +320,76 @@ fs_rawudp_stream_transmitter_class_init (FsRawUdpStreamTransmitterClass *klass)
           1, MAX_STUN_TIMEOUT, DEFAULT_STUN_TIMEOUT,
           G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_SHARDS,
+      g_param_spec_uint ("receive-shards",
+          "The number of receive sockets per local port",
+          "The number of SO_REUSEPORT sockets, each with its own thread,"
+          " receiving on each local port. Packets from one remote address"
+          " are always received by the same socket. If the port is already"
+          " used by another stream, its existing sockets are shared",
+          1, MAX_RECEIVE_SHARDS, 1,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_THREADS,
+      g_param_spec_uint ("receive-threads",
+          "The number of threads of the shared receive source",
+          "If not 0, the local ports are read by a receive source shared by"
+          " all the streams of the transmitter that also set this property,"
+          " using epoll on this many threads, instead of each having its own"
+          " udpsrc thread. The first stream to use it picks the number of"
+          " threads",
+          0, MAX_RECEIVE_THREADS, 0,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_RTCP_MUX,
+      g_param_spec_boolean ("rtcp-mux",
+          "Multiplex RTCP on the RTP port",
+          "Send and receive RTCP on the local RTP port (RFC 5761). The RTCP"
+          " candidates then use the RTP port and STUN and UPnP are only"
+          " done for the RTP component",
+          FALSE,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class,
+      PROP_MTU,
+      g_param_spec_uint ("mtu",
+          "The path MTU to the remote RTP candidate",
+          "The largest UDP payload that can be sent to the remote RTP"
+          " candidate without being fragmented, as found by path MTU"
+          " discovery, 0 if it is not known yet",
+          0, G_MAXUINT, 0,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpStreamTransmitter:stats:
+   *
+   * The statistics of the sockets, in a #GstStructure named
+   * "application/x-fs-udp-stats". For each component N that has a socket,
+   * it has the fields:
+   *
+   * "componentN-receive-drops" (#guint): the number of packets the kernel
+   * dropped on the socket, mostly because the receive buffer was full, as
+   * counted by SO_RXQ_OVFL. It is 0 where the kernel can not tell.
+   *
+   * "componentN-receive-buffer-size" (#gint): the size of the receive
+   * buffer
+   *
+   * "componentN-send-buffer-size" (#gint): the size of the send buffer
+   *
+   * The socket is shared by all the streams that use the same local port,
+   * so are its statistics.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_STATS,
+      g_param_spec_boxed ("stats",
+          "Socket statistics",
+          "The drop counters and buffer sizes of the sockets",
+          GST_TYPE_STRUCTURE,
+          G_PARAM_READABLE | G_PARAM_STATIC_STRINGS));
+
   g_object_class_install_property (gobject_class,
       PROP_UPNP_MAPPING,
       g_param_spec_boolean ("upnp-mapping",
@@ -342,6 +452,7 @@ fs_rawudp_stream_transmitter_init (FsRawUdpStreamTransmitter *self)
 
   self->priv->sending = TRUE;
   self->priv->associate_on_source = TRUE;
+  self->priv->receive_shards = 1;
 
 #ifdef HAVE_GUPNP
   self->priv->upnp_mapping = TRUE;
@@ -369,6 +480,9 @@ fs_rawudp_stream_transmitter_dispose (GObject *object)
     {
       if (self->priv->component[c])
       {
+        /* The MTU refresh can keep the component alive a bit longer */
+        g_signal_handlers_disconnect_by_func (self->priv->component[c],
+            _component_mtu_changed, self);
         g_object_unref (self->priv->component[c]);
         self->priv->component[c] = NULL;
       }
@@ -412,6 +526,42 @@ fs_rawudp_stream_transmitter_finalize (GObject *object)
   parent_class->finalize (object);
 }
 
+static GstStructure *
+fs_rawudp_stream_transmitter_get_stats (FsRawUdpStreamTransmitter *self)
+{
+  GstStructure *stats = gst_structure_new_empty ("application/x-fs-udp-stats");
+  guint c;
+
+  if (!self->priv->component)
+    return stats;
+
+  for (c = 1; c <= self->priv->transmitter->components; c++)
+  {
+    guint drops;
+    gint rcvbuf, sndbuf;
+    gchar *drops_name, *rcvbuf_name, *sndbuf_name;
+
+    if (!self->priv->component[c] ||
+        !fs_rawudp_component_get_socket_stats (self->priv->component[c],
+            &drops, &rcvbuf, &sndbuf))
+      continue;
+
+    drops_name = g_strdup_printf ("component%u-receive-drops", c);
+    rcvbuf_name = g_strdup_printf ("component%u-receive-buffer-size", c);
+    sndbuf_name = g_strdup_printf ("component%u-send-buffer-size", c);
+    gst_structure_set (stats,
+        drops_name, G_TYPE_UINT, drops,
+        rcvbuf_name, G_TYPE_INT, rcvbuf,
+        sndbuf_name, G_TYPE_INT, sndbuf,
+        NULL);
+    g_free (drops_name);
+    g_free (rcvbuf_name);
+    g_free (sndbuf_name);
+  }
+
+  return stats;
+}
+
 static void
 fs_rawudp_stream_transmitter_get_property (GObject *object,
     guint prop_id,
@@ -440,6 +590,26 @@ fs_rawudp_stream_transmitter_get_property (GObject *object,
     case PROP_STUN_TIMEOUT:
       g_value_set_uint (value, self->priv->stun_timeout);
       break;
+    case PROP_RECEIVE_SHARDS:
+      g_value_set_uint (value, self->priv->receive_shards);
+      break;
+    case PROP_RECEIVE_THREADS:
+      g_value_set_uint (value, self->priv->receive_threads);
+      break;
+    case PROP_RTCP_MUX:
+      g_value_set_boolean (value, self->priv->rtcp_mux);
+      break;
+    case PROP_MTU:
+      if (self->priv->component && self->priv->component[FS_COMPONENT_RTP])
+        g_object_get_property (
+            G_OBJECT (self->priv->component[FS_COMPONENT_RTP]), "mtu", value);
+      else
+        g_value_set_uint (value, 0);
+      break;
+    case PROP_STATS:
+      g_value_take_boxed (value,
+          fs_rawudp_stream_transmitter_get_stats (self));
+      break;
 #ifdef HAVE_GUPNP
     case PROP_UPNP_MAPPING:
       g_value_set_boolean (value, self->priv->upnp_mapping);
@@ -503,6 +673,15 @@ fs_rawudp_stream_transmitter_set_property (GObject *object,
     case PROP_STUN_TIMEOUT:
       self->priv->stun_timeout = g_value_get_uint (value);
       break;
+    case PROP_RECEIVE_SHARDS:
+      self->priv->receive_shards = g_value_get_uint (value);
+      break;
+    case PROP_RECEIVE_THREADS:
+      self->priv->receive_threads = g_value_get_uint (value);
+      break;
+    case PROP_RTCP_MUX:
+      self->priv->rtcp_mux = g_value_get_boolean (value);
+      break;
 #ifdef HAVE_GUPNP
     case PROP_UPNP_MAPPING:
       self->priv->upnp_mapping = g_value_get_boolean (value);
@@ -540,6 +719,7 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
   GList *item;
   gint c;
   guint16 next_port;
+  guint rtp_port = 0;
 
 #ifdef HAVE_GUPNP
   if (self->priv->upnp_mapping ||
@@ -609,22 +789,32 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
   {
     gint requested_port = ports[c];
     guint used_port;
+    gboolean rtcp_mux = (self->priv->rtcp_mux && c == FS_COMPONENT_RTCP);
 
     if (!requested_port)
       requested_port = next_port;
 
+    /* The RTCP component shares the port the RTP component got */
+    if (rtcp_mux)
+    {
+      ips[c] = ips[FS_COMPONENT_RTP];
+      requested_port = rtp_port;
+    }
 
     self->priv->component[c] = fs_rawudp_component_new (c,
         self->priv->transmitter,
         self->priv->associate_on_source,
         ips[c],
         requested_port,
-        self->priv->stun_ip,
+        self->priv->receive_shards,
+        self->priv->receive_threads,
+        rtcp_mux,
+        rtcp_mux ? NULL : self->priv->stun_ip,
         self->priv->stun_port,
         self->priv->stun_timeout,
 #ifdef HAVE_GUPNP
-        self->priv->upnp_mapping,
-        self->priv->upnp_discovery,
+        self->priv->upnp_mapping && !rtcp_mux,
+        self->priv->upnp_discovery && !rtcp_mux,
         self->priv->upnp_mapping_timeout,
         self->priv->upnp_discovery_timeout,
         self->priv->upnp_igd,
@@ -646,6 +836,9 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
         G_CALLBACK (_component_error), self);
     g_signal_connect (self->priv->component[c], "known-source-packet-received",
         G_CALLBACK (_component_known_source_packet_received), self);
+    if (c == FS_COMPONENT_RTP)
+      g_signal_connect (self->priv->component[c], "notify::mtu",
+          G_CALLBACK (_component_mtu_changed), self);
 
     /* If we dont get the requested port and it wasnt a forced port,
      * then we rewind up to the last forced port and jump to the next
@@ -675,6 +868,9 @@ fs_rawudp_stream_transmitter_build (FsRawUdpStreamTransmitter *self,
       fs_candidate_destroy (forced);
     }
 
+    if (c == FS_COMPONENT_RTP)
+      rtp_port = used_port;
+
     next_port = used_port+1;
   }
 
@@ -762,6 +958,36 @@ fs_rawudp_stream_transmitter_force_remote_candidates (
       return FALSE;
   }
 
+  /* With RTCP-mux, the remote RTCP is on the remote RTP port unless
+   * the caller gave us a RTCP candidate */
+  if (self->priv->rtcp_mux &&
+      self->priv->transmitter->components >= FS_COMPONENT_RTCP)
+  {
+    FsCandidate *rtp_candidate = NULL;
+
+    for (item = candidates; item; item = g_list_next (item))
+    {
+      FsCandidate *candidate = item->data;
+
+      if (candidate->component_id == FS_COMPONENT_RTCP)
+        return TRUE;
+      if (candidate->component_id == FS_COMPONENT_RTP)
+        rtp_candidate = candidate;
+    }
+
+    if (rtp_candidate)
+    {
+      FsCandidate *rtcp_candidate = fs_candidate_copy (rtp_candidate);
+      gboolean ret;
+
+      rtcp_candidate->component_id = FS_COMPONENT_RTCP;
+      ret = fs_rawudp_component_set_remote_candidate (
+          self->priv->component[FS_COMPONENT_RTCP], rtcp_candidate, error);
+      fs_candidate_destroy (rtcp_candidate);
+      return ret;
+    }
+  }
+
   return TRUE;
 }
 
@@ -903,3 +1129,11 @@ _component_known_source_packet_received (FsRawUdpComponent *component,
       buffer);
 }
 
+static void
+_component_mtu_changed (FsRawUdpComponent *component, GParamSpec *pspec,
+    gpointer user_data)
+{
+  FsRawUdpStreamTransmitter *self = FS_RAWUDP_STREAM_TRANSMITTER (user_data);
+
+  g_object_notify (G_OBJECT (self), "mtu");
+}
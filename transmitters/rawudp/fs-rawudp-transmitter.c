@@ -36,22 +36,70 @@
 
 #include "fs-rawudp-transmitter.h"
 #include "fs-rawudp-stream-transmitter.h"
+#include "fs-multiudpsrc-pad.h"
 
 #include <farstream/fs-conference.h>
 #include <farstream/fs-plugin.h>
 
+#include <gst/net/gstnetaddressmeta.h>
+
 #include <gio/gio.h>
 
+#include <errno.h>
 #include <string.h>
+#include <time.h>
 #include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
 
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
 
+#ifdef HAVE_LINUX_NET_TSTAMP_H
+# include <linux/net_tstamp.h>
+# ifdef SO_TXTIME
+#  define USE_SO_TXTIME
+# endif
+#endif
+
+#ifdef HAVE_LINUX_SOCK_DIAG_H
+# include <linux/sock_diag.h>
+# ifdef SO_MEMINFO
+#  define USE_SO_MEMINFO
+# endif
+#endif
+
 GST_DEBUG_CATEGORY (fs_rawudp_transmitter_debug);
 #define GST_CAT_DEFAULT fs_rawudp_transmitter_debug
 
+/* An ethernet frame */
+#define DEFAULT_RECEIVE_MTU 1500
+#define DEFAULT_RECEIVE_BUFFERS 16
+/* RTCP only has a few packets per second */
+#define RTCP_RECEIVE_BUFFERS 2
+
+/* Buffers with more memories than this go through the udpsink */
+#define MAX_SEND_MEMORIES 16
+
+/* The IP and UDP headers that the path MTU has to hold */
+#define IPV4_UDP_HEADERS (20 + 8)
+#define IPV6_UDP_HEADERS (40 + 8)
+
+/* The socket buffers of the RTP ports are sized to hold this much of the
+ * bitrate, so that the kernel does not drop the packets of a keyframe while
+ * the receive thread is not scheduled */
+#define SOCKET_BUFFER_TIME (GST_SECOND / 2)
+#define MAX_SOCKET_BUFFER_SIZE (16 * 1024 * 1024)
+
+#ifdef __linux__
+/* Linux doubles the size it is asked for to leave room for its own
+ * bookkeeping, and reports the doubled size */
+# define SOCKET_BUFFER_OVERHEAD 2
+#else
+# define SOCKET_BUFFER_OVERHEAD 1
+#endif
+
 /* Signals */
 enum
 {
@@ -66,7 +114,15 @@ enum
   PROP_GST_SRC,
   PROP_COMPONENTS,
   PROP_TYPE_OF_SERVICE,
-  PROP_DO_TIMESTAMP
+  PROP_DO_TIMESTAMP,
+  PROP_IO_URING,
+  PROP_RECEIVE_MTU,
+  PROP_RECEIVE_BUFFERS,
+  PROP_PACED_SENDING,
+  PROP_KERNEL_PACING,
+  PROP_SEND_BITRATE,
+  PROP_RECEIVE_BITRATE,
+  PROP_CONNECT_SINGLE_DESTINATION
 };
 
 struct _FsRawUdpTransmitterPrivate
@@ -84,9 +140,31 @@ struct _FsRawUdpTransmitterPrivate
   GMutex mutex;
   /* Protected by the mutex */
   GList **udpports;
+  /* Created by the first port that wants a shared receive source */
+  GstElement *multiudpsrc;
 
   gint type_of_service;
   gboolean do_timestamp;
+  gboolean io_uring;
+  /* Protected by the mutex */
+  guint receive_mtu;
+  guint receive_buffers;
+  guint send_bitrate;
+  guint receive_bitrate;
+  gboolean connect_single_destination;
+
+  /* Read without the mutex by the send probes */
+  volatile gint paced_sending;
+  volatile gint kernel_pacing;
+
+  /* Sends the paced packets that the kernel can not hold back, started by
+   * the first one. Everything is protected by pacer_mutex, the queue of
+   * struct PacedPacket is sorted by deadline */
+  GMutex pacer_mutex;
+  GCond pacer_cond;
+  GThread *pacer_thread;
+  GQueue pacer_queue;
+  gboolean pacer_stop;
 
   gboolean disposed;
 };
@@ -122,6 +200,11 @@ static GType fs_rawudp_transmitter_get_stream_transmitter_type (
 static void fs_rawudp_transmitter_set_type_of_service (
     FsRawUdpTransmitter *self,
     gint tos);
+static void fs_rawudp_transmitter_set_bitrate (FsRawUdpTransmitter *self,
+    gboolean receive,
+    guint bitrate);
+static void _udpport_update_buffer_sizes_locked (FsRawUdpTransmitter *trans,
+    UdpPort *udpport);
 
 
 static GObjectClass *parent_class = NULL;
@@ -193,6 +276,179 @@ fs_rawudp_transmitter_class_init (FsRawUdpTransmitterClass *klass)
   g_object_class_override_property (gobject_class, PROP_DO_TIMESTAMP,
       "do-timestamp");
 
+  /**
+   * FsRawUdpTransmitter:io-uring:
+   *
+   * Send with the fsuringudpsink element and receive with a shared
+   * fsmultiudpsrc in io-uring mode, instead of using a multiudpsink and
+   * a udpsrc per port. This is what the "uring" transmitter is made of.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_IO_URING,
+      g_param_spec_boolean ("io-uring",
+          "Use io_uring",
+          "Send and receive the packets through io_uring",
+          FALSE,
+          G_PARAM_CONSTRUCT_ONLY | G_PARAM_READWRITE |
+          G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:receive-mtu:
+   *
+   * The size of the buffers of the pool that the packets of each port are
+   * received into. The buffers are recycled once downstream is done with
+   * them, instead of allocating one per packet. A datagram bigger than this
+   * can not be received whole, so it should not be smaller than the MTU of
+   * the network. 0 disables the pools.
+   *
+   * The pools are only used when the ports are read by fsmultiudpsrc, that
+   * is when #FsRawUdpStreamTransmitter:receive-threads is not 0 or with
+   * #FsRawUdpTransmitter:io-uring, udpsrc always allocates its own buffers.
+   *
+   * It only applies to the ports created after it is set.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_MTU,
+      g_param_spec_uint ("receive-mtu",
+          "Receive MTU",
+          "The size of the preallocated receive buffers (0 to allocate one"
+          " per packet)",
+          0, 65536,
+          DEFAULT_RECEIVE_MTU,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:receive-buffers:
+   *
+   * The number of buffers preallocated in the receive pool of each RTP
+   * port. The pool grows if more packets are held downstream at once, for
+   * example by a jitterbuffer, so this should match how many packets of the
+   * media are usually in flight: a few for audio, more for video. The RTCP
+   * ports preallocate at most 2.
+   *
+   * It only applies to the ports created after it is set.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BUFFERS,
+      g_param_spec_uint ("receive-buffers",
+          "Receive buffers",
+          "The number of receive buffers preallocated per port",
+          0, G_MAXUINT,
+          DEFAULT_RECEIVE_BUFFERS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:paced-sending:
+   *
+   * Send the packets that carry a #FsSendTimeMeta at the time it gives,
+   * instead of right away, and answer the queries made with
+   * fs_send_time_query_new() so that the rate controller upstream stops
+   * holding them back itself. The packets are handed to the kernel with
+   * their departure time if #FsRawUdpTransmitter:kernel-pacing allows it,
+   * or sent by a pacer thread otherwise. It does nothing in io-uring mode.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_PACED_SENDING,
+      g_param_spec_boolean ("paced-sending",
+          "Paced sending",
+          "Send the packets at the time of their FsSendTimeMeta",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:kernel-pacing:
+   *
+   * Pace the sending with SO_TXTIME where the kernel supports it, so that
+   * no thread has to wake up for every packet. If it is %FALSE or SO_TXTIME
+   * is not supported, a pacer thread sends them.
+   *
+   * The departure time is only enforced by the fq qdisc, but the socket
+   * option is accepted whatever the qdisc is. Only set this if fq is
+   * installed on the outgoing interface, otherwise the kernel sends the
+   * packets right away and they are not paced at all.
+   *
+   * It only applies to the ports that did not send a paced packet yet.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_KERNEL_PACING,
+      g_param_spec_boolean ("kernel-pacing",
+          "Kernel pacing",
+          "Let the kernel send the paced packets at their departure time"
+          " with SO_TXTIME (requires the fq qdisc)",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:send-bitrate:
+   *
+   * The bitrate at which the RTP packets are sent, in bits per second. The
+   * send buffers of the RTP sockets are sized to hold half a second of it,
+   * but never made smaller than the size the kernel gave them, and they are
+   * resized when it changes by more than a quarter. 0 leaves them as the
+   * kernel made them.
+   *
+   * Going over the net.core.wmem_max sysctl requires CAP_NET_ADMIN.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_SEND_BITRATE,
+      g_param_spec_uint ("send-bitrate",
+          "Send bitrate",
+          "The bitrate the RTP send buffers are sized for, in bits/s"
+          " (0 for the default size)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:receive-bitrate:
+   *
+   * The bitrate at which the RTP packets are received, in bits per second.
+   * The receive buffers of the RTP sockets are sized from it like the send
+   * buffers are from #FsRawUdpTransmitter:send-bitrate, so that the bursts
+   * of packets of a keyframe are not dropped by the kernel before they are
+   * read. The #FsRawUdpStreamTransmitter:stats property tells how many
+   * were.
+   *
+   * Going over the net.core.rmem_max sysctl requires CAP_NET_ADMIN.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BITRATE,
+      g_param_spec_uint ("receive-bitrate",
+          "Receive bitrate",
+          "The bitrate the RTP receive buffers are sized for, in bits/s"
+          " (0 for the default size)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsRawUdpTransmitter:connect-single-destination:
+   *
+   * While a port has a single destination and no other known address,
+   * connect its socket to that destination once a packet came back from
+   * there, and send the packets with a plain send() instead of going
+   * through the multiudpsink. This saves the route lookup of every packet
+   * and reports the ICMP errors of the destination.
+   *
+   * A connected socket only receives what its destination sends from the
+   * connected address, the kernel drops everything else. A peer that
+   * changes its address, for example behind a NAT that rebinds, is cut off
+   * until the destinations change, so this should only be used with peers
+   * known to be symmetric and stable. Sending a STUN request to another
+   * address disconnects the socket.
+   *
+   * It only applies to the ports read by fsmultiudpsrc without shards,
+   * that is when #FsRawUdpStreamTransmitter:receive-threads is not 0 and
+   * #FsRawUdpStreamTransmitter:receive-shards is at most 1, and not in
+   * io-uring mode. It only applies to the ports created after it is set.
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_CONNECT_SINGLE_DESTINATION,
+      g_param_spec_boolean ("connect-single-destination",
+          "Connect to a single destination",
+          "Connect the socket of a port that has a single destination"
+          " (it then only receives from that destination)",
+          FALSE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   transmitter_class->new_stream_transmitter =
     fs_rawudp_transmitter_new_stream_transmitter;
   transmitter_class->get_stream_transmitter_type =
@@ -215,6 +471,32 @@ fs_rawudp_transmitter_init (FsRawUdpTransmitter *self)
   self->components = 2;
   g_mutex_init (&self->priv->mutex);
   self->priv->do_timestamp = TRUE;
+  self->priv->receive_mtu = DEFAULT_RECEIVE_MTU;
+  self->priv->receive_buffers = DEFAULT_RECEIVE_BUFFERS;
+
+  g_mutex_init (&self->priv->pacer_mutex);
+  g_cond_init (&self->priv->pacer_cond);
+  g_queue_init (&self->priv->pacer_queue);
+}
+
+/* The paced packets are sent by the send probes of all the ports behind
+ * the tee, so the send time query is answered before it gets there */
+static gboolean
+fs_rawudp_transmitter_sink_query (GstPad *pad, GstObject *parent,
+    GstQuery *query)
+{
+  FsRawUdpTransmitter *self = g_object_get_data (G_OBJECT (pad),
+      "fs-rawudp-transmitter");
+
+  if (!self->priv->io_uring &&
+      g_atomic_int_get (&self->priv->paced_sending) &&
+      fs_send_time_query_parse (query, NULL))
+  {
+    fs_send_time_query_set_paced (query, TRUE);
+    return TRUE;
+  }
+
+  return gst_proxy_pad_query_default (pad, parent, query);
 }
 
 static void
@@ -327,6 +609,9 @@ fs_rawudp_transmitter_constructed (GObject *object)
     g_free (padname);
     gst_object_unref (pad);
 
+    g_object_set_data (G_OBJECT (ghostpad), "fs-rawudp-transmitter", self);
+    gst_pad_set_query_function (ghostpad, fs_rawudp_transmitter_sink_query);
+
     gst_pad_set_active (ghostpad, TRUE);
     gst_element_add_pad (self->priv->gst_sink, ghostpad);
 
@@ -424,6 +709,19 @@ fs_rawudp_transmitter_finalize (GObject *object)
     self->priv->udpports = NULL;
   }
 
+  /* All the ports are gone, so is every paced packet */
+  if (self->priv->pacer_thread)
+  {
+    g_mutex_lock (&self->priv->pacer_mutex);
+    self->priv->pacer_stop = TRUE;
+    g_cond_signal (&self->priv->pacer_cond);
+    g_mutex_unlock (&self->priv->pacer_mutex);
+    g_thread_join (self->priv->pacer_thread);
+    self->priv->pacer_thread = NULL;
+  }
+
+  g_mutex_clear (&self->priv->pacer_mutex);
+  g_cond_clear (&self->priv->pacer_cond);
   g_mutex_clear (&self->priv->mutex);
 
   parent_class->finalize (object);
@@ -456,6 +754,42 @@ fs_rawudp_transmitter_get_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       g_value_set_boolean (value, self->priv->do_timestamp);
       break;
+    case PROP_IO_URING:
+      g_value_set_boolean (value, self->priv->io_uring);
+      break;
+    case PROP_RECEIVE_MTU:
+      g_mutex_lock (&self->priv->mutex);
+      g_value_set_uint (value, self->priv->receive_mtu);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
+    case PROP_RECEIVE_BUFFERS:
+      g_mutex_lock (&self->priv->mutex);
+      g_value_set_uint (value, self->priv->receive_buffers);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
+    case PROP_PACED_SENDING:
+      g_value_set_boolean (value,
+          g_atomic_int_get (&self->priv->paced_sending));
+      break;
+    case PROP_KERNEL_PACING:
+      g_value_set_boolean (value,
+          g_atomic_int_get (&self->priv->kernel_pacing));
+      break;
+    case PROP_SEND_BITRATE:
+      g_mutex_lock (&self->priv->mutex);
+      g_value_set_uint (value, self->priv->send_bitrate);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
+    case PROP_RECEIVE_BITRATE:
+      g_mutex_lock (&self->priv->mutex);
+      g_value_set_uint (value, self->priv->receive_bitrate);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
+    case PROP_CONNECT_SINGLE_DESTINATION:
+      g_mutex_lock (&self->priv->mutex);
+      g_value_set_boolean (value, self->priv->connect_single_destination);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -482,6 +816,40 @@ fs_rawudp_transmitter_set_property (GObject *object,
     case PROP_DO_TIMESTAMP:
       self->priv->do_timestamp = g_value_get_boolean (value);
       break;
+    case PROP_IO_URING:
+      self->priv->io_uring = g_value_get_boolean (value);
+      break;
+    case PROP_RECEIVE_MTU:
+      g_mutex_lock (&self->priv->mutex);
+      self->priv->receive_mtu = g_value_get_uint (value);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
+    case PROP_RECEIVE_BUFFERS:
+      g_mutex_lock (&self->priv->mutex);
+      self->priv->receive_buffers = g_value_get_uint (value);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
+    case PROP_PACED_SENDING:
+      g_atomic_int_set (&self->priv->paced_sending,
+          g_value_get_boolean (value));
+      break;
+    case PROP_KERNEL_PACING:
+      g_atomic_int_set (&self->priv->kernel_pacing,
+          g_value_get_boolean (value));
+      break;
+    case PROP_SEND_BITRATE:
+      fs_rawudp_transmitter_set_bitrate (self, FALSE,
+          g_value_get_uint (value));
+      break;
+    case PROP_RECEIVE_BITRATE:
+      fs_rawudp_transmitter_set_bitrate (self, TRUE,
+          g_value_get_uint (value));
+      break;
+    case PROP_CONNECT_SINGLE_DESTINATION:
+      g_mutex_lock (&self->priv->mutex);
+      self->priv->connect_single_destination = g_value_get_boolean (value);
+      g_mutex_unlock (&self->priv->mutex);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -525,12 +893,35 @@ struct _UdpPort {
   /* Protected by the transmitter mutex */
   gint refcount;
 
+  /* The socket is read either by its own udpsrc or through a pad of the
+   * fsmultiudpsrc shared by the transmitter, in both cases linked to the
+   * funnel through udpsrc_requested_pad */
   GstElement *udpsrc;
+  GstPad *multiudpsrc_pad;
   GstPad *udpsrc_requested_pad;
 
+  /* When the receive side is sharded, extra sockets are bound to the same
+   * port with SO_REUSEPORT, each read by its own udpsrc. The kernel spreads
+   * the incoming flows over them by hashing the 4-tuple, so one sender always
+   * lands on the same shard. All udpsrcs, including the main one, feed
+   * shard_funnel which is linked to the component funnel through
+   * shard_funnel_requested_pad. */
+  GstElement *shard_funnel;
+  GstPad *shard_funnel_requested_pad;
+  guint n_extra_shards;
+  struct UdpShard *extra_shards;
+
   GstElement *udpsink;
   GstPad *udpsink_requested_pad;
 
+  /* Set once when the port is created, if the transmitter asks for it.
+   * Only sockets read by an unsharded fsmultiudpsrc can be connected:
+   * udpsrc turns the ICMP errors that a connected socket reports into
+   * element errors, and with shards the kernel would hand the packets of
+   * the peer to the main socket only. The io_uring sends are batched
+   * already. */
+  gboolean connectable;
+
   gchar *requested_ip;
   guint requested_port;
 
@@ -538,7 +929,15 @@ struct _UdpPort {
 
   GSocket *socket;
 
+  /* With RTCP-mux, the RTCP UdpPort has no socket or udpsrc of its own, it
+   * holds a reference to the RTP UdpPort and uses its socket. The receive
+   * probe of the RTP UdpPort pushes the RTCP packets out of mux_srcpad,
+   * which is linked to the RTCP funnel through udpsrc_requested_pad. */
+  UdpPort *rtp_udpport;
+  GstPad *mux_srcpad;
+
   /* These are just convenience pointers to our parent transmitter */
+  FsRawUdpTransmitter *trans;
   GstElement *funnel;
   GstElement *tee;
 
@@ -547,26 +946,197 @@ struct _UdpPort {
   /* Everything below is protected by the mutex */
   GMutex mutex;
   GArray *known_addresses;
+  /* The unique known addresses that want their packets, indexed by address
+   * so that the receive probe can find them in constant time */
+  GHashTable *known_sources;
+  UdpPort *rtcp_mux_udpport;
+
+  /* The destinations of the udpsink, with how many times each one was
+   * added and their resolved address. While a connectable port has a
+   * single resolved destination and no other known address, connect_addr
+   * is its address. Once a packet has come from there, the socket is
+   * connected to it and the send probe sends the packets with a plain
+   * send() instead of going through the udpsink. Sending anything
+   * elsewhere, like a STUN request, disconnects it until the destinations
+   * change. */
+  GArray *dests;
+  GSocketAddress *connect_addr;
+  gboolean sent_elsewhere;
+  /* Also read without the mutex by the send probe */
+  volatile gint connected;
+  /* 0 until the first paced packet, then 1 if the kernel paces the socket
+   * and -1 if the pacer thread has to */
+  gint txtime;
+
+  /* The sizes last asked for the socket buffers, starting with the ones
+   * the kernel gave the socket, which are the smallest they get. Protected
+   * by the transmitter mutex */
+  gint default_rcvbuf;
+  gint default_sndbuf;
+  gint rcvbuf;
+  gint sndbuf;
+};
+
+struct UdpDest {
+  gchar *ip;
+  gint port;
+  guint refcount;
+  /* addrlen is 0 if ip is not numeric, only the udpsink can send there */
+  struct sockaddr_storage addr;
+  socklen_t addrlen;
+};
+
+struct PacedPacket {
+  UdpPort *udpport;
+  GstBuffer *buffer;
+  /* In monotonic time */
+  gint64 deadline;
 };
 
 struct KnownAddress {
   FsRawUdpAddressUniqueCallbackFunc callback;
+  FsRawUdpKnownSourceCallbackFunc packet_callback;
   gpointer user_data;
   GSocketAddress *addr;
 };
 
+struct KnownSource {
+  FsRawUdpKnownSourceCallbackFunc packet_callback;
+  gpointer user_data;
+};
+
+struct UdpShard {
+  GSocket *socket;
+  GstElement *udpsrc;
+  GstPad *multiudpsrc_pad;
+  GstPad *requested_pad;
+};
+
+static void
+_set_socket_tos (GSocket *socket, int tos)
+{
+  int fd = g_socket_get_fd (socket);
+
+  if (setsockopt (fd, IPPROTO_IP, IP_TOS, &tos, sizeof (tos)) < 0)
+    GST_WARNING ("could not set socket ToS: %s", g_strerror (errno));
+
+#ifdef IPV6_TCLASS
+  if (setsockopt (fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof (tos)) < 0)
+    GST_WARNING ("could not set TCLASS: %s", g_strerror (errno));
+#endif
+}
+
+/* Sets the DF bit on the packets that fit in the path MTU known by the
+ * kernel, so that the routers report smaller MTUs along the path with ICMP
+ * and the kernel learns them. Larger packets are still fragmented. */
+static void
+_set_socket_pmtu_discovery (GSocket *socket)
+{
+  int fd = g_socket_get_fd (socket);
+  int val;
+
+  if (g_socket_get_family (socket) == G_SOCKET_FAMILY_IPV4)
+  {
+#ifdef IP_MTU_DISCOVER
+    val = IP_PMTUDISC_WANT;
+    if (setsockopt (fd, IPPROTO_IP, IP_MTU_DISCOVER, &val, sizeof (val)) < 0)
+      GST_WARNING ("could not enable path MTU discovery: %s",
+          g_strerror (errno));
+#endif
+  }
+  else
+  {
+#ifdef IPV6_MTU_DISCOVER
+    val = IPV6_PMTUDISC_WANT;
+    if (setsockopt (fd, IPPROTO_IPV6, IPV6_MTU_DISCOVER, &val,
+            sizeof (val)) < 0)
+      GST_WARNING ("could not enable path MTU discovery: %s",
+          g_strerror (errno));
+#endif
+  }
+}
+
+static gint
+_get_socket_buffer_size (GSocket *socket, gboolean receive)
+{
+  int size = 0;
+  socklen_t len = sizeof (size);
+
+  if (getsockopt (g_socket_get_fd (socket), SOL_SOCKET,
+          receive ? SO_RCVBUF : SO_SNDBUF, &size, &len) < 0)
+    return 0;
+
+  return size;
+}
+
+static void
+_set_socket_buffer_size (GSocket *socket, gboolean receive, gint size)
+{
+  int fd = g_socket_get_fd (socket);
+
+#if defined (SO_RCVBUFFORCE) && defined (SO_SNDBUFFORCE)
+  /* Goes over the rmem_max and wmem_max sysctls if we have CAP_NET_ADMIN */
+  if (setsockopt (fd, SOL_SOCKET, receive ? SO_RCVBUFFORCE : SO_SNDBUFFORCE,
+          &size, sizeof (size)) == 0)
+    return;
+#endif
+
+  if (setsockopt (fd, SOL_SOCKET, receive ? SO_RCVBUF : SO_SNDBUF, &size,
+          sizeof (size)) < 0)
+    GST_WARNING ("could not set the %s buffer size to %d: %s",
+        receive ? "receive" : "send", size, g_strerror (errno));
+}
+
+/* Returns the number of packets the kernel dropped on the socket, mostly
+ * because its receive buffer was full. It is the counter that SO_RXQ_OVFL
+ * would attach to every packet, but udpsrc ignores the control messages it
+ * does not know, so it is read with SO_MEMINFO instead. */
+static guint
+_get_socket_drops (GSocket *socket)
+{
+#ifdef USE_SO_MEMINFO
+  guint32 meminfo[SK_MEMINFO_VARS];
+  socklen_t len = sizeof (meminfo);
+
+  if (getsockopt (g_socket_get_fd (socket), SOL_SOCKET, SO_MEMINFO, meminfo,
+          &len) == 0 &&
+      len > SK_MEMINFO_DROPS * sizeof (guint32))
+    return meminfo[SK_MEMINFO_DROPS];
+#endif
+
+  return 0;
+}
+
+#ifdef SO_REUSEPORT
+static gboolean
+_set_socket_reuseport (GSocket *socket, GError **error)
+{
+  int one = 1;
+
+  if (setsockopt (g_socket_get_fd (socket), SOL_SOCKET, SO_REUSEPORT, &one,
+          sizeof (one)) < 0)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_NETWORK,
+        "Could not set SO_REUSEPORT on the socket: %s", g_strerror (errno));
+    return FALSE;
+  }
+
+  return TRUE;
+}
+#endif
+
 static GSocket *
 _bind_port (
     const gchar *ip,
     guint port,
     guint *used_port,
     int tos,
+    gboolean reuseport,
     GError **error)
 {
   GSocketAddress *socket_addr;
   GInetAddress *addr;
   GSocket *socket;
-  int fd;
 
   if (ip)
   {
@@ -612,19 +1182,89 @@ _bind_port (
 
   *used_port = port;
 
-  fd = g_socket_get_fd (socket);
-
-  if (setsockopt (fd, IPPROTO_IP, IP_TOS, &tos, sizeof (tos)) < 0)
-    GST_WARNING ("could not set socket ToS: %s", g_strerror (errno));
+  _set_socket_tos (socket, tos);
+  _set_socket_pmtu_discovery (socket);
 
-#ifdef IPV6_TCLASS
-  if (setsockopt (fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof (tos)) < 0)
-    GST_WARNING ("could not set TCLASS: %s", g_strerror (errno));
+#ifdef SO_REUSEPORT
+  /* This is only set after the bind so that searching for a free port
+   * can never end up sharing a port with another sharded UdpPort, only
+   * the shards bound by _bind_shard() can join it */
+  if (reuseport && !_set_socket_reuseport (socket, error))
+  {
+    g_socket_close (socket, NULL);
+    g_object_unref (socket);
+    return NULL;
+  }
 #endif
 
   return socket;
 }
 
+#ifdef SO_REUSEPORT
+static GSocket *
+_bind_shard (GSocket *main_socket, GError **error)
+{
+  GSocketAddress *socket_addr;
+  GSocket *socket;
+
+  socket_addr = g_socket_get_local_address (main_socket, error);
+  if (!socket_addr)
+    return NULL;
+
+  socket = g_socket_new (g_socket_address_get_family (socket_addr),
+      G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, error);
+  if (!socket)
+    goto out;
+
+  if (!_set_socket_reuseport (socket, error) ||
+      !g_socket_bind (socket, socket_addr, FALSE, error))
+  {
+    g_socket_close (socket, NULL);
+    g_clear_object (&socket);
+  }
+
+ out:
+  g_object_unref (socket_addr);
+  return socket;
+}
+#endif
+
+/* A pool of MTU sized buffers for the packets of one socket, or NULL if the
+ * pools are disabled */
+static GstBufferPool *
+_create_receive_pool (FsRawUdpTransmitter *trans,
+    guint component_id)
+{
+  GstBufferPool *pool;
+  GstStructure *config;
+  guint mtu, buffers;
+
+  g_mutex_lock (&trans->priv->mutex);
+  mtu = trans->priv->receive_mtu;
+  buffers = trans->priv->receive_buffers;
+  g_mutex_unlock (&trans->priv->mutex);
+
+  if (mtu == 0)
+    return NULL;
+
+  if (component_id == FS_COMPONENT_RTCP)
+    buffers = MIN (buffers, RTCP_RECEIVE_BUFFERS);
+
+  pool = gst_buffer_pool_new ();
+  config = gst_buffer_pool_get_config (pool);
+  /* No maximum, a burst must never block the receiving thread */
+  gst_buffer_pool_config_set_params (config, NULL, mtu, buffers, 0);
+  if (!gst_buffer_pool_set_config (pool, config))
+  {
+    GST_WARNING ("Could not configure a receive pool of %u buffers of %u"
+        " bytes", buffers, mtu);
+    gst_object_unref (pool);
+    return NULL;
+  }
+
+  return pool;
+}
+
 static GstElement *
 _create_sinksource (
     gchar *elementname,
@@ -653,11 +1293,15 @@ _create_sinksource (
   }
 
   g_object_set (elem,
-      "auto-multicast", FALSE,
       "close-socket", FALSE,
       "socket", socket,
       NULL);
 
+  /* fsuringudpsink only sends to unicast destinations */
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (elem),
+          "auto-multicast"))
+    g_object_set (elem, "auto-multicast", FALSE, NULL);
+
   if (direction == GST_PAD_SINK)
     g_object_set (elem,
         "async", FALSE,
@@ -792,108 +1436,1012 @@ _create_sinksource (
 }
 
 
-static UdpPort *
-fs_rawudp_transmitter_get_udpport_locked (FsRawUdpTransmitter *trans,
-    guint component_id,
-    const gchar *requested_ip,
-    guint requested_port)
+static void
+_remove_element (GstBin *bin, GstElement *element)
 {
-  UdpPort *udpport;
-  GList *udpport_e;
+  GstStateChangeReturn ret;
+
+  gst_element_set_locked_state (element, TRUE);
+  ret = gst_element_set_state (element, GST_STATE_NULL);
+  if (ret != GST_STATE_CHANGE_SUCCESS)
+    GST_ERROR ("Error changing state of %s: %s", GST_OBJECT_NAME (element),
+        gst_element_state_change_return_get_name (ret));
+  if (!gst_bin_remove (bin, element))
+    GST_ERROR ("Could not remove %s from the transmitter bin",
+        GST_OBJECT_NAME (element));
+}
 
-  for (udpport_e = g_list_first (trans->priv->udpports[component_id]);
-       udpport_e;
-       udpport_e = g_list_next (udpport_e))
+static GstPad *
+_create_multiudpsrc_pad (FsRawUdpTransmitter *trans,
+    GstElement *funnel,
+    GSocket *socket,
+    guint receive_threads,
+    GstBufferPool *pool,
+    GstPad **requested_pad,
+    GError **error)
+{
+  GstElement *multiudpsrc;
+  GstPad *pad;
+
+  g_mutex_lock (&trans->priv->mutex);
+  if (!trans->priv->multiudpsrc)
   {
-    udpport = udpport_e->data;
-    if (requested_port == udpport->requested_port &&
-        ((requested_ip == NULL && udpport->requested_ip == NULL) ||
-            (requested_ip && udpport->requested_ip &&
-                !strcmp (requested_ip, udpport->requested_ip))))
+    trans->priv->multiudpsrc = fs_multiudpsrc_new (
+        GST_BIN (trans->priv->gst_src), receive_threads,
+        trans->priv->do_timestamp, trans->priv->io_uring, error);
+    if (!trans->priv->multiudpsrc)
     {
-      GST_LOG ("Got port refcount %d->%d", udpport->refcount,
-          udpport->refcount+1);
-      udpport->refcount++;
-      return udpport;
+      g_mutex_unlock (&trans->priv->mutex);
+      return NULL;
     }
   }
+  multiudpsrc = gst_object_ref (trans->priv->multiudpsrc);
+  g_mutex_unlock (&trans->priv->mutex);
 
-  return NULL;
-}
+  pad = fs_multiudpsrc_request_pad (multiudpsrc, funnel, socket, pool,
+      requested_pad, error);
 
+  gst_object_unref (multiudpsrc);
+  return pad;
+}
 
-UdpPort *
-fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
+/* Creates what reads from the socket into the funnel: its own udpsrc or,
+ * if receive_threads is not 0 or io_uring is used, a pad of the shared
+ * fsmultiudpsrc */
+static gboolean
+_create_receiver (FsRawUdpTransmitter *trans,
     guint component_id,
-    const gchar *requested_ip,
-    guint requested_port,
+    GstElement *funnel,
+    GSocket *socket,
+    guint receive_threads,
+    GstElement **udpsrc,
+    GstPad **multiudpsrc_pad,
+    GstPad **requested_pad,
     GError **error)
 {
-  UdpPort *udpport;
-  UdpPort *tmpudpport;
-  int tos;
-
-  /* First lets check if we already have one */
-  if (component_id > trans->components)
+  if (receive_threads || trans->priv->io_uring)
   {
-    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
-        "Invalid component %d > %d", component_id, trans->components);
-    return NULL;
+    /* Only fsmultiudpsrc receives into the pool */
+    GstBufferPool *pool = _create_receive_pool (trans, component_id);
+
+    *multiudpsrc_pad = _create_multiudpsrc_pad (trans, funnel, socket,
+        MAX (receive_threads, 1), pool, requested_pad, error);
+    if (pool)
+      gst_object_unref (pool);
+    return *multiudpsrc_pad != NULL;
+  }
+  else
+  {
+    *udpsrc = _create_sinksource ("udpsrc", GST_BIN (trans->priv->gst_src),
+        funnel, NULL, socket, GST_PAD_SRC, trans->priv->do_timestamp,
+        requested_pad, error);
+    return *udpsrc != NULL;
   }
+}
 
-  g_mutex_lock (&trans->priv->mutex);
-  udpport = fs_rawudp_transmitter_get_udpport_locked (trans, component_id,
-      requested_ip, requested_port);
-  tos = trans->priv->type_of_service;
-  g_mutex_unlock (&trans->priv->mutex);
+#ifdef SO_REUSEPORT
+static gboolean
+_create_receive_shards (FsRawUdpTransmitter *trans,
+    UdpPort *udpport,
+    guint receive_shards,
+    guint receive_threads,
+    GError **error)
+{
+  GstPad *pad;
+  GstPadLinkReturn ret;
+  guint i;
 
-  if (udpport)
-    return udpport;
+  udpport->shard_funnel = gst_element_factory_make ("funnel", NULL);
+  if (!udpport->shard_funnel)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not make the shard funnel element");
+    return FALSE;
+  }
 
-  GST_DEBUG ("Make new UdpPort for component %u requesting %s:%u", component_id,
-      requested_ip ? requested_ip : "ANY", requested_port);
+  if (!gst_bin_add (GST_BIN (trans->priv->gst_src), udpport->shard_funnel))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not add the shard funnel element to the transmitter src bin");
+    gst_object_unref (udpport->shard_funnel);
+    udpport->shard_funnel = NULL;
+    return FALSE;
+  }
 
-  udpport = g_slice_new0 (UdpPort);
+  udpport->shard_funnel_requested_pad =
+    gst_element_get_request_pad (udpport->funnel, "sink_%u");
+  if (!udpport->shard_funnel_requested_pad)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not get the sink request pad from the funnel");
+    return FALSE;
+  }
 
-  udpport->refcount = 1;
-  udpport->requested_ip = g_strdup (requested_ip);
-  udpport->requested_port = requested_port;
-  udpport->component_id = component_id;
-  g_mutex_init (&udpport->mutex);
-  udpport->known_addresses = g_array_new (TRUE, FALSE,
-      sizeof (struct KnownAddress));
+  pad = gst_element_get_static_pad (udpport->shard_funnel, "src");
+  ret = gst_pad_link (pad, udpport->shard_funnel_requested_pad);
+  gst_object_unref (pad);
 
-  /* Now lets bind both ports */
+  if (GST_PAD_LINK_FAILED (ret))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the shard funnel (%d)", ret);
+    return FALSE;
+  }
 
-  udpport->socket = _bind_port (requested_ip, requested_port, &udpport->port,
-      tos, error);
+  if (!gst_element_sync_state_with_parent (udpport->shard_funnel))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not sync the state of the shard funnel with its parent");
+    return FALSE;
+  }
+
+  udpport->extra_shards = g_new0 (struct UdpShard, receive_shards - 1);
+
+  for (i = 0; i < receive_shards - 1; i++)
+  {
+    struct UdpShard *shard = &udpport->extra_shards[i];
+
+    udpport->n_extra_shards++;
+
+    shard->socket = _bind_shard (udpport->socket, error);
+    if (!shard->socket)
+      return FALSE;
+
+    if (!_create_receiver (trans, udpport->component_id,
+            udpport->shard_funnel, shard->socket,
+            receive_threads, &shard->udpsrc, &shard->multiudpsrc_pad,
+            &shard->requested_pad, error))
+      return FALSE;
+  }
+
+  GST_DEBUG ("Receiving on port %u with %u shards", udpport->port,
+      receive_shards);
+
+  return TRUE;
+}
+#endif
+
+/* With receive shards, the probes go on the shard funnel so they see
+ * the packets from every shard. With RTCP-mux, the RTCP packets come
+ * out of the mux pad */
+static GstPad *
+_udpport_get_recv_pad (UdpPort *udpport)
+{
+  if (udpport->mux_srcpad)
+    return gst_object_ref (udpport->mux_srcpad);
+  else if (udpport->shard_funnel)
+    return gst_element_get_static_pad (udpport->shard_funnel, "src");
+  else if (udpport->multiudpsrc_pad)
+    return gst_object_ref (udpport->multiudpsrc_pad);
+  else
+    return gst_element_get_static_pad (udpport->udpsrc, "src");
+}
+
+static void
+_known_source_free (gpointer data)
+{
+  g_slice_free (struct KnownSource, data);
+}
+
+static gboolean
+_copy_sticky_event (GstPad *pad, GstEvent **event, gpointer user_data)
+{
+  GstPad *mux_srcpad = user_data;
+
+  gst_pad_store_sticky_event (mux_srcpad, *event);
+
+  return TRUE;
+}
+
+static gboolean
+_buffer_is_rtcp (GstBuffer *buffer)
+{
+  guint8 header[2];
+
+  if (gst_buffer_extract (buffer, 0, header, 2) != 2)
+    return FALSE;
+
+  /* RFC 5761: version 2 and a packet type in the RTCP range [192, 223] */
+  return (header[0] >> 6) == 2 && header[1] >= 192 && header[1] <= 223;
+}
+
+static gint
+_udpport_find_dest_locked (UdpPort *udpport, const gchar *ip, gint port)
+{
+  guint i;
+
+  for (i = 0; i < udpport->dests->len; i++)
+  {
+    struct UdpDest *dest = &g_array_index (udpport->dests, struct UdpDest, i);
+
+    if (dest->port == port && !strcmp (dest->ip, ip))
+      return i;
+  }
+
+  return -1;
+}
+
+static void
+_udpport_connect_locked (UdpPort *udpport)
+{
+  struct sockaddr_storage addr;
+  gssize len = g_socket_address_get_native_size (udpport->connect_addr);
+
+  if (len < 0 ||
+      !g_socket_address_to_native (udpport->connect_addr, &addr,
+          sizeof (addr), NULL) ||
+      connect (g_socket_get_fd (udpport->socket), (struct sockaddr *) &addr,
+          len) < 0)
+  {
+    GST_WARNING ("Could not connect port %u to its destination: %s",
+        udpport->port, g_strerror (errno));
+    /* Do not try again for every packet */
+    g_clear_object (&udpport->connect_addr);
+    return;
+  }
+
+  GST_DEBUG ("Connected port %u to its only destination", udpport->port);
+  g_atomic_int_set (&udpport->connected, TRUE);
+}
+
+static void
+_udpport_disconnect_locked (UdpPort *udpport)
+{
+  struct sockaddr addr;
+
+  if (!g_atomic_int_get (&udpport->connected))
+    return;
+
+  g_atomic_int_set (&udpport->connected, FALSE);
+
+  /* The socket was bound explicitly, so it keeps its address and port */
+  memset (&addr, 0, sizeof (addr));
+  addr.sa_family = AF_UNSPEC;
+  if (connect (g_socket_get_fd (udpport->socket), &addr, sizeof (addr)) < 0)
+    GST_WARNING ("Could not disconnect port %u: %s", udpport->port,
+        g_strerror (errno));
+  else
+    GST_DEBUG ("Disconnected port %u", udpport->port);
+}
+
+/* Must be called whenever the destinations or the known addresses change */
+static void
+_udpport_update_connect_addr_locked (UdpPort *udpport)
+{
+  GSocketAddress *old_addr = udpport->connect_addr;
+  guint i;
+
+  udpport->connect_addr = NULL;
+
+  /* The RTCP-mux port sends through the same socket with its own udpsink */
+  if (udpport->connectable && udpport->dests->len == 1 &&
+      !udpport->rtcp_mux_udpport)
+  {
+    struct UdpDest *dest = &g_array_index (udpport->dests, struct UdpDest, 0);
+
+    if (dest->addrlen)
+      udpport->connect_addr = g_socket_address_new_from_native (&dest->addr,
+          dest->addrlen);
+
+    /* The packets of any other known address would be filtered out */
+    for (i = 0; udpport->connect_addr && i < udpport->known_addresses->len;
+         i++)
+      if (!fs_g_inet_socket_address_equal (udpport->connect_addr,
+              g_array_index (udpport->known_addresses,
+                  struct KnownAddress, i).addr))
+        g_clear_object (&udpport->connect_addr);
+  }
+
+  if (!udpport->connect_addr || !old_addr ||
+      !fs_g_inet_socket_address_equal (udpport->connect_addr, old_addr))
+  {
+    udpport->sent_elsewhere = FALSE;
+    _udpport_disconnect_locked (udpport);
+  }
+
+  if (old_addr)
+    g_object_unref (old_addr);
+}
+
+/* Returns 0 or the errno of sendmsg(). Without an address, the socket must
+ * be connected. The kernel holds the packet until txtime if it is not 0 */
+static gint
+_udpport_sendmsg (UdpPort *udpport, GstBuffer *buffer,
+    const struct sockaddr_storage *addr, socklen_t addrlen, guint64 txtime)
+{
+  struct iovec iov[MAX_SEND_MEMORIES];
+  GstMapInfo maps[MAX_SEND_MEMORIES];
+  struct msghdr msg;
+#ifdef USE_SO_TXTIME
+  union {
+    gchar buf[CMSG_SPACE (sizeof (guint64))];
+    struct cmsghdr align;
+  } control;
+#endif
+  guint n_mems = gst_buffer_n_memory (buffer);
+  guint i;
+  gssize ret;
+  gint err;
+
+  g_return_val_if_fail (n_mems <= MAX_SEND_MEMORIES, EMSGSIZE);
+
+  for (i = 0; i < n_mems; i++)
+  {
+    gst_memory_map (gst_buffer_peek_memory (buffer, i), &maps[i],
+        GST_MAP_READ);
+    iov[i].iov_base = maps[i].data;
+    iov[i].iov_len = maps[i].size;
+  }
+
+  memset (&msg, 0, sizeof (msg));
+  msg.msg_name = (gpointer) addr;
+  msg.msg_namelen = addrlen;
+  msg.msg_iov = iov;
+  msg.msg_iovlen = n_mems;
+
+#ifdef USE_SO_TXTIME
+  if (txtime)
+  {
+    struct cmsghdr *cmsg;
+
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof (control.buf);
+    cmsg = CMSG_FIRSTHDR (&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_TXTIME;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (guint64));
+    memcpy (CMSG_DATA (cmsg), &txtime, sizeof (guint64));
+  }
+#endif
+
+  ret = sendmsg (g_socket_get_fd (udpport->socket), &msg, 0);
+  err = ret < 0 ? errno : 0;
+
+  for (i = 0; i < n_mems; i++)
+    gst_memory_unmap (gst_buffer_peek_memory (buffer, i), &maps[i]);
+
+  return err;
+}
+
+/* Returns FALSE if the buffer has to go through the udpsink */
+static gboolean
+_udpport_send_connected (UdpPort *udpport, GstBuffer *buffer)
+{
+  gint err;
+
+  if (gst_buffer_n_memory (buffer) > MAX_SEND_MEMORIES)
+    return FALSE;
+
+  err = _udpport_sendmsg (udpport, buffer, NULL, 0, 0);
+  if (err == 0)
+    return TRUE;
+
+  /* An ICMP error said nothing listens there anymore, the packet is lost
+   * like any other UDP packet would be */
+  if (err == ECONNREFUSED)
+  {
+    GST_LOG ("The destination of port %u is unreachable", udpport->port);
+    return TRUE;
+  }
+
+  /* Disconnected meanwhile, or the socket buffer is full and the udpsink
+   * knows how to wait */
+  return FALSE;
+}
+
+/* Sends to every destination, like the udpsink would */
+static void
+_udpport_send_paced_locked (UdpPort *udpport, GstBuffer *buffer,
+    guint64 txtime)
+{
+  guint i;
+
+  for (i = 0; i < udpport->dests->len; i++)
+  {
+    struct UdpDest *dest = &g_array_index (udpport->dests, struct UdpDest, i);
+    gint err;
+
+    if (!dest->addrlen)
+      continue;
+
+    err = _udpport_sendmsg (udpport, buffer, &dest->addr, dest->addrlen,
+        txtime);
+    if (err)
+      GST_DEBUG ("Could not send a paced packet from port %u to %s:%d: %s",
+          udpport->port, dest->ip, dest->port, g_strerror (err));
+  }
+}
+
+static gboolean
+_udpport_dests_resolved_locked (UdpPort *udpport)
+{
+  guint i;
+
+  for (i = 0; i < udpport->dests->len; i++)
+    if (!g_array_index (udpport->dests, struct UdpDest, i).addrlen)
+      return FALSE;
+
+  return TRUE;
+}
+
+static void
+_udpport_setup_txtime_locked (UdpPort *udpport)
+{
+#ifdef USE_SO_TXTIME
+  struct sock_txtime txtime;
+
+  if (g_atomic_int_get (&udpport->trans->priv->kernel_pacing))
+  {
+    memset (&txtime, 0, sizeof (txtime));
+    /* The fq qdisc only understands the monotonic clock */
+    txtime.clockid = CLOCK_MONOTONIC;
+
+    if (setsockopt (g_socket_get_fd (udpport->socket), SOL_SOCKET,
+            SO_TXTIME, &txtime, sizeof (txtime)) == 0)
+    {
+      GST_DEBUG ("The kernel paces port %u", udpport->port);
+      udpport->txtime = 1;
+      return;
+    }
+
+    GST_DEBUG ("Could not set SO_TXTIME on port %u, pacing it in a thread:"
+        " %s", udpport->port, g_strerror (errno));
+  }
+#endif
+
+  udpport->txtime = -1;
+}
+
+/* Returns the monotonic time in nanoseconds at which a packet with this
+ * running time has to leave, or 0 if it is already late */
+static guint64
+_udpport_get_departure_time (UdpPort *udpport, GstClockTime send_time)
+{
+  GstClock *clock;
+  GstClockTime now, departure;
+  struct timespec ts;
+
+  clock = gst_element_get_clock (udpport->udpsink);
+  if (!clock)
+    return 0;
+
+  departure = send_time + gst_element_get_base_time (udpport->udpsink);
+  now = gst_clock_get_time (clock);
+  gst_object_unref (clock);
+
+  if (departure <= now)
+    return 0;
+
+  if (clock_gettime (CLOCK_MONOTONIC, &ts) < 0)
+    return 0;
+
+  return GST_TIMESPEC_TO_TIME (ts) + (departure - now);
+}
+
+static gint
+_paced_packet_compare (gconstpointer a, gconstpointer b)
+{
+  const struct PacedPacket *pa = a;
+  const struct PacedPacket *pb = b;
+
+  return (pa->deadline > pb->deadline) - (pa->deadline < pb->deadline);
+}
+
+static gpointer
+fs_rawudp_transmitter_pacer_thread (gpointer data)
+{
+  FsRawUdpTransmitter *self = data;
+
+  g_mutex_lock (&self->priv->pacer_mutex);
+  while (!self->priv->pacer_stop)
+  {
+    struct PacedPacket *packet = g_queue_peek_head (&self->priv->pacer_queue);
+
+    if (!packet)
+    {
+      g_cond_wait (&self->priv->pacer_cond, &self->priv->pacer_mutex);
+      continue;
+    }
+
+    if (packet->deadline > g_get_monotonic_time ())
+    {
+      g_cond_wait_until (&self->priv->pacer_cond, &self->priv->pacer_mutex,
+          packet->deadline);
+      continue;
+    }
+
+    /* Sent with the pacer mutex held, so that the port can not go away */
+    g_queue_pop_head (&self->priv->pacer_queue);
+    g_mutex_lock (&packet->udpport->mutex);
+    _udpport_send_paced_locked (packet->udpport, packet->buffer, 0);
+    g_mutex_unlock (&packet->udpport->mutex);
+
+    gst_buffer_unref (packet->buffer);
+    g_slice_free (struct PacedPacket, packet);
+  }
+  g_mutex_unlock (&self->priv->pacer_mutex);
+
+  return NULL;
+}
+
+static void
+fs_rawudp_transmitter_pace (FsRawUdpTransmitter *self, UdpPort *udpport,
+    GstBuffer *buffer, gint64 deadline)
+{
+  struct PacedPacket *packet = g_slice_new (struct PacedPacket);
+  GList *link;
+
+  packet->udpport = udpport;
+  packet->buffer = gst_buffer_ref (buffer);
+  packet->deadline = deadline;
+
+  g_mutex_lock (&self->priv->pacer_mutex);
+  if (!self->priv->pacer_thread)
+    self->priv->pacer_thread = g_thread_new ("fsrawudppacer",
+        fs_rawudp_transmitter_pacer_thread, self);
+
+  /* The packets of a stream come in order, so look from the end */
+  for (link = self->priv->pacer_queue.tail;
+       link && _paced_packet_compare (link->data, packet) > 0;
+       link = link->prev);
+  if (link)
+    g_queue_insert_after (&self->priv->pacer_queue, link, packet);
+  else
+    g_queue_push_head (&self->priv->pacer_queue, packet);
+
+  if (self->priv->pacer_queue.head->data == packet)
+    g_cond_signal (&self->priv->pacer_cond);
+  g_mutex_unlock (&self->priv->pacer_mutex);
+}
+
+static void
+fs_rawudp_transmitter_pacer_flush (FsRawUdpTransmitter *self,
+    UdpPort *udpport)
+{
+  GList *link, *next;
+
+  g_mutex_lock (&self->priv->pacer_mutex);
+  for (link = self->priv->pacer_queue.head; link; link = next)
+  {
+    struct PacedPacket *packet = link->data;
+
+    next = link->next;
+    if (packet->udpport == udpport)
+    {
+      g_queue_delete_link (&self->priv->pacer_queue, link);
+      gst_buffer_unref (packet->buffer);
+      g_slice_free (struct PacedPacket, packet);
+    }
+  }
+  g_mutex_unlock (&self->priv->pacer_mutex);
+}
+
+/* Returns FALSE if the buffer has to go through the udpsink right away */
+static gboolean
+_udpport_send_at (UdpPort *udpport, GstBuffer *buffer,
+    GstClockTime send_time)
+{
+  guint64 departure;
+
+  if (gst_buffer_n_memory (buffer) > MAX_SEND_MEMORIES)
+    return FALSE;
+
+  departure = _udpport_get_departure_time (udpport, send_time);
+  if (!departure)
+    return FALSE;
+
+  g_mutex_lock (&udpport->mutex);
+
+  if (!_udpport_dests_resolved_locked (udpport))
+  {
+    g_mutex_unlock (&udpport->mutex);
+    return FALSE;
+  }
+
+  if (udpport->txtime == 0)
+    _udpport_setup_txtime_locked (udpport);
+
+  if (udpport->txtime > 0)
+  {
+    _udpport_send_paced_locked (udpport, buffer, departure);
+    g_mutex_unlock (&udpport->mutex);
+    return TRUE;
+  }
+
+  g_mutex_unlock (&udpport->mutex);
+
+  fs_rawudp_transmitter_pace (udpport->trans, udpport, buffer,
+      departure / 1000);
+
+  return TRUE;
+}
+
+/* Returns FALSE if the buffer has to go through the udpsink */
+static gboolean
+_udpport_send (UdpPort *udpport, GstBuffer *buffer)
+{
+  if (g_atomic_int_get (&udpport->trans->priv->paced_sending))
+  {
+    FsSendTimeMeta *meta = fs_buffer_get_send_time_meta (buffer);
+
+    if (meta && GST_CLOCK_TIME_IS_VALID (meta->send_time) &&
+        _udpport_send_at (udpport, buffer, meta->send_time))
+      return TRUE;
+  }
+
+  if (g_atomic_int_get (&udpport->connected))
+    return _udpport_send_connected (udpport, buffer);
+
+  return FALSE;
+}
+
+static GstPadProbeReturn
+_udpport_send_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  UdpPort *udpport = user_data;
+  GstBufferList *list;
+  guint i, len;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+  {
+    if (_udpport_send (udpport, GST_PAD_PROBE_INFO_BUFFER (info)))
+      return GST_PAD_PROBE_DROP;
+    else
+      return GST_PAD_PROBE_OK;
+  }
+
+  list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+  len = gst_buffer_list_length (list);
+
+  for (i = 0; i < len; i++)
+    if (!_udpport_send (udpport, gst_buffer_list_get (list, i)))
+      break;
+
+  if (i == len)
+    return GST_PAD_PROBE_DROP;
+
+  /* Let the udpsink send what is left */
+  if (i > 0)
+  {
+    list = gst_buffer_list_make_writable (list);
+    gst_buffer_list_remove (list, 0, i);
+    GST_PAD_PROBE_INFO_DATA (info) = list;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn
+_udpport_recv_probe (GstPad *pad, GstPadProbeInfo *info, gpointer user_data)
+{
+  UdpPort *udpport = user_data;
+  UdpPort *target;
+  GstPad *mux_srcpad = NULL;
+  GstBuffer *buffer;
+  GstNetAddressMeta *netmeta;
+  struct KnownSource *ks = NULL;
+  FsRawUdpKnownSourceCallbackFunc packet_callback = NULL;
+  gpointer source_data = NULL;
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM)
+  {
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT (info);
+
+    if (!GST_EVENT_IS_STICKY (event))
+      return GST_PAD_PROBE_OK;
+
+    g_mutex_lock (&udpport->mutex);
+    if (udpport->rtcp_mux_udpport)
+      mux_srcpad = gst_object_ref (udpport->rtcp_mux_udpport->mux_srcpad);
+    g_mutex_unlock (&udpport->mutex);
+
+    if (mux_srcpad)
+    {
+      gst_pad_store_sticky_event (mux_srcpad, event);
+      gst_object_unref (mux_srcpad);
+    }
+
+    return GST_PAD_PROBE_OK;
+  }
+
+  buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+  netmeta = gst_buffer_get_net_address_meta (buffer);
+
+  g_mutex_lock (&udpport->mutex);
+
+  /* The only destination also sends from where we send to, so connecting
+   * the socket to it does not filter out anything we want */
+  if (udpport->connect_addr && !udpport->sent_elsewhere &&
+      !g_atomic_int_get (&udpport->connected) &&
+      netmeta && G_IS_INET_SOCKET_ADDRESS (netmeta->addr) &&
+      fs_g_inet_socket_address_equal (netmeta->addr, udpport->connect_addr))
+    _udpport_connect_locked (udpport);
+
+  target = udpport;
+  if (udpport->rtcp_mux_udpport && _buffer_is_rtcp (buffer))
+  {
+    target = udpport->rtcp_mux_udpport;
+    mux_srcpad = gst_object_ref (target->mux_srcpad);
+    g_mutex_lock (&target->mutex);
+  }
+
+  if (netmeta && G_IS_INET_SOCKET_ADDRESS (netmeta->addr))
+    ks = g_hash_table_lookup (target->known_sources, netmeta->addr);
+  if (ks)
+  {
+    packet_callback = ks->packet_callback;
+    source_data = g_object_ref (ks->user_data);
+  }
+
+  if (target != udpport)
+    g_mutex_unlock (&target->mutex);
+  g_mutex_unlock (&udpport->mutex);
+
+  if (!netmeta)
+    GST_WARNING ("received buffer that does not contain a GstNetAddressMeta");
+
+  if (packet_callback)
+  {
+    packet_callback (buffer, source_data);
+    g_object_unref (source_data);
+  }
+
+  if (mux_srcpad)
+  {
+    /* Like a source task, hold the stream lock while pushing so that
+     * deactivating the pad waits for us */
+    GST_PAD_STREAM_LOCK (mux_srcpad);
+    gst_pad_push (mux_srcpad, gst_buffer_ref (buffer));
+    GST_PAD_STREAM_UNLOCK (mux_srcpad);
+    gst_object_unref (mux_srcpad);
+    return GST_PAD_PROBE_DROP;
+  }
+
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+_attach_rtcp_mux (FsRawUdpTransmitter *trans,
+    UdpPort *udpport,
+    GError **error)
+{
+  UdpPort *rtp_udpport = NULL;
+  GstPad *recv_pad;
+  GstPadLinkReturn ret;
+  GList *item;
+
+  g_mutex_lock (&trans->priv->mutex);
+  for (item = trans->priv->udpports[1]; item; item = item->next)
+  {
+    UdpPort *tmp = item->data;
+
+    if (tmp->port == udpport->requested_port &&
+        ((udpport->requested_ip == NULL && tmp->requested_ip == NULL) ||
+            (udpport->requested_ip && tmp->requested_ip &&
+                !strcmp (udpport->requested_ip, tmp->requested_ip))))
+    {
+      rtp_udpport = tmp;
+      rtp_udpport->refcount++;
+      break;
+    }
+  }
+  g_mutex_unlock (&trans->priv->mutex);
+
+  if (!rtp_udpport)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "There is no RTP port %u to multiplex RTCP on",
+        udpport->requested_port);
+    return FALSE;
+  }
+
+  udpport->rtp_udpport = rtp_udpport;
+  udpport->socket = g_object_ref (rtp_udpport->socket);
+  udpport->port = rtp_udpport->port;
+
+  udpport->udpsrc_requested_pad =
+    gst_element_get_request_pad (udpport->funnel, "sink_%u");
+  if (!udpport->udpsrc_requested_pad)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not get the sink request pad from the funnel");
+    return FALSE;
+  }
+
+  udpport->mux_srcpad = gst_pad_new ("rtcp_mux_src", GST_PAD_SRC);
+  gst_pad_set_active (udpport->mux_srcpad, TRUE);
+
+  recv_pad = _udpport_get_recv_pad (rtp_udpport);
+  gst_pad_sticky_events_foreach (recv_pad, _copy_sticky_event,
+      udpport->mux_srcpad);
+  gst_object_unref (recv_pad);
+
+  ret = gst_pad_link (udpport->mux_srcpad, udpport->udpsrc_requested_pad);
+  if (GST_PAD_LINK_FAILED (ret))
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_CONSTRUCTION,
+        "Could not link the RTCP mux pad (%d)", ret);
+    return FALSE;
+  }
+
+  return TRUE;
+}
+
+static UdpPort *
+fs_rawudp_transmitter_get_udpport_locked (FsRawUdpTransmitter *trans,
+    guint component_id,
+    const gchar *requested_ip,
+    guint requested_port,
+    gboolean rtcp_mux)
+{
+  UdpPort *udpport;
+  GList *udpport_e;
+
+  for (udpport_e = g_list_first (trans->priv->udpports[component_id]);
+       udpport_e;
+       udpport_e = g_list_next (udpport_e))
+  {
+    udpport = udpport_e->data;
+    if (requested_port == udpport->requested_port &&
+        rtcp_mux == (udpport->rtp_udpport != NULL) &&
+        ((requested_ip == NULL && udpport->requested_ip == NULL) ||
+            (requested_ip && udpport->requested_ip &&
+                !strcmp (requested_ip, udpport->requested_ip))))
+    {
+      GST_LOG ("Got port refcount %d->%d", udpport->refcount,
+          udpport->refcount+1);
+      udpport->refcount++;
+      return udpport;
+    }
+  }
+
+  return NULL;
+}
+
+
+UdpPort *
+fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
+    guint component_id,
+    const gchar *requested_ip,
+    guint requested_port,
+    guint receive_shards,
+    guint receive_threads,
+    gboolean rtcp_mux,
+    GError **error)
+{
+  UdpPort *udpport;
+  UdpPort *tmpudpport;
+  GstPad *pad;
+  int tos;
+  gboolean connect_single_destination;
+
+  /* First lets check if we already have one */
+  if (component_id > trans->components)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Invalid component %d > %d", component_id, trans->components);
+    return NULL;
+  }
+
+  if (rtcp_mux && component_id == 1)
+  {
+    g_set_error (error, FS_ERROR, FS_ERROR_INVALID_ARGUMENTS,
+        "Can not multiplex the first component on itself");
+    return NULL;
+  }
+
+  g_mutex_lock (&trans->priv->mutex);
+  udpport = fs_rawudp_transmitter_get_udpport_locked (trans, component_id,
+      requested_ip, requested_port, rtcp_mux);
+  tos = trans->priv->type_of_service;
+  connect_single_destination = trans->priv->connect_single_destination;
+  g_mutex_unlock (&trans->priv->mutex);
+
+  if (udpport)
+    return udpport;
+
+#ifndef SO_REUSEPORT
+  if (receive_shards > 1)
+  {
+    GST_WARNING ("SO_REUSEPORT is not supported, can not shard the receive"
+        " side over %u sockets", receive_shards);
+    receive_shards = 1;
+  }
+#endif
+
+  GST_DEBUG ("Make new UdpPort for component %u requesting %s:%u", component_id,
+      requested_ip ? requested_ip : "ANY", requested_port);
+
+  udpport = g_slice_new0 (UdpPort);
+
+  udpport->refcount = 1;
+  udpport->requested_ip = g_strdup (requested_ip);
+  udpport->requested_port = requested_port;
+  udpport->component_id = component_id;
+  g_mutex_init (&udpport->mutex);
+  udpport->known_addresses = g_array_new (TRUE, FALSE,
+      sizeof (struct KnownAddress));
+  udpport->dests = g_array_new (FALSE, FALSE, sizeof (struct UdpDest));
+  udpport->known_sources = g_hash_table_new_full (
+      fs_g_inet_socket_address_hash,
+      (GEqualFunc) fs_g_inet_socket_address_equal,
+      g_object_unref, _known_source_free);
+
+  udpport->trans = trans;
+  udpport->tee = trans->priv->udpsink_tees[component_id];
+  udpport->funnel = trans->priv->udpsrc_funnels[component_id];
+
+  if (rtcp_mux)
+  {
+    if (!_attach_rtcp_mux (trans, udpport, error))
+      goto error;
+    goto create_sink;
+  }
+
+  /* Now lets bind both ports */
+
+  udpport->socket = _bind_port (requested_ip, requested_port, &udpport->port,
+      tos, receive_shards > 1, error);
   if (!udpport->socket)
     goto error;
 
+  udpport->default_rcvbuf =
+    _get_socket_buffer_size (udpport->socket, TRUE) / SOCKET_BUFFER_OVERHEAD;
+  udpport->default_sndbuf =
+    _get_socket_buffer_size (udpport->socket, FALSE) / SOCKET_BUFFER_OVERHEAD;
+  udpport->rcvbuf = udpport->default_rcvbuf;
+  udpport->sndbuf = udpport->default_sndbuf;
+
   /* Now lets create the elements */
 
-  udpport->tee = trans->priv->udpsink_tees[component_id];
-  udpport->funnel = trans->priv->udpsrc_funnels[component_id];
+#ifdef SO_REUSEPORT
+  if (receive_shards > 1 &&
+      !_create_receive_shards (trans, udpport, receive_shards,
+          receive_threads, error))
+    goto error;
+#endif
 
-  udpport->udpsrc = _create_sinksource ("udpsrc",
-      GST_BIN (trans->priv->gst_src), udpport->funnel, NULL,
-      udpport->socket, GST_PAD_SRC, trans->priv->do_timestamp,
-      &udpport->udpsrc_requested_pad, error);
-  if (!udpport->udpsrc)
+  if (!_create_receiver (trans, component_id,
+          udpport->shard_funnel ? udpport->shard_funnel : udpport->funnel,
+          udpport->socket, receive_threads, &udpport->udpsrc,
+          &udpport->multiudpsrc_pad, &udpport->udpsrc_requested_pad, error))
     goto error;
 
-  udpport->udpsink = _create_sinksource ("multiudpsink",
+  pad = _udpport_get_recv_pad (udpport);
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM,
+      _udpport_recv_probe, udpport, NULL);
+  gst_object_unref (pad);
+
+  udpport->connectable = connect_single_destination &&
+    udpport->multiudpsrc_pad != NULL && udpport->shard_funnel == NULL &&
+    !trans->priv->io_uring;
+
+ create_sink:
+  udpport->udpsink = _create_sinksource (
+      trans->priv->io_uring ? "fsuringudpsink" : "multiudpsink",
       GST_BIN (trans->priv->gst_sink), udpport->tee, NULL,
-      udpport->socket, GST_PAD_SINK, FALSE, &udpport->udpsink_requested_pad,
+      udpport->socket, GST_PAD_SINK, FALSE,
+      &udpport->udpsink_requested_pad,
       error);
   if (!udpport->udpsink)
     goto error;
 
+  /* Sends the paced packets, and the others once connected */
+  if (!trans->priv->io_uring)
+  {
+    pad = gst_element_get_static_pad (udpport->udpsink, "sink");
+    gst_pad_add_probe (pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        _udpport_send_probe, udpport, NULL);
+    gst_object_unref (pad);
+  }
+
   g_mutex_lock (&trans->priv->mutex);
 
   /* Check if someone else added the same port at the same time */
   tmpudpport = fs_rawudp_transmitter_get_udpport_locked (trans, component_id,
-      requested_ip, requested_port);
+      requested_ip, requested_port, rtcp_mux);
 
   if (tmpudpport)
   {
@@ -902,8 +2450,17 @@ fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
     return tmpudpport;
   }
 
+  if (udpport->rtp_udpport)
+  {
+    g_mutex_lock (&udpport->rtp_udpport->mutex);
+    udpport->rtp_udpport->rtcp_mux_udpport = udpport;
+    _udpport_update_connect_addr_locked (udpport->rtp_udpport);
+    g_mutex_unlock (&udpport->rtp_udpport->mutex);
+  }
+
   trans->priv->udpports[component_id] =
     g_list_prepend (trans->priv->udpports[component_id], udpport);
+  _udpport_update_buffer_sizes_locked (trans, udpport);
   g_mutex_unlock (&trans->priv->mutex);
 
   return udpport;
@@ -917,6 +2474,8 @@ void
 fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
   UdpPort *udpport)
 {
+  guint i;
+
   GST_LOG ("Put port refcount %d->%d", udpport->refcount, udpport->refcount-1);
 
   g_mutex_lock (&trans->priv->mutex);
@@ -933,6 +2492,29 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
 
   g_mutex_unlock (&trans->priv->mutex);
 
+  if (udpport->rtp_udpport)
+  {
+    g_mutex_lock (&udpport->rtp_udpport->mutex);
+    if (udpport->rtp_udpport->rtcp_mux_udpport == udpport)
+    {
+      udpport->rtp_udpport->rtcp_mux_udpport = NULL;
+      _udpport_update_connect_addr_locked (udpport->rtp_udpport);
+    }
+    g_mutex_unlock (&udpport->rtp_udpport->mutex);
+  }
+
+  if (udpport->mux_srcpad)
+  {
+    /* Waits for a push from the RTP receive probe to be done */
+    gst_pad_set_active (udpport->mux_srcpad, FALSE);
+    if (udpport->udpsrc_requested_pad)
+      gst_pad_unlink (udpport->mux_srcpad, udpport->udpsrc_requested_pad);
+    gst_object_unref (udpport->mux_srcpad);
+  }
+
+  if (udpport->multiudpsrc_pad)
+    fs_multiudpsrc_release_pad (udpport->multiudpsrc_pad);
+
   if (udpport->udpsrc)
   {
     GstStateChangeReturn ret;
@@ -947,11 +2529,45 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
 
   if (udpport->udpsrc_requested_pad)
   {
-    gst_element_release_request_pad (udpport->funnel,
+    gst_element_release_request_pad (
+        udpport->shard_funnel ? udpport->shard_funnel : udpport->funnel,
         udpport->udpsrc_requested_pad);
     gst_object_unref (udpport->udpsrc_requested_pad);
   }
 
+  for (i = 0; i < udpport->n_extra_shards; i++)
+  {
+    struct UdpShard *shard = &udpport->extra_shards[i];
+
+    if (shard->multiudpsrc_pad)
+      fs_multiudpsrc_release_pad (shard->multiudpsrc_pad);
+
+    if (shard->udpsrc)
+      _remove_element (GST_BIN (trans->priv->gst_src), shard->udpsrc);
+
+    if (shard->requested_pad)
+    {
+      gst_element_release_request_pad (udpport->shard_funnel,
+          shard->requested_pad);
+      gst_object_unref (shard->requested_pad);
+    }
+
+    if (shard->socket)
+      g_socket_close (shard->socket, NULL);
+    g_clear_object (&shard->socket);
+  }
+  g_free (udpport->extra_shards);
+
+  if (udpport->shard_funnel)
+    _remove_element (GST_BIN (trans->priv->gst_src), udpport->shard_funnel);
+
+  if (udpport->shard_funnel_requested_pad)
+  {
+    gst_element_release_request_pad (udpport->funnel,
+        udpport->shard_funnel_requested_pad);
+    gst_object_unref (udpport->shard_funnel_requested_pad);
+  }
+
   if (udpport->udpsink_requested_pad)
   {
     gst_element_release_request_pad (udpport->tee,
@@ -971,10 +2587,16 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
       GST_ERROR ("Could not remove udpsink element from transmitter source");
   }
 
-  if (udpport->socket)
+  fs_rawudp_transmitter_pacer_flush (trans, udpport);
+
+  /* With RTCP-mux, the socket belongs to the RTP UdpPort */
+  if (udpport->socket && !udpport->rtp_udpport)
     g_socket_close (udpport->socket, NULL);
   g_clear_object (&udpport->socket);
 
+  if (udpport->rtp_udpport)
+    fs_rawudp_transmitter_put_udpport (trans, udpport->rtp_udpport);
+
   if (udpport->known_addresses)
   {
     guint i;
@@ -984,6 +2606,18 @@ fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
     g_array_free (udpport->known_addresses, TRUE);
   }
 
+  if (udpport->known_sources)
+    g_hash_table_unref (udpport->known_sources);
+
+  if (udpport->dests)
+  {
+    guint i;
+    for (i = 0; i < udpport->dests->len; i++)
+      g_free (g_array_index (udpport->dests, struct UdpDest, i).ip);
+    g_array_free (udpport->dests, TRUE);
+  }
+  g_clear_object (&udpport->connect_addr);
+
   g_free (udpport->requested_ip);
   g_mutex_clear (&udpport->mutex);
   g_slice_free (UdpPort, udpport);
@@ -994,7 +2628,42 @@ fs_rawudp_transmitter_udpport_add_dest (UdpPort *udpport,
     const gchar *ip,
     gint port)
 {
+  gint i;
+
   GST_DEBUG ("Adding dest %s:%d", ip, port);
+
+  /* Stop bypassing the udpsink before it has a second destination */
+  g_mutex_lock (&udpport->mutex);
+  i = _udpport_find_dest_locked (udpport, ip, port);
+  if (i >= 0)
+  {
+    g_array_index (udpport->dests, struct UdpDest, i).refcount++;
+  }
+  else
+  {
+    struct UdpDest dest = { g_strdup (ip), port, 1 };
+    GInetAddress *addr = g_inet_address_new_from_string (ip);
+
+    /* The udpsink resolves the others, and maps IPv4 on IPv6 sockets */
+    if (addr && g_inet_address_get_family (addr) ==
+        g_socket_get_family (udpport->socket))
+    {
+      GSocketAddress *sockaddr = g_inet_socket_address_new (addr, port);
+      gssize len = g_socket_address_get_native_size (sockaddr);
+
+      if (len > 0 && g_socket_address_to_native (sockaddr, &dest.addr,
+              sizeof (dest.addr), NULL))
+        dest.addrlen = len;
+      g_object_unref (sockaddr);
+    }
+    if (addr)
+      g_object_unref (addr);
+
+    g_array_append_val (udpport->dests, dest);
+    _udpport_update_connect_addr_locked (udpport);
+  }
+  g_mutex_unlock (&udpport->mutex);
+
   g_signal_emit_by_name (udpport->udpsink, "add", ip, port);
   gst_element_send_event (udpport->udpsink,
       gst_event_new_custom (GST_EVENT_CUSTOM_UPSTREAM,
@@ -1009,6 +2678,20 @@ fs_rawudp_transmitter_udpport_remove_dest (UdpPort *udpport,
   const gchar *ip,
     gint port)
 {
+  gint i;
+
+  /* Disconnect from it before the udpsink forgets it */
+  g_mutex_lock (&udpport->mutex);
+  i = _udpport_find_dest_locked (udpport, ip, port);
+  if (i >= 0 &&
+      --g_array_index (udpport->dests, struct UdpDest, i).refcount == 0)
+  {
+    g_free (g_array_index (udpport->dests, struct UdpDest, i).ip);
+    g_array_remove_index_fast (udpport->dests, i);
+    _udpport_update_connect_addr_locked (udpport);
+  }
+  g_mutex_unlock (&udpport->mutex);
+
   g_signal_emit_by_name (udpport->udpsink, "remove", ip, port);
 }
 
@@ -1024,6 +2707,20 @@ fs_rawudp_transmitter_udpport_sendto (UdpPort *udpport,
   gboolean ret;
 
   addr = g_socket_address_new_from_native ((gpointer) to, tolen);
+
+  /* A connected socket would only receive the answers of its peer */
+  if (!udpport->rtp_udpport)
+  {
+    g_mutex_lock (&udpport->mutex);
+    if (udpport->connect_addr &&
+        !fs_g_inet_socket_address_equal (addr, udpport->connect_addr))
+    {
+      udpport->sent_elsewhere = TRUE;
+      _udpport_disconnect_locked (udpport);
+    }
+    g_mutex_unlock (&udpport->mutex);
+  }
+
   ret = g_socket_send_to (udpport->socket, addr, msg, len, NULL, error);
   g_object_unref (addr);
 
@@ -1038,7 +2735,7 @@ fs_rawudp_transmitter_udpport_connect_recv (UdpPort *udpport,
   GstPad *pad;
   gulong id;
 
-  pad = gst_element_get_static_pad (udpport->udpsrc, "src");
+  pad = _udpport_get_recv_pad (udpport);
 
   id = gst_pad_add_probe (pad,
       GST_PAD_PROBE_TYPE_BUFFER,
@@ -1054,7 +2751,7 @@ void
 fs_rawudp_transmitter_udpport_disconnect_recv (UdpPort *udpport,
     gulong id)
 {
-  GstPad *pad = gst_element_get_static_pad (udpport->udpsrc, "src");
+  GstPad *pad = _udpport_get_recv_pad (udpport);
 
   gst_pad_remove_probe (pad, id);
 
@@ -1068,7 +2765,7 @@ fs_rawudp_transmitter_udpport_is_pad (UdpPort *udpport,
   GstPad *mypad;
   gboolean res;
 
-  mypad =  gst_element_get_static_pad (udpport->udpsrc, "src");
+  mypad = _udpport_get_recv_pad (udpport);
 
   res = (mypad == pad);
 
@@ -1084,6 +2781,107 @@ fs_rawudp_transmitter_udpport_get_port (UdpPort *udpport)
   return udpport->port;
 }
 
+/**
+ * fs_rawudp_transmitter_udpport_get_path_mtu:
+ * @udpport: a #UdpPort
+ * @address: the destination
+ *
+ * Asks the kernel for the MTU of the path to @address, as learnt by path
+ * MTU discovery or from the route if no ICMP error came back yet. A socket
+ * connected to @address is needed for that, a temporary one is used so
+ * that the socket of the port is only connected when it is asked for.
+ *
+ * Returns: the largest UDP payload that fits in the path MTU, or 0 if it
+ * is not known
+ */
+guint
+fs_rawudp_transmitter_udpport_get_path_mtu (UdpPort *udpport,
+    GSocketAddress *address)
+{
+  struct sockaddr_storage addr;
+  gssize len = g_socket_address_get_native_size (address);
+  int level, optname, headers, max_mtu;
+  int fd = -1;
+  int mtu = 0;
+  socklen_t mtulen = sizeof (mtu);
+
+  switch (g_socket_address_get_family (address))
+  {
+    case G_SOCKET_FAMILY_IPV4:
+#ifdef IP_MTU
+      level = IPPROTO_IP;
+      optname = IP_MTU;
+      headers = IPV4_UDP_HEADERS;
+      /* The total length of the packet is 16 bits */
+      max_mtu = G_MAXUINT16;
+      break;
+#else
+      return 0;
+#endif
+    case G_SOCKET_FAMILY_IPV6:
+#ifdef IPV6_MTU
+      level = IPPROTO_IPV6;
+      optname = IPV6_MTU;
+      headers = IPV6_UDP_HEADERS;
+      /* Only the length of the payload is 16 bits, without jumbograms */
+      max_mtu = G_MAXUINT16 + 40;
+      break;
+#else
+      return 0;
+#endif
+    default:
+      return 0;
+  }
+
+  if (len < 0 ||
+      !g_socket_address_to_native (address, &addr, sizeof (addr), NULL))
+    return 0;
+
+  /* Connecting a UDP socket sends nothing, it only looks up the route */
+  fd = socket (addr.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+  if (fd < 0 ||
+      connect (fd, (struct sockaddr *) &addr, len) < 0 ||
+      getsockopt (fd, level, optname, &mtu, &mtulen) < 0)
+  {
+    GST_DEBUG ("Could not get the path MTU of port %u: %s", udpport->port,
+        g_strerror (errno));
+    mtu = 0;
+  }
+  if (fd >= 0)
+    close (fd);
+
+  if (mtu <= headers)
+    return 0;
+
+  return MIN (mtu, max_mtu) - headers;
+}
+
+/**
+ * fs_rawudp_transmitter_udpport_get_socket_stats:
+ * @udpport: a #UdpPort
+ * @receive_drops: (out): the number of packets the kernel dropped, summed
+ * over all the shards
+ * @receive_buffer_size: (out): the size of the receive buffer
+ * @send_buffer_size: (out): the size of the send buffer
+ *
+ * Reads the statistics of the socket of the port, the buffer sizes are the
+ * ones the kernel reports.
+ */
+void
+fs_rawudp_transmitter_udpport_get_socket_stats (UdpPort *udpport,
+    guint *receive_drops,
+    gint *receive_buffer_size,
+    gint *send_buffer_size)
+{
+  guint i;
+
+  *receive_drops = _get_socket_drops (udpport->socket);
+  for (i = 0; i < udpport->n_extra_shards; i++)
+    *receive_drops += _get_socket_drops (udpport->extra_shards[i].socket);
+
+  *receive_buffer_size = _get_socket_buffer_size (udpport->socket, TRUE);
+  *send_buffer_size = _get_socket_buffer_size (udpport->socket, FALSE);
+}
 
 static GType
 fs_rawudp_transmitter_get_stream_transmitter_type (FsTransmitter *transmitter)
@@ -1091,13 +2889,29 @@ fs_rawudp_transmitter_get_stream_transmitter_type (FsTransmitter *transmitter)
   return FS_TYPE_RAWUDP_STREAM_TRANSMITTER;
 }
 
+static void
+_known_source_insert (UdpPort *udpport,
+    GSocketAddress *address,
+    FsRawUdpKnownSourceCallbackFunc packet_callback,
+    gpointer user_data)
+{
+  struct KnownSource *ks = g_slice_new (struct KnownSource);
+
+  ks->packet_callback = packet_callback;
+  ks->user_data = user_data;
+
+  g_hash_table_insert (udpport->known_sources, g_object_ref (address), ks);
+}
+
 /**
  * fs_rawudp_transmitter_udpport_add_known_address:
  * @udpport: a #UdpPort
  * @address: the new #GSocketAddress that we know
  * @callback: a Callback that will be called if the uniqueness of an address
  *   changes
- * @user_data: data passed back to the callback
+ * @packet_callback: (allow-none): a callback called with every packet
+ *   received from this address while it is unique
+ * @user_data: the #GObject passed back to the callbacks
  *
  * This function stores the passed address and tells the caller if it was
  * unique or not. The callback is called when the uniqueness changes.
@@ -1109,6 +2923,7 @@ gboolean
 fs_rawudp_transmitter_udpport_add_known_address (UdpPort *udpport,
     GSocketAddress *address,
     FsRawUdpAddressUniqueCallbackFunc callback,
+    FsRawUdpKnownSourceCallbackFunc packet_callback,
     gpointer user_data)
 {
   gint i;
@@ -1138,18 +2953,23 @@ fs_rawudp_transmitter_udpport_add_known_address (UdpPort *udpport,
   if (counter == 0)
   {
     unique = TRUE;
+    if (packet_callback)
+      _known_source_insert (udpport, address, packet_callback, user_data);
   }
   else if (counter == 1)
   {
+    g_hash_table_remove (udpport->known_sources, address);
     if (prev_ka->callback)
       prev_ka->callback (FALSE, prev_ka->addr, prev_ka->user_data);
   }
 
   newka.addr = g_object_ref (address);
   newka.callback = callback;
+  newka.packet_callback = packet_callback;
   newka.user_data = user_data;
 
   g_array_append_val (udpport->known_addresses, newka);
+  _udpport_update_connect_addr_locked (udpport);
 
   g_mutex_unlock (&udpport->mutex);
 
@@ -1208,12 +3028,22 @@ fs_rawudp_transmitter_udpport_remove_known_address (UdpPort *udpport,
     goto out;
   }
 
-  if (counter == 1)
+  if (counter == 0)
+  {
+    g_hash_table_remove (udpport->known_sources, address);
+  }
+  else if (counter == 1)
+  {
+    if (prev_ka->packet_callback)
+      _known_source_insert (udpport, prev_ka->addr, prev_ka->packet_callback,
+          prev_ka->user_data);
     prev_ka->callback (TRUE, prev_ka->addr, prev_ka->user_data);
+  }
 
   g_object_unref (g_array_index (udpport->known_addresses,
           struct KnownAddress, remove_i).addr);
   g_array_remove_index_fast (udpport->known_addresses, remove_i);
+  _udpport_update_connect_addr_locked (udpport);
 
  out:
 
@@ -1239,15 +3069,8 @@ fs_rawudp_transmitter_set_type_of_service (FsRawUdpTransmitter *self,
     for (item = self->priv->udpports[i]; item; item = item->next)
     {
       UdpPort *udpport = item->data;
-      int fd = g_socket_get_fd (udpport->socket);
 
-      if (setsockopt (fd, IPPROTO_IP, IP_TOS, &tos, sizeof (tos)) < 0)
-        GST_WARNING ( "could not set socket ToS: %s", g_strerror (errno));
-
-#ifdef IPV6_TCLASS
-      if (setsockopt (fd, IPPROTO_IPV6, IPV6_TCLASS, &tos, sizeof (tos)) < 0)
-        GST_WARNING ("could not set TCLASS: %s", g_strerror (errno));
-#endif
+      _set_socket_tos (udpport->socket, tos);
     }
   }
 
@@ -1255,8 +3078,103 @@ fs_rawudp_transmitter_set_type_of_service (FsRawUdpTransmitter *self,
   g_mutex_unlock (&self->priv->mutex);
 }
 
+/* Returns the size to ask for a socket buffer that holds SOCKET_BUFFER_TIME
+ * of the bitrate */
+static gint
+_socket_buffer_size_for_bitrate (guint bitrate, gint default_size)
+{
+  guint64 size = gst_util_uint64_scale (bitrate, SOCKET_BUFFER_TIME,
+      8 * GST_SECOND);
+
+  return CLAMP (size, default_size, MAX_SOCKET_BUFFER_SIZE);
+}
+
+/* Resizing a buffer does not change the memory the kernel holds, only how
+ * much it lets the socket queue, but sizes within a quarter of the current
+ * one are ignored so that a bitrate that moves a little does not make a
+ * system call on every change */
+static gboolean
+_socket_buffer_size_changed (gint old_size, gint new_size)
+{
+  return ABS (new_size - old_size) > old_size / 4;
+}
+
+/* Must be called with the transmitter mutex held */
+static void
+_udpport_update_buffer_sizes_locked (FsRawUdpTransmitter *trans,
+    UdpPort *udpport)
+{
+  gint size;
+  guint i;
+
+  /* The RTCP ports see too little traffic to need it, and with RTCP-mux
+   * they use the socket of the RTP port */
+  if (udpport->component_id != FS_COMPONENT_RTP || udpport->rtp_udpport)
+    return;
+
+  size = _socket_buffer_size_for_bitrate (trans->priv->receive_bitrate,
+      udpport->default_rcvbuf);
+  if (_socket_buffer_size_changed (udpport->rcvbuf, size))
+  {
+    GST_DEBUG ("Resizing the receive buffers of port %u from %d to %d",
+        udpport->port, udpport->rcvbuf, size);
+    _set_socket_buffer_size (udpport->socket, TRUE, size);
+    for (i = 0; i < udpport->n_extra_shards; i++)
+      _set_socket_buffer_size (udpport->extra_shards[i].socket, TRUE, size);
+    udpport->rcvbuf = size;
+  }
+
+  size = _socket_buffer_size_for_bitrate (trans->priv->send_bitrate,
+      udpport->default_sndbuf);
+  if (_socket_buffer_size_changed (udpport->sndbuf, size))
+  {
+    GST_DEBUG ("Resizing the send buffer of port %u from %d to %d",
+        udpport->port, udpport->sndbuf, size);
+    _set_socket_buffer_size (udpport->socket, FALSE, size);
+    udpport->sndbuf = size;
+  }
+}
+
+static void
+fs_rawudp_transmitter_set_bitrate (FsRawUdpTransmitter *self,
+    gboolean receive,
+    guint bitrate)
+{
+  GList *item;
+
+  g_mutex_lock (&self->priv->mutex);
+  if (receive)
+    self->priv->receive_bitrate = bitrate;
+  else
+    self->priv->send_bitrate = bitrate;
+
+  /* The ports only exist once constructed */
+  if (self->priv->udpports)
+    for (item = self->priv->udpports[FS_COMPONENT_RTP]; item;
+         item = item->next)
+      _udpport_update_buffer_sizes_locked (self, item->data);
+
+  g_mutex_unlock (&self->priv->mutex);
+}
+
 
 /* TEMPORARY: should be in Glib */
+guint
+fs_g_inet_socket_address_hash (gconstpointer key)
+{
+  GInetSocketAddress *inet = G_INET_SOCKET_ADDRESS (key);
+  GInetAddress *addr = g_inet_socket_address_get_address (inet);
+  const guint8 *bytes = g_inet_address_to_bytes (addr);
+  gsize len = g_inet_address_get_native_size (addr);
+  guint hash = g_inet_socket_address_get_port (inet);
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    hash = hash * 31 + bytes[i];
+
+  return hash;
+}
+
 gboolean
 fs_g_inet_socket_address_equal (GSocketAddress *addr1, GSocketAddress *addr2)
 {
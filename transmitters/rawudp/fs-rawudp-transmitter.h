@@ -96,6 +96,9 @@ typedef struct _UdpPort UdpPort;
 typedef void (*FsRawUdpAddressUniqueCallbackFunc) (gboolean unique,
     GSocketAddress *address, gpointer user_data);
 
+typedef void (*FsRawUdpKnownSourceCallbackFunc) (GstBuffer *buffer,
+    gpointer user_data);
+
 GType fs_rawudp_transmitter_get_type (void);
 
 GST_DEBUG_CATEGORY_EXTERN (fs_rawudp_transmitter_debug);
@@ -104,6 +107,9 @@ UdpPort *fs_rawudp_transmitter_get_udpport (FsRawUdpTransmitter *trans,
     guint component_id,
     const gchar *requested_ip,
     guint requested_port,
+    guint receive_shards,
+    guint receive_threads,
+    gboolean rtcp_mux,
     GError **error);
 
 void fs_rawudp_transmitter_put_udpport (FsRawUdpTransmitter *trans,
@@ -134,10 +140,19 @@ gboolean fs_rawudp_transmitter_udpport_is_pad (UdpPort *udpport,
 
 gint fs_rawudp_transmitter_udpport_get_port (UdpPort *udpport);
 
+void fs_rawudp_transmitter_udpport_get_socket_stats (UdpPort *udpport,
+    guint *receive_drops,
+    gint *receive_buffer_size,
+    gint *send_buffer_size);
+
+guint fs_rawudp_transmitter_udpport_get_path_mtu (UdpPort *udpport,
+    GSocketAddress *address);
+
 
 gboolean fs_rawudp_transmitter_udpport_add_known_address (UdpPort *udpport,
     GSocketAddress *address,
     FsRawUdpAddressUniqueCallbackFunc callback,
+    FsRawUdpKnownSourceCallbackFunc packet_callback,
     gpointer user_data);
 
 void fs_rawudp_transmitter_udpport_remove_known_address (UdpPort *udpport,
@@ -145,6 +160,7 @@ void fs_rawudp_transmitter_udpport_remove_known_address (UdpPort *udpport,
     FsRawUdpAddressUniqueCallbackFunc callback,
     gpointer user_data);
 
+guint fs_g_inet_socket_address_hash (gconstpointer key);
 gboolean fs_g_inet_socket_address_equal (GSocketAddress *addr1,
     GSocketAddress *addr2);
 
@@ -0,0 +1,396 @@
+/*
+ * Farstream - Farstream io_uring UDP Transmitter
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * fs-uring-transmitter.c - A Farstream UDP transmitter using io_uring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+/**
+ * SECTION:fs-uring-transmitter
+ * @short_description: A transmitter for unicast UDP through io_uring
+ * @see_also: #FsRawUdpStreamTransmitter
+ *
+ * This transmitter behaves like the "rawudp" transmitter: its stream
+ * transmitters are #FsRawUdpStreamTransmitter, with the same properties, the
+ * same candidates and the same handling of the known sources. Only the way
+ * the packets go through the sockets differs. They are sent by the
+ * fsuringudpsink element, which submits a whole buffer list at once, and all
+ * the ports are read by one fsmultiudpsrc in io-uring mode, where every
+ * socket has a multishot receive filling a ring of buffers registered with
+ * the kernel.
+ *
+ * It is a raw UDP transmitter with the #FsRawUdpTransmitter:io-uring
+ * property set, so the rawudp transmitter and both elements must be
+ * installed, and the kernel must allow the use of io_uring.
+ *
+ * The name of this transmitter is "uring".
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "fs-uring-transmitter.h"
+
+#include <farstream/fs-conference.h>
+#include <farstream/fs-plugin.h>
+
+GST_DEBUG_CATEGORY (fs_uring_transmitter_debug);
+#define GST_CAT_DEFAULT fs_uring_transmitter_debug
+
+/* props */
+enum
+{
+  PROP_0,
+  PROP_GST_SINK,
+  PROP_GST_SRC,
+  PROP_COMPONENTS,
+  PROP_TYPE_OF_SERVICE,
+  PROP_DO_TIMESTAMP,
+  PROP_RECEIVE_MTU,
+  PROP_RECEIVE_BUFFERS,
+  PROP_SEND_BITRATE,
+  PROP_RECEIVE_BITRATE
+};
+
+struct _FsUringTransmitterPrivate
+{
+  /* The raw UDP transmitter in io-uring mode that does all the work */
+  FsTransmitter *rawudp;
+};
+
+#define FS_URING_TRANSMITTER_GET_PRIVATE(o)                             \
+  (G_TYPE_INSTANCE_GET_PRIVATE ((o), FS_TYPE_URING_TRANSMITTER,         \
+      FsUringTransmitterPrivate))
+
+static void fs_uring_transmitter_class_init (FsUringTransmitterClass *klass);
+static void fs_uring_transmitter_init (FsUringTransmitter *self);
+static void fs_uring_transmitter_constructed (GObject *object);
+static void fs_uring_transmitter_dispose (GObject *object);
+
+static void fs_uring_transmitter_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec);
+static void fs_uring_transmitter_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec);
+
+static FsStreamTransmitter *fs_uring_transmitter_new_stream_transmitter (
+    FsTransmitter *transmitter,
+    FsParticipant *participant,
+    guint n_parameters,
+    GParameter *parameters,
+    GError **error);
+static GType fs_uring_transmitter_get_stream_transmitter_type (
+    FsTransmitter *transmitter);
+
+
+static GObjectClass *parent_class = NULL;
+
+/*
+ * Lets register the plugin
+ */
+
+static GType type = 0;
+
+GType
+fs_uring_transmitter_get_type (void)
+{
+  g_assert (type);
+  return type;
+}
+
+static GType
+fs_uring_transmitter_register_type (FsPlugin *module)
+{
+  static const GTypeInfo info = {
+    sizeof (FsUringTransmitterClass),
+    NULL,
+    NULL,
+    (GClassInitFunc) fs_uring_transmitter_class_init,
+    NULL,
+    NULL,
+    sizeof (FsUringTransmitter),
+    0,
+    (GInstanceInitFunc) fs_uring_transmitter_init
+  };
+
+  GST_DEBUG_CATEGORY_INIT (fs_uring_transmitter_debug,
+      "fsuringtransmitter", 0,
+      "Farstream io_uring UDP transmitter");
+
+  type = g_type_register_static (FS_TYPE_TRANSMITTER, "FsUringTransmitter",
+      &info, 0);
+
+  return type;
+}
+
+FS_INIT_PLUGIN (uring, transmitter)
+
+static void
+fs_uring_transmitter_class_init (FsUringTransmitterClass *klass)
+{
+  GObjectClass *gobject_class = (GObjectClass *) klass;
+  FsTransmitterClass *transmitter_class = FS_TRANSMITTER_CLASS (klass);
+
+  parent_class = g_type_class_peek_parent (klass);
+
+  gobject_class->set_property = fs_uring_transmitter_set_property;
+  gobject_class->get_property = fs_uring_transmitter_get_property;
+
+  gobject_class->constructed = fs_uring_transmitter_constructed;
+
+  g_object_class_override_property (gobject_class, PROP_GST_SRC, "gst-src");
+  g_object_class_override_property (gobject_class, PROP_GST_SINK, "gst-sink");
+  g_object_class_override_property (gobject_class, PROP_COMPONENTS,
+      "components");
+  g_object_class_override_property (gobject_class, PROP_TYPE_OF_SERVICE,
+      "tos");
+  g_object_class_override_property (gobject_class, PROP_DO_TIMESTAMP,
+      "do-timestamp");
+
+  /**
+   * FsUringTransmitter:receive-mtu:
+   *
+   * See #FsRawUdpTransmitter:receive-mtu
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_MTU,
+      g_param_spec_uint ("receive-mtu",
+          "Receive MTU",
+          "The size of the preallocated receive buffers (0 to allocate one"
+          " per packet)",
+          0, 65536,
+          1500,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsUringTransmitter:receive-buffers:
+   *
+   * See #FsRawUdpTransmitter:receive-buffers
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BUFFERS,
+      g_param_spec_uint ("receive-buffers",
+          "Receive buffers",
+          "The number of receive buffers preallocated per port",
+          0, G_MAXUINT,
+          16,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsUringTransmitter:send-bitrate:
+   *
+   * See #FsRawUdpTransmitter:send-bitrate
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_SEND_BITRATE,
+      g_param_spec_uint ("send-bitrate",
+          "Send bitrate",
+          "The bitrate the RTP send buffers are sized for, in bits/s"
+          " (0 for the default size)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * FsUringTransmitter:receive-bitrate:
+   *
+   * See #FsRawUdpTransmitter:receive-bitrate
+   */
+  g_object_class_install_property (gobject_class,
+      PROP_RECEIVE_BITRATE,
+      g_param_spec_uint ("receive-bitrate",
+          "Receive bitrate",
+          "The bitrate the RTP receive buffers are sized for, in bits/s"
+          " (0 for the default size)",
+          0, G_MAXUINT, 0,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  transmitter_class->new_stream_transmitter =
+    fs_uring_transmitter_new_stream_transmitter;
+  transmitter_class->get_stream_transmitter_type =
+    fs_uring_transmitter_get_stream_transmitter_type;
+
+  gobject_class->dispose = fs_uring_transmitter_dispose;
+
+  g_type_class_add_private (klass, sizeof (FsUringTransmitterPrivate));
+}
+
+static void
+fs_uring_transmitter_init (FsUringTransmitter *self)
+{
+  /* member init */
+  self->priv = FS_URING_TRANSMITTER_GET_PRIVATE (self);
+
+  self->components = 2;
+}
+
+static void
+_rawudp_error (FsTransmitter *rawudp,
+    gint errorno,
+    gchar *error_msg,
+    gpointer user_data)
+{
+  fs_transmitter_emit_error (FS_TRANSMITTER (user_data), errorno, error_msg);
+}
+
+static void
+fs_uring_transmitter_constructed (GObject *object)
+{
+  FsUringTransmitter *self = FS_URING_TRANSMITTER_CAST (object);
+  FsTransmitter *trans = FS_TRANSMITTER_CAST (self);
+  GError *error = NULL;
+  GstElementFactory *factory;
+
+  /* Fail early rather than when the first stream is created */
+  factory = gst_element_factory_find ("fsuringudpsink");
+  if (!factory)
+  {
+    trans->construction_error = g_error_new (FS_ERROR,
+        FS_ERROR_CONSTRUCTION,
+        "The fsuringudpsink element is not installed");
+    return;
+  }
+  gst_object_unref (factory);
+
+  self->priv->rawudp = FS_TRANSMITTER (fs_plugin_create ("rawudp",
+          "transmitter", &error,
+          "components", self->components,
+          "io-uring", TRUE,
+          NULL));
+
+  if (!self->priv->rawudp)
+  {
+    trans->construction_error = error;
+    return;
+  }
+
+  if (self->priv->rawudp->construction_error)
+  {
+    trans->construction_error = self->priv->rawudp->construction_error;
+    self->priv->rawudp->construction_error = NULL;
+    g_object_unref (self->priv->rawudp);
+    self->priv->rawudp = NULL;
+    return;
+  }
+
+  g_signal_connect_object (self->priv->rawudp, "error",
+      G_CALLBACK (_rawudp_error), self, 0);
+
+  GST_CALL_PARENT (G_OBJECT_CLASS, constructed, (object));
+}
+
+static void
+fs_uring_transmitter_dispose (GObject *object)
+{
+  FsUringTransmitter *self = FS_URING_TRANSMITTER (object);
+
+  if (self->priv->rawudp)
+  {
+    g_object_unref (self->priv->rawudp);
+    self->priv->rawudp = NULL;
+  }
+
+  parent_class->dispose (object);
+}
+
+static void
+fs_uring_transmitter_get_property (GObject *object,
+    guint prop_id,
+    GValue *value,
+    GParamSpec *pspec)
+{
+  FsUringTransmitter *self = FS_URING_TRANSMITTER (object);
+
+  switch (prop_id)
+  {
+    case PROP_COMPONENTS:
+      g_value_set_uint (value, self->components);
+      break;
+    case PROP_GST_SINK:
+    case PROP_GST_SRC:
+    case PROP_TYPE_OF_SERVICE:
+    case PROP_DO_TIMESTAMP:
+    case PROP_RECEIVE_MTU:
+    case PROP_RECEIVE_BUFFERS:
+    case PROP_SEND_BITRATE:
+    case PROP_RECEIVE_BITRATE:
+      if (self->priv->rawudp)
+        g_object_get_property (G_OBJECT (self->priv->rawudp),
+            g_param_spec_get_name (pspec), value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static void
+fs_uring_transmitter_set_property (GObject *object,
+    guint prop_id,
+    const GValue *value,
+    GParamSpec *pspec)
+{
+  FsUringTransmitter *self = FS_URING_TRANSMITTER (object);
+
+  switch (prop_id)
+  {
+    case PROP_COMPONENTS:
+      self->components = g_value_get_uint (value);
+      break;
+    case PROP_TYPE_OF_SERVICE:
+    case PROP_DO_TIMESTAMP:
+    case PROP_RECEIVE_MTU:
+    case PROP_RECEIVE_BUFFERS:
+    case PROP_SEND_BITRATE:
+    case PROP_RECEIVE_BITRATE:
+      /* These are not construct properties, so they are only set once the
+       * raw UDP transmitter exists */
+      if (self->priv->rawudp)
+        g_object_set_property (G_OBJECT (self->priv->rawudp),
+            g_param_spec_get_name (pspec), value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+      break;
+  }
+}
+
+static FsStreamTransmitter *
+fs_uring_transmitter_new_stream_transmitter (FsTransmitter *transmitter,
+    FsParticipant *participant,
+    guint n_parameters,
+    GParameter *parameters,
+    GError **error)
+{
+  FsUringTransmitter *self = FS_URING_TRANSMITTER (transmitter);
+
+  return fs_transmitter_new_stream_transmitter (self->priv->rawudp,
+      participant, n_parameters, parameters, error);
+}
+
+static GType
+fs_uring_transmitter_get_stream_transmitter_type (
+    FsTransmitter *transmitter)
+{
+  FsUringTransmitter *self = FS_URING_TRANSMITTER (transmitter);
+
+  return fs_transmitter_get_stream_transmitter_type (self->priv->rawudp);
+}
@@ -0,0 +1,87 @@
+/*
+ * Farstream - Farstream io_uring UDP Transmitter
+ *
+ * Copyright 2026 The Farstream contributors
+ *
+ * fs-uring-transmitter.h - A Farstream UDP transmitter using io_uring
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301 USA
+ */
+
+#ifndef __FS_URING_TRANSMITTER_H__
+#define __FS_URING_TRANSMITTER_H__
+
+#include <farstream/fs-transmitter.h>
+
+#include <gst/gst.h>
+
+G_BEGIN_DECLS
+
+/* TYPE MACROS */
+#define FS_TYPE_URING_TRANSMITTER \
+  (fs_uring_transmitter_get_type ())
+#define FS_URING_TRANSMITTER(obj) \
+  (G_TYPE_CHECK_INSTANCE_CAST((obj), FS_TYPE_URING_TRANSMITTER, \
+    FsUringTransmitter))
+#define FS_URING_TRANSMITTER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_CAST((klass), FS_TYPE_URING_TRANSMITTER, \
+    FsUringTransmitterClass))
+#define FS_IS_URING_TRANSMITTER(obj) \
+  (G_TYPE_CHECK_INSTANCE_TYPE((obj), FS_TYPE_URING_TRANSMITTER))
+#define FS_IS_URING_TRANSMITTER_CLASS(klass) \
+  (G_TYPE_CHECK_CLASS_TYPE((klass), FS_TYPE_URING_TRANSMITTER))
+#define FS_URING_TRANSMITTER_GET_CLASS(obj) \
+  (G_TYPE_INSTANCE_GET_CLASS ((obj), FS_TYPE_URING_TRANSMITTER, \
+    FsUringTransmitterClass))
+#define FS_URING_TRANSMITTER_CAST(obj) ((FsUringTransmitter *) (obj))
+
+typedef struct _FsUringTransmitter FsUringTransmitter;
+typedef struct _FsUringTransmitterClass FsUringTransmitterClass;
+typedef struct _FsUringTransmitterPrivate FsUringTransmitterPrivate;
+
+/**
+ * FsUringTransmitterClass:
+ * @parent_class: Our parent
+ *
+ * The io_uring UDP transmitter class
+ */
+
+struct _FsUringTransmitterClass
+{
+  FsTransmitterClass parent_class;
+};
+
+/**
+ * FsUringTransmitter:
+ * @parent: Parent object
+ *
+ * All members are private, access them using methods and properties
+ */
+struct _FsUringTransmitter
+{
+  FsTransmitter parent;
+
+  /* The number of components (READONLY) */
+  gint components;
+
+  /*< private >*/
+  FsUringTransmitterPrivate *priv;
+};
+
+GType fs_uring_transmitter_get_type (void);
+
+G_END_DECLS
+
+#endif /* __FS_URING_TRANSMITTER_H__ */